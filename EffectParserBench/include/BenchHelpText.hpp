@@ -0,0 +1,92 @@
+#pragma once
+#include <string_view>
+#include "WeaveEffects/Version.hpp"
+
+// Build names are only defined by some project configurations
+#ifdef BUILD_NAME
+#define FXB_VERSION_STRING VERSION_STRING
+#elif defined(NDEBUG)
+#define FXB_VERSION_STRING STRINGIZE(VERSION_MAJOR) "." STRINGIZE(VERSION_MINOR) "." STRINGIZE(VERSION_PATCH) \
+    " (Release Build " STRINGIZE(VERSION_BUILD) ")"
+#else
+#define FXB_VERSION_STRING STRINGIZE(VERSION_MAJOR) "." STRINGIZE(VERSION_MINOR) "." STRINGIZE(VERSION_PATCH) \
+    " (Debug Build " STRINGIZE(VERSION_BUILD) ")"
+#endif
+
+constexpr std::string_view g_Bench_HelpText = R"(
+WFXB - Effect Parser Benchmark v)" FXB_VERSION_STRING R"(
+----------------------------------------------------
+Measures the throughput of the effect front end over a synthetic effect
+library or an existing, preprocessed source. Each iteration times:
+    lex        BlockAnalyzer::AnalyzeSource, with a new analyzer
+    retain     BlockAnalyzer::RetainAnalysis, copying the lexed blocks as a
+               base for other variants
+    lexVariant BlockAnalyzer::AnalyzeSource, over a copy of the source that
+               differs after its midpoint, reusing the retained blocks
+    parse      SymbolTable::ParseBlocks
+    generate   ShaderGenerator::GetShaderSource, for every shader block
+
+Generated sources declare variant flags and modes via #pragma shader, but
+are not preprocessed, so no variants are expanded.
+
+With --tick-jitter, measures TickLimiter timing error instead, over an
+empty update loop at the given tick time.
+
+USAGE:
+    wfxb [options]
+    wfxb --input <file> [options]
+    wfxb --tick-jitter <us> [--ticks <n>] [--spin-limit <us>] [--format <json|csv>]
+
+OPTIONS:
+    --size <KB>
+                      Minimum size of the generated source in KB.
+                      Default: 256.
+
+    --seed <n>
+                      Generator seed. Equal seeds and sizes always produce
+                      identical sources. Default: 1.
+
+    --input <file>
+                      Benchmarks the given source instead of generating
+                      one. The source must already be preprocessed.
+
+    --dump <file>
+                      Writes the benchmarked source to the given file.
+
+    --iterations <n>
+                      Number of timed iterations, after one untimed warmup
+                      iteration. Default: 10.
+
+    --lex-threads <n>
+                      Maximum number of threads used to lex the source.
+                      Default: 1.
+
+    --tick-jitter <us>
+                      Runs the tick jitter benchmark at the given target
+                      tick time in microseconds, instead of the parser
+                      benchmark.
+
+    --ticks <n>
+                      Number of ticks measured by the tick jitter
+                      benchmark. Default: 1000.
+
+    --spin-limit <us>
+                      Spin limit passed to TickLimiter::WaitTick, in
+                      microseconds. Default: 0, sleep only.
+
+    --format <json|csv>
+                      Output format. JSON writes a single object per run,
+                      CSV writes a header and one row per stage.
+                      Default: json.
+
+    --help
+                      Displays this help message.
+
+OUTPUT:
+    Results are written to stdout. For each stage, min, median, mean and
+    max time are given in milliseconds, with throughput in MB/s per mean
+    iteration time. Lex and parse throughput is measured over the source,
+    and generate throughput over the combined generated shader sources.
+    Tick jitter results give the absolute error of each tick's duration
+    against the target, in nanoseconds.
+)";
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include "WeaveUtils/Int.hpp"
+
+namespace Weave::Effects
+{
+    /// <summary>
+    /// Configuration for generated effect sources
+    /// </summary>
+    struct CorpusDesc
+    {
+        /// <summary>
+        /// Minimum length of the generated source in bytes. Generation stops after the first
+        /// module reaching it.
+        /// </summary>
+        size_t targetSize = 256 * 1024;
+
+        /// <summary>
+        /// Seed for the generator. Equal descriptions always produce identical sources.
+        /// </summary>
+        uint seed = 1;
+
+        /// <summary>
+        /// Number of variant flags declared via #pragma shader flags
+        /// </summary>
+        uint flagCount = 4;
+
+        /// <summary>
+        /// Number of shader modes declared via #pragma shader modes
+        /// </summary>
+        uint modeCount = 2;
+    };
+
+    /// <summary>
+    /// Writes a synthetic effect source to the given string, in the style of the built-in effect
+    /// libraries. The source is composed of independent modules, each containing global structs,
+    /// cbuffers and helper functions with nested scopes, vertex, pixel and compute shader blocks
+    /// using templated resources and attributes, and an effect with explicit passes. Returns the
+    /// number of modules written.
+    /// </summary>
+    uint GetSyntheticCorpus(const CorpusDesc& desc, std::string& srcOut);
+}
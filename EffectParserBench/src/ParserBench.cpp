@@ -0,0 +1,566 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <unordered_map>
+#include <charconv>
+#include <algorithm>
+#include <format>
+#include <memory>
+#include "WeaveEffects/EffectParseException.hpp"
+#include "WeaveUtils/GenericMain.hpp"
+#include "WeaveUtils/Stopwatch.hpp"
+#include "WeaveUtils/StatsRecorder.hpp"
+#include "WeaveUtils/TickLimiter.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
+#include "WeaveEffects/ShaderLibBuilder/SymbolTable.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderGenerator.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderEntrypoint.hpp"
+#include "WeaveEffects/Version.hpp"
+#include "SyntheticCorpus.hpp"
+#include "BenchHelpText.hpp"
+
+namespace fs = std::filesystem;
+using namespace Weave;
+using namespace Weave::Effects;
+
+//-----------------------------------------------------------------------------
+// Global Configuration Settings (controlled via command-line arguments)
+//-----------------------------------------------------------------------------
+
+// If true, the help page is shown
+static bool shouldShowHelp = false;
+// Generated source configuration
+static CorpusDesc corpusDesc;
+// Optional preprocessed source benchmarked instead of a generated one
+static string inputPath;
+// Optional path the benchmarked source is written to
+static string dumpPath;
+// Number of timed iterations
+static uint iterations = 10;
+// Maximum number of threads used to lex the source
+static uint lexThreads = 1;
+// Output format name
+static string outputFormat;
+// Target tick time for the tick jitter benchmark, in microseconds. Zero runs the parser benchmark.
+static uint jitterTickUS = 0;
+// Number of ticks measured by the tick jitter benchmark
+static uint jitterTicks = 1000;
+// Spin limit used by the tick jitter benchmark, in microseconds
+static uint jitterSpinUS = 0;
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+// Source path reported to the parser for generated sources
+static constexpr string_view s_CorpusPath = "SyntheticCorpus.wfx";
+
+// Stage names, in order of execution
+static constexpr string_view s_LexStage = "lex";
+static constexpr string_view s_RetainStage = "retain";
+static constexpr string_view s_LexVariantStage = "lexVariant";
+static constexpr string_view s_ParseStage = "parse";
+static constexpr string_view s_GenerateStage = "generate";
+
+//-----------------------------------------------------------------------------
+// Command-line Option Handlers
+//-----------------------------------------------------------------------------
+
+/// <summary>
+/// Helper to read the next argument specifically as a string value for an option.
+/// Ensures the option is not specified more than once.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, the next token is an option, or the option was already set.</exception>
+static void SetStringParam(const IDynamicArray<string_view>& args, int& pos, string& param)
+{
+    int originalPos = pos;
+    pos++;
+
+    FX_CHECK_MSG(pos < args.GetLength() && (args[pos].empty() || args[pos][0] != '-'),
+        "Expected argument after option '{}'", args[originalPos]);
+    FX_CHECK_MSG(param.empty(),
+        "Option '{}' specified more than once", args[originalPos]);
+
+    param = args[pos];
+}
+
+/// <summary>
+/// Helper to read the next argument as a positive integer count for an option.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a positive integer.</exception>
+static void SetCountParam(const IDynamicArray<string_view>& args, int& pos, uint& param)
+{
+    string count;
+    SetStringParam(args, pos, count);
+
+    const auto result = std::from_chars(count.data(), count.data() + count.size(), param);
+    FX_CHECK_MSG(result.ec == std::errc() && result.ptr == (count.data() + count.size()) && param > 0,
+        "Expected a positive integer count after '{}'. Found: '{}'", args[pos - 1], count);
+}
+
+// Sets help page flag
+static void SetShowHelp(const IDynamicArray<string_view>& args, int& pos) { shouldShowHelp = true; }
+
+// Sets the preprocessed input source using SetStringParam.
+static void SetInput(const IDynamicArray<string_view>& args, int& pos) { SetStringParam(args, pos, inputPath); }
+
+// Sets the path the benchmarked source is written to using SetStringParam.
+static void SetDump(const IDynamicArray<string_view>& args, int& pos) { SetStringParam(args, pos, dumpPath); }
+
+// Sets the number of timed iterations.
+static void SetIterations(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, iterations); }
+
+// Sets the maximum number of threads used to lex the source.
+static void SetLexThreads(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, lexThreads); }
+
+// Sets the target tick time and enables the tick jitter benchmark.
+static void SetTickJitter(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, jitterTickUS); }
+
+// Sets the number of ticks measured by the tick jitter benchmark.
+static void SetTicks(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, jitterTicks); }
+
+// Sets the spin limit used by the tick jitter benchmark.
+static void SetSpinLimit(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, jitterSpinUS); }
+
+// Sets the generator seed.
+static void SetSeed(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, corpusDesc.seed); }
+
+/// <summary>
+/// Sets the minimum size of the generated source, in KB.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a positive integer.</exception>
+static void SetSize(const IDynamicArray<string_view>& args, int& pos)
+{
+    uint sizeKB = 0;
+    SetCountParam(args, pos, sizeKB);
+    corpusDesc.targetSize = (size_t)sizeKB * 1024;
+}
+
+/// <summary>
+/// Sets the output format.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the format is not recognized.</exception>
+static void SetFormat(const IDynamicArray<string_view>& args, int& pos)
+{
+    SetStringParam(args, pos, outputFormat);
+    FX_CHECK_MSG(outputFormat == "json" || outputFormat == "csv",
+        "Expected format 'json' or 'csv'. Found: '{}'", outputFormat);
+}
+
+/// Type alias for command-line option handler functions.
+typedef void (*OptionHandlerFunc)(const IDynamicArray<string_view>& args, int& pos);
+
+/// Maps long options (e.g., '--size') to their handler functions.
+static const std::unordered_map<string_view, OptionHandlerFunc> s_OptionMap
+{
+    { "help", SetShowHelp },
+    { "size", SetSize },
+    { "seed", SetSeed },
+    { "input", SetInput },
+    { "dump", SetDump },
+    { "iterations", SetIterations },
+    { "lex-threads", SetLexThreads },
+    { "format", SetFormat },
+    { "tick-jitter", SetTickJitter },
+    { "ticks", SetTicks },
+    { "spin-limit", SetSpinLimit }
+};
+
+/// <summary>
+/// Parses command-line arguments using the defined option map.
+/// </summary>
+/// <exception cref="EffectParseException">If an unknown option is encountered, or if arguments are malformed.</exception>
+static void HandleOptions(const IDynamicArray<string_view>& args)
+{
+    for (int i = 1; i < args.GetLength(); ++i)
+    {
+        const string_view& arg = args[i];
+        FX_CHECK_MSG(arg.size() > 2 && arg[0] == '-' && arg[1] == '-', "Unexpected argument: {}", arg);
+
+        const auto& it = s_OptionMap.find(arg.substr(2));
+        FX_CHECK_MSG(it != s_OptionMap.end(), "Unknown option: {}", arg);
+        const OptionHandlerFunc OptHandler = it->second;
+        OptHandler(args, i);
+    }
+
+    if (outputFormat.empty())
+        outputFormat = "json";
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark
+//-----------------------------------------------------------------------------
+
+/// <summary>
+/// Timing results for a single front end stage, in milliseconds
+/// </summary>
+struct StageStats
+{
+    string_view name;
+    StatsRecorder<double> timesMS;
+    size_t byteCount;
+
+    StageStats(string_view name, uint iterations) :
+        name(name),
+        timesMS(iterations),
+        byteCount(0)
+    { }
+
+    /// <summary>
+    /// Returns throughput in MB/s of text processed by the stage, per mean iteration time
+    /// </summary>
+    double GetThroughputMBS() const
+    {
+        const double meanMS = timesMS.GetAverage();
+        return (meanMS > 0) ? ((double)byteCount / (1024.0 * 1024.0)) / (meanMS * 1E-3) : 0;
+    }
+};
+
+/// <summary>
+/// Summary of the benchmarked source and its results
+/// </summary>
+struct BenchResults
+{
+    string srcPath;
+    size_t srcSize;
+    size_t lineCount;
+    size_t blockCount;
+    int symbolCount;
+    uint shaderCount;
+    UniqueVector<StageStats> stages;
+};
+
+/// <summary>
+/// Reads the entire content of a specified file into a string.
+/// </summary>
+/// <exception cref="EffectParseException">If the file doesn't exist, isn't a regular file, or cannot be opened.</exception>
+static void GetInput(const fs::path& path, string& text)
+{
+    FX_CHECK_MSG(fs::exists(path), "Input path does not exist: {}", path.string());
+    FX_CHECK_MSG(fs::is_regular_file(path), "Input path is not a regular file: {}", path.string());
+
+    std::ifstream inputStream(path, std::ios::binary);
+    FX_CHECK_MSG(inputStream.is_open(), "Failed to open input file: {}", path.string());
+
+    std::stringstream ss;
+    ss << inputStream.rdbuf();
+    text = ss.str();
+}
+
+/// <summary>
+/// Finds the entrypoint for each shader block, as done by the variant pipeline
+/// </summary>
+static void GetEntrypoints(const SymbolTable& table, UniqueVector<ShaderEntrypoint>& entrypoints)
+{
+    entrypoints.Clear();
+
+    for (int i = 0; i < table.GetSymbolCount(); i++)
+    {
+        SymbolHandle symbol = table.GetSymbol(i);
+
+        if (symbol.GetHasFlags(SymbolTypes::ShaderDef))
+        {
+            ScopeHandle scope = *symbol.GetScope();
+            string_view name = symbol.GetName();
+            const IDList* pFuncs = scope.TryGetFuncOverloads(name);
+
+            FX_CHECK_MSG(pFuncs != nullptr && !pFuncs->IsEmpty(), "Could not find entrypoint for shader block '{}'", name);
+            entrypoints.EmplaceBack(string(name), GetStageFromFlags(symbol.GetFlags()), pFuncs->GetBack());
+        }
+    }
+}
+
+/// <summary>
+/// Writes a copy of the source differing from it only after its midpoint, standing in for another
+/// variant of the same repo. The first space after the midpoint outside of a directive is replaced
+/// with a tab, leaving the blocks unchanged.
+/// </summary>
+static void GetVariantSource(string_view src, string& dst)
+{
+    dst = src;
+    size_t lineStart = dst.rfind('\n', dst.size() / 2);
+    lineStart = (lineStart != string::npos) ? lineStart + 1 : 0;
+
+    while (lineStart < dst.size())
+    {
+        size_t lineEnd = dst.find('\n', lineStart);
+        lineEnd = (lineEnd != string::npos) ? lineEnd : dst.size();
+
+        const size_t first = dst.find_first_not_of(" \t", lineStart);
+
+        if (first < lineEnd && dst[first] != '#')
+        {
+            const size_t space = dst.find(' ', std::max(first, dst.size() / 2));
+
+            if (space < lineEnd)
+            {
+                dst[space] = '\t';
+                return;
+            }
+        }
+
+        lineStart = lineEnd + 1;
+    }
+}
+
+/// <summary>
+/// Runs each front end stage over the source for the configured number of iterations, after an
+/// untimed warmup iteration. Cold lexing uses a new analyzer each iteration. Retaining copies that
+/// analysis as a base for other variants, as done once per repo for variant 0. Variant lexing uses
+/// another new analyzer given the retained base, measuring the restore of the shared prefix and 
+/// lexing of the rest.
+/// </summary>
+static void RunBench(string_view srcPath, string& src, BenchResults& results)
+{
+    std::unique_ptr<BlockAnalyzer> pAnalyzer;
+    std::unique_ptr<BlockAnalyzer> pVariantAnalyzer;
+    SymbolTable table;
+    ShaderGenerator generator;
+    UniqueVector<ShaderEntrypoint> entrypoints;
+    string variantSrc;
+    string hlslBuf;
+    Stopwatch timer;
+
+    GetVariantSource(src, variantSrc);
+
+    // Reserved up front, as stage references must remain valid
+    results.stages.Reserve(5);
+    StageStats& lex = results.stages.EmplaceBack(s_LexStage, iterations);
+    StageStats& retain = results.stages.EmplaceBack(s_RetainStage, iterations);
+    StageStats& lexVariant = results.stages.EmplaceBack(s_LexVariantStage, iterations);
+    StageStats& parse = results.stages.EmplaceBack(s_ParseStage, iterations);
+    StageStats& generate = results.stages.EmplaceBack(s_GenerateStage, iterations);
+
+    for (uint i = 0; i <= iterations; i++)
+    {
+        table.Clear();
+        pAnalyzer.reset(new BlockAnalyzer());
+        pAnalyzer->SetMaxThreads(lexThreads);
+
+        timer.Restart();
+        pAnalyzer->AnalyzeSource(srcPath, src);
+        timer.Stop();
+        const double lexMS = timer.GetElapsedMS();
+
+        timer.Restart();
+        pAnalyzer->RetainAnalysis(srcPath);
+        timer.Stop();
+        const double retainMS = timer.GetElapsedMS();
+
+        pVariantAnalyzer.reset(new BlockAnalyzer());
+        pVariantAnalyzer->SetMaxThreads(lexThreads);
+        pVariantAnalyzer->SetRetainedAnalysis(*pAnalyzer);
+
+        timer.Restart();
+        pVariantAnalyzer->AnalyzeSource(srcPath, variantSrc);
+        timer.Stop();
+        const double lexVariantMS = timer.GetElapsedMS();
+
+        const BlockAnalyzer& analyzer = *pAnalyzer;
+
+        timer.Restart();
+        table.ParseBlocks(analyzer);
+        timer.Stop();
+        const double parseMS = timer.GetElapsedMS();
+
+        GetEntrypoints(table, entrypoints);
+        generate.byteCount = 0;
+
+        timer.Restart();
+
+        for (const ShaderEntrypoint& ep : entrypoints)
+        {
+            hlslBuf.clear();
+            generator.GetShaderSource(table, analyzer.GetBlocks(), ep, entrypoints, hlslBuf);
+            generate.byteCount += hlslBuf.size();
+        }
+
+        timer.Stop();
+        const double generateMS = timer.GetElapsedMS();
+
+        // First iteration warms caches and allocations
+        if (i > 0)
+        {
+            lex.timesMS.AddValue(lexMS);
+            retain.timesMS.AddValue(retainMS);
+            lexVariant.timesMS.AddValue(lexVariantMS);
+            parse.timesMS.AddValue(parseMS);
+            generate.timesMS.AddValue(generateMS);
+        }
+    }
+
+    // Paths are written with forward slashes, keeping JSON output free of escapes
+    results.srcPath = fs::path(srcPath).generic_string();
+    results.srcSize = src.size();
+    lex.byteCount = src.size();
+    retain.byteCount = src.size();
+    lexVariant.byteCount = variantSrc.size();
+    parse.byteCount = src.size();
+    results.lineCount = std::count(src.begin(), src.end(), '\n') + 1;
+    results.blockCount = pAnalyzer->GetBlocks().GetLength();
+    results.symbolCount = table.GetSymbolCount();
+    results.shaderCount = (uint)entrypoints.GetLength();
+}
+
+//-----------------------------------------------------------------------------
+// Output
+//-----------------------------------------------------------------------------
+
+/// <summary>
+/// Writes results as a single JSON object
+/// </summary>
+static void WriteJSON(const BenchResults& results, std::ostream& out)
+{
+    out << std::format(
+        "{{\"version\":\"{}\",\"source\":\"{}\",\"seed\":{},\"sourceBytes\":{},\"lines\":{},\"blocks\":{},"
+        "\"symbols\":{},\"shaders\":{},\"iterations\":{},\"lexThreads\":{},\"stages\":[",
+        FXB_VERSION_STRING, results.srcPath, corpusDesc.seed, results.srcSize, results.lineCount, results.blockCount,
+        results.symbolCount, results.shaderCount, iterations, lexThreads
+    );
+
+    for (int i = 0; i < results.stages.GetLength(); i++)
+    {
+        const StageStats& stage = results.stages[i];
+        out << std::format(
+            "{}{{\"name\":\"{}\",\"bytes\":{},\"minMS\":{:.4f},\"medianMS\":{:.4f},\"meanMS\":{:.4f},\"maxMS\":{:.4f},\"MBps\":{:.2f}}}",
+            (i > 0) ? "," : "", stage.name, stage.byteCount, stage.timesMS.GetMin(), stage.timesMS.GetPercentile(0.5),
+            stage.timesMS.GetAverage(), stage.timesMS.GetMax(), stage.GetThroughputMBS()
+        );
+    }
+
+    out << "]}\n";
+}
+
+/// <summary>
+/// Writes results as CSV, with a header and one row per stage
+/// </summary>
+static void WriteCSV(const BenchResults& results, std::ostream& out)
+{
+    out << "stage,bytes,sourceBytes,lines,shaders,iterations,lexThreads,minMS,medianMS,meanMS,maxMS,MBps\n";
+
+    for (const StageStats& stage : results.stages)
+    {
+        out << std::format(
+            "{},{},{},{},{},{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.2f}\n",
+            stage.name, stage.byteCount, results.srcSize, results.lineCount, results.shaderCount, iterations, lexThreads,
+            stage.timesMS.GetMin(), stage.timesMS.GetPercentile(0.5), stage.timesMS.GetAverage(),
+            stage.timesMS.GetMax(), stage.GetThroughputMBS()
+        );
+    }
+}
+
+/// <summary>
+/// Measures TickLimiter timing error at the configured tick time and writes the distribution to
+/// stdout
+/// </summary>
+static void RunJitterBenchmark()
+{
+    const slong targetNS = (slong)jitterTickUS * 1000;
+    const slong spinLimitNS = (slong)jitterSpinUS * 1000;
+    const TickJitterStats stats = TickLimiter::GetJitterStats(targetNS, jitterTicks, spinLimitNS);
+
+    if (outputFormat == "csv")
+    {
+        std::cout << "targetNS,ticks,spinLimitNS,avgTickNS,avgErrorNS,p50ErrorNS,p95ErrorNS,p99ErrorNS,maxErrorNS\n";
+        std::cout << std::format("{},{},{},{},{},{},{},{},{}\n",
+            stats.targetNS, jitterTicks, spinLimitNS, stats.avgTickNS, stats.avgErrorNS,
+            stats.p50ErrorNS, stats.p95ErrorNS, stats.p99ErrorNS, stats.maxErrorNS
+        );
+    }
+    else
+    {
+        std::cout << std::format(
+            "{{\"version\":\"{}\",\"benchmark\":\"tickJitter\",\"targetNS\":{},\"ticks\":{},\"spinLimitNS\":{},"
+            "\"avgTickNS\":{},\"avgErrorNS\":{},\"p50ErrorNS\":{},\"p95ErrorNS\":{},\"p99ErrorNS\":{},\"maxErrorNS\":{}}}\n",
+            FXB_VERSION_STRING, stats.targetNS, jitterTicks, spinLimitNS, stats.avgTickNS, stats.avgErrorNS,
+            stats.p50ErrorNS, stats.p95ErrorNS, stats.p99ErrorNS, stats.maxErrorNS
+        );
+    }
+}
+
+/// <summary>
+/// Generates or reads the source, benchmarks it and writes the results to stdout
+/// </summary>
+static void RunBenchmark()
+{
+    if (jitterTickUS > 0)
+    {
+        RunJitterBenchmark();
+        return;
+    }
+
+    string src;
+    string_view srcPath;
+
+    if (!inputPath.empty())
+    {
+        GetInput(inputPath, src);
+        srcPath = inputPath;
+    }
+    else
+    {
+        GetSyntheticCorpus(corpusDesc, src);
+        srcPath = s_CorpusPath;
+    }
+
+    if (!dumpPath.empty())
+    {
+        std::ofstream dstFile(dumpPath, std::ios::binary);
+        FX_CHECK_MSG(dstFile.is_open(), "Failed to open output file for writing: {}", dumpPath);
+        dstFile << src;
+    }
+
+    BenchResults results;
+    RunBench(srcPath, src, results);
+
+    if (outputFormat == "csv")
+        WriteCSV(results, std::cout);
+    else
+        WriteJSON(results, std::cout);
+}
+
+// Converts c-string arguments into dynamic array of string_views
+static DynamicArray<string_view> GetArgs(int argc, char* argv[])
+{
+    DynamicArray<string_view> args(argc);
+
+    for (int i = 0; i < argc; ++i)
+        args[i] = string_view(argv[i]);
+
+    return args;
+}
+
+/// <summary>
+/// Main control function for CLI execution. Errors are written to stderr, keeping stdout
+/// machine-readable.
+/// </summary>
+/// <param name="args">Pre-parsed string_view arguments.</param>
+/// <returns>Exit code representing success or failure.</returns>
+static int RunCLI(const IDynamicArray<string_view>& args)
+{
+    const GenericMainT<const IDynamicArray<string_view>&> OptionFunc = HandleOptions;
+    const int exitCode = GenericMain(std::cerr, OptionFunc, args);
+
+    if (exitCode != 0 || shouldShowHelp)
+    {
+        std::cout << g_Bench_HelpText;
+        return exitCode;
+    }
+
+    const GenericMainT<> BenchFunc = RunBenchmark;
+    return GenericMain(std::cerr, BenchFunc);
+}
+
+/// <summary>
+/// Application entry point.
+/// Initializes the argument list and delegates execution to the CLI runner.
+/// </summary>
+/// <param name="argc">Argument count.</param>
+/// <param name="argv">Argument values.</param>
+/// <returns>Process exit code.</returns>
+int main(int argc, char* argv[])
+{
+    const DynamicArray<string_view> args = GetArgs(argc, argv);
+    return RunCLI(args);
+}
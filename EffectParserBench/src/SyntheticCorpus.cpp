@@ -0,0 +1,252 @@
+#include <array>
+#include <format>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include "SyntheticCorpus.hpp"
+
+using namespace Weave;
+using namespace Weave::Effects;
+using std::string;
+using std::string_view;
+
+// Member types used in generated structs and cbuffers
+static constexpr std::array<string_view, 8> s_MemberTypes
+{
+    "float", "float2", "float3", "float4", "int2", "uint", "float3x3", "float4x4"
+};
+
+// Member names used in generated structs and cbuffers
+static constexpr std::array<string_view, 8> s_MemberNames
+{
+    "pos", "normal", "tangent", "color", "uv", "scale", "offset", "weight"
+};
+
+// Loop attributes used in generated functions
+static constexpr std::array<string_view, 3> s_LoopAttributes
+{
+    "[unroll]", "[loop]", "[unroll(4)]"
+};
+
+namespace
+{
+    /// <summary>
+    /// Writes the modules of a synthetic effect source. Random choices only use raw generator
+    /// output, as std distributions are implementation defined and would produce different
+    /// sources between standard libraries.
+    /// </summary>
+    class CorpusWriter
+    {
+    public:
+        CorpusWriter(const CorpusDesc& desc, string& srcOut) :
+            desc(desc),
+            src(srcOut),
+            rng(desc.seed)
+        { }
+
+        void WriteHeader()
+        {
+            src.append("// Synthetic effect library\n");
+            WritePragma("flags", "FEATURE_", desc.flagCount);
+            WritePragma("modes", "MODE_", desc.modeCount);
+            src.push_back('\n');
+        }
+
+        void WriteModule(uint id)
+        {
+            std::format_to(std::back_inserter(src), "// Module {}\n", id);
+            WriteStruct(std::format("Surface{}", id), 1);
+            WriteConstBuffer(id);
+            WriteHelper(id);
+            WriteVertexShader(id);
+            WritePixelShader(id);
+            WriteComputeShader(id);
+            WriteEffect(id);
+        }
+
+    private:
+        const CorpusDesc& desc;
+        string& src;
+        std::mt19937 rng;
+
+        uint GetRandom(uint count) { return (uint)(rng() % count); }
+
+        template<size_t N>
+        string_view GetRandom(const std::array<string_view, N>& values) { return values[GetRandom(N)]; }
+
+        void Indent(uint depth) { src.append(depth, '\t'); }
+
+        void WritePragma(string_view name, string_view prefix, uint count)
+        {
+            if (count == 0)
+                return;
+
+            std::format_to(std::back_inserter(src), "#pragma shader {}(", name);
+
+            for (uint i = 0; i < count; i++)
+                std::format_to(std::back_inserter(src), "{}{}{}", (i > 0) ? ", " : "", prefix, i);
+
+            src.append(")\n");
+        }
+
+        void WriteMembers(uint depth, bool hasSemantics)
+        {
+            const uint memberCount = 2 + GetRandom(4);
+
+            for (uint i = 0; i < memberCount; i++)
+            {
+                Indent(depth);
+                std::format_to(std::back_inserter(src), "{} {}{}", GetRandom(s_MemberTypes), GetRandom(s_MemberNames), i);
+
+                if (hasSemantics)
+                    std::format_to(std::back_inserter(src), " : TexCoord{}", i);
+
+                src.append(";\n");
+            }
+        }
+
+        void WriteStruct(string_view name, uint depth)
+        {
+            Indent(depth - 1);
+            std::format_to(std::back_inserter(src), "struct {}\n", name);
+            Indent(depth - 1);
+            src.append("{\n");
+            WriteMembers(depth, true);
+            Indent(depth - 1);
+            src.append("};\n\n");
+        }
+
+        void WriteConstBuffer(uint id)
+        {
+            std::format_to(std::back_inserter(src), "cbuffer Frame{}\n{{\n", id);
+            src.append("\tfloat4x4 viewProj;\n\tfloat4 time;\n");
+            WriteMembers(1, false);
+            src.append("};\n\n");
+        }
+
+        /// <summary>
+        /// Writes a free function with nested loops and branches
+        /// </summary>
+        void WriteHelper(uint id)
+        {
+            std::format_to(std::back_inserter(src),
+                "float4 Shade{0}(float3 normal, float3 light, float4 color)\n{{\n"
+                "\tfloat intensity = saturate(dot(normal, light));\n\n", id);
+
+            const uint loopDepth = 1 + GetRandom(3);
+
+            for (uint i = 0; i < loopDepth; i++)
+            {
+                const uint depth = 1 + i;
+                Indent(depth);
+                std::format_to(std::back_inserter(src), "{}\n", GetRandom(s_LoopAttributes));
+                Indent(depth);
+                std::format_to(std::back_inserter(src), "for (int i{0} = 0; i{0} < {1}; i{0}++)\n", i, 2 + GetRandom(6));
+                Indent(depth);
+                src.append("{\n");
+            }
+
+            const uint depth = 1 + loopDepth;
+            Indent(depth);
+            std::format_to(std::back_inserter(src), "if (intensity > {}.{}f)\n", GetRandom(2), GetRandom(10));
+            Indent(depth);
+            src.append("{\n");
+            Indent(depth + 1);
+            src.append("color.rgb += intensity * color.a;\n");
+            Indent(depth);
+            src.append("}\n");
+            Indent(depth);
+            src.append("else\n");
+            Indent(depth + 1);
+            src.append("color.rgb *= 0.5f;\n");
+
+            for (uint i = loopDepth; i > 0; i--)
+            {
+                Indent(i);
+                src.append("}\n");
+            }
+
+            src.append("\n\treturn color;\n}\n\n");
+        }
+
+        void WriteVertexShader(uint id)
+        {
+            std::format_to(std::back_inserter(src),
+                "vertex VS_Module{0}\n{{\n"
+                "\tfloat4x4 mvp;\n\n"
+                "\tstruct VertIn\n\t{{\n\t\tfloat3 pos : Position;\n\t\tfloat3 normal : Normal;\n\t\tfloat2 uv : TexCoord;\n\t}};\n\n"
+                "\tstruct VertOut\n\t{{\n\t\tfloat4 pos : SV_Position;\n\t\tfloat3 normal : Normal;\n\t\tfloat2 uv : TexCoord0;\n\t}};\n\n"
+                "\tVertOut VS_Module{0}(VertIn i)\n\t{{\n"
+                "\t\tVertOut o;\n"
+                "\t\to.pos = mul(float4(i.pos, 1.0f), mvp);\n"
+                "\t\to.normal = i.normal;\n"
+                "\t\to.uv = 0.5f * (i.uv + 1.0f);\n\n"
+                "\t\treturn o;\n"
+                "\t}}\n}}\n\n", id);
+        }
+
+        void WritePixelShader(uint id)
+        {
+            std::format_to(std::back_inserter(src),
+                "pixel PS_Module{0}\n{{\n"
+                "\tstruct VertOut\n\t{{\n\t\tfloat4 pos : SV_Position;\n\t\tfloat3 normal : Normal;\n\t\tfloat2 uv : TexCoord0;\n\t}};\n\n", id);
+
+            WriteStruct("Material", 2);
+            std::format_to(std::back_inserter(src),
+                "\tfloat3 LightDir;\n"
+                "\tTexture2D<float4> tex;\n"
+                "\tStructuredBuffer<Surface{0}> surfaces;\n"
+                "\tSamplerState samp;\n\n"
+                "\tfloat4 PS_Module{0}(VertOut i) : SV_Target\n\t{{\n"
+                "\t\tfloat4 color = tex.Sample(samp, i.uv);\n"
+                "\t\treturn Shade{0}(normalize(i.normal), LightDir, color);\n"
+                "\t}}\n}}\n\n", id);
+        }
+
+        void WriteComputeShader(uint id)
+        {
+            std::format_to(std::back_inserter(src),
+                "compute CS_Module{0}\n{{\n"
+                "\tint2 SrcOffset;\n"
+                "\tint2 DstOffset;\n\n"
+                "\tTexture2D<float4> SrcTex;\n"
+                "\tRWTexture2D<float4> DstTex;\n\n"
+                "\t[numthreads({1}, {1}, 1)]\n"
+                "\tvoid CS_Module{0}(uint3 id : SV_DispatchThreadID)\n\t{{\n"
+                "\t\tDstTex[id.xy + DstOffset] = SrcTex[id.xy + SrcOffset];\n"
+                "\t}}\n}}\n\n", id, 4u << GetRandom(2));
+        }
+
+        void WriteEffect(uint id)
+        {
+            std::format_to(std::back_inserter(src),
+                "effect Module{0}\n{{\n"
+                "\tpass Main\n\t{{\n\t\tVertex = VS_Module{0};\n\t\tPixel = PS_Module{0};\n\t}}\n", id);
+
+            if (GetRandom(2) == 1)
+                std::format_to(std::back_inserter(src), "\n\tpass Depth\n\t{{\n\t\tVertex = VS_Module{};\n\t}}\n", id);
+
+            src.append("}\n\n");
+        }
+    };
+}
+
+namespace Weave::Effects
+{
+    uint GetSyntheticCorpus(const CorpusDesc& desc, string& srcOut)
+    {
+        CorpusWriter writer(desc, srcOut);
+        const size_t start = srcOut.length();
+        uint moduleCount = 0;
+
+        writer.WriteHeader();
+
+        while ((srcOut.length() - start) < desc.targetSize)
+        {
+            writer.WriteModule(moduleCount);
+            moduleCount++;
+        }
+
+        return moduleCount;
+    }
+}
@@ -40,12 +40,37 @@ OPTIONS:
 
     --cache <path>
                       Overrides the default directory to be used for reading and 
-                      writing cache files.
+                      writing cache files. Compiled shaders and parsed variants
+                      are cached in this directory and shared between libraries.
 
     --feature-level <level>
                       Sets the target shader feature level (e.g., '5_0', '6_0').
                       [Default: '5_0']
 
+    --jobs <count>
+                      Sets the maximum number of threads used to preprocess and
+                      compile shader variants. Output is identical for any count.
+                      [Default: One per hardware thread]
+
+    --compiler <d3d11|stub>
+                      Selects the shader compiler backend. 'stub' emits placeholder
+                      bytecode and approximate reflection without invoking a real
+                      compiler, for testing and profiling the preprocessor on any
+                      platform. Stub libraries cannot be loaded by a renderer.
+                      [Default: 'd3d11' on Windows, 'stub' elsewhere]
+
+    --compile-workers <count>
+                      Compiles shaders in <count> separate worker processes instead
+                      of in-process. A worker that crashes is restarted, and the
+                      shader retried once before being reported as an error.
+                      [Default: Compile in-process]
+
+    --lazy <maxFlags>
+                      Only precompiles variants with at most <maxFlags> flags set.
+                      Remaining variants are compiled from source stored in the
+                      library when first used at runtime, and cached to disk.
+                      [Default: Precompile every variant]
+
 -m, --merge           Merge all processed input files into a single output library
                       file specified by --output. If not set (default), each
                       input file produces a separate output file.
@@ -3,12 +3,17 @@
 #include <fstream>
 #include <filesystem>
 #include <unordered_map>
+#include <charconv>
 #include "WeaveEffects/EffectParseException.hpp"
 #include "WeaveUtils/Logger.hpp"
 #include "WeaveUtils/GenericMain.hpp"
 #include "WeaveUtils/Stopwatch.hpp"
 #include "WeaveUtils/Compression.hpp"
+#include "WeaveUtils/Metrics.hpp"
+#include "WeaveUtils/ChildProcess.hpp"
 #include "WeaveEffects/ShaderLibBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompilerWorkerPool.hpp"
 #include "WeaveEffects/ShaderDataSerialization.hpp"
 #include "FXHelpText.hpp"
 
@@ -34,6 +39,14 @@ static string featureLevel;
 static string outputDir;
 // Specifies directory where the preprocessor should read/write cache files
 static string cacheDir;
+// Maximum number of threads used to process variants. Zero uses all hardware threads.
+static uint maxJobs = 0;
+// Shader compiler backend name. Empty uses the platform default.
+static string compilerName;
+// Number of out-of-process compile workers. Zero compiles in-process.
+static uint compileWorkers = 0;
+// Variants with more flags set are compiled on first use. -1 precompiles every variant.
+static uint maxHotFlags = -1;
 // Stores the set of input file paths to process.
 static std::unordered_set<string> inputFiles;
 
@@ -44,12 +57,28 @@ static std::unordered_set<string> inputFiles;
 // std::format formatting string for shader cache files
 static constexpr string_view s_CacheFileFormat = "{}.cache";
 
+// Shader compile cache shared by all libraries, within the cache directory
+static constexpr string_view s_CompileCacheFile = "shaders.ccache";
+
+// Parsed variant snapshots shared by all libraries, within the cache directory
+static constexpr string_view s_ParseCacheSubDir = "parse";
+
 // Default subfolder used when no cache directory is specified, relative to working directory.
 static constexpr string_view s_DefaultCacheSubDir = "wfxc";
 
 // Log file, relative to the working directory
 static constexpr string_view s_LogFile = "wfxc.log";
 
+// Internal option used to start the preprocessor as a compile worker for another instance
+static constexpr string_view s_CompileWorkerOption = "--compile-worker";
+
+// Compiler backend used when none is specified
+#ifdef _WIN32
+static constexpr string_view s_DefaultCompiler = "d3d11";
+#else
+static constexpr string_view s_DefaultCompiler = "stub";
+#endif
+
 /// <summary>
 /// Finds all regular files with a specific extension within a directory.
 /// </summary>
@@ -120,6 +149,57 @@ static void SetOutput(const IDynamicArray<string_view>& args, int& pos) { SetStr
 // Sets the global string for the cache directory/file using SetStringParam.
 static void SetCache(const IDynamicArray<string_view>& args, int& pos) { SetStringParam(args, pos, cacheDir); }
 
+/// <summary>
+/// Helper to read the next argument as a positive integer count for an option.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a positive integer.</exception>
+static void SetCountParam(const IDynamicArray<string_view>& args, int& pos, uint& param)
+{
+    string count;
+    SetStringParam(args, pos, count);
+
+    const auto result = std::from_chars(count.data(), count.data() + count.size(), param);
+    FX_CHECK_MSG(result.ec == std::errc() && result.ptr == (count.data() + count.size()) && param > 0,
+        "Expected a positive integer count after '{}'. Found: '{}'", args[pos - 1], count);
+}
+
+/// <summary>
+/// Sets the maximum number of threads used to process shader variants.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a positive integer.</exception>
+static void SetJobs(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, maxJobs); }
+
+/// <summary>
+/// Sets the number of worker processes used to compile shaders.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a positive integer.</exception>
+static void SetCompileWorkers(const IDynamicArray<string_view>& args, int& pos) { SetCountParam(args, pos, compileWorkers); }
+
+/// <summary>
+/// Enables lazy compilation for variants with more than the given number of flags set.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the argument is not a non-negative integer.</exception>
+static void SetLazy(const IDynamicArray<string_view>& args, int& pos)
+{
+    string count;
+    SetStringParam(args, pos, count);
+
+    const auto result = std::from_chars(count.data(), count.data() + count.size(), maxHotFlags);
+    FX_CHECK_MSG(result.ec == std::errc() && result.ptr == (count.data() + count.size()),
+        "Expected a flag count after '{}'. Found: '{}'", args[pos - 1], count);
+}
+
+/// <summary>
+/// Sets the shader compiler backend used to compile variants.
+/// </summary>
+/// <exception cref="EffectParseException">If no argument follows, or the compiler name is not recognized.</exception>
+static void SetCompiler(const IDynamicArray<string_view>& args, int& pos)
+{
+    SetStringParam(args, pos, compilerName);
+    FX_CHECK_MSG(compilerName == "d3d11" || compilerName == "stub",
+        "Expected compiler 'd3d11' or 'stub'. Found: '{}'", compilerName);
+}
+
 /// <summary>
 /// Sets the input file(s). Handles single files or wildcard patterns (*.ext).
 /// </summary>
@@ -176,7 +256,11 @@ static const std::unordered_map<string_view, OptionHandlerFunc> s_OptionMap
     { "feature-level", SetFeatureLevel },
     { "input", SetInput },
     { "output", SetOutput },
-    { "cache", SetCache }
+    { "cache", SetCache },
+    { "jobs", SetJobs },
+    { "compiler", SetCompiler },
+    { "compile-workers", SetCompileWorkers },
+    { "lazy", SetLazy }
 };
 
 //-----------------------------------------------------------------------------
@@ -317,8 +401,18 @@ static void GetCache(string_view libName, std::stringstream& streamBuf, ShaderLi
 
     if (fs::exists(cachePath) && fs::is_regular_file(cachePath))
     {
-        GetInput(cachePath, streamBuf);
-        libCache = GetDeserializedLibDef(streamBuf.view());
+        try
+        {
+            GetInput(cachePath, streamBuf);
+            libCache = GetDeserializedLibDef(streamBuf.view());
+        }
+        catch (const std::exception& err)
+        {
+            // Caches written by other versions may not be readable, and only cost reprocessing
+            WV_LOG_WARN() << "Failed to read shader cache " << cachePath.string() << ": " << err.what()
+                << ". Falling back to full reprocessing...";
+            return;
+        }
         
         if (libBuilder.TrySetCache(libCache.GetHandle()))
             WV_LOG_INFO() << "Using shader cache for " << libCache.name;
@@ -329,6 +423,49 @@ static void GetCache(string_view libName, std::stringstream& streamBuf, ShaderLi
         WV_LOG_INFO() << "No cache found for " << libName << ". Falling back to full compilation...";
 }
 
+/// <summary>
+/// Attempts to load the shader compile cache from the configured cache directory into the
+/// library builder.
+/// </summary>
+static void GetCompileCache(std::stringstream& streamBuf, ShaderLibBuilder& libBuilder)
+{
+    fs::path cachePath = fs::path(cacheDir) / s_CompileCacheFile;
+
+    if (fs::exists(cachePath) && fs::is_regular_file(cachePath))
+    {
+        ShaderCompileCacheDef compileCache;
+
+        try
+        {
+            GetInput(cachePath, streamBuf);
+            compileCache = GetDeserializedCompileCacheDef(streamBuf.view());
+        }
+        catch (const std::exception& err)
+        {
+            WV_LOG_WARN() << "Failed to read compile cache " << cachePath.string() << ": " << err.what()
+                << ". Recompiling all shaders...";
+            return;
+        }
+
+        if (libBuilder.TrySetCompileCache(compileCache.GetHandle()))
+            WV_LOG_INFO() << "Using compile cache with " << compileCache.keys.GetLength() << " shaders";
+        else
+            WV_LOG_INFO() << "Compile cache version mismatch. Recompiling all shaders...";
+    }
+}
+
+/// <summary>
+/// Writes the shader compile cache to the configured cache directory, if any shaders were compiled
+/// </summary>
+static void WriteCompileCache(ShaderLibBuilder& libBuilder, std::stringstream& streamBuf, ZLibArchive& zipBuffer)
+{
+    if (libBuilder.GetIsCompileCacheChanged())
+    {
+        GetCompressedSerializedStream(libBuilder.GetCompileCacheDefinition(), zipBuffer, streamBuf);
+        WriteBinary(fs::path(cacheDir) / s_CompileCacheFile, streamBuf.view());
+    }
+}
+
 /// <summary>
 /// Finalizes the shader library, serializes it, optionally converts to a header,
 /// and writes it to the specified output file.
@@ -428,6 +565,20 @@ static void ValidateConfiguration()
         FX_THROW("Output path (--output <filepath>) is required when merging.");
 }
 
+/// <summary>
+/// Returns a new instance of the named shader compiler backend.
+/// </summary>
+/// <exception cref="EffectParseException">If the name is not recognized.</exception>
+static std::unique_ptr<IShaderCompiler> GetCompilerBackend(string_view name)
+{
+    if (name == "d3d11")
+        return std::make_unique<ShaderCompilerD3D11>();
+    else if (name == "stub")
+        return std::make_unique<ShaderCompilerStub>();
+    else
+        FX_THROW("Unknown shader compiler: '{}'", name);
+}
+
 /// <summary>
 /// Main function to create the shader library/libraries based on parsed options.
 /// Handles reading inputs, configuring the builder, processing files, and writing outputs.
@@ -444,10 +595,29 @@ static void CreateLibrary()
     // Configure the library builder
     libBuilder.SetFeatureLevel(featureLevel);
     libBuilder.SetDebug(isDebugging);
+    libBuilder.SetMaxThreads(maxJobs);
+    libBuilder.SetMaxHotFlags(maxHotFlags);
+    libBuilder.SetParseCacheDirectory((fs::path(cacheDir) / s_ParseCacheSubDir).string());
+
+    const string_view backend = !compilerName.empty() ? string_view(compilerName) : s_DefaultCompiler;
+
+    if (compileWorkers > 0)
+    {
+        Vector<string_view> workerArgs;
+        workerArgs.Add(s_CompileWorkerOption);
+        workerArgs.Add(backend);
+
+        libBuilder.SetCompiler(std::make_unique<ShaderCompilerWorkerPool>(
+            ChildProcess::GetExecutablePath(), workerArgs, compileWorkers));
+    }
+    else if (!compilerName.empty())
+        libBuilder.SetCompiler(GetCompilerBackend(backend));
 
     Stopwatch timer;
     timer.Start();
 
+    GetCompileCache(streamBuf, libBuilder);
+
     // Use shared caching
     if (isMerging)
         GetCache(outPath.stem().string(), streamBuf, libCache, libBuilder);
@@ -498,8 +668,17 @@ static void CreateLibrary()
         WriteLibrary(mergedName, libBuilder, streamBuf, zipBuffer, outPath);
     }
 
+    WriteCompileCache(libBuilder, streamBuf, zipBuffer);
+
     timer.Stop();
     WV_LOG_INFO() << "Total processing time: " << timer.GetElapsedMS() << " ms";
+
+    // Report pipeline counters
+    MetricsSnapshot metrics;
+    string metricsText;
+    Metrics::GetSnapshot(metrics);
+    metrics.WriteText(metricsText);
+    WV_LOG_DEBUG() << "Metrics:\n" << metricsText;
 }
 
 /// <summary>
@@ -652,6 +831,23 @@ static int RunCLI(const IDynamicArray<string_view>& args)
     return exitCode;
 }
 
+/// <summary>
+/// Serves shader compile requests from a parent preprocessor until it closes the pipe.
+/// Errors are reported via stderr, as stdout is reserved for the parent.
+/// </summary>
+/// <param name="backend">Name of the compiler backend to use.</param>
+/// <returns>Exit code representing success or failure.</returns>
+static int RunCompileWorker(string_view backend)
+{
+    const GenericMainT<string_view> WorkerFunc = [](string_view backend)
+    {
+        const std::unique_ptr<IShaderCompiler> pCompiler = GetCompilerBackend(backend);
+        ShaderCompilerWorkerPool::RunWorker(*pCompiler);
+    };
+
+    return GenericMain(std::cerr, WorkerFunc, std::move(backend));
+}
+
 /// <summary>
 /// Application entry point.
 /// Initializes the argument list and delegates execution to the CLI runner.
@@ -661,6 +857,10 @@ static int RunCLI(const IDynamicArray<string_view>& args)
 /// <returns>Process exit code.</returns>
 int main(int argc, char* argv[])
 {
+    // Compile workers are started by another instance and communicate over stdin/stdout
+    if (argc == 3 && string_view(argv[1]) == s_CompileWorkerOption)
+        return RunCompileWorker(argv[2]);
+
     const DynamicArray<string_view> args = GetArgs(argc, argv);
     const int exitCode = RunCLI(args);
 
@@ -3,6 +3,7 @@
 #include "WeaveEffects/EffectParseException.hpp"
 #include "WeaveUtils/StringIDMap.hpp"
 #include "WeaveUtils/VectorSpan.hpp"
+#include "WeaveUtils/ContentHash.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/SymbolEnums.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/ShaderTypeInfo.hpp"
 
@@ -508,6 +509,11 @@ namespace Weave::Effects
 		/// Graphics API compiled for
 		/// </summary>
 		PlatformTargets target;
+
+		/// <summary>
+		/// True if shaders were compiled with debug information and without optimization
+		/// </summary>
+		bool isDebugging;
 	};
 
 	/// <summary>
@@ -526,6 +532,43 @@ namespace Weave::Effects
 		DynamicArray<uint> modeIDs;
 	};
 
+	/// <summary>
+	/// Identifies the contents of a file read while compiling a repo
+	/// </summary>
+	struct FileDependencyDef
+	{
+		/// <summary>
+		/// Absolute path to the file
+		/// </summary>
+		string path;
+
+		/// <summary>
+		/// Length of the file in bytes
+		/// </summary>
+		uint sizeBytes;
+
+		/// <summary>
+		/// CRC32 of the file's contents
+		/// </summary>
+		uint crc;
+	};
+
+	/// <summary>
+	/// Contents of a file included by a repo, embedded for regenerating its deferred variants
+	/// </summary>
+	struct IncludeTextDef
+	{
+		/// <summary>
+		/// Path to the file, relative to the directory of the repo's source
+		/// </summary>
+		string path;
+
+		/// <summary>
+		/// Contents of the file
+		/// </summary>
+		string text;
+	};
+
 	/// <summary>
 	/// Serializable collection of effect and shader variants compiled from the same
 	/// effect file.
@@ -553,9 +596,36 @@ namespace Weave::Effects
 		ConfigIDTableDef configTable;
 
 		/// <summary>
-		/// Array of shaders and effects for each variant
+		/// Array of shaders and effects for each variant. Deferred variants are left empty.
 		/// </summary>
 		DynamicArray<VariantDef> variants;
+
+		/// <summary>
+		/// Variants with more flags set than this are deferred to compilation on first use.
+		/// -1 if every variant is precompiled.
+		/// </summary>
+		uint maxHotFlags;
+
+		/// <summary>
+		/// Original source code, retained only if variants are deferred
+		/// </summary>
+		string deferredSrc;
+
+		/// <summary>
+		/// Files deferred variants may include, retained only if variants are deferred. Deferred
+		/// variants are regenerated from these, rather than the files on disk.
+		/// </summary>
+		DynamicArray<IncludeTextDef> deferredIncludes;
+
+		/// <summary>
+		/// Files included by any variant in the repo
+		/// </summary>
+		DynamicArray<FileDependencyDef> includes;
+
+		/// <summary>
+		/// Bit mask of the includes opened by each variant. Includes past the 63rd share the last bit.
+		/// </summary>
+		DynamicArray<ulong> variantIncludeMasks;
 	};
 
 	/// <summary>
@@ -662,11 +732,85 @@ namespace Weave::Effects
 		}
 	};
 
+	/// <summary>
+	/// Serializable collection of precompiled shaders indexed by a hash of the generated source and
+	/// compile options they were compiled with. Used to skip recompilation of unchanged shaders.
+	/// </summary>
+	struct ShaderCompileCacheDef
+	{
+		/// <summary>
+		/// Describes the platform targeted during compilation
+		/// </summary>
+		PlatformDef platform;
+
+		/// <summary>
+		/// Compile keys for each cached shader
+		/// </summary>
+		DynamicArray<Hash128> keys;
+
+		/// <summary>
+		/// Shader IDs corresponding to each key
+		/// </summary>
+		DynamicArray<uint> shaderIDs;
+
+		/// <summary>
+		/// Cached shaders and their resources
+		/// </summary>
+		ShaderRegistryDef regData;
+
+		/// <summary>
+		/// Unique strings
+		/// </summary>
+		StringIDMapDef stringIDs;
+
+		/// <summary>
+		/// Represents a serializable, non-owning view of the definition data
+		/// </summary>
+		struct Handle
+		{
+			const PlatformDef* pPlatform;
+			const IDynamicArray<Hash128>* pKeys;
+			const IDynamicArray<uint>* pShaderIDs;
+			ShaderRegistryDef::Handle regHandle;
+			StringIDMapDef::Handle strMapHandle;
+
+			/// <summary>
+			/// Returns true if the handle has been initialized
+			/// </summary>
+			bool GetIsValid() const { return pPlatform && pKeys && pShaderIDs; }
+		};
+
+		/// <summary>
+		/// Returns a serializable, non-owning view of the definition data
+		/// </summary>
+		Handle GetHandle() const
+		{
+			return
+			{
+				.pPlatform = &platform,
+				.pKeys = &keys,
+				.pShaderIDs = &shaderIDs,
+				.regHandle = regData.GetHandle(),
+				.strMapHandle = stringIDs.GetHandle()
+			};
+		}
+	};
+
+	/// <summary>
+	/// Returns true if the given configuration of the repo was deferred to compilation on first use
+	/// </summary>
+	bool GetIsVariantDeferred(const VariantRepoDef& repo, uint configID);
+
 	/// <summary>
 	/// Deserializes a byte array into a ShaderLibDef
 	/// </summary>
 	ShaderLibDef GetDeserializedLibDef(string_view libData);
 
+	/// <summary>
+	/// Deserializes a byte array into a ShaderCompileCacheDef
+	/// </summary>
+	ShaderCompileCacheDef GetDeserializedCompileCacheDef(string_view cacheData);
+
 	/// <summary>
 	/// Deserializes a byte array into a ShaderLibDef
 	/// </summary>
@@ -5,6 +5,43 @@
 
 namespace Weave::Effects
 {
+	/// <summary>
+	/// Identifies serialized shader libraries and compile caches, ahead of the format version
+	/// </summary>
+	constexpr uint g_ShaderDataFormatMagic = 0x58465757u;
+
+	/// <summary>
+	/// Version of the serialized shader library and compile cache layout. Must be incremented
+	/// whenever the serialization of any type stored in either changes.
+	/// 1: Deferred variants (VariantRepoDef::maxHotFlags, deferredSrc), PlatformDef::isDebugging
+	/// 2: Include dependencies (VariantRepoDef::includes, variantIncludeMasks)
+	/// 3: Embedded includes for deferred variants (VariantRepoDef::deferredIncludes)
+	/// </summary>
+	constexpr uint g_ShaderDataFormatVersion = 3;
+
+	/// <summary>
+	/// Writes the format header preceding serialized libraries and compile caches
+	/// </summary>
+	template <class Archive>
+	inline void SaveFormatHeader(Archive& ar)
+	{
+		ar(g_ShaderDataFormatMagic, g_ShaderDataFormatVersion);
+	}
+
+	/// <summary>
+	/// Reads and validates the format header preceding serialized libraries and compile caches.
+	/// Checked before reading further, as data in other layouts can't be read reliably.
+	/// </summary>
+	template <class Archive>
+	inline void LoadFormatHeader(Archive& ar)
+	{
+		uint magic = 0, version = 0;
+		ar(magic, version);
+		FX_CHECK_MSG(magic == g_ShaderDataFormatMagic, "Data is not a serialized shader library or compile cache");
+		FX_CHECK_MSG(version == g_ShaderDataFormatVersion, "Unsupported shader data format version {}. Expected: {}",
+			version, g_ShaderDataFormatVersion);
+	}
+
 	template <class Archive>
 	inline void serialize(Archive& ar, ConstDef& def)
 	{
@@ -72,7 +109,7 @@ namespace Weave::Effects
 	template <class Archive>
 	inline void serialize(Archive& ar, PlatformDef& def)
 	{
-		ar(def.preprocessorVersion, def.preprocessorBuild, def.compilerVersion, def.featureLevel, def.target);
+		ar(def.preprocessorVersion, def.preprocessorBuild, def.compilerVersion, def.featureLevel, def.target, def.isDebugging);
 	}
 
 	template <class Archive>
@@ -81,18 +118,39 @@ namespace Weave::Effects
 		ar(def.flagIDs, def.modeIDs);
 	}
 
+	template <class Archive>
+	inline void serialize(Archive& ar, FileDependencyDef& def)
+	{
+		ar(def.path, def.sizeBytes, def.crc);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, IncludeTextDef& def)
+	{
+		ar(def.path, def.text);
+	}
+
 	template <class Archive>
 	inline void serialize(Archive& ar, VariantRepoDef& def)
 	{
-		ar(def.path, def.sourceSizeBytes, def.sourceCRC, def.configTable, def.variants);
+		ar(def.path, def.sourceSizeBytes, def.sourceCRC, def.configTable, def.variants, def.maxHotFlags, def.deferredSrc,
+			def.deferredIncludes, def.includes, def.variantIncludeMasks);
 	}
 
 	template <class Archive>
 	inline void save(Archive& ar, const ShaderLibDef::Handle& def)
 	{
+		SaveFormatHeader(ar);
 		ar(*def.pName, *def.pPlatform, *def.pRepos, def.regHandle, def.strMapHandle);
 	}
 
+	template <class Archive>
+	inline void save(Archive& ar, const ShaderCompileCacheDef::Handle& def)
+	{
+		SaveFormatHeader(ar);
+		ar(*def.pPlatform, *def.pKeys, *def.pShaderIDs, def.regHandle, def.strMapHandle);
+	}
+
 	template <class Archive>
 	inline void save(Archive& ar, const ShaderRegistryDef::Handle& def)
 	{
@@ -106,9 +164,17 @@ namespace Weave::Effects
 	template <class Archive>
 	inline void load(Archive& ar, ShaderLibDef& def)
 	{
+		LoadFormatHeader(ar);
 		ar(def.name, def.platform, def.repos, def.regData, def.stringIDs);
 	}
 
+	template <class Archive>
+	inline void load(Archive& ar, ShaderCompileCacheDef& def)
+	{
+		LoadFormatHeader(ar);
+		ar(def.platform, def.keys, def.shaderIDs, def.regData, def.stringIDs);
+	}
+
 	template <class Archive>
 	inline void load(Archive& ar, ShaderRegistryDef& def)
 	{
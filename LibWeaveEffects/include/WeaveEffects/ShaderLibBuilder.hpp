@@ -2,19 +2,18 @@
 #include <unordered_map>
 #include <memory>
 #include "WeaveEffects/ShaderData.hpp"
-#include "WeaveEffects/ShaderLibBuilder/ShaderEntrypoint.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantPipeline.hpp"
 
 namespace Weave::Effects
 {
 	using std::unique_ptr;
 
 	class VariantPreprocessor;
-	class BlockAnalyzer;
-	class SymbolTable;
-	class ShaderGenerator;
 	class ShaderRegistryBuilder;
-	class ScopeHandle;
 	class ShaderLibMap;
+	class ShaderCompileCache;
+	class ParseCache;
+	class IShaderCompiler;
 
 	struct ShaderLibCacheStats
 	{
@@ -65,12 +64,53 @@ namespace Weave::Effects
 		/// </summary>
 		void SetDebug(bool isDebugging);
 
+		/// <summary>
+		/// Replaces the backend used to compile shaders. Defaults to D3D11 on Windows and the stub
+		/// compiler elsewhere. Clears the compile cache if the compiler version changes.
+		/// </summary>
+		void SetCompiler(unique_ptr<IShaderCompiler>&& compiler);
+
+		/// <summary>
+		/// Sets the maximum number of threads used to process variants in AddRepo(). Zero uses
+		/// one thread per hardware thread. Output is identical regardless of thread count.
+		/// </summary>
+		void SetMaxThreads(uint maxThreads);
+
+		/// <summary>
+		/// Enables lazy variant compilation. Variants with more than the given number of flags set are
+		/// skipped, and the repo's source is stored in the library to compile them on first use. 
+		/// Variant 0 and mode variants are always compiled. -1 compiles every variant (default).
+		/// </summary>
+		void SetMaxHotFlags(uint maxHotFlags);
+
 		/// <summary>
 		/// Assigns a preexisting shader library to be used as a cache, allowing definitions to 
 		/// be reused if their source hasn't changed in the cache. Returns false on cache mismatch.
 		/// </summary>
 		bool TrySetCache(const ShaderLibDef::Handle& cachedDef);
 
+		/// <summary>
+		/// Assigns a preexisting compile cache, allowing shaders to be reused when their generated source
+		/// and compile options are unchanged. Returns false if the cache targets a different compiler or platform.
+		/// </summary>
+		bool TrySetCompileCache(const ShaderCompileCacheDef::Handle& cacheDef);
+
+		/// <summary>
+		/// Returns true if shaders were compiled since the compile cache was set
+		/// </summary>
+		bool GetIsCompileCacheChanged() const;
+
+		/// <summary>
+		/// Returns a serializable handle to every shader compiled or reused from the compile cache 
+		/// </summary>
+		ShaderCompileCacheDef::Handle GetCompileCacheDefinition() const;
+
+		/// <summary>
+		/// Sets the directory used to store snapshots of parsed variants, allowing unchanged variants
+		/// to skip lexing and parsing on later runs. Empty disables the parse cache (default).
+		/// </summary>
+		void SetParseCacheDirectory(string_view path);
+
 		/// <summary>
 		/// Returns a serializable library handle containing all preprocessed source 
 		/// data and their variants added via AddRepo().
@@ -83,58 +123,41 @@ namespace Weave::Effects
 		const ShaderLibCacheStats& GetCacheStats() const;
 
 		/// <summary>
-		/// Resets the builder for reuse. Invalidates definition handles.
+		/// Resets the builder for reuse. Invalidates definition handles. The compile cache is retained.
 		/// </summary>
 		void Clear();
 
 	private:
-		struct PassBlock
-		{
-			uint nameID;
-			uint shaderStart;
-			uint shaderCount;
-		};
-
-		struct EffectBlock
-		{
-			uint nameID;
-			uint passStart;
-			uint passCount;
-		};
-
-		struct RepoSrcBuf
-		{
-			string libText;
-			uint configID;
-		};
-
 		string name;
 		PlatformDef platform;
 		mutable UniqueVector<VariantRepoDef> repos;
-		bool isDebugging;
+		uint maxThreads;
+		uint maxHotFlags;
 
-		// Parsing, code gen and reflection
+		// Deduplicated definitions for the final library
 		unique_ptr<ShaderRegistryBuilder> pShaderRegistry;
-		unique_ptr<VariantPreprocessor> pVariantGen;
-
-		unique_ptr<BlockAnalyzer> pAnalyzer;
-		unique_ptr<SymbolTable> pTable;
-		unique_ptr<ShaderGenerator> pShaderGen;
-
-		// Variant buffers
-		RepoSrcBuf libBufs[4];
-		uint libBufIndex;
-		string hlslBuf;
-
-		// Shader mains
-		UniqueVector<ShaderEntrypoint> entrypoints;
-		// nameID -> shaderID
-		std::unordered_map<uint, uint> epNameShaderIDMap;
-
-		// Effect buffers
-		UniqueVector<EffectBlock> effectBlocks;
-		UniqueVector<PassBlock> effectPasses;
-		UniqueVector<uint> effectShaders;
+		// Shaders compiled by any repo, including previous runs
+		unique_ptr<ShaderCompileCache> pCompileCache;
+		// Parsed variant snapshots shared by any repo, including previous runs
+		unique_ptr<ParseCache> pParseCache;
+		unique_ptr<IShaderCompiler> pCompiler;
+
+		// Per-thread variant processing
+		UniqueVector<VariantPipeline> pipelines;
+		// configID -> hash of preprocessed variant source
+		UniqueVector<Hash128> variantHashes;
+		// Preprocessed source hash -> lowest configID producing it
+		std::unordered_map<Hash128, uint> variantHashConfigMap;
+		// configID -> index of the pipeline that processed it
+		UniqueVector<uint> variantPipelineIDs;
+		// Files included by the current repo, and their indices
+		UniqueVector<FileDependencyDef> includeBuf;
+		std::unordered_map<string, uint> includeIndexMap;
+		// Files opened by configurations still being processed, in the order first seen
+		UniqueVector<FileDependencyDef> pendingIncludes;
+		std::unordered_map<string, uint> pendingIncludeMap;
+		// configID -> pendingIncludes indices of the files it opened
+		UniqueVector<Vector<uint>> variantIncludeIDs;
 
 		// Caching
 		mutable unique_ptr<ShaderLibMap> pCacheMap;
@@ -142,60 +165,82 @@ namespace Weave::Effects
 		mutable Vector<const VariantRepoDef*> cacheHits;
 		mutable ShaderLibDef::Handle lastDefHandle;
 		mutable ShaderLibCacheStats cacheStats;
+		// Cached repo with unchanged source, but modified includes
+		const VariantRepoDef* pReusedRepo;
+		ulong changedIncludeMask;
 
 		/// <summary>
 		/// Initializes the variant repo and corresponding flags
 		/// </summary>
-		void InitRepo(VariantRepoDef& lib);
+		void InitRepo(const VariantPreprocessor& variantGen, VariantRepoDef& lib);
 
 		/// <summary>
-		/// Preprocesses all effects and shaders in the variant repo configuration
+		/// Returns the number of threads to use for variant processing
 		/// </summary>
-		void AddRepoConfiguration(string_view repoPath, const uint configID, const uint repoID, VariantRepoDef& repo);
+		uint GetThreadCount() const;
 
 		/// <summary>
-		/// Ensures definition is resolved with the cache
+		/// Processes every configuration after variant 0 in parallel, using one pipeline per thread.
+		/// Deferred, reused and configurations with previously seen source are skipped. Configurations
+		/// that only differ from a processed one in defines its preprocessing never referenced are 
+		/// skipped before preprocessing. Definitions remain in pipeline 
+		/// registries until merged. Returns the number of pipelines used.
 		/// </summary>
-		void FinalizeDefinition() const;
+		uint ProcessVariants(const uint repoID, const Hash128& firstHash, VariantRepoDef& repo);
 
 		/// <summary>
-		/// Copies unchanged definitions from the cache into the final definition
+		/// Copies pipeline definitions into the library registry in configID order, and resolves
+		/// duplicate variants
 		/// </summary>
-		void MergeCacheHits() const;
+		void MergeVariants(const uint repoID, const uint pipelineCount, VariantRepoDef& repo);
 
 		/// <summary>
-		/// Attempts to retrieve a repo from the cache based on its original source path
+		/// Returns true if the given configuration can be copied from a partial cache hit
 		/// </summary>
-		const VariantRepoDef* TryGetCachedRepo(string_view path) const;
+		bool GetIsVariantReused(const uint configID) const;
+
+		/// <summary>
+		/// Rehashes the includes of a cached repo, and returns a mask of the ones that changed
+		/// </summary>
+		ulong InitIncludes(const VariantRepoDef& cachedRepo);
 
 		/// <summary>
-		/// Identifies shaders in the source and buffers their entrypoint symbols
+		/// Records the files opened by the last configuration generated, hashing new ones from the
+		/// preprocessor's cached text. Indices are assigned separately, by GetVariantIncludeMask().
 		/// </summary>
-		void GetEntryPoints();
+		void AddVariantIncludes(const uint configID, const VariantPreprocessor& variantGen);
 
 		/// <summary>
-		/// Identifies effects and passes defined
+		/// Adds the files recorded for the given configuration to the current repo's includes, if
+		/// not already present, and returns their mask. Called in configID order, so include indices
+		/// don't depend on the order configurations finish in.
 		/// </summary>
-		void GetEffects();
+		ulong GetVariantIncludeMask(const uint configID);
 
 		/// <summary>
-		/// Adds an effect pass to the buffer to be later converted into a definition
+		/// Embeds the includes the repo's deferred variants may open, so they can be regenerated
+		/// without the original files. Must precede merging, which clears the text cached by pipelines.
 		/// </summary>
-		void AddPass(const ScopeHandle& effectScope, string_view name);
+		void GetDeferredIncludes(VariantRepoDef& repo) const;
 
 		/// <summary>
-		/// Generates shader definitions for every shader in a variant
+		/// Returns a map of the last cached definition
 		/// </summary>
-		void GetShaderDefs(string_view libPath, DynamicArray<ShaderVariantDef>& variants, uint resID);
+		const ShaderLibMap& GetCacheMap() const;
 
 		/// <summary>
-		/// Generates effect definitions for every effect in a variant
+		/// Ensures definition is resolved with the cache
 		/// </summary>
-		void GetEffectDefs(DynamicArray<EffectVariantDef>& effects, uint resID);
+		void FinalizeDefinition() const;
 
 		/// <summary>
-		/// Resets tables for next variant
+		/// Copies unchanged definitions from the cache into the final definition
 		/// </summary>
-		void ClearVariant();
+		void MergeCacheHits() const;
+
+		/// <summary>
+		/// Attempts to retrieve a repo from the cache based on its original source path
+		/// </summary>
+		const VariantRepoDef* TryGetCachedRepo(string_view path) const;
 	};
 }
\ No newline at end of file
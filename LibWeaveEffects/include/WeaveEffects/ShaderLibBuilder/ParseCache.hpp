@@ -0,0 +1,61 @@
+#pragma once
+#include "WeaveUtils/ContentHash.hpp"
+
+namespace Weave::Effects
+{
+	struct ParseSnapshot;
+
+	/// <summary>
+	/// Stores parse snapshots in a directory, one file per hash of the preprocessed source they were
+	/// parsed from. Snapshots are independent of the repo path, so identical variants in different
+	/// repos share them. Snapshots may be read and written concurrently, including by other processes.
+	/// The directory is trimmed when set: least recently used snapshots are evicted once it exceeds
+	/// its size limit, and temporary files abandoned by failed writers are removed.
+	/// </summary>
+	class ParseCache
+	{
+	public:
+		MAKE_IMMOVABLE(ParseCache)
+
+		ParseCache();
+
+		~ParseCache();
+
+		/// <summary>
+		/// Sets the directory snapshots are read from and written to, and trims it. Empty disables
+		/// the cache.
+		/// </summary>
+		void SetDirectory(string_view path);
+
+		/// <summary>
+		/// Returns the directory snapshots are stored in
+		/// </summary>
+		string_view GetDirectory() const;
+
+		/// <summary>
+		/// Returns true if a directory has been set
+		/// </summary>
+		bool GetIsEnabled() const;
+
+		/// <summary>
+		/// Attempts to read the snapshot for the source with the given hash. Returns false if no
+		/// snapshot exists, or if it is unreadable or from another version.
+		/// </summary>
+		bool TryGetSnapshot(const Hash128& srcHash, ParseSnapshot& dst) const;
+
+		/// <summary>
+		/// Writes a snapshot for the source with the given hash, replacing any existing snapshot.
+		/// Failures are logged and otherwise ignored.
+		/// </summary>
+		void AddSnapshot(const Hash128& srcHash, const ParseSnapshot& snapshot) const;
+
+	private:
+		string dir;
+
+		/// <summary>
+		/// Removes stale temporary files, and evicts the least recently used snapshots until the
+		/// directory is within its size limit
+		/// </summary>
+		void Trim() const;
+	};
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <unordered_map>
+#include <memory>
+#include "WeaveEffects/ShaderData.hpp"
+
+namespace Weave::Effects
+{
+	using std::unique_ptr;
+
+	class ShaderRegistryBuilder;
+	class ShaderRegistryMap;
+	class ShaderDefHandle;
+
+	/// <summary>
+	/// Maps compile keys to previously compiled shader definitions. Lookups are read-only and may be
+	/// made concurrently, provided the cache is not modified at the same time.
+	/// </summary>
+	class ShaderCompileCache
+	{
+	public:
+		MAKE_IMMOVABLE(ShaderCompileCache)
+
+		ShaderCompileCache();
+
+		~ShaderCompileCache();
+
+		/// <summary>
+		/// Returns a key uniquely identifying the output of a compilation with the given source and
+		/// options. The source file only affects the key when debugging, as it is embedded in the bytecode.
+		/// </summary>
+		static Hash128 GetKey(
+			string_view srcFile,
+			string_view srcText,
+			string_view featureLevel,
+			ShadeStages stage,
+			string_view mainName,
+			bool isDebugging
+		);
+
+		/// <summary>
+		/// Returns the ID of the shader in the cache map compiled with the given key, or -1 if not found
+		/// </summary>
+		uint TryGetShader(const Hash128& key) const;
+
+		/// <summary>
+		/// Returns the registry map containing cached shaders
+		/// </summary>
+		const ShaderRegistryMap& GetMap() const;
+
+		/// <summary>
+		/// Returns the number of cached shaders
+		/// </summary>
+		uint GetShaderCount() const;
+
+		/// <summary>
+		/// Returns true if shaders were added since the cache was last set or cleared
+		/// </summary>
+		bool GetIsChanged() const;
+
+		/// <summary>
+		/// Copies a newly compiled shader into the cache. Shaders added are not visible to
+		/// TryGetShader() until UpdateMap() is called.
+		/// </summary>
+		void AddShader(const Hash128& key, const ShaderDefHandle& shader);
+
+		/// <summary>
+		/// Updates the cache map with shaders added since the last update
+		/// </summary>
+		void UpdateMap();
+
+		/// <summary>
+		/// Replaces the contents of the cache with a copy of the given definition
+		/// </summary>
+		void SetDefinition(const ShaderCompileCacheDef::Handle& cacheDef);
+
+		/// <summary>
+		/// Returns a serializable handle to the cache contents for the given platform. Entries are
+		/// ordered by key, independent of the order shaders were added in.
+		/// </summary>
+		ShaderCompileCacheDef::Handle GetDefinition(const PlatformDef& platform) const;
+
+		/// <summary>
+		/// Removes all cached shaders
+		/// </summary>
+		void Clear();
+
+	private:
+		unique_ptr<ShaderRegistryBuilder> pRegistry;
+		unique_ptr<ShaderRegistryMap> pMap;
+		// Key -> shaderID
+		std::unordered_map<Hash128, uint> keyShaderMap;
+		bool isMapStale;
+		bool isChanged;
+
+		// Export buffers
+		mutable unique_ptr<ShaderRegistryBuilder> pExportRegistry;
+		mutable PlatformDef lastPlatform;
+		mutable UniqueVector<Hash128> keyBuf;
+		mutable UniqueVector<uint> shaderIDBuf;
+	};
+}
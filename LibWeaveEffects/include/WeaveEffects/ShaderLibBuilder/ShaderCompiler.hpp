@@ -3,17 +3,96 @@
 #include "ShaderRegistryBuilder.hpp"
 
 namespace Weave::Effects
-{ 
+{
+	class SymbolTable;
+
+	/// <summary>
+	/// Generated source and options for compiling a single shader entrypoint
+	/// </summary>
+	struct ShaderCompileArgs
+	{
+		string_view srcFile;
+		string_view srcText;
+		string_view featureLevel;
+		ShadeStages stage;
+		string_view mainName;
+		bool isDebugging;
+
+		/// <summary>
+		/// Symbols parsed from the variant the source was generated from. Null when compiling
+		/// out-of-process, in which case backends requiring symbols must parse srcText.
+		/// </summary>
+		const SymbolTable* pTable;
+
+		/// <summary>
+		/// Symbol ID of the entrypoint function in pTable, or -1 if pTable is null
+		/// </summary>
+		int mainSymbolID;
+	};
+
+	/// <summary>
+	/// Abstract shader compiler backend. Compiles generated source to bytecode and reflects the
+	/// resources it requires into a registry.
+	/// </summary>
+	class IShaderCompiler
+	{
+	public:
+		/// <summary>
+		/// Returns the name and version of the compiler
+		/// </summary>
+		virtual string_view GetVersion() const = 0;
+
+		/// <summary>
+		/// Compiles the given shader into the registry and returns its shader ID. Must be safe to call
+		/// concurrently with different registries.
+		/// </summary>
+		virtual uint GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const = 0;
+
+		/// <summary>
+		/// Returns true if reflection uses the symbol table in ShaderCompileArgs, and its output may
+		/// differ when compiling out-of-process without one
+		/// </summary>
+		virtual bool GetIsUsingSymbols() const { return false; }
+
+		virtual ~IShaderCompiler() = default;
+	};
+
+	/// <summary>
+	/// Compiles shaders with D3DCompile and reflects them with D3DReflect. Windows only.
+	/// </summary>
+	class ShaderCompilerD3D11 : public IShaderCompiler
+	{
+	public:
+		string_view GetVersion() const override;
+
+		uint GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const override;
+	};
+
+	/// <summary>
+	/// Platform independent stand-in for a real compiler. Emits deterministic placeholder bytecode,
+	/// and approximates reflection from the symbol table. Used to run and benchmark the rest of the
+	/// pipeline where no compiler is available. Libraries built with it cannot be loaded by a renderer.
+	/// </summary>
+	class ShaderCompilerStub : public IShaderCompiler
+	{
+	public:
+		string_view GetVersion() const override;
+
+		uint GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const override;
+
+		bool GetIsUsingSymbols() const override;
+	};
+
 	/// <summary>
 	/// Precompiles the given HLSL source for D3D11 and generates metadata for resources required by the shader
 	/// </summary>
 	uint GetShaderDefD3D11(
-		string_view srcFile, 
-		string_view srcText, 
+		string_view srcFile,
+		string_view srcText,
 		string_view featureLevel,
-		ShadeStages stage, 
-		string_view mainName, 
-		ShaderRegistryBuilder& builder, 
+		ShadeStages stage,
+		string_view mainName,
+		ShaderRegistryBuilder& builder,
 		bool isDebugging = false
 	);
 
@@ -21,4 +100,4 @@ namespace Weave::Effects
 	/// Returns the name of the compiler used for D3D11
 	/// </summary>
 	string_view GetCompilerVersionD3D11();
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+
+namespace Weave
+{
+	class ChildProcess;
+}
+
+namespace Weave::Effects
+{
+	using std::unique_ptr;
+
+	/// <summary>
+	/// Compiles shaders in separate worker processes. Workers are started on demand, up to a fixed
+	/// limit, and callers block until a worker is free. A worker that exits mid-compile, or exceeds
+	/// the per-shader time limit, is replaced, and the shader retried once, before the failure is
+	/// reported as a compile error. Allows
+	/// process-level parallelism with backends that are not thread-safe, and isolates the builder
+	/// from crashes in the backend.
+	/// </summary>
+	class ShaderCompilerWorkerPool : public IShaderCompiler
+	{
+	public:
+		MAKE_IMMOVABLE(ShaderCompilerWorkerPool)
+
+		/// <summary>
+		/// Creates a pool of workers started with the given executable and arguments. Workers must
+		/// call RunWorker(). Starts the first worker to retrieve the backend version.
+		/// </summary>
+		ShaderCompilerWorkerPool(string_view exePath, const IDynamicArray<string_view>& workerArgs, uint maxWorkers);
+
+		~ShaderCompilerWorkerPool();
+
+		/// <summary>
+		/// Returns the version reported by workers. Qualified to distinguish their output from the
+		/// same backend running in-process, if the backend uses symbol tables.
+		/// </summary>
+		string_view GetVersion() const override;
+
+		uint GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const override;
+
+		/// <summary>
+		/// Serves compile requests from a parent pool over standard input and output until the
+		/// parent closes the pipe. Symbol tables are not available to workers, and the version
+		/// reported is qualified if the backend uses them.
+		/// </summary>
+		static void RunWorker(const IShaderCompiler& compiler);
+
+	private:
+		string exePath;
+		UniqueVector<string> workerArgs;
+		string backendVersion;
+		uint maxWorkers;
+
+		mutable std::mutex poolMutex;
+		mutable std::condition_variable workerFreed;
+		mutable UniqueVector<unique_ptr<ChildProcess>> idleWorkers;
+		mutable uint workerCount;
+
+		/// <summary>
+		/// Starts a new worker process and returns the version reported by its backend
+		/// </summary>
+		unique_ptr<ChildProcess> StartWorker(string& workerVersion) const;
+
+		/// <summary>
+		/// Returns an idle worker, starting a new one if below the limit, or waits for one to be freed
+		/// </summary>
+		unique_ptr<ChildProcess> AcquireWorker() const;
+
+		/// <summary>
+		/// Returns a worker to the pool. Null workers are counted as exited.
+		/// </summary>
+		void ReleaseWorker(unique_ptr<ChildProcess>&& pWorker) const;
+	};
+}
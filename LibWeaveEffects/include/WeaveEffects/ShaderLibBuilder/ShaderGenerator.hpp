@@ -4,7 +4,7 @@
 
 namespace Weave::Effects
 {
-	struct LexBlock;
+	class LexBlockList;
 	class SymbolTable;
 	struct ShaderEntrypoint;
 
@@ -31,7 +31,7 @@ namespace Weave::Effects
 	public:
 		ShaderGenerator();
 
-		void GetShaderSource(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks, const ShaderEntrypoint& main,
+		void GetShaderSource(const SymbolTable& table, const LexBlockList& srcBlocks, const ShaderEntrypoint& main,
 			const IDynamicArray<ShaderEntrypoint>& shaders, std::string& srcOut);
 
 		void Clear();
@@ -44,7 +44,7 @@ namespace Weave::Effects
 		/// <summary>
 		/// Writes a copy of the source with masking applied
 		/// </summary>
-		void GetMaskedSource(const IDynamicArray<LexBlock>& srcBlocks, std::string& srcOut);
+		void GetMaskedSource(const LexBlockList& srcBlocks, std::string& srcOut);
 
 		/// <summary>
 		/// Identifies all loose global variable symbols within the scopes visible to the given entrypoint
@@ -55,14 +55,14 @@ namespace Weave::Effects
 		/// <summary>
 		/// Generates source masks needed to produce native HLSL for the given shader
 		/// </summary>
-		void GetSourceMask(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks,
+		void GetSourceMask(const SymbolTable& table, const LexBlockList& srcBlocks,
 			const ShaderEntrypoint& main, const IDynamicArray<ShaderEntrypoint>& shaders);
 
 		/// <summary>
 		/// Dynamically generates a cbuffer for loose/global cbuffer variables, and masks out
 		/// the originals.
 		/// </summary>
-		void GenerateGlobalCBuffer(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks);
+		void GenerateGlobalCBuffer(const SymbolTable& table, const LexBlockList& srcBlocks);
 
 		/// <summary>
 		/// Masks out a scope along with its declaring symbol. Masks content of the scope unless
@@ -74,6 +74,6 @@ namespace Weave::Effects
 		/// Appends the given range of blocks to the output, while ensuring the line numbers
 		/// of the output remain consistent
 		/// </summary>
-		void AddBlockRange(const IDynamicArray<LexBlock>& srcBlocks, int start, const int end, std::string& srcOut, int& line);
+		void AddBlockRange(const LexBlockList& srcBlocks, int start, const int end, std::string& srcOut, int& line);
 	};
 }
\ No newline at end of file
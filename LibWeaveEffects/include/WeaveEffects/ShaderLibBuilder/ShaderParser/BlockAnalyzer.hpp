@@ -1,11 +1,16 @@
 #pragma once
 #include "WeaveUtils/TextUtils.hpp"
 #include "WeaveUtils/TextBlock.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/StructuralIndex.hpp"
 #include <unordered_map>
+#include <memory>
 
 namespace Weave::Effects
 {
     using std::string_view;
+    using std::unique_ptr;
+
+    struct ParseSnapshot;
 
     enum class LexBlockTypes : uint
     {
@@ -135,7 +140,112 @@ namespace Weave::Effects
     };
 
     /// <summary>
-    /// Decomposes pre-sanitized source into contiguous chunks represented by LexBlocks
+    /// Column-wise storage for LexBlocks. Each field is kept in its own array, so scans over block 
+    /// types or lines touch only the data they need. Source ranges are stored as offsets from a base
+    /// pointer, and can be moved to another copy of the same source by changing the base.
+    /// </summary>
+    class LexBlockList
+    {
+    public:
+        MAKE_MOVE_ONLY(LexBlockList)
+
+        LexBlockList();
+
+        /// <summary>
+        /// Returns a copy of the block at the given index
+        /// </summary>
+        LexBlock operator[](ptrdiff_t index) const;
+
+        LexBlockTypes GetType(ptrdiff_t index) const { return types[index]; }
+
+        bool GetHasAnyFlag(ptrdiff_t index, LexBlockTypes flag) const { return (uint)(types[index] & flag) > 0; }
+
+        bool GetHasFlags(ptrdiff_t index, LexBlockTypes flag) const { return (types[index] & flag) == flag; }
+
+        TextBlock GetSrc(ptrdiff_t index) const { return TextBlock(pBase + offsets[index], lengths[index]); }
+
+        int GetFile(ptrdiff_t index) const { return files[index]; }
+
+        int GetDepth(ptrdiff_t index) const { return depths[index]; }
+
+        int GetStartLine(ptrdiff_t index) const { return startLines[index]; }
+
+        int GetLineCount(ptrdiff_t index) const { return lineCounts[index]; }
+
+        int GetLastLine(ptrdiff_t index) const { return startLines[index] + lineCounts[index]; }
+
+        /// <summary>
+        /// Returns the types of all blocks, in order
+        /// </summary>
+        const IDynamicArray<LexBlockTypes>& GetTypes() const { return types; }
+
+        size_t GetLength() const { return types.GetLength(); }
+
+        bool IsEmpty() const { return types.IsEmpty(); }
+
+        /// <summary>
+        /// Returns the start of the source block ranges are relative to
+        /// </summary>
+        const char* GetBase() const { return pBase; }
+
+        /// <summary>
+        /// Sets the start of the source block ranges are relative to. Existing blocks are moved with it.
+        /// </summary>
+        void SetBase(const char* pBase);
+
+        /// <summary>
+        /// Appends a block with a source range following the current base
+        /// </summary>
+        void Add(const LexBlock& block);
+
+        /// <summary>
+        /// Appends a range of blocks from another list. Source ranges keep their offsets, and are 
+        /// rebased to this list's source.
+        /// </summary>
+        void AddRange(const LexBlockList& other, ptrdiff_t start, ptrdiff_t count);
+
+        /// <summary>
+        /// Overwrites the block at the given index
+        /// </summary>
+        void Set(ptrdiff_t index, const LexBlock& block);
+
+        /// <summary>
+        /// Appends all blocks from a list over a later range of the same source. Source ranges are 
+        /// translated to this list's base, and file indices are offset by the given amount.
+        /// </summary>
+        void AddChunk(const LexBlockList& chunk, int fileOffset);
+
+        void SetType(ptrdiff_t index, LexBlockTypes type) { types[index] = type; }
+
+        void SetSrc(ptrdiff_t index, const TextBlock& src);
+
+        void SetLineCount(ptrdiff_t index, int lineCount) { lineCounts[index] = lineCount; }
+
+        void RemoveRange(ptrdiff_t start, ptrdiff_t count);
+
+        void Clear();
+
+    private:
+        const char* pBase;
+        UniqueVector<LexBlockTypes> types;
+        UniqueVector<uint> offsets;
+        UniqueVector<uint> lengths;
+        UniqueVector<int> files;
+        UniqueVector<int> depths;
+        UniqueVector<int> startLines;
+        UniqueVector<int> lineCounts;
+    };
+
+    /// <summary>
+    /// Decomposes pre-sanitized source into contiguous chunks represented by LexBlocks.
+    /// 
+    /// An analysis can be retained as a base for later ones. If a later source shares a prefix 
+    /// with it, as variants of the same repo usually do, blocks are reused up to the last top-level 
+    /// declaration preceding the first difference, and lexing resumes from there.
+    /// 
+    /// Large sources can be split into chunks at top-level scopes and lexed in parallel. Chunks are
+    /// stitched back together only if they start in the state the preceding chunk ended in, and any
+    /// remainder is lexed serially, so results are identical either way.
     /// </summary>
     class BlockAnalyzer
     {
@@ -144,28 +254,116 @@ namespace Weave::Effects
 
         BlockAnalyzer();
 
+        /// <summary>
+        /// Clears the current analysis. Blocks retained for reuse are unaffected.
+        /// </summary>
         void Clear();
 
         void AnalyzeSource(string_view path, TextBlock src);
 
+        /// <summary>
+        /// Copies the current analysis, up to its last top-level checkpoint, as the base reused by 
+        /// later analyses of the same path. Replaces any analysis retained before.
+        /// </summary>
+        void RetainAnalysis(string_view path);
+
+        /// <summary>
+        /// Copies the analysis retained by another analyzer
+        /// </summary>
+        void SetRetainedAnalysis(const BlockAnalyzer& other);
+
+        /// <summary>
+        /// Discards the retained analysis
+        /// </summary>
+        void ClearRetainedAnalysis();
+
+        /// <summary>
+        /// Sets the maximum number of threads used to lex a single source. Only sources large enough 
+        /// to give each thread a sizable chunk are split. 1 by default.
+        /// </summary>
+        void SetMaxThreads(uint maxThreads);
+
         const IDynamicArray<LexFile>& GetSourceFiles() const;
 
-        const IDynamicArray<LexBlock>& GetBlocks() const;
+        const LexBlockList& GetBlocks() const;
+
+        /// <summary>
+        /// Copies the blocks and files of the current analysis into the given snapshot
+        /// </summary>
+        void GetSnapshot(ParseSnapshot& dst) const;
+
+        /// <summary>
+        /// Replaces the current analysis with a snapshot taken from identical source, without lexing
+        /// </summary>
+        void SetSnapshot(string_view path, TextBlock src, const ParseSnapshot& snapshot);
 
     private:
+        /// <summary>
+        /// Top-level block after which lexing can be resumed without prior state
+        /// </summary>
+        struct Checkpoint
+        {
+            int block;
+            int line;
+            int fileCount;
+        };
+
+        /// <summary>
+        /// Expected lexer state at the start of a chunk of top-level declarations
+        /// </summary>
+        struct ChunkStart
+        {
+            const char* pStart;
+            int line;
+            string_view filePath;
+        };
+
         TextBlock src;
+        // Retained across backtracking restarts
+        StructuralIndex index;
         UniqueVector<LexFile> files;
-        UniqueVector<LexBlock> blocks;
+        LexBlockList blocks;
         UniqueVector<int> containers;
+        UniqueVector<Checkpoint> checkpoints;
         const char* pPosOld;
 
         const char* pPos;
         int depth;
         int line;
 
+        // Retained analysis, referencing its own copy of the source prefix
+        string cachedPath;
+        string cachedSrc;
+        UniqueVector<LexFile> cachedFiles;
+        LexBlockList cachedBlocks;
+        UniqueVector<Checkpoint> cachedCheckpoints;
+
+        // Parallel lexing
+        uint maxThreads;
+        UniqueVector<ChunkStart> chunkStarts;
+        UniqueVector<unique_ptr<BlockAnalyzer>> chunkAnalyzers;
+
+        void StartAnalysis(string_view path);
+
+        void Lex();
+
+        void FindChunks(uint chunkCount);
+
+        void AnalyzeChunks(string_view path);
+
+        void AnalyzeChunk(const ChunkStart& start, TextBlock chunk);
+
+        bool GetIsChunkClosed() const;
+
+        void AddChunk(const BlockAnalyzer& chunk);
+
+        bool TryRestoreCache(string_view path);
+
+        void TryAddCheckpoint();
+
         void AddBlock(const TextBlock& start);
 
-        LexBlock* GetTopContainer();
+        int GetTopContainer() const;
 
         void StartContainer();
 
@@ -185,7 +383,9 @@ namespace Weave::Effects
 
         bool GetCanCloseTemplate() const;
 
-        string_view GetBreakFilter() const;
+        ScanMasks GetBreakMasks() const;
+
+        size_t GetOffset(const char* pCh) const;
 
         bool TryFinalizeParse();
 
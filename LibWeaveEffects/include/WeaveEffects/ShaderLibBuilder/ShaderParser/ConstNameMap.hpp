@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <stdexcept>
+#include "WeaveUtils/GlobalUtils.hpp"
+
+namespace Weave::Effects
+{
+    using std::string_view;
+
+    template<typename T>
+    struct NameMapEntry
+    {
+        string_view name = {};
+        T value = {};
+    };
+
+    /// <summary>
+    /// Read-only string to value map built at compile time as a perfect hash table. Names are hashed
+    /// once into a bucket, and each bucket stores a seed mapping its names to distinct slots, so
+    /// lookups are a single hash and at most one string comparison.
+    /// </summary>
+    template<typename T, size_t N>
+    class ConstNameMap
+    {
+    public:
+        static constexpr size_t SlotCount = std::bit_ceil(2 * N);
+        static constexpr size_t BucketCount = std::bit_ceil(N / 2 + 1);
+
+        consteval ConstNameMap(const NameMapEntry<T>(&entries)[N]) :
+            seeds(),
+            slots()
+        {
+            std::array<ulong, N> hashes = {};
+            std::array<size_t, BucketCount + 1> bucketStarts = {};
+            std::array<size_t, N> bucketMembers = {};
+            std::array<bool, SlotCount> isSlotUsed = {};
+            size_t maxBucketSize = 0;
+
+            for (size_t i = 0; i < N; i++)
+            {
+                if (entries[i].name.empty())
+                    throw std::logic_error("Names in a ConstNameMap cannot be empty");
+
+                hashes[i] = GetHash(entries[i].name);
+                bucketStarts[GetBucket(hashes[i]) + 1]++;
+            }
+
+            // Group entry indices by bucket
+            for (size_t bucket = 0; bucket < BucketCount; bucket++)
+            {
+                maxBucketSize = std::max(maxBucketSize, bucketStarts[bucket + 1]);
+                bucketStarts[bucket + 1] += bucketStarts[bucket];
+            }
+
+            std::array<size_t, BucketCount> bucketEnds = {};
+
+            for (size_t bucket = 0; bucket < BucketCount; bucket++)
+                bucketEnds[bucket] = bucketStarts[bucket];
+
+            for (size_t i = 0; i < N; i++)
+                bucketMembers[bucketEnds[GetBucket(hashes[i])]++] = i;
+
+            // Largest buckets are placed first, while the table is emptiest
+            for (size_t size = maxBucketSize; size > 0; size--)
+            {
+                for (size_t bucket = 0; bucket < BucketCount; bucket++)
+                {
+                    if (bucketStarts[bucket + 1] - bucketStarts[bucket] == size)
+                        PlaceBucket(entries, hashes, &bucketMembers[bucketStarts[bucket]], size, bucket, isSlotUsed);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Returns a pointer to the value with the given name, or nullptr if not found
+        /// </summary>
+        const T* TryGetValue(string_view name) const
+        {
+            const ulong hash = GetHash(name);
+            const NameMapEntry<T>& slot = slots[GetSlot(hash, seeds[GetBucket(hash)])];
+
+            if (!name.empty() && slot.name == name)
+                return &slot.value;
+            else
+                return nullptr;
+        }
+
+    private:
+        static constexpr uint s_MaxSeed = 1u << 16;
+
+        std::array<uint, BucketCount> seeds;
+        std::array<NameMapEntry<T>, SlotCount> slots;
+
+        /// <summary>
+        /// FNV-1a
+        /// </summary>
+        static constexpr ulong GetHash(string_view name)
+        {
+            ulong hash = 0xcbf29ce484222325ull;
+
+            for (const char ch : name)
+            {
+                hash ^= (byte)ch;
+                hash *= 0x100000001b3ull;
+            }
+
+            return hash;
+        }
+
+        static constexpr size_t GetBucket(ulong hash) { return (size_t)(hash & (BucketCount - 1)); }
+
+        static constexpr size_t GetSlot(ulong hash, uint seed)
+        {
+            hash += seed * 0x9e3779b97f4a7c15ull;
+            hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+            hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+            return (size_t)((hash ^ (hash >> 31)) & (SlotCount - 1));
+        }
+
+        /// <summary>
+        /// Finds the first seed mapping every name in the bucket to an unused slot, and claims them
+        /// </summary>
+        consteval void PlaceBucket(const NameMapEntry<T>(&entries)[N], const std::array<ulong, N>& hashes,
+            const size_t* pMembers, size_t memberCount, size_t bucket, std::array<bool, SlotCount>& isSlotUsed)
+        {
+            std::array<size_t, N> memberSlots = {};
+
+            for (uint seed = 0; seed < s_MaxSeed; seed++)
+            {
+                bool isValid = true;
+
+                for (size_t i = 0; i < memberCount && isValid; i++)
+                {
+                    memberSlots[i] = GetSlot(hashes[pMembers[i]], seed);
+                    isValid = !isSlotUsed[memberSlots[i]];
+
+                    for (size_t j = 0; j < i && isValid; j++)
+                        isValid = memberSlots[i] != memberSlots[j];
+                }
+
+                if (isValid)
+                {
+                    for (size_t i = 0; i < memberCount; i++)
+                    {
+                        slots[memberSlots[i]] = entries[pMembers[i]];
+                        isSlotUsed[memberSlots[i]] = true;
+                    }
+
+                    seeds[bucket] = seed;
+                    return;
+                }
+            }
+
+            // Only reachable with duplicate names
+            throw std::logic_error("Failed to place names in ConstNameMap. Names must be unique.");
+        }
+    };
+
+    /// <summary>
+    /// Builds a ConstNameMap from a list of name-value pairs, deducing its size
+    /// </summary>
+    template<typename T, size_t N>
+    consteval ConstNameMap<T, N> GetConstNameMap(const NameMapEntry<T>(&entries)[N])
+    {
+        return ConstNameMap<T, N>(entries);
+    }
+}
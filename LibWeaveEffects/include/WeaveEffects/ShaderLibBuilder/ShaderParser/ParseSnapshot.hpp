@@ -0,0 +1,200 @@
+#pragma once
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/SymbolData.hpp"
+#include "WeaveEffects/Version.hpp"
+
+namespace Weave::Effects
+{
+    using std::string_view;
+
+    /// <summary>
+    /// Version of the parse snapshot format. Must be incremented whenever the snapshot layout, or
+    /// the blocks and symbols produced by the lexer or parser change, as the library version is
+    /// not guaranteed to change with them.
+    /// 1: Initial layout
+    /// </summary>
+    constexpr uint g_ParseSnapshotVersion = 1;
+
+    /// <summary>
+    /// Text referenced by a ParseSnapshot, stored as a range in the parsed source, or in the
+    /// snapshot's text pool if it was generated by the parser
+    /// </summary>
+    struct SnapshotText
+    {
+        uint offset;
+        uint length;
+        bool isPooled;
+    };
+
+    struct SnapshotFile
+    {
+        SnapshotText path;
+        int startLine;
+    };
+
+    struct SnapshotBlock
+    {
+        LexBlockTypes type;
+        uint offset;
+        uint length;
+        int file;
+        int depth;
+        int startLine;
+        int lineCount;
+    };
+
+    struct SnapshotToken
+    {
+        SnapshotText value;
+        TokenTypes type;
+        int depth;
+        int blockStart;
+        int blockCount;
+        int childStart;
+        int childCount;
+        int subtypeID;
+        int symbolID;
+    };
+
+    /// <summary>
+    /// Type referenced by a type specifier or alias. Intrinsic types are stored by flags, and
+    /// user types by index.
+    /// </summary>
+    struct SnapshotTypeRef
+    {
+        static constexpr int Intrinsic = -1;
+        static constexpr int Null = -2;
+
+        ShaderTypes flags;
+        int userTypeID;
+    };
+
+    struct SnapshotUserType
+    {
+        SnapshotText name;
+        ShaderTypes flags;
+        ulong size;
+    };
+
+    struct SnapshotMapEntry
+    {
+        ulong key;
+        int value;
+    };
+
+    /// <summary>
+    /// Serializable copy of the blocks and symbol table parsed from a preprocessed variant. The
+    /// source text is not included, and a snapshot can only be restored against the source it
+    /// was taken from, or an identical copy.
+    /// </summary>
+    struct ParseSnapshot
+    {
+        /// <summary>
+        /// Snapshot format version. Other fields are not read if it differs from
+        /// g_ParseSnapshotVersion.
+        /// </summary>
+        uint formatVersion;
+
+        /// <summary>
+        /// Version of the library that produced the snapshot. Snapshots from other versions are
+        /// discarded, as parser output may differ.
+        /// </summary>
+        string version;
+
+        /// <summary>
+        /// Files set by line directives. The first file, the repo path, is not stored.
+        /// </summary>
+        UniqueVector<SnapshotFile> files;
+        UniqueVector<SnapshotBlock> blocks;
+
+        UniqueVector<ScopeData> scopes;
+        // Scope symbol lists, flattened
+        UniqueVector<uint> scopeSymbolCounts;
+        UniqueVector<int> scopeSymbols;
+
+        /// <summary>
+        /// Identifiers and signatures, indexed by identID
+        /// </summary>
+        UniqueVector<SnapshotText> identNames;
+        UniqueVector<SnapshotMapEntry> scopeSymbolEntries;
+        UniqueVector<SnapshotMapEntry> scopeOverloadEntries;
+        // Function overload lists, flattened
+        UniqueVector<uint> overloadCounts;
+        UniqueVector<int> overloads;
+
+        UniqueVector<SnapshotToken> tokens;
+        UniqueVector<SymbolData> symbols;
+        UniqueVector<SnapshotTypeRef> types;
+        UniqueVector<SnapshotUserType> userTypes;
+        UniqueVector<SnapshotText> functions;
+        UniqueVector<AttributeData> attributes;
+
+        int topScope;
+        int pendingScopeSymbol;
+
+        /// <summary>
+        /// Text generated during parsing
+        /// </summary>
+        string textPool;
+
+        ParseSnapshot() :
+            formatVersion(g_ParseSnapshotVersion),
+            version(VERSION_STRING),
+            topScope(-1),
+            pendingScopeSymbol(-1)
+        { }
+
+        /// <summary>
+        /// Returns a reference to the given text, stored as a range in the source if it lies
+        /// within it, and copied to the text pool otherwise
+        /// </summary>
+        SnapshotText GetTextRef(string_view src, string_view text)
+        {
+            if (text.empty())
+                return { 0, 0, false };
+
+            if (text.data() >= src.data() && text.data() + text.length() <= src.data() + src.length())
+                return { (uint)(text.data() - src.data()), (uint)text.length(), false };
+
+            const uint offset = (uint)textPool.length();
+            textPool.append(text);
+            return { offset, (uint)text.length(), true };
+        }
+
+        /// <summary>
+        /// Returns the text referenced in the source or a copy of the text pool
+        /// </summary>
+        static string_view GetText(string_view src, string_view pool, const SnapshotText& text)
+        {
+            const string_view base = text.isPooled ? pool : src;
+            FX_CHECK_MSG((size_t)text.offset + text.length <= base.length(), "Malformed parse snapshot");
+
+            return base.substr(text.offset, text.length);
+        }
+
+        void Clear()
+        {
+            formatVersion = g_ParseSnapshotVersion;
+            version = VERSION_STRING;
+            files.Clear();
+            blocks.Clear();
+            scopes.Clear();
+            scopeSymbolCounts.Clear();
+            scopeSymbols.Clear();
+            identNames.Clear();
+            scopeSymbolEntries.Clear();
+            scopeOverloadEntries.Clear();
+            overloadCounts.Clear();
+            overloads.Clear();
+            tokens.Clear();
+            symbols.Clear();
+            types.Clear();
+            userTypes.Clear();
+            functions.Clear();
+            attributes.Clear();
+            topScope = -1;
+            pendingScopeSymbol = -1;
+            textPool.clear();
+        }
+    };
+}
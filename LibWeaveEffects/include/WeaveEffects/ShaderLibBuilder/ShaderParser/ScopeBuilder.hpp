@@ -1,9 +1,9 @@
 #pragma once
-#include <forward_list>
-#include <list>
+#include <deque>
 #include <unordered_map>
 #include "SymbolEnums.hpp"
 #include "ShaderTypeInfo.hpp"
+#include "TextArena.hpp"
 #include "WeaveUtils/Span.hpp"
 
 namespace Weave::Effects
@@ -15,10 +15,9 @@ namespace Weave::Effects
     struct FunctionData;
     struct ScopeData;
     struct AttributeData;
+    struct ParseSnapshot;
 
-    using IDList = std::list<int>;
-    using NameIndexMap = std::unordered_map<string_view, int>;
-    using FuncOverloadMap = std::unordered_map<string_view, IDList>;
+    using IDList = IDynamicArray<int>;
 
     /// <summary>
     /// Stores a collection of symbols and tokens owned by scoping objects
@@ -116,14 +115,15 @@ namespace Weave::Effects
         AttributeData& GetAttribData(int attribID);
 
         /// <summary>
-        /// Moves a dynamically generated string into the builder and returns a view to it
+        /// Copies a dynamically generated string into the builder and returns a view to it
         /// </summary>
-        string_view AddGeneratedText(string&& str);
+        string_view AddGeneratedText(string_view str);
 
         /// <summary>
-        /// Copies a dynamically generated string into the builder and returns a view to it
+        /// Returns the arena generated text is stored in. Text can be written to it in place, and
+        /// remains valid until the builder is cleared.
         /// </summary>
-        string_view AddGeneratedText(string_view str);
+        TextArena& GetGeneratedText();
 
         /// <summary>
         /// Attempts to retrive a symbol by the given name with the given top scope
@@ -134,7 +134,7 @@ namespace Weave::Effects
 
         /// <summary>
         /// Attempts to retrieve a list of function overloads with the given identifier, starting
-        /// with the given top scopeID
+        /// with the given top scopeID. Overloads are listed in declaration order.
         /// </summary>
         const IDList* TryGetFuncOverloads(string_view ident, int top = -1) const;
 
@@ -191,27 +191,46 @@ namespace Weave::Effects
         /// </summary>
         void PopScope(const int lastBlock);
 
-        void Clear();
+        /// <summary>
+        /// Copies the contents of the builder into the given snapshot. Text within the given 
+        /// source is stored by offset.
+        /// </summary>
+        void GetSnapshot(string_view src, ParseSnapshot& dst) const;
 
-    private:
         /// <summary>
-        /// Lookup tables for each symbol in each scope, parallel with scopes vector
+        /// Replaces the contents of the builder with a snapshot taken from identical source
         /// </summary>
+        void SetSnapshot(string_view src, const ParseSnapshot& snapshot);
+
+        void Clear();
+
+    private:
         UniqueVector<ScopeData> scopes;
-        UniqueVector<NameIndexMap> scopeSymbolMaps;
-        UniqueVector<FuncOverloadMap> funcOverloadMaps;
         UniqueVector<UniqueVector<int>> scopeSymbolLists;
 
+        /// <summary>
+        /// Dense IDs for each distinct identifier or signature declared, hashed once per lookup
+        /// </summary>
+        std::unordered_map<string_view, int> identIDMap;
+
+        /// <summary>
+        /// Symbol and overload list lookup tables for all scopes, keyed by (scopeID, identID)
+        /// </summary>
+        std::unordered_map<ulong, int> scopeSymbolMap;
+        std::unordered_map<ulong, int> scopeOverloadMap;
+        UniqueVector<UniqueVector<int>> funcOverloads;
+
         UniqueVector<TokenNode> tokens;
         UniqueVector<SymbolData> symbols;
 
         UniqueVector<const ShaderTypeInfo*> types;
-        UniqueVector<ShaderTypeInfo> userTypes;
+        // Referenced by pointer in types, and must not be reallocated as it grows
+        std::deque<ShaderTypeInfo> userTypes;
         UniqueVector<FunctionData> functions;
         UniqueVector<AttributeData> attributes;
 
         UniqueVector<int> deferredSymbolBuf;
-        std::forward_list<string> generatedText;
+        TextArena generatedText;
 
         int topScope;
         int pendingScopeSymbol;
@@ -221,5 +240,19 @@ namespace Weave::Effects
         void AddScope(const int symbolID, const int blockStart = 0, const int blockCount = 0);
 
         void AddFuncToOverloadTable(const string_view name, const int symbolID);
+
+        /// <summary>
+        /// Returns the ID of the given identifier, or -1 if no symbol has been declared with it
+        /// </summary>
+        int TryGetIdentID(string_view name) const;
+
+        int GetOrAddIdentID(string_view name);
+
+        /// <summary>
+        /// Searches the given scope and its parents for the given identifier. Returns the
+        /// value mapped to the first match or -1.
+        /// </summary>
+        static int TryGetScopeValue(const std::unordered_map<ulong, int>& map, const IDynamicArray<ScopeData>& scopes, 
+            int identID, int top);
     };
 }
\ No newline at end of file
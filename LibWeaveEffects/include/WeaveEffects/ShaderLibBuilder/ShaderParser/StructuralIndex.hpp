@@ -0,0 +1,82 @@
+#pragma once
+#include "WeaveUtils/GlobalUtils.hpp"
+#include "WeaveUtils/DynamicCollections.hpp"
+
+namespace Weave::Effects
+{
+    using std::string_view;
+
+    /// <summary>
+    /// Character classes tracked by StructuralIndex
+    /// </summary>
+    enum class ScanMasks : uint
+    {
+        None = 0,
+
+        /// <summary>
+        /// Block delimiters other than angle brackets, '=,:;{}()[]#', and non-ASCII bytes
+        /// </summary>
+        Breaks = 1 << 0,
+
+        OpenAngles = 1 << 1,
+        CloseAngles = 1 << 2,
+        Newlines = 1 << 3,
+
+        /// <summary>
+        /// Characters greater than ' ', as signed chars
+        /// </summary>
+        NonSpaces = 1 << 4
+    };
+
+    /// <summary>
+    /// Classifies source text 64 bytes at a time into bit masks, one per character class,
+    /// allowing lexers to find delimiters and count lines without visiting every byte.
+    /// </summary>
+    class StructuralIndex
+    {
+    public:
+        MAKE_MOVE_ONLY(StructuralIndex)
+
+        StructuralIndex();
+
+        /// <summary>
+        /// Classifies the given text. The text is not retained.
+        /// </summary>
+        void Build(string_view text);
+
+        /// <summary>
+        /// Returns the offset of the first character at or after the given offset in any of the
+        /// given classes, or the length of the text if none are found.
+        /// </summary>
+        size_t FindNext(size_t offset, ScanMasks classes) const;
+
+        /// <summary>
+        /// Returns the number of characters in the given classes within [start, end)
+        /// </summary>
+        uint GetCount(size_t start, size_t end, ScanMasks classes) const;
+
+        /// <summary>
+        /// Returns the length of the indexed text
+        /// </summary>
+        size_t GetLength() const;
+
+        void Clear();
+
+    private:
+        struct Chunk
+        {
+            ulong breaks;
+            ulong openAngles;
+            ulong closeAngles;
+            ulong newlines;
+            ulong nonSpaces;
+        };
+
+        UniqueVector<Chunk> chunks;
+        size_t length;
+
+        static ulong GetMask(const Chunk& chunk, ScanMasks classes);
+
+        static void ClassifyChunk(const char* pChunk, Chunk& dst);
+    };
+}
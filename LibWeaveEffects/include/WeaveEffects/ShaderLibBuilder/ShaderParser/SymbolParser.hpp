@@ -49,8 +49,6 @@ namespace Weave::Effects
         UniqueVector<CaptureBlock> captures;
         UniqueVector<CaptureBlock> captureBuf;
 
-        std::stringstream textBuf;
-
         /// <summary>
         /// Parses relevant symbols and tokens from source
         /// </summary>
@@ -123,7 +121,7 @@ namespace Weave::Effects
         /// </summary>
         void GetFuncSignature(const TokenNode& ident);
 
-        const LexBlock& GetBlock(ptrdiff_t index);
+        LexBlock GetBlock(ptrdiff_t index);
 
         size_t GetBlockCount();
 
@@ -349,6 +349,37 @@ namespace Weave::Effects
 		void ReversePattern();
 	};
 
+	/// <summary>
+	/// Block types that can begin the forward part of a MatchNode's match, precomputed from its 
+	/// patterns. Used to reject nodes that cannot match a block without attempting the match.
+	/// </summary>
+	struct MatchStartSet
+	{
+		/// <summary>
+		/// Block qualifier types accepted by the first forward block
+		/// </summary>
+		DynamicArray<LexBlockTypes> types;
+
+		/// <summary>
+		/// True if the first forward block may be of any type
+		/// </summary>
+		bool isAny;
+
+		/// <summary>
+		/// True if the node can succeed without matching any forward blocks
+		/// </summary>
+		bool isNullable;
+
+		MatchStartSet();
+
+		explicit MatchStartSet(const MatchNode& node);
+
+		/// <summary>
+		/// Returns false if a node cannot match a sequence starting with the given block type
+		/// </summary>
+		bool GetCanStartWith(LexBlockTypes blockType) const;
+	};
+
 	/// <summary>
 	/// Groups a set of match nodes based on the type of keyword in the first block
 	/// </summary>
@@ -367,6 +398,11 @@ namespace Weave::Effects
 		/// </summary>
 		DynamicArray<MatchNode> rootNodes;
 
+		/// <summary>
+		/// Start sets for each root node, in parallel
+		/// </summary>
+		DynamicArray<MatchStartSet> rootStartSets;
+
 		MatchNodeGroup() = default;
 
 		MatchNodeGroup(
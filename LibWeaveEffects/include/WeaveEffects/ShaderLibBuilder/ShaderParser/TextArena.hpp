@@ -0,0 +1,105 @@
+#pragma once
+#include <iterator>
+#include <memory>
+#include "WeaveUtils/GlobalUtils.hpp"
+#include "WeaveUtils/DynamicCollections.hpp"
+
+namespace Weave::Effects
+{
+    using std::string_view;
+    using std::unique_ptr;
+
+    /// <summary>
+    /// Append-only text storage. Text is written into fixed chunks that are never reallocated, so
+    /// views to finished text remain valid until the arena is cleared. Cleared chunks are retained
+    /// for reuse.
+    /// </summary>
+    class TextArena
+    {
+    public:
+        /// <summary>
+        /// Output iterator appending characters to the arena's pending text, for use with std::format_to
+        /// </summary>
+        class Appender
+        {
+        public:
+            using iterator_category = std::output_iterator_tag;
+            using value_type = void;
+            using difference_type = ptrdiff_t;
+            using pointer = void;
+            using reference = void;
+
+            explicit Appender(TextArena& arena) : pArena(&arena) { }
+
+            Appender& operator=(char ch) { pArena->Append(ch); return *this; }
+
+            Appender& operator*() { return *this; }
+
+            Appender& operator++() { return *this; }
+
+            Appender operator++(int) { return *this; }
+
+        private:
+            TextArena* pArena;
+        };
+
+        MAKE_MOVE_ONLY(TextArena)
+
+        TextArena();
+
+        /// <summary>
+        /// Returns an iterator appending to the pending text
+        /// </summary>
+        Appender GetAppender() { return Appender(*this); }
+
+        /// <summary>
+        /// Appends a character to the pending text
+        /// </summary>
+        void Append(char ch)
+        {
+            if (length == chunks[chunkID].capacity)
+                ReserveChunk(1);
+
+            chunks[chunkID].pData[length++] = ch;
+        }
+
+        /// <summary>
+        /// Appends a copy of the given text to the pending text
+        /// </summary>
+        void Append(string_view text);
+
+        /// <summary>
+        /// Finishes the pending text and returns a view to it
+        /// </summary>
+        string_view EndText();
+
+        /// <summary>
+        /// Copies the given text into the arena and returns a view to it. Any pending text is
+        /// included before it.
+        /// </summary>
+        string_view Add(string_view text);
+
+        /// <summary>
+        /// Invalidates all text in the arena, retaining its chunks
+        /// </summary>
+        void Clear();
+
+    private:
+        struct Chunk
+        {
+            unique_ptr<char[]> pData;
+            size_t capacity;
+        };
+
+        UniqueVector<Chunk> chunks;
+        size_t chunkID;
+        size_t length;
+        size_t textStart;
+
+        /// <summary>
+        /// Moves the pending text to a chunk with room for at least the given number of additional
+        /// characters
+        /// </summary>
+        void ReserveChunk(size_t count);
+    };
+}
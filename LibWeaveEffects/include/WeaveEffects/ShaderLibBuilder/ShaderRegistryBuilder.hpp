@@ -150,6 +150,12 @@ namespace Weave::Effects
 
 		uint GetOrAddEffect(const EffectDefHandle& effectDef);
 
+		/// <summary>
+		/// Resets the copy conversion cache. Must be called before the last copied ShaderRegistryMap is
+		/// destroyed, if the builder may copy from another map later.
+		/// </summary>
+		void ClearCopyCache();
+
 		/* Get(Member) returns an immutable reference to the object corresponding to the given ID. */
 
 		const ConstDef& GetConstant(const uint id) const;
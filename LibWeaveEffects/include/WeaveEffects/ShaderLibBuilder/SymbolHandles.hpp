@@ -1,7 +1,7 @@
 #pragma once
 #include <optional>
-#include <list>
 #include <string_view>
+#include "WeaveUtils/DynamicCollections.hpp"
 #include "ShaderParser/SymbolEnums.hpp"
 #include "ShaderParser/ShaderTypeInfo.hpp"
 
@@ -16,7 +16,7 @@ namespace Weave::Effects
 
 	using std::string_view;
 	using std::optional;
-	using IDList = std::list<int>;
+	using IDList = IDynamicArray<int>;
 
 	/// <summary>
 	/// Wrapper providing an interface to tokens 
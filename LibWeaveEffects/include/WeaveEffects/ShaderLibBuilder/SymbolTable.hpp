@@ -7,6 +7,7 @@ namespace Weave::Effects
     struct LexBlock;
     class ScopeBuilder;
     class SymbolParser;
+    struct ParseSnapshot;
 
     /// <summary>
     /// A reusable table of token, symbol and scope data generated from preprocessed shader LexBlocks
@@ -26,6 +27,17 @@ namespace Weave::Effects
         /// </summary>
         void ParseBlocks(const BlockAnalyzer& src);
 
+        /// <summary>
+        /// Copies the table into the given snapshot. Text within the given source is stored by offset.
+        /// </summary>
+        void GetSnapshot(string_view src, ParseSnapshot& dst) const;
+
+        /// <summary>
+        /// Replaces the contents of the table with a snapshot taken from identical source, 
+        /// without parsing
+        /// </summary>
+        void SetSnapshot(string_view src, const ParseSnapshot& snapshot);
+
         /// <summary>
         /// Resets the parser to its initial state
         /// </summary>
@@ -0,0 +1,130 @@
+#pragma once
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <queue>
+#include "WeaveEffects/ShaderData.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantPipeline.hpp"
+
+namespace Weave::Effects
+{
+	using std::unique_ptr;
+
+	class ShaderLibMap;
+	class ShaderCompileCache;
+	class ParseCache;
+	class IShaderCompiler;
+
+	/// <summary>
+	/// Compiles variants deferred by a lazy shader library on a background thread. Requests are
+	/// processed in the order they are made, and results are held until retrieved. Compiled shaders
+	/// are written to a compile cache on disk, if a path is given, allowing them to be reused across runs.
+	/// </summary>
+	class VariantCompileService
+	{
+	public:
+		/// <summary>
+		/// Definitions of a compiled variant, in a registry of their own
+		/// </summary>
+		struct CompiledVariant
+		{
+			ShaderRegistryDef regDef;
+			StringIDMapDef strDef;
+			VariantDef variant;
+		};
+
+		MAKE_IMMOVABLE(VariantCompileService)
+
+		/// <summary>
+		/// Starts a service for the deferred variants of the given library, compiled with the given
+		/// backend. The cache path may be empty.
+		/// </summary>
+		VariantCompileService(const ShaderLibMap& libMap, unique_ptr<IShaderCompiler>&& compiler, string_view cachePath);
+
+		/// <summary>
+		/// Finishes the current variant, discards remaining requests and writes the compile cache
+		/// </summary>
+		~VariantCompileService();
+
+		/// <summary>
+		/// Queues the given variant for compilation without waiting. Variants already queued or
+		/// awaiting retrieval are ignored.
+		/// </summary>
+		void Request(uint vID);
+
+		/// <summary>
+		/// Returns true if the variant has finished compiling and has not been retrieved
+		/// </summary>
+		bool GetIsReady(uint vID) const;
+
+		/// <summary>
+		/// Returns the given variant, requesting it and waiting for it to compile if necessary.
+		/// Compile errors are rethrown on the calling thread.
+		/// </summary>
+		CompiledVariant GetVariant(uint vID);
+
+	private:
+		struct RepoSource
+		{
+			string path;
+			string src;
+			DynamicArray<IncludeTextDef> includes;
+		};
+
+		struct VariantResult
+		{
+			CompiledVariant def;
+			std::exception_ptr error;
+		};
+
+		PlatformDef platform;
+		string cachePath;
+		UniqueArray<RepoSource> repoSources;
+
+		// Used only by the worker thread
+		unique_ptr<IShaderCompiler> pCompiler;
+		unique_ptr<ShaderCompileCache> pCompileCache;
+		// Disabled. Deferred variants are parsed once per run.
+		unique_ptr<ParseCache> pParseCache;
+		VariantPipeline pipeline;
+		bool isCacheChanged;
+
+		mutable std::mutex queueMutex;
+		std::condition_variable requestAdded;
+		std::condition_variable variantCompiled;
+		std::queue<uint> requests;
+		std::unordered_set<uint> pendingIDs;
+		std::unordered_map<uint, VariantResult> results;
+		bool isStopping;
+
+		std::thread worker;
+
+		/// <summary>
+		/// Compiles requests until the service is stopped
+		/// </summary>
+		void Run();
+
+		/// <summary>
+		/// Fails all pending requests, releasing threads waiting on them. Requires queueMutex.
+		/// </summary>
+		void CancelRequests();
+
+		/// <summary>
+		/// Regenerates the given variant from its repo's source and embedded includes, and compiles it
+		/// </summary>
+		void CompileVariant(uint vID, CompiledVariant& result);
+
+		/// <summary>
+		/// Loads the compile cache from disk, if it exists and matches the platform
+		/// </summary>
+		void ReadCache();
+
+		/// <summary>
+		/// Writes the compile cache to disk if shaders were added
+		/// </summary>
+		void WriteCache();
+	};
+}
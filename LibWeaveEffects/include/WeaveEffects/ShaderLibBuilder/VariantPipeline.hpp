@@ -0,0 +1,195 @@
+#pragma once
+#include <unordered_map>
+#include <memory>
+#include "WeaveUtils/ContentHash.hpp"
+#include "WeaveEffects/ShaderData.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderEntrypoint.hpp"
+
+namespace Weave::Effects
+{
+	using std::unique_ptr;
+
+	class VariantPreprocessor;
+	class BlockAnalyzer;
+	class SymbolTable;
+	class ShaderGenerator;
+	class ShaderRegistryBuilder;
+	class ShaderCompileCache;
+	class ParseCache;
+	struct ParseSnapshot;
+	class IShaderCompiler;
+	class ScopeHandle;
+
+	/// <summary>
+	/// Independent preprocess, parse, codegen and compile pipeline for generating variants of a
+	/// single repo. Definitions are written to a registry owned by the pipeline, allowing separate
+	/// pipelines to process variants of the same repo concurrently.
+	/// </summary>
+	class VariantPipeline
+	{
+	public:
+		/// <summary>
+		/// Shader compiled by the pipeline and the key it was compiled with
+		/// </summary>
+		struct CompiledShader
+		{
+			Hash128 key;
+			uint shaderID;
+		};
+
+		MAKE_MOVE_ONLY(VariantPipeline)
+
+		VariantPipeline();
+
+		~VariantPipeline();
+
+		/// <summary>
+		/// Initializes the pipeline to a new repo. Variant 0 must be processed before the
+		/// repo's variant count and flags are known. Shaders found in the compile cache are copied
+		/// from the cache instead of being recompiled, and cache misses are compiled with the given compiler.
+		/// Variants found in the parse cache are restored instead of being parsed.
+		/// </summary>
+		void SetSrc(string_view repoPath, string_view libSrc, string_view featureLevel, bool isDebugging,
+			const ShaderCompileCache& compileCache, const ParseCache& parseCache, const IShaderCompiler& compiler);
+
+		/// <summary>
+		/// Initializes the pipeline to the repo, flags and modes of another pipeline that has
+		/// already processed variant 0. Blocks lexed for variant 0 are shared as the base for 
+		/// lexing later variants.
+		/// </summary>
+		void SetSrc(const VariantPipeline& other);
+
+		/// <summary>
+		/// Embeds the contents of an include, given its path relative to the repo's directory. Once
+		/// any are embedded, includes are never read from disk. Must be called after SetSrc().
+		/// </summary>
+		void AddIncludeText(string_view filePath, string_view text);
+
+		/// <summary>
+		/// Sets the maximum number of threads used to lex a single large variant. 1 by default.
+		/// </summary>
+		void SetMaxLexThreads(uint maxThreads);
+
+		/// <summary>
+		/// Preprocesses the given configuration and returns a hash of the resulting source. 
+		/// Identical variants can be detected by hash without being parsed or compiled.
+		/// </summary>
+		Hash128 PreprocessVariant(const uint configID);
+
+		/// <summary>
+		/// Parses and precompiles the last preprocessed configuration into the pipeline's registry
+		/// </summary>
+		void CompileVariant(const uint configID, const uint repoID, VariantDef& variant);
+
+		/// <summary>
+		/// Returns the preprocessor for the current repo
+		/// </summary>
+		const VariantPreprocessor& GetPreprocessor() const;
+
+		/// <summary>
+		/// Returns the registry containing definitions generated by the pipeline since the last Clear()
+		/// </summary>
+		const ShaderRegistryBuilder& GetRegistry() const;
+
+		/// <summary>
+		/// Returns shaders compiled by the pipeline since the last Clear(), excluding compile cache hits
+		/// </summary>
+		const IDynamicArray<CompiledShader>& GetCompiledShaders() const;
+
+		/// <summary>
+		/// Resets the pipeline and its registry for reuse
+		/// </summary>
+		void Clear();
+
+	private:
+		struct PassBlock
+		{
+			uint nameID;
+			uint shaderStart;
+			uint shaderCount;
+		};
+
+		struct EffectBlock
+		{
+			uint nameID;
+			uint passStart;
+			uint passCount;
+		};
+
+		string_view repoPath;
+		string featureLevel;
+		bool isDebugging;
+		const ShaderCompileCache* pCompileCache;
+		const ParseCache* pParseCache;
+		const IShaderCompiler* pCompiler;
+
+		// Parsing, code gen and reflection
+		unique_ptr<ShaderRegistryBuilder> pShaderRegistry;
+		unique_ptr<VariantPreprocessor> pVariantGen;
+
+		unique_ptr<BlockAnalyzer> pAnalyzer;
+		unique_ptr<SymbolTable> pTable;
+		unique_ptr<ShaderGenerator> pShaderGen;
+		unique_ptr<ParseSnapshot> pSnapshot;
+
+		// Variant buffers
+		string libText;
+		Hash128 srcHash;
+		string hlslBuf;
+
+		// Shader mains
+		UniqueVector<ShaderEntrypoint> entrypoints;
+		// nameID -> shaderID
+		std::unordered_map<uint, uint> epNameShaderIDMap;
+
+		// Compile key -> shaderID for every shader in the registry
+		std::unordered_map<Hash128, uint> keyShaderMap;
+		UniqueVector<CompiledShader> compiledShaders;
+
+		// Effect buffers
+		UniqueVector<EffectBlock> effectBlocks;
+		UniqueVector<PassBlock> effectPasses;
+		UniqueVector<uint> effectShaders;
+
+		/// <summary>
+		/// Lexes and parses the last preprocessed source, or restores it from the parse cache
+		/// </summary>
+		void ParseVariant();
+
+		/// <summary>
+		/// Identifies shaders in the source and buffers their entrypoint symbols
+		/// </summary>
+		void GetEntryPoints();
+
+		/// <summary>
+		/// Identifies effects and passes defined
+		/// </summary>
+		void GetEffects();
+
+		/// <summary>
+		/// Adds an effect pass to the buffer to be later converted into a definition
+		/// </summary>
+		void AddPass(const ScopeHandle& effectScope, string_view name);
+
+		/// <summary>
+		/// Generates shader definitions for every shader in a variant
+		/// </summary>
+		void GetShaderDefs(DynamicArray<ShaderVariantDef>& variants, uint resID);
+
+		/// <summary>
+		/// Returns the ID of the shader generated in hlslBuf, compiling it only if it has not
+		/// been seen by the pipeline or compile cache
+		/// </summary>
+		uint GetOrCompileShader(const ShaderEntrypoint& ep);
+
+		/// <summary>
+		/// Generates effect definitions for every effect in a variant
+		/// </summary>
+		void GetEffectDefs(DynamicArray<EffectVariantDef>& effects, uint resID);
+
+		/// <summary>
+		/// Resets tables for next variant
+		/// </summary>
+		void ClearVariant();
+	};
+}
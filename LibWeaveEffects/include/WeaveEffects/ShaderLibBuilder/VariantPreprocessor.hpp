@@ -1,6 +1,8 @@
 #pragma once
 #include <unordered_set>
+#include <unordered_map>
 #include <list>
+#include <memory>
 #include "WeaveUtils/GlobalUtils.hpp"
 #include "WeaveUtils/StringSpan.hpp"
 #include "ShaderEntrypoint.hpp"
@@ -13,8 +15,14 @@ namespace Weave::Effects
 	constexpr string_view g_VariantModesKeyword = "modes";
 	constexpr uint g_VariantModeLimit = 256u;
 
+	using std::unique_ptr;
+
+	class WaveTokenCache;
+
 	/// <summary>
-	/// Evaluates preprocessor directives for shaders and generates variants
+	/// Evaluates preprocessor directives for shaders and generates variants. The source and its 
+	/// includes are lexed once, by the first variant that reaches them. Later variants replay the 
+	/// cached tokens, and only evaluate directives and expand macros.
 	/// </summary>
 	class VariantPreprocessor
 	{
@@ -23,11 +31,19 @@ namespace Weave::Effects
 
 		VariantPreprocessor();
 
+		~VariantPreprocessor();
+
 		/// <summary>
 		/// Initializes preprocessor to the given source
 		/// </summary>
 		void SetSrc(string_view filePath, string_view src);
 
+		/// <summary>
+		/// Initializes preprocessor to the source, include paths, macros, flags and modes of
+		/// another preprocessor. Allows variants of the same source to be generated concurrently.
+		/// </summary>
+		void SetSrc(const VariantPreprocessor& other);
+
 		/// <summary>
 		/// Returns true if the preprocessor source has been set
 		/// </summary>
@@ -47,6 +63,18 @@ namespace Weave::Effects
 		/// Adds an include path for user includes
 		/// </summary>
 		void AddIncludePath(string_view path);
+
+		/// <summary>
+		/// Embeds the contents of an include, given its path relative to the source's directory.
+		/// Once any are embedded, includes are resolved only against embedded files, and never read
+		/// from disk. Must be called after SetSrc().
+		/// </summary>
+		void AddIncludeText(string_view filePath, string_view text);
+
+		/// <summary>
+		/// Returns true if includes are resolved against embedded files instead of the file system
+		/// </summary>
+		bool GetHasEmbeddedIncludes() const;
 		
 		/// <summary>
 		/// Generates variant with flags corresponding to the given index and returns 
@@ -85,6 +113,46 @@ namespace Weave::Effects
 		/// </summary>
 		void AddEntrypoint(string_view shaderName, ShadeStages stage);
 
+		/// <summary>
+		/// Records a file opened while generating the current variant
+		/// </summary>
+		void AddDependency(string_view filePath);
+
+		/// <summary>
+		/// Returns the files included by the last variant generated, in the order they were opened
+		/// </summary>
+		const IDynamicArray<string>& GetDependencies() const;
+
+		/// <summary>
+		/// Retrieves the contents of the given file, reading it on first use, unless includes are
+		/// embedded. Cached files are retained until the source is changed.
+		/// </summary>
+		bool TryGetFileText(string_view filePath, string_view& text);
+
+		/// <summary>
+		/// Retrieves the contents of the given file if a previous variant read it, without reading
+		/// from disk
+		/// </summary>
+		bool TryGetCachedFileText(string_view filePath, string_view& text) const;
+
+		/// <summary>
+		/// Records an identifier that can affect the output of the current variant, either in a 
+		/// conditional, macro expansion or the output itself
+		/// </summary>
+		void AddReference(string_view identifier);
+
+		/// <summary>
+		/// Returns a mask of the flags that affected the output of the last variant generated. 
+		/// Configurations that only differ in other flags produce identical output, unless the
+		/// mode is also referenced. Every flag and mode is referenced in variant 0.
+		/// </summary>
+		uint GetReferencedFlags() const;
+
+		/// <summary>
+		/// Returns true if any mode affected the output of the last variant generated
+		/// </summary>
+		bool GetIsModeReferenced() const;
+
 		/// <summary>
 		/// Returns the current list of variant flags
 		/// </summary>
@@ -106,6 +174,13 @@ namespace Weave::Effects
 		static string GetWaveVerString();
 
 	private:
+		struct DefineHash
+		{
+			using is_transparent = void;
+
+			size_t operator()(string_view name) const { return std::hash<string_view>()(name); }
+		};
+
 		string_view src;
 		string_view filePath;
 		bool isInitialized;
@@ -118,7 +193,21 @@ namespace Weave::Effects
 		UniqueVector<StringSpan> variantFlags;
 
 		Vector<ShaderEntrypoint>* pEntrypoints;
+		UniqueVector<string> dependencies;
+		std::unordered_map<string, string> fileTextMap;
+		bool hasEmbeddedIncludes;
+		size_t lastVariantLength;
 
 		std::unordered_set<StringSpan> variantDefineSet;
+		// Flag and mode name -> flag index or g_VariantFlagLimit for modes
+		std::unordered_map<string, uint, DefineHash, std::equal_to<>> defineIndexMap;
+		uint referencedFlags;
+		bool isModeReferenced;
+		unique_ptr<WaveTokenCache> pTokenCache;
+
+		/// <summary>
+		/// Indexes variant defines after they are finalized by variant 0
+		/// </summary>
+		void InitDefineIndexMap();
 	};
 }
\ No newline at end of file
@@ -6,12 +6,17 @@
 #define BOOST_WAVE_SUPPORT_CPP1Z 0
 #define BOOST_WAVE_SUPPORT_CPP2A 0
 #define BOOST_WAVE_SUPPORT_MS_EXTENSIONS 0
+// Variants are preprocessed concurrently with one context per thread
+#define BOOST_WAVE_SUPPORT_THREADING 1
 #define BOOST_ALLOW_DEPRECATED_HEADERS
 
+#include <unordered_map>
+#include <memory>
 #include <boost/wave.hpp>
 #include <boost/wave/cpplexer/cpp_lex_token.hpp>
 #include <boost/wave/cpplexer/cpp_lex_iterator.hpp>
 #include "boost/utility/string_view.hpp"
+#include "WeaveUtils/GlobalUtils.hpp"
 
 namespace Weave::Effects
 {
@@ -46,9 +51,137 @@ namespace Weave::Effects
 	using WaveLexToken = boost::wave::cpplexer::lex_token<>;
 
 	/// <summary>
-	/// Presents access to the lexer through WaveLexToken iterators. Tokens are evaluated on the fly.
+	/// Interface implemented by lexers driving WaveLexIterator
 	/// </summary>
-	using WaveLexIterator = boost::wave::cpplexer::lex_iterator<WaveLexToken>;
+	using WaveLexInterface = boost::wave::cpplexer::lex_input_interface<WaveLexToken>;
+
+	/// <summary>
+	/// Caches the tokens of each source file lexed while it is active, keyed by the address of the
+	/// file's text. Later passes over the same text replay the cached tokens instead of lexing it 
+	/// again, leaving only directive evaluation and macro expansion to be repeated per variant.
+	/// Cached texts must remain unchanged until the cache is cleared.
+	/// </summary>
+	class WaveTokenCache
+	{
+	public:
+		MAKE_IMMOVABLE(WaveTokenCache)
+
+		/// <summary>
+		/// Activates a cache for lexers created on the calling thread, until destroyed
+		/// </summary>
+		class Scope
+		{
+		public:
+			MAKE_IMMOVABLE(Scope)
+
+			Scope(WaveTokenCache& cache);
+
+			~Scope();
+
+		private:
+			WaveTokenCache* pLast;
+		};
+
+		WaveTokenCache();
+
+		~WaveTokenCache();
+
+		/// <summary>
+		/// Returns a lexer for the given text. Tokens are replayed from the cache if the text was
+		/// lexed to its end before, and are otherwise recorded while lexing.
+		/// </summary>
+		WaveLexInterface* GetLexer(const char* pFirst, const char* pLast, 
+			WaveLexToken::position_type const& pos, WaveLangSupport language);
+
+		/// <summary>
+		/// Clears all cached tokens
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		/// Returns the cache active on the calling thread, or null if none is active
+		/// </summary>
+		static WaveTokenCache* GetActive();
+
+	private:
+		struct FileTokens;
+		class TokenReplay;
+		class TokenRecorder;
+
+		std::unordered_map<const char*, std::unique_ptr<FileTokens>> fileMap;
+	};
+
+	/// <summary>
+	/// Presents access to the lexer through WaveLexToken iterators. Tokens are evaluated on the fly,
+	/// or replayed from the active WaveTokenCache for files it has already lexed.
+	/// </summary>
+	class WaveLexIterator : public boost::wave::cpplexer::make_multi_pass<
+		boost::wave::cpplexer::impl::lex_iterator_functor_shim<WaveLexToken>>::type
+	{
+		using LexShim = boost::wave::cpplexer::impl::lex_iterator_functor_shim<WaveLexToken>;
+		using BaseType = boost::wave::cpplexer::make_multi_pass<LexShim>::type;
+		using FunctorData = boost::wave::cpplexer::make_multi_pass<LexShim>::functor_data_type;
+
+	public:
+		using token_type = WaveLexToken;
+
+		WaveLexIterator()
+		{ }
+
+		template <typename IteratorT>
+		WaveLexIterator(IteratorT const& first, IteratorT const& last, 
+			WaveLexToken::position_type const& pos, WaveLangSupport language) :
+			BaseType(FunctorData(LexShim(), GetLexer(first, last, pos, language)))
+		{ }
+
+		/// <summary>
+		/// Sets the position of the current token and those following it, as on #line
+		/// </summary>
+		void set_position(WaveLexToken::position_type const& pos)
+		{
+			const WaveLexToken& currToken = BaseType::dereference(*this);
+			WaveLexToken::position_type currPos = currToken.get_position();
+
+			currPos.set_file(pos.get_file());
+			currPos.set_line(pos.get_line());
+			const_cast<WaveLexToken&>(currToken).set_position(currPos);
+
+			if (currToken.get_value().find_first_of('\n') != WaveLexToken::string_type::npos)
+				currPos.set_line(pos.get_line() + 1);
+
+			LexShim::set_position(*this, currPos);
+		}
+
+		/// <summary>
+		/// Returns true if the current file has include guards. Only valid once the file has been
+		/// lexed to its end.
+		/// </summary>
+		bool has_include_guards(std::string& guardName) const
+		{
+			return LexShim::has_include_guards(*this, guardName);
+		}
+
+	private:
+		/// <summary>
+		/// Only texts given by address, as files are, can be cached. Other inputs, such as macros
+		/// and pragma operands, are lexed from temporaries.
+		/// </summary>
+		template <typename IteratorT>
+		static WaveLexInterface* GetLexer(IteratorT const& first, IteratorT const& last, 
+			WaveLexToken::position_type const& pos, WaveLangSupport language)
+		{
+			if constexpr (std::is_same_v<IteratorT, const char*>)
+			{
+				WaveTokenCache* pCache = WaveTokenCache::GetActive();
+
+				if (pCache != nullptr)
+					return pCache->GetLexer(first, last, pos, language);
+			}
+
+			return boost::wave::cpplexer::lex_input_interface_generator<WaveLexToken>
+				::new_lexer(first, last, pos, language);
+		}
+	};
 
 	/// <summary>
 	/// Base class for accessing preprocessor hooks
@@ -76,8 +209,119 @@ namespace Weave::Effects
 			WaveTokenSeqT const& values,
 			WaveLexToken const& pragma_token);
 
+		/// <summary>
+		/// Include hook, called after a file is opened
+		/// </summary>
+		template <typename WaveContextT>
+		void opened_include_file(
+			WaveContextT const& ctx,
+			std::string const& relname,
+			std::string const& absname,
+			bool is_system_include);
+
+		/// <summary>
+		/// Conditional hook. Records identifiers that can select a branch.
+		/// </summary>
+		template <typename WaveContextT, typename WaveTokenT, typename WaveContainerT>
+		bool evaluated_conditional_expression(
+			WaveContextT const& ctx,
+			WaveTokenT const& directive,
+			WaveContainerT const& expression,
+			bool expression_value)
+		{
+			AddReferences(expression);
+			return false;
+		}
+
+		/// <summary>
+		/// Macro hook. Records the macro and identifiers in its definition.
+		/// </summary>
+		template <typename WaveContextT, typename WaveTokenT, typename WaveContainerT>
+		bool expanding_object_like_macro(
+			WaveContextT const& ctx,
+			WaveTokenT const& macro,
+			WaveContainerT const& definition,
+			WaveTokenT const& macrocall)
+		{
+			AddReference(macro);
+			AddReferences(definition);
+			return false;
+		}
+
+		/// <summary>
+		/// Macro hook. Records identifiers in the macro's definition. Arguments are expanded, or 
+		/// appear in the output, separately.
+		/// </summary>
+		template <typename WaveContextT, typename WaveTokenT, typename WaveContainerT, typename WaveIterT>
+		bool expanding_function_like_macro(
+			WaveContextT const& ctx,
+			WaveTokenT const& macrodef,
+			std::vector<WaveTokenT> const& formal_args,
+			WaveContainerT const& definition,
+			WaveTokenT const& macrocall,
+			std::vector<WaveContainerT> const& arguments,
+			WaveIterT const& seqstart,
+			WaveIterT const& seqend)
+		{
+			AddReferences(definition);
+			return false;
+		}
+
+		/// <summary>
+		/// Include hook, called to resolve the path of an include. Embedded includes are matched by
+		/// path alone, as the files they were read from may not exist on this machine.
+		/// </summary>
+		template <typename WaveContextT>
+		bool locate_include_file(
+			WaveContextT& ctx,
+			std::string& file_path,
+			bool is_system,
+			char const* current_name,
+			std::string& dir_path,
+			std::string& native_name)
+		{
+			if (!GetHasEmbeddedIncludes())
+				return WaveContextPolicyBase::locate_include_file(ctx, file_path, is_system, current_name, dir_path, native_name);
+
+			// Only the including file's directory is searched, as with no include paths configured
+			if (!TryLocateEmbeddedFile(ctx.get_current_directory(), file_path))
+				return false;
+
+			dir_path = file_path;
+			native_name = file_path;
+			return true;
+		}
+
+		/// <summary>
+		/// Retrieves the contents of an included file. Returns false if the file can't be read.
+		/// </summary>
+		bool TryGetFileText(std::string_view filePath, std::string_view& text);
+
 	private:
 		VariantPreprocessor* pMain;
+
+		/// <summary>
+		/// Returns true if the preprocessor resolves includes against embedded files
+		/// </summary>
+		bool GetHasEmbeddedIncludes() const;
+
+		/// <summary>
+		/// Resolves the given include path against embedded files, relative to the given directory.
+		/// Returns false if no embedded file has the resulting path.
+		/// </summary>
+		bool TryLocateEmbeddedFile(const boost::filesystem::path& currentDir, std::string& filePath) const;
+
+		/// <summary>
+		/// Forwards identifiers to the preprocessor for variant dependency tracking
+		/// </summary>
+		void AddReference(WaveLexToken const& token);
+
+		template <typename WaveContainerT>
+		void AddReferences(WaveContainerT const& tokens)
+		{
+			for (WaveLexToken const& token : tokens)
+				AddReference(token);
+		}
 	};
 
 	/// <summary>
@@ -91,9 +335,35 @@ namespace Weave::Effects
 	using WaveSrcIterator = WaveStringView::iterator;
 
 	/// <summary>
-	/// Defines how includes are loaded
+	/// Defines how includes are loaded. Files are retrieved from the preprocessor, which reads each 
+	/// one from disk once per source, rather than once per variant.
 	/// </summary>
-	using WaveInputPolicy = boost::wave::iteration_context_policies::load_file_to_string;
+	struct WaveInputPolicy
+	{
+		template <typename IterContextT>
+		class inner
+		{
+		public:
+			template <typename PositionT>
+			static void init_iterators(IterContextT& iter_ctx, PositionT const& act_pos, WaveLangSupport language)
+			{
+				using WaveIterT = typename IterContextT::iterator_type;
+				const std::string_view filePath(iter_ctx.filename.c_str(), iter_ctx.filename.size());
+				std::string_view text;
+
+				if (!iter_ctx.ctx.get_hooks().TryGetFileText(filePath, text))
+				{
+					BOOST_WAVE_THROW_CTX(iter_ctx.ctx, boost::wave::preprocess_exception,
+						bad_include_file, iter_ctx.filename.c_str(), act_pos);
+					return;
+				}
+
+				// Same iterator type as the main source, sharing its lexer instantiation
+				iter_ctx.first = WaveIterT(text.data(), text.data() + text.length(), PositionT(iter_ctx.filename), language);
+				iter_ctx.last = WaveIterT();
+			}
+		};
+	};
 
 	/// <summary>
 	/// Main preprocessor interface. Used for configuring macros, includes and retrieving lexing iterators
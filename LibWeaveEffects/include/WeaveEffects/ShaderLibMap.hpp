@@ -63,6 +63,11 @@ namespace Weave::Effects
 		/// </summary>
 		EffectDefHandle GetEffect(uint effectID) const;
 
+		/// <summary>
+		/// Returns the shaderID corresponding to a shader ID referenced by a pass in the given effect
+		/// </summary>
+		uint GetEffectShaderID(uint effectID, uint shaderID) const;
+
 		/// <summary>
 		/// Returns the default variant ID for the shader with the given name, -1 on fail
 		/// </summary>
@@ -83,6 +88,26 @@ namespace Weave::Effects
 		/// </summary>
 		uint TryGetEffectID(uint nameID, uint vID) const;
 
+		// Deferred variants
+
+		/// <summary>
+		/// Returns true if any variants in the library were deferred to compilation on first use
+		/// </summary>
+		bool GetHasDeferredVariants() const;
+
+		/// <summary>
+		/// Returns true if the variant was deferred to compilation on first use, and has not yet been
+		/// added. Shaders and effects cannot be retrieved from variants until they are added.
+		/// </summary>
+		bool GetIsDeferred(uint vID) const;
+
+		/// <summary>
+		/// Adds a deferred variant compiled at runtime. Strings are merged into the library's string
+		/// map, and shaders and effects are assigned new IDs. Existing IDs and handles remain valid.
+		/// </summary>
+		void AddDeferredVariant(uint vID, ShaderRegistryDef&& regDef, const StringIDMapDef::Handle& strDef, 
+			const VariantDef& variant);
+
 		// Flag/Mode getters
 
 		/// <summary>
@@ -147,6 +172,22 @@ namespace Weave::Effects
 			/// Maps (EffectName) => EffectDef
 			/// </summary>
 			NameIndexMap effects;
+
+			/// <summary>
+			/// True if the variant is waiting to be compiled and added
+			/// </summary>
+			bool isDeferred;
+		};
+
+		/// <summary>
+		/// Registry for a single variant compiled at runtime. Deferred IDs are offset by the number of
+		/// shaders and effects in the registries added before it.
+		/// </summary>
+		struct DeferredRegistry
+		{
+			std::unique_ptr<ShaderRegistryMap> pRegMap;
+			uint shaderStart;
+			uint effectStart;
 		};
 
 		string name;
@@ -156,11 +197,28 @@ namespace Weave::Effects
 		/// </summary>
 		PlatformDef platform;
 
+		/// <summary>
+		/// String map owned by the library, if variants are deferred and strings are not shared
+		/// </summary>
+		std::unique_ptr<StringIDBuilder> pOwnedStringIDs;
+
+		/// <summary>
+		/// Builder used to merge the strings of deferred variants. Null if no variants are deferred.
+		/// </summary>
+		StringIDBuilder* pStringIDs;
+
 		/// <summary>
 		/// Pointer to unique shader data map
 		/// </summary>
 		std::unique_ptr<ShaderRegistryMap> pRegMap;
 
+		/// <summary>
+		/// Registries of deferred variants added at runtime, in the order they were added
+		/// </summary>
+		UniqueVector<DeferredRegistry> deferredRegs;
+		uint deferredShaderCount;
+		uint deferredEffectCount;
+
 		/// <summary>
 		/// NameID -> default vID map shared with all repos
 		/// </summary>
@@ -183,5 +241,10 @@ namespace Weave::Effects
 
 		void InitMaps();
 
+		/// <summary>
+		/// Returns the deferred registry containing the given shader or effect, and its ID in that registry
+		/// </summary>
+		const DeferredRegistry& GetDeferredRegistry(uint id, uint& localID) const;
+
 	};
 }
\ No newline at end of file
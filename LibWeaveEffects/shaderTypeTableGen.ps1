@@ -65,6 +65,7 @@ Param(
 [string]$header = 
 @"
 #include "pch.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ConstNameMap.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/ShaderTypeInfo.hpp"
 
 namespace Weave::Effects
@@ -96,11 +97,11 @@ const ShaderTypeInfo* TryGetShaderTypeInfo(ShaderTypes flags)
 
 bool TryGetShaderType(string_view name, ShaderTypes& type)
 {
-	const auto& pair = s_ShaderTypeNameMap.find(name);
+	const ShaderTypes* pType = s_ShaderTypeNameMap.TryGetValue(name);
 
-	if (pair != s_ShaderTypeNameMap.end())
+	if (pType != nullptr)
 	{
-		type |= pair->second;
+		type |= *pType;
 		return true;
 	}
 	else
@@ -129,7 +130,7 @@ static const std::unordered_map<ShaderTypes, ShaderTypeInfo> s_ShaderTypeMap =
 # HLSL type name to shader type map
 [string]$nameTypeMapDecl = 
 @"
-static const std::unordered_map<string_view, ShaderTypes> s_ShaderTypeNameMap
+static constexpr auto s_ShaderTypeNameMap = GetConstNameMap<ShaderTypes>(
 {
 "@;
 
@@ -272,7 +273,7 @@ function Write-Tables
 		AppendSubtypeNames -hlslBaseName $pair[0] -baseEnumName $pair[1]
 	}
 
-	[void]$sb.AppendLine("};");
+	[void]$sb.AppendLine("});");
 
 	# Add footer and write to file
 	[void]$sb.AppendLine($footer);
@@ -37,7 +37,7 @@ EffectParseException::EffectParseException(const std::source_location& loc, stri
 EffectSyntaxException::EffectSyntaxException(const std::source_location& loc,
 	const BlockAnalyzer& ctx, int block, string&& msg)
 {
-	const LexBlock& fxLoc = ctx.GetBlocks()[block];
+	const LexBlock fxLoc = ctx.GetBlocks()[block];
 	const LexFile& fxSrc = ctx.GetSourceFiles()[fxLoc.file];
 
 	if (msg.length() > 0)
@@ -62,7 +62,7 @@ EffectSyntaxException::EffectSyntaxException(const std::source_location& loc,
 
 EffectSyntaxException::EffectSyntaxException(const BlockAnalyzer& ctx, int block, string&& msg)
 {
-	const LexBlock& fxLoc = ctx.GetBlocks()[block];
+	const LexBlock fxLoc = ctx.GetBlocks()[block];
 	const LexFile& fxSrc = ctx.GetSourceFiles()[fxLoc.file];
 
 	if (msg.length() > 0)
@@ -1,4 +1,5 @@
 #include "pch.hpp"
+#include <bit>
 #include "WeaveUtils/Compression.hpp"
 #include "WeaveUtils/Span.hpp"
 #include "WeaveEffects/ShaderData.hpp"
@@ -7,6 +8,18 @@
 using namespace Weave;
 using namespace Weave::Effects;
 
+bool Weave::Effects::GetIsVariantDeferred(const VariantRepoDef& repo, uint configID)
+{
+	if (repo.maxHotFlags == g_InvalidID32)
+		return false;
+
+	// Cid = F + (M * 2^Fc)
+	const uint flagCount = (uint)repo.configTable.flagIDs.GetLength();
+	const uint flags = configID & ((1u << flagCount) - 1u);
+
+	return (uint)std::popcount(flags) > repo.maxHotFlags;
+}
+
 ShaderLibDef Weave::Effects::GetDeserializedLibDef(string_view libData)
 {
 	static thread_local ZLibArchive archive;
@@ -17,3 +30,14 @@ ShaderLibDef Weave::Effects::GetDeserializedLibDef(string_view libData)
 
 	return lib;
 }
+
+ShaderCompileCacheDef Weave::Effects::GetDeserializedCompileCacheDef(string_view cacheData)
+{
+	static thread_local ZLibArchive archive;
+	static thread_local Vector<byte> zipBuffer;
+
+	ShaderCompileCacheDef cache;
+	DeserializeCompressedStream(cacheData, archive, zipBuffer, cache);
+
+	return cache;
+}
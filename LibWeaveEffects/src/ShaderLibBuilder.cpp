@@ -1,36 +1,181 @@
 #pragma once
 #include "pch.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
 #include "WeaveUtils/Compression.hpp"
-#include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
-#include "WeaveEffects/ShaderLibBuilder/SymbolTable.hpp"
-#include "WeaveEffects/ShaderLibBuilder/ShaderGenerator.hpp"
+#include "WeaveUtils/Metrics.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompileCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ParseCache.hpp"
 #include "WeaveEffects/ShaderLibBuilder/VariantPreprocessor.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryMap.hpp"
+#include "WeaveEffects/ShaderDataHandles.hpp"
 #include "WeaveEffects/ShaderLibMap.hpp"
 #include "WeaveEffects/ShaderLibBuilder.hpp"
 #include "WeaveEffects/Version.hpp"
 
 using namespace Weave::Effects;
 
+/// <summary>
+/// Returns the bit representing the given include in a variant's include mask
+/// </summary>
+static ulong GetIncludeBit(const uint index) { return 1ull << std::min(index, 63u); }
+
+/// <summary>
+/// Appends the names of files included with quotes in the given text to the given buffer. Conditional
+/// directives are ignored, so every file that could be included is found.
+/// </summary>
+static void GetQuotedIncludes(string_view text, Vector<string_view>& names)
+{
+	constexpr string_view whitespace = " \t";
+	constexpr string_view keyword = "include";
+	size_t lineStart = 0;
+
+	while (lineStart < text.length())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		lineEnd = (lineEnd != string_view::npos) ? lineEnd : text.length();
+		string_view line = text.substr(lineStart, lineEnd - lineStart);
+		lineStart = lineEnd + 1;
+
+		line.remove_prefix(std::min(line.find_first_not_of(whitespace), line.length()));
+
+		if (!line.starts_with('#'))
+			continue;
+
+		line.remove_prefix(1);
+		line.remove_prefix(std::min(line.find_first_not_of(whitespace), line.length()));
+
+		if (!line.starts_with(keyword))
+			continue;
+
+		line.remove_prefix(keyword.length());
+		line.remove_prefix(std::min(line.find_first_not_of(whitespace), line.length()));
+
+		if (!line.starts_with('"'))
+			continue;
+
+		const size_t nameEnd = line.find('"', 1);
+
+		if (nameEnd != string_view::npos && nameEnd > 1)
+			names.Add(line.substr(1, nameEnd - 1));
+	}
+}
+
+/// <summary>
+/// Sets the size and CRC of a dependency from the given file contents
+/// </summary>
+static void SetFileHash(string_view text, FileDependencyDef& file)
+{
+	file.sizeBytes = (uint)text.length();
+	file.crc = GetCRC32(text);
+}
+
+/// <summary>
+/// Sets the size and CRC of the file at the dependency's path. Returns false if it can't be read.
+/// </summary>
+static bool TryHashFile(FileDependencyDef& file)
+{
+	std::ifstream stream(file.path, std::ios::binary);
+
+	if (!stream)
+		return false;
+
+	std::stringstream streamBuf;
+	streamBuf << stream.rdbuf();
+	SetFileHash(streamBuf.view(), file);
+	return true;
+}
+
+/// <summary>
+/// Configurations whose preprocessing referenced the same flags and modes. Configurations that 
+/// agree on those defines produce identical source.
+/// </summary>
+struct VariantDependencyClass
+{
+	uint flagMask;
+	bool isModeDependent;
+	// Referenced define values -> first configID preprocessed with them
+	std::unordered_map<uint, uint> keyConfigMap;
+};
+
+static uint GetDependencyKey(const VariantDependencyClass& depClass, const uint configID, const uint flagBits)
+{
+	return (configID & depClass.flagMask) | (depClass.isModeDependent ? (configID & ~flagBits) : 0u);
+}
+
+/// <summary>
+/// Returns a previously preprocessed configuration with output identical to the given one, 
+/// or -1 if none is known
+/// </summary>
+static uint TryGetEquivalentConfig(const IDynamicArray<VariantDependencyClass>& depClasses, const uint configID, const uint flagBits)
+{
+	for (const VariantDependencyClass& depClass : depClasses)
+	{
+		const auto it = depClass.keyConfigMap.find(GetDependencyKey(depClass, configID, flagBits));
+
+		if (it != depClass.keyConfigMap.end())
+			return it->second;
+	}
+
+	return g_InvalidID32;
+}
+
+/// <summary>
+/// Adds a preprocessed configuration to the class matching the defines it referenced
+/// </summary>
+static void AddDependencyClass(UniqueVector<VariantDependencyClass>& depClasses, const VariantPreprocessor& variantGen, 
+	const uint configID, const uint flagBits)
+{
+	const uint flagMask = variantGen.GetReferencedFlags();
+	const bool isModeDependent = variantGen.GetIsModeReferenced();
+	VariantDependencyClass* pClass = nullptr;
+
+	for (VariantDependencyClass& depClass : depClasses)
+	{
+		if (depClass.flagMask == flagMask && depClass.isModeDependent == isModeDependent)
+		{
+			pClass = &depClass;
+			break;
+		}
+	}
+
+	if (pClass == nullptr)
+		pClass = &depClasses.EmplaceBack(VariantDependencyClass{ .flagMask = flagMask, .isModeDependent = isModeDependent });
+
+	pClass->keyConfigMap.emplace(GetDependencyKey(*pClass, configID, flagBits), configID);
+}
+
 ShaderLibBuilder::ShaderLibBuilder() :
-	pVariantGen(new VariantPreprocessor()),
-	pAnalyzer(new BlockAnalyzer()),
-	pTable(new SymbolTable()),
-	pShaderGen(new ShaderGenerator()),
+	maxThreads(0),
+	maxHotFlags(g_InvalidID32),
 	pShaderRegistry(new ShaderRegistryBuilder()),
-	isDebugging(false),
-	libBufIndex(0),
+	pCompileCache(new ShaderCompileCache()),
+	pParseCache(new ParseCache()),
+#ifdef _WIN32
+	pCompiler(new ShaderCompilerD3D11()),
+#else
+	pCompiler(new ShaderCompilerStub()),
+#endif
+	pipelines(1),
 	cacheStats({}),
-	lastDefHandle({})
+	lastDefHandle({}),
+	pReusedRepo(nullptr),
+	changedIncludeMask(0)
 {
 	platform = PlatformDef
 	{
 		.preprocessorVersion = VERSION_STRING,
 		.preprocessorBuild = VERSION_BUILD,
-		.compilerVersion = string(GetCompilerVersionD3D11()),
+		.compilerVersion = string(pCompiler->GetVersion()),
 		.featureLevel = "5_0",
-		.target = PlatformTargets::DirectX11
+		.target = PlatformTargets::DirectX11,
+		.isDebugging = false
 	};
 }
 
@@ -50,7 +195,32 @@ void ShaderLibBuilder::SetTarget(PlatformTargets target) { platform.target = tar
 
 void ShaderLibBuilder::SetFeatureLevel(string_view featureLevel) { platform.featureLevel = featureLevel; }
 
-void ShaderLibBuilder::SetDebug(bool isDebugging) { this->isDebugging = isDebugging; }
+void ShaderLibBuilder::SetDebug(bool isDebugging) { platform.isDebugging = isDebugging; }
+
+void ShaderLibBuilder::SetCompiler(unique_ptr<IShaderCompiler>&& compiler)
+{
+	FX_CHECK_MSG(compiler.get() != nullptr, "Shader compiler cannot be null");
+	pCompiler = std::move(compiler);
+
+	// Cached shaders are only valid for the compiler that produced them
+	if (platform.compilerVersion != pCompiler->GetVersion())
+	{
+		platform.compilerVersion = pCompiler->GetVersion();
+		pCompileCache->Clear();
+	}
+}
+
+void ShaderLibBuilder::SetMaxThreads(uint maxThreads) { this->maxThreads = maxThreads; }
+
+void ShaderLibBuilder::SetMaxHotFlags(uint maxHotFlags) { this->maxHotFlags = maxHotFlags; }
+
+uint ShaderLibBuilder::GetThreadCount() const
+{
+	if (maxThreads > 0)
+		return maxThreads;
+	else
+		return std::max(std::thread::hardware_concurrency(), 1u);
+}
 
 bool ShaderLibBuilder::TrySetCache(const ShaderLibDef::Handle& cachedDef)
 {
@@ -75,6 +245,31 @@ bool ShaderLibBuilder::TrySetCache(const ShaderLibDef::Handle& cachedDef)
 	return false;
 }
 
+bool ShaderLibBuilder::TrySetCompileCache(const ShaderCompileCacheDef::Handle& cacheDef)
+{
+	// Feature level and debugging are part of each shader's compile key
+	PlatformDef cachePlatform = *cacheDef.pPlatform;
+	cachePlatform.featureLevel = platform.featureLevel;
+	cachePlatform.isDebugging = platform.isDebugging;
+
+	if (platform == cachePlatform)
+	{
+		pCompileCache->SetDefinition(cacheDef);
+		return true;
+	}
+
+	return false;
+}
+
+bool ShaderLibBuilder::GetIsCompileCacheChanged() const { return pCompileCache->GetIsChanged(); }
+
+ShaderCompileCacheDef::Handle ShaderLibBuilder::GetCompileCacheDefinition() const 
+{ 
+	return pCompileCache->GetDefinition(platform); 
+}
+
+void ShaderLibBuilder::SetParseCacheDirectory(string_view path) { pParseCache->SetDirectory(path); }
+
 /* 
 	Main Processing 
 */
@@ -85,32 +280,184 @@ void ShaderLibBuilder::AddRepo(string_view repoPath, string_view libSrc)
 
 	const uint repoID = (uint)repos.GetLength() << g_VariantGroupOffset;
 	const uint crc = GetCRC32(libSrc);
-	pVariantGen->SetSrc(repoPath, libSrc);
+
+	includeBuf.Clear();
+	includeIndexMap.clear();
+	pendingIncludes.Clear();
+	pendingIncludeMap.clear();
+	pReusedRepo = nullptr;
+	changedIncludeMask = 0;
 
 	// Check repo cache
 	if (const VariantRepoDef* pRepo = TryGetCachedRepo(repoPath); pRepo != nullptr)
 	{
-		if (libSrc.length() == pRepo->sourceSizeBytes && crc == pRepo->sourceCRC)
+		if (libSrc.length() == pRepo->sourceSizeBytes && crc == pRepo->sourceCRC && maxHotFlags == pRepo->maxHotFlags)
 		{
-			WV_LOG_DEBUG() << "Cache hit for repository: " << repoPath;
-			cacheHits.Add(pRepo);
-			return;
+			changedIncludeMask = InitIncludes(*pRepo);
+
+			if (changedIncludeMask == 0)
+			{
+				WV_LOG_DEBUG() << "Cache hit for repository: " << repoPath;
+				WV_METRIC_ADD("fx.repo.cacheHits", 1);
+				cacheHits.Add(pRepo);
+				return;
+			}
+
+			// Variants that did not open a modified include are copied from the cache
+			WV_LOG_DEBUG() << "Partial cache hit for " << repoPath << ": includes changed, reprocessing dependent variants";
+			WV_METRIC_ADD("fx.repo.partialHits", 1);
+			pReusedRepo = pRepo;
 		}
 		else
-			WV_LOG_DEBUG() << "Cache miss for " << repoPath << ": source changed, reprocessing";
+			WV_LOG_DEBUG() << "Cache miss for " << repoPath << ": source or settings changed, reprocessing";
 	}
 
 	// Fall back to full processing
+	WV_METRIC_ADD("fx.repo.cacheMisses", 1);
 	VariantRepoDef& repo = repos.EmplaceBack();
 	repo.sourceSizeBytes = (uint)libSrc.length();
 	repo.sourceCRC = crc;
 	repo.path = repoPath;
+	repo.maxHotFlags = maxHotFlags;
+
+	// Variant 0 declares the repo's flags and modes, and must be processed first
+	VariantPipeline& primary = pipelines[0];
+	primary.SetSrc(repoPath, libSrc, platform.featureLevel, platform.isDebugging, *pCompileCache, *pParseCache, *pCompiler);
+	const Hash128 firstHash = primary.PreprocessVariant(0);
+
+	InitRepo(primary.GetPreprocessor(), repo);
+	AddVariantIncludes(0, primary.GetPreprocessor());
+	repo.variantIncludeMasks[0] = GetVariantIncludeMask(0);
+
+	// Flags and modes may have been declared in a modified include
+	if (pReusedRepo != nullptr && (pReusedRepo->variants.GetLength() != repo.variants.GetLength()
+		|| (repo.variantIncludeMasks[0] & changedIncludeMask) != 0))
+	{
+		pReusedRepo = nullptr;
+	}
+
+	// Variant 0 is processed alone, and large sources can be lexed in parallel
+	if (!GetIsVariantReused(0))
+	{
+		primary.SetMaxLexThreads(GetThreadCount());
+		primary.CompileVariant(0, repoID, repo.variants[0]);
+	}
+
+	// Deferred variants are regenerated from source at runtime
+	if (maxHotFlags < (uint)repo.configTable.flagIDs.GetLength())
+		repo.deferredSrc = libSrc;
+
+	const uint pipelineCount = ProcessVariants(repoID, firstHash, repo);
+
+	// Include text is retained by pipelines until merged
+	if (!repo.deferredSrc.empty())
+		GetDeferredIncludes(repo);
+
+	MergeVariants(repoID, pipelineCount, repo);
+
+	// Indexed in configID order, after processing, for output independent of thread count
+	for (uint configID = 1; configID < (uint)repo.variants.GetLength(); configID++)
+	{
+		if (!GetIsVariantReused(configID))
+			repo.variantIncludeMasks[configID] = GetVariantIncludeMask(configID);
+	}
+
+	repo.includes = DynamicArray<FileDependencyDef>(includeBuf);
+	pReusedRepo = nullptr;
+}
+
+void ShaderLibBuilder::GetDeferredIncludes(VariantRepoDef& repo) const
+{
+	namespace fs = std::filesystem;
+	const fs::path srcDir = fs::absolute(fs::path(repo.path)).parent_path().lexically_normal();
+	std::unordered_map<string, string> fileTexts;
+	Vector<string> scanQueue;
+	Vector<string_view> names;
+
+	const auto AddFile = [&](const fs::path& path)
+	{
+		const string key = path.lexically_normal().string();
+
+		if (fileTexts.contains(key))
+			return;
+
+		string_view cachedText;
+		string text;
+		bool isCached = false;
+
+		// Files opened by precompiled variants were retained by the pipeline that opened them
+		for (const VariantPipeline& pipeline : pipelines)
+		{
+			if (pipeline.GetPreprocessor().TryGetCachedFileText(path.string(), cachedText))
+			{
+				text = cachedText;
+				isCached = true;
+				break;
+			}
+		}
+
+		if (!isCached)
+		{
+			std::ifstream stream(path, std::ios::binary);
+
+			// Scanned includes may be in branches no configuration takes
+			if (!stream)
+				return;
+
+			std::stringstream streamBuf;
+			streamBuf << stream.rdbuf();
+			text = std::move(streamBuf).str();
+		}
+
+		fileTexts.emplace(key, std::move(text));
+		scanQueue.EmplaceBack(key);
+	};
 
-	for (uint configID = 0; configID < pVariantGen->GetVariantCount(); configID++)
+	/* Deferred variants may take branches no precompiled variant took, so files named in include
+	directives of the source, or any embedded file, are embedded too. Quoted includes are searched for
+	relative to the including file, as no include paths are configured. */
+	for (const FileDependencyDef& file : includeBuf)
+		AddFile(fs::path(file.path));
+
+	for (const FileDependencyDef& file : pendingIncludes)
+		AddFile(fs::path(file.path));
+
+	GetQuotedIncludes(repo.deferredSrc, names);
+
+	for (const string_view name : names)
+		AddFile(srcDir / fs::path(name));
+
+	while (!scanQueue.IsEmpty())
 	{
-		AddRepoConfiguration(repoPath, configID, repoID, repo);
-		ClearVariant();
+		const fs::path path(scanQueue.GetBack());
+		scanQueue.RemoveBack();
+
+		names.Clear();
+		GetQuotedIncludes(fileTexts.at(path.string()), names);
+
+		for (const string_view name : names)
+			AddFile(path.parent_path() / fs::path(name));
 	}
+
+	// Sorted by path, for output independent of thread count
+	Vector<string_view> paths;
+	paths.Reserve(fileTexts.size());
+
+	for (const auto& [path, text] : fileTexts)
+		paths.Add(path);
+
+	std::sort(paths.begin(), paths.end());
+	repo.deferredIncludes = DynamicArray<IncludeTextDef>(paths.GetLength());
+
+	for (uint i = 0; i < (uint)paths.GetLength(); i++)
+	{
+		const fs::path relPath = fs::path(paths[i]).lexically_relative(srcDir);
+		IncludeTextDef& include = repo.deferredIncludes[i];
+		include.path = !relPath.empty() ? relPath.generic_string() : fs::path(paths[i]).generic_string();
+		include.text = fileTexts.at(string(paths[i]));
+	}
+
+	WV_LOG_DEBUG() << "Includes embedded for deferred variants: " << paths.GetLength();
 }
 
 const VariantRepoDef* ShaderLibBuilder::TryGetCachedRepo(string_view path) const
@@ -122,89 +469,330 @@ const VariantRepoDef* ShaderLibBuilder::TryGetCachedRepo(string_view path) const
 	return (it != repoPathCacheMap.end()) ? &lastDefHandle.pRepos->at(it->second) : nullptr;
 }
 
-void ShaderLibBuilder::AddRepoConfiguration(string_view repoPath, const uint configID, const uint repoID, VariantRepoDef& repo)
+void ShaderLibBuilder::InitRepo(const VariantPreprocessor& variantGen, VariantRepoDef& lib)
+{
+	const IDynamicArray<StringSpan>& flags = variantGen.GetVariantFlags();
+	lib.configTable.flagIDs = DynamicArray<uint>(flags.GetLength());
+
+	for (int i = 0; i < flags.GetLength(); i++)
+		lib.configTable.flagIDs[i] = pShaderRegistry->GetOrAddStringID(flags[i]);
+
+	const IDynamicArray<StringSpan>& modes = variantGen.GetVariantModes();
+	lib.configTable.modeIDs = DynamicArray<uint>(modes.GetLength());
+
+	for (int i = 0; i < modes.GetLength(); i++)
+		lib.configTable.modeIDs[i] = pShaderRegistry->GetOrAddStringID(modes[i]);
+
+	lib.variants = DynamicArray<VariantDef>(variantGen.GetVariantCount());
+	lib.variantIncludeMasks = DynamicArray<ulong>(lib.variants.GetLength());
+	variantIncludeIDs.Clear();
+	variantIncludeIDs.Resize(lib.variants.GetLength());
+
+	WV_LOG_DEBUG() << "Variants declared: " << lib.variants.GetLength();
+	FX_CHECK_MSG(lib.variants.GetLength() != 0, "No shaders found.");
+}
+
+uint ShaderLibBuilder::ProcessVariants(const uint repoID, const Hash128& firstHash, VariantRepoDef& repo)
 {
-	const uint vID = repoID | configID;
-	RepoSrcBuf* pBuf = &libBufs[libBufIndex];
-	pBuf->libText.clear();
-	pBuf->configID = configID;
+	const uint variantCount = (uint)repo.variants.GetLength();
+	const uint threadCount = std::clamp(GetThreadCount(), 1u, std::max(variantCount - 1, 1u));
 
-	// Generate variant
-	pVariantGen->GetVariant(configID, pBuf->libText, entrypoints);
+	variantHashes.Clear();
+	variantHashes.Resize(variantCount);
+	variantPipelineIDs.Clear();
+	variantPipelineIDs.Resize(variantCount);
+	variantHashConfigMap.clear();
 
-	// Update variant history and check for repeats
-	bool isDuplicate = false;
+	variantHashes[0] = firstHash;
+	variantHashConfigMap.emplace(firstHash, 0);
 
-	for (int i = 0; i < std::size(libBufs); i++)
+	if (variantCount == 1)
+		return 1;
+
+	while (pipelines.GetLength() < threadCount)
+		pipelines.EmplaceBack();
+
+	for (uint i = 1; i < threadCount; i++)
+		pipelines[i].SetSrc(pipelines[0]);
+
+	// Threads left over by pipelines are shared for lexing
+	for (uint i = 0; i < threadCount; i++)
+		pipelines[i].SetMaxLexThreads(std::max(GetThreadCount() / threadCount, 1u));
+
+	// Configurations are claimed in ascending order, but may finish out of order
+	std::atomic<uint> nextConfigID(1);
+	std::atomic<bool> isCanceled(false);
+	std::mutex hashMutex;
+	UniqueVector<VariantDependencyClass> depClasses;
+	const uint flagBits = (1u << (uint)repo.configTable.flagIDs.GetLength()) - 1u;
+	Vector<std::exception_ptr> errors(threadCount);
+	Vector<uint> errorConfigIDs(threadCount, -1);
+
+	const auto RunPipeline = [&](const uint pipelineID)
 	{
-		if (libBufIndex != i && pBuf->libText == libBufs[i].libText)
+		VariantPipeline& pipeline = pipelines[pipelineID];
+		uint configID = 0;
+
+		try
 		{
-			isDuplicate = true;
-			pBuf = &libBufs[i];
-			break;
+			while (!isCanceled.load(std::memory_order_relaxed))
+			{
+				configID = nextConfigID.fetch_add(1, std::memory_order_relaxed);
+
+				if (configID >= variantCount)
+					break;
+
+				if (GetIsVariantDeferred(repo, configID))
+				{
+					WV_METRIC_ADD("fx.variants.deferred", 1);
+					continue;
+				}
+
+				if (GetIsVariantReused(configID))
+				{
+					repo.variantIncludeMasks[configID] = pReusedRepo->variantIncludeMasks[configID];
+					WV_METRIC_ADD("fx.variants.reused", 1);
+					continue;
+				}
+
+				uint srcConfigID;
+
+				// Skip preprocessing if an equivalent configuration was already processed
+				{
+					std::lock_guard lock(hashMutex);
+					srcConfigID = TryGetEquivalentConfig(depClasses, configID, flagBits);
+
+					if (srcConfigID != g_InvalidID32)
+					{
+						variantHashes[configID] = variantHashes[srcConfigID];
+						variantIncludeIDs[configID] = variantIncludeIDs[srcConfigID];
+					}
+				}
+
+				if (srcConfigID != g_InvalidID32)
+				{
+					WV_LOG_WARN() << "Unused flag/mode combination detected. ID: " << (repoID | configID) << ". Skipped.";
+					WV_METRIC_ADD("fx.variants.pruned", 1);
+					continue;
+				}
+
+				const Hash128 hash = pipeline.PreprocessVariant(configID);
+				variantHashes[configID] = hash;
+
+				{
+					std::lock_guard lock(hashMutex);
+					AddVariantIncludes(configID, pipeline.GetPreprocessor());
+					AddDependencyClass(depClasses, pipeline.GetPreprocessor(), configID, flagBits);
+					const auto [it, isNew] = variantHashConfigMap.emplace(hash, configID);
+
+					// The lowest configuration always becomes the source for its duplicates
+					if (configID < it->second)
+						it->second = configID;
+
+					srcConfigID = it->second;
+				}
+
+				if (srcConfigID == configID)
+				{
+					pipeline.CompileVariant(configID, repoID, repo.variants[configID]);
+					variantPipelineIDs[configID] = pipelineID;
+				}
+				else
+				{
+					WV_LOG_WARN() << "Unused flag/mode combination detected. ID: " << (repoID | configID) << ". Skipped.";
+					WV_METRIC_ADD("fx.variants.skipped", 1);
+				}
+			}
+		}
+		catch (...)
+		{
+			errors[pipelineID] = std::current_exception();
+			errorConfigIDs[pipelineID] = configID;
+			isCanceled.store(true, std::memory_order_relaxed);
 		}
+	};
+
+	// Calling thread runs the primary pipeline
+	{
+		Vector<std::jthread> workers;
+		workers.Reserve(threadCount - 1);
+
+		for (uint i = 1; i < threadCount; i++)
+			workers.EmplaceBack(RunPipeline, i);
+
+		RunPipeline(0);
 	}
 
-	// Initialize storage
-	if (configID == 0)
-		InitRepo(repo);
+	// Configurations below a failed ID were all claimed before it and still run to completion, 
+	// so reporting the lowest ID matches the error a serial build would report
+	uint firstError = -1;
 
-	if (!isDuplicate) // Parse and precompile variants
+	for (uint i = 0; i < threadCount; i++)
 	{
-		const uint resCount = pShaderRegistry->GetUniqueResCount();
+		if (errors[i] != nullptr && (firstError == -1 || errorConfigIDs[i] < errorConfigIDs[firstError]))
+			firstError = i;
+	}
 
-		pAnalyzer->AnalyzeSource(repoPath, pBuf->libText);
-		pTable->ParseBlocks(*pAnalyzer);
+	if (firstError != -1)
+		std::rethrow_exception(errors[firstError]);
 
-		// Shaders
-		GetEntryPoints();
-		repo.variants[configID].shaders = DynamicArray<ShaderVariantDef>(entrypoints.GetLength());
-		GetShaderDefs(repoPath, repo.variants[configID].shaders, vID);
+	return threadCount;
+}
 
-		// Effects
-		GetEffects();
-		repo.variants[configID].effects = DynamicArray<EffectVariantDef>(effectBlocks.GetLength());
-		GetEffectDefs(repo.variants[configID].effects, vID);
+void ShaderLibBuilder::MergeVariants(const uint repoID, const uint pipelineCount, VariantRepoDef& repo)
+{
+	UniqueVector<unique_ptr<ShaderRegistryMap>> regMaps;
+	regMaps.Reserve(pipelineCount);
+
+	for (uint i = 0; i < pipelineCount; i++)
+	{
+		const ShaderRegistryBuilder& registry = pipelines[i].GetRegistry();
+		regMaps.EmplaceBack(new ShaderRegistryMap(registry.GetDefinition(), registry.GetStringIDBuilder().GetDefinition()));
+	}
+
+	for (uint configID = 0; configID < (uint)repo.variants.GetLength(); configID++)
+	{
+		if (GetIsVariantDeferred(repo, configID))
+			continue;
+
+		const uint vID = repoID | configID;
+		VariantDef& variant = repo.variants[configID];
+
+		if (GetIsVariantReused(configID)) // Copy cached variant into the library registry
+		{
+			const ShaderLibMap& cacheMap = GetCacheMap();
+			variant = pReusedRepo->variants[configID];
+
+			for (ShaderVariantDef& shader : variant.shaders)
+			{
+				shader.shaderID = pShaderRegistry->GetOrAddShader(cacheMap.GetShader(shader.shaderID));
+				shader.variantID = vID;
+			}
+
+			for (EffectVariantDef& effect : variant.effects)
+			{
+				effect.effectID = pShaderRegistry->GetOrAddEffect(cacheMap.GetEffect(effect.effectID));
+				effect.variantID = vID;
+			}
+
+			continue;
+		}
+
+		const uint srcConfigID = variantHashConfigMap.at(variantHashes[configID]);
+
+		if (srcConfigID != configID) // Copy variant mappings and update ID
+		{
+			variant = repo.variants[srcConfigID];
 
-		if (resCount == pShaderRegistry->GetUniqueResCount())
-			WV_LOG_WARN() << "Unused flag/mode combination detected. ID: " << vID << ". Not skipped.";
+			for (ShaderVariantDef& shader : variant.shaders)
+				shader.variantID = vID;
 
-		libBufIndex++;
-		libBufIndex %= std::size(libBufs);
+			for (EffectVariantDef& effect : variant.effects)
+				effect.variantID = vID;
+		}
+		else // Remap pipeline IDs to library IDs
+		{
+			const ShaderRegistryMap& regMap = *regMaps[variantPipelineIDs[configID]];
+
+			for (ShaderVariantDef& shader : variant.shaders)
+				shader.shaderID = pShaderRegistry->GetOrAddShader(ShaderDefHandle(regMap, shader.shaderID));
+
+			for (EffectVariantDef& effect : variant.effects)
+				effect.effectID = pShaderRegistry->GetOrAddEffect(EffectDefHandle(regMap, effect.effectID));
+		}
 	}
-	else // Skip processing
+
+	// Make new shaders available to later repos
+	for (uint i = 0; i < pipelineCount; i++)
 	{
-		// Copy variant mappings and update ID
-		repo.variants[configID] = repo.variants[pBuf->configID];
+		for (const VariantPipeline::CompiledShader& shader : pipelines[i].GetCompiledShaders())
+			pCompileCache->AddShader(shader.key, ShaderDefHandle(*regMaps[i], shader.shaderID));
+	}
 
-		for (ShaderVariantDef& shader : repo.variants[configID].shaders)
-			shader.variantID = vID;
+	pShaderRegistry->ClearCopyCache();
 
-		for (EffectVariantDef& effect : repo.variants[configID].effects)
-			effect.variantID = vID;
+	for (VariantPipeline& pipeline : pipelines)
+		pipeline.Clear();
 
-		WV_LOG_WARN() << "Unused flag/mode combination detected. ID: " << vID << ". Skipped.";
+	pCompileCache->UpdateMap();
+}
+
+bool ShaderLibBuilder::GetIsVariantReused(const uint configID) const
+{
+	return pReusedRepo != nullptr && (pReusedRepo->variantIncludeMasks[configID] & changedIncludeMask) == 0;
+}
+
+ulong ShaderLibBuilder::InitIncludes(const VariantRepoDef& cachedRepo)
+{
+	ulong changedMask = 0;
+
+	// Indices are preserved, so cached include masks remain valid
+	for (uint i = 0; i < (uint)cachedRepo.includes.GetLength(); i++)
+	{
+		const FileDependencyDef& cachedFile = cachedRepo.includes[i];
+		FileDependencyDef& file = includeBuf.EmplaceBack(FileDependencyDef{ .path = cachedFile.path });
+		includeIndexMap.emplace(file.path, i);
+
+		if (!TryHashFile(file) || file.sizeBytes != cachedFile.sizeBytes || file.crc != cachedFile.crc)
+		{
+			WV_LOG_DEBUG() << "Include changed: " << file.path;
+			changedMask |= GetIncludeBit(i);
+		}
 	}
+
+	return changedMask;
 }
 
-void ShaderLibBuilder::InitRepo(VariantRepoDef& lib)
+void ShaderLibBuilder::AddVariantIncludes(const uint configID, const VariantPreprocessor& variantGen)
 {
-	const IDynamicArray<StringSpan>& flags = pVariantGen->GetVariantFlags();
-	lib.configTable.flagIDs = DynamicArray<uint>(flags.GetLength());
+	Vector<uint>& includeIDs = variantIncludeIDs[configID];
+	includeIDs.Clear();
 
-	for (int i = 0; i < flags.GetLength(); i++)
-		lib.configTable.flagIDs[i] = pShaderRegistry->GetOrAddStringID(flags[i]);
+	for (const string& path : variantGen.GetDependencies())
+	{
+		const auto [it, isNew] = pendingIncludeMap.emplace(path, (uint)pendingIncludes.GetLength());
 
-	const IDynamicArray<StringSpan>& modes = pVariantGen->GetVariantModes();
-	lib.configTable.modeIDs = DynamicArray<uint>(modes.GetLength());
+		if (isNew)
+		{
+			FileDependencyDef& file = pendingIncludes.EmplaceBack(FileDependencyDef{ .path = path });
+			string_view text;
+
+			// Opened includes are retained by the preprocessor, and only read from disk as a fallback
+			if (variantGen.TryGetCachedFileText(path, text))
+				SetFileHash(text, file);
+			else if (!TryHashFile(file))
+				WV_LOG_WARN() << "Failed to read include for caching: " << path;
+		}
 
-	for (int i = 0; i < modes.GetLength(); i++)
-		lib.configTable.modeIDs[i] = pShaderRegistry->GetOrAddStringID(modes[i]);
+		includeIDs.Add(it->second);
+	}
+}
 
-	lib.variants = DynamicArray<VariantDef>(pVariantGen->GetVariantCount());
+ulong ShaderLibBuilder::GetVariantIncludeMask(const uint configID)
+{
+	ulong mask = 0;
 
-	WV_LOG_DEBUG() << "Variants declared: " << lib.variants.GetLength();
-	FX_CHECK_MSG(lib.variants.GetLength() != 0, "No shaders found.");
+	for (const uint pendingID : variantIncludeIDs[configID])
+	{
+		const FileDependencyDef& file = pendingIncludes[pendingID];
+		const auto [it, isNew] = includeIndexMap.emplace(file.path, (uint)includeBuf.GetLength());
+
+		if (isNew)
+			includeBuf.EmplaceBack(file);
+
+		mask |= GetIncludeBit(it->second);
+	}
+
+	return mask;
+}
+
+const ShaderLibMap& ShaderLibBuilder::GetCacheMap() const
+{
+	// Only create map if merging is needed
+	if (pCacheMap.get() == nullptr)
+		pCacheMap.reset(new ShaderLibMap(lastDefHandle));
+
+	return *pCacheMap;
 }
 
 const ShaderLibDef::Handle& ShaderLibBuilder::GetDefinition() const
@@ -244,10 +832,6 @@ void ShaderLibBuilder::FinalizeDefinition() const
 
 void ShaderLibBuilder::MergeCacheHits() const
 {
-	// Only create map if merging is needed
-	if (pCacheMap.get() == nullptr)
-		pCacheMap.reset(new ShaderLibMap(lastDefHandle));
-
 	const uint newRepoCount = (uint)repos.GetLength();
 	const uint newShaderCount = pShaderRegistry->GetShaderCount();
 	const uint newEffectCount = pShaderRegistry->GetEffectCount();
@@ -256,7 +840,7 @@ void ShaderLibBuilder::MergeCacheHits() const
 	for (const VariantRepoDef* pRepo : cacheHits)
 	{
 		const uint repoID = (uint)repos.GetLength() << g_VariantGroupOffset;
-		const IStringIDMap& oldStrings = pCacheMap->GetStringMap();
+		const IStringIDMap& oldStrings = GetCacheMap().GetStringMap();
 		VariantRepoDef& cachedRepo = repos.EmplaceBack(*pRepo);
 
 		// Remap define names
@@ -271,14 +855,14 @@ void ShaderLibBuilder::MergeCacheHits() const
 		{
 			for (ShaderVariantDef& shader : variant.shaders)
 			{
-				const ShaderDefHandle handle = pCacheMap->GetShader(shader.shaderID);
+				const ShaderDefHandle handle = GetCacheMap().GetShader(shader.shaderID);
 				shader.shaderID = pShaderRegistry->GetOrAddShader(handle);
 				shader.variantID = (shader.variantID & g_VariantMask) | repoID;
 			}
 
 			for (EffectVariantDef& effect : variant.effects)
 			{
-				const EffectDefHandle handle = pCacheMap->GetEffect(effect.effectID);
+				const EffectDefHandle handle = GetCacheMap().GetEffect(effect.effectID);
 				effect.effectID = pShaderRegistry->GetOrAddEffect(handle);
 				effect.variantID = (effect.variantID & g_VariantMask) | repoID;
 			}
@@ -293,17 +877,21 @@ void ShaderLibBuilder::MergeCacheHits() const
 
 void ShaderLibBuilder::Clear()
 {
-	ClearVariant();
-	libBufIndex = 0;
-
-	for (int i = 0; i < std::size(libBufs); i++)
-	{
-		libBufs[i].libText.clear();
-		libBufs[i].configID = 0;
-	}
+	for (VariantPipeline& pipeline : pipelines)
+		pipeline.Clear();
+
+	variantHashes.Clear();
+	variantPipelineIDs.Clear();
+	variantHashConfigMap.clear();
+	includeBuf.Clear();
+	includeIndexMap.clear();
+	pendingIncludes.Clear();
+	pendingIncludeMap.clear();
+	variantIncludeIDs.Clear();
+	pReusedRepo = nullptr;
+	changedIncludeMask = 0;
 
 	repos.Clear();
-	pVariantGen->Clear();
 	pShaderRegistry->Clear();
 	name.clear();
 
@@ -312,249 +900,4 @@ void ShaderLibBuilder::Clear()
 	cacheHits.Clear();
 	lastDefHandle = {};
 	cacheStats = {};
-}
-
-void ShaderLibBuilder::ClearVariant()
-{
-	pTable->Clear();
-	pAnalyzer->Clear();
-	pShaderGen->Clear();
-
-	entrypoints.Clear();
-	epNameShaderIDMap.clear();
-
-	effectBlocks.Clear();
-	effectPasses.Clear();
-	effectShaders.Clear();
-
-	hlslBuf.clear();
-}
-
-/* 
-	Metadata Analysis 
-*/
-
-void ShaderLibBuilder::GetEntryPoints()
-{
-	// Attribute tags
-	for (int i = 0; i < pTable->GetSymbolCount(); i++)
-	{
-		SymbolHandle symbol = pTable->GetSymbol(i);
-
-		if (symbol.GetHasFlags(SymbolTypes::FuncDefinition))
-		{
-			TokenNodeHandle funcIdent = symbol.GetIdent();
-
-			for (int j = 0; j < funcIdent.GetChildCount(); j++)
-			{
-				if (funcIdent[j].GetHasFlags(TokenTypes::AttribShaderDecl))
-				{
-					string_view name = funcIdent.GetValue();
-					const uint nameID = pShaderRegistry->GetOrAddStringID(name);
-
-					if (!epNameShaderIDMap.contains(nameID))
-					{
-						ShaderEntrypoint& ep = entrypoints.EmplaceBack();
-						epNameShaderIDMap.emplace(nameID, -1);
-						ep.name = name;
-						ep.stage = GetStageFromFlags(funcIdent[j].GetFlags());
-						ep.symbolID = i;
-					}
-
-					break;
-				}
-			}
-		}
-	}
-
-	// Pragma shaders
-	for (int i = 0; i < entrypoints.GetLength(); i++)
-	{
-		ShaderEntrypoint& ep = entrypoints[i];
-		ScopeHandle global = pTable->GetScope(0);
-		const IDList* pFuncs = global.TryGetFuncOverloads(ep.name);
-		
-		if (pFuncs != nullptr && !pFuncs->empty())
-		{
-			const uint nameID = pShaderRegistry->GetOrAddStringID(ep.name);
-
-			if (!epNameShaderIDMap.contains(nameID))
-			{
-				epNameShaderIDMap.emplace(nameID, -1);
-				ep.symbolID = pFuncs->front();
-			}
-		}
-		else
-			FXBLOCK_THROW(*pAnalyzer, global.GetBlockStart(), 
-				"Definition for shader '{}' declared in pragma not found", ep.name);
-	}
-	
-	// Shader blocks
-	for (int i = 0; i < pTable->GetSymbolCount(); i++)
-	{
-		SymbolHandle symbol = pTable->GetSymbol(i);
-
-		if (symbol.GetHasFlags(SymbolTypes::ShaderDef))
-		{
-			ScopeHandle scope = *symbol.GetScope();
-			string_view name = symbol.GetName();
-			const IDList* pFuncs = scope.TryGetFuncOverloads(name);
-
-			if (pFuncs != nullptr && !pFuncs->empty())
-			{
-				const uint nameID = pShaderRegistry->GetOrAddStringID(name);
-
-				if (!epNameShaderIDMap.contains(nameID))
-				{
-					ShaderEntrypoint& ep = entrypoints.EmplaceBack();
-					epNameShaderIDMap.emplace(nameID, -1);
-					ep.name = name;
-					ep.stage = GetStageFromFlags(symbol.GetFlags());
-					ep.symbolID = pFuncs->front();
-				}
-			}
-			else
-				FXBLOCK_THROW(*pAnalyzer, symbol.GetIdent().GetBlockStart(),
-					"Could not find entrypoint for shader block '{}'", name);
-		}
-	}
-}
-
-void ShaderLibBuilder::GetEffects()
-{
-	for (int i = 0; i < pTable->GetSymbolCount(); i++)
-	{
-		SymbolHandle symbol = pTable->GetSymbol(i);
-
-		if (symbol.GetIsScope() && symbol.GetHasFlags(SymbolTypes::TechniqueDef))
-		{
-			ScopeHandle effectScope = *symbol.GetScope();
-			EffectBlock& effect = effectBlocks.EmplaceBack();
-			effect.nameID = pShaderRegistry->GetOrAddStringID(symbol.GetName());
-			effect.passStart = 0;
-			effect.passStart = (uint)effectPasses.GetLength();
-			effect.passCount = 0; 
-			bool isPassDefaulted = false;
-
-			for (int j = 0; j < effectScope.GetChildCount(); j++)
-			{
-				SymbolHandle effectChild = effectScope[j];
-
-				if (!isPassDefaulted && effectChild.GetHasFlags(SymbolTypes::TechniqueShaderDecl))
-					isPassDefaulted = true;
-
-				if (effectChild.GetHasFlags(SymbolTypes::TechniquePassDecl))
-				{
-					FXBLOCK_CHECK_MSG(!isPassDefaulted, *pAnalyzer, symbol.GetIdent().GetBlockStart(),
-						"Illegal use of defaulted and explicit passes in the same effect '{}'", symbol.GetName());
-						
-					effect.passCount++;
-				}
-			}
-
-			if (isPassDefaulted)
-			{
-				AddPass(effectScope, "DefaultedPass");
-				effect.passCount = 1;
-			}
-			else
-			{
-				for (int j = 0; j < effectScope.GetChildCount(); j++)
-				{
-					SymbolHandle effectChild = effectScope[j];
-
-					if (effectChild.GetHasFlags(SymbolTypes::TechniquePassDecl))
-					{
-						ScopeHandle passScope = *effectChild.GetScope();
-						AddPass(passScope, effectChild.GetName());
-					}
-				}
-			}
-		}
-	}
-}
-
-void ShaderLibBuilder::AddPass(const ScopeHandle& passScope, string_view name)
-{
-	PassBlock& pass = effectPasses.EmplaceBack();
-	pass.nameID = pShaderRegistry->GetOrAddStringID(name);
-	pass.shaderStart = (uint)effectShaders.GetLength();
-
-	for (int j = 0; j < passScope.GetChildCount(); j++)
-	{
-		SymbolHandle effectChild = passScope[j];
-
-		if (effectChild.GetHasFlags(SymbolTypes::TechniqueShaderDecl))
-		{
-			string_view shaderName = effectChild.GetName();
-			const uint stringID = pShaderRegistry->GetOrAddStringID(shaderName);
-			const auto& it = epNameShaderIDMap.find(stringID);
-
-			FXBLOCK_CHECK_MSG(it != epNameShaderIDMap.end(), *pAnalyzer, effectChild.GetIdent().GetBlockStart(),
-				"Unrecognised shader name '{}' declared in effect pass", shaderName);
-
-			const uint shaderID = it->second;
-			effectShaders.EmplaceBack(shaderID);
-		}
-	}
-
-	pass.shaderCount = (uint)effectShaders.GetLength() - pass.shaderStart;
-}
-
-void ShaderLibBuilder::GetShaderDefs(string_view libPath, DynamicArray<ShaderVariantDef>& variants, uint vID)
-{
-	for (int i = 0; i < entrypoints.GetLength(); i++)
-	{
-		hlslBuf.clear();
-
-		const ShaderEntrypoint& ep = entrypoints[i];
-		pShaderGen->GetShaderSource(*pTable, pAnalyzer->GetBlocks(), ep, entrypoints, hlslBuf);
-
-		const uint shaderID = GetShaderDefD3D11(libPath, hlslBuf, platform.featureLevel, ep.stage, 
-			ep.name, *pShaderRegistry, isDebugging);
-		const uint nameID = pShaderRegistry->GetShader(shaderID).nameID;
-
-		variants[i].shaderID = shaderID;
-		variants[i].variantID = vID;
-		// Update name -> shader ID key
-		epNameShaderIDMap[nameID] = shaderID;
-	}
-}
-
-void ShaderLibBuilder::GetEffectDefs(DynamicArray<EffectVariantDef>& effects, uint vID)
-{
-	// Effects
-	for (uint i = 0; i < (uint)effectBlocks.GetLength(); i++)
-	{
-		const EffectBlock& block = effectBlocks[i];
-		EffectDef effect;
-		effect.nameID = block.nameID;
-		Vector<uint> passBuf = pShaderRegistry->GetTmpIDBuffer();
-
-		// Passes
-		for (uint j = 0; j < block.passCount; j++)
-		{
-			PassBlock& pass = effectPasses[block.passStart + j];
-			Vector<uint> idBuf = pShaderRegistry->GetTmpIDBuffer();
-
-			// Shaders
-			for (uint k = 0; k < pass.shaderCount; k++)
-			{
-				const uint shaderIndex = pass.shaderStart + k;
-				idBuf.EmplaceBack(effectShaders[shaderIndex]);
-			}
-
-			passBuf.EmplaceBack(pShaderRegistry->GetOrAddIDGroup(idBuf));
-			pShaderRegistry->ReturnTmpIDBuffer(std::move(idBuf));
-		}
-
-		effect.passGroupID = pShaderRegistry->GetOrAddIDGroup(passBuf);
-		pShaderRegistry->ReturnTmpIDBuffer(std::move(passBuf));
-
-		effects[i] = EffectVariantDef 
-		{
-			.effectID = pShaderRegistry->GetOrAddEffect(effect),
-			.variantID = vID
-		};
-	}
-}
+}
\ No newline at end of file
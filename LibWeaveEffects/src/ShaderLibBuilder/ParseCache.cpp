@@ -0,0 +1,322 @@
+#include "pch.hpp"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <random>
+#include <chrono>
+#include "WeaveUtils/Compression.hpp"
+#include "WeaveUtils/Metrics.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ParseSnapshot.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ParseCache.hpp"
+#include "WeaveEffects/Version.hpp"
+
+namespace fs = std::filesystem;
+using namespace Weave;
+using namespace Weave::Effects;
+
+// Snapshots are written once per unique variant and read on every rebuild, favoring fast compression
+static constexpr byte s_CompressionLevel = 1;
+
+// std::format formatting string for snapshot files, named by source hash
+static constexpr string_view s_SnapshotFileFormat = "{:016x}{:016x}.psnap";
+
+static constexpr string_view s_SnapshotExt = ".psnap";
+
+static constexpr string_view s_TempExt = ".tmp";
+
+// Snapshots are evicted, least recently used first, when the directory exceeds this size
+static constexpr ulong s_MaxCacheBytes = 1ull << 30;
+
+// Temporary files older than this were left by writers that failed or were terminated
+static constexpr std::chrono::hours s_MaxTempAge(1);
+
+namespace Weave::Effects
+{
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotText& text)
+	{
+		ar(text.offset, text.length, text.isPooled);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotFile& file)
+	{
+		ar(file.path, file.startLine);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotBlock& block)
+	{
+		ar(block.type, block.offset, block.length, block.file, block.depth, block.startLine, block.lineCount);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotToken& token)
+	{
+		ar(
+			token.value, token.type, token.depth, token.blockStart, token.blockCount,
+			token.childStart, token.childCount, token.subtypeID, token.symbolID
+		);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotTypeRef& type)
+	{
+		ar(type.flags, type.userTypeID);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotUserType& type)
+	{
+		ar(type.name, type.flags, type.size);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SnapshotMapEntry& entry)
+	{
+		ar(entry.key, entry.value);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, ScopeData& scope)
+	{
+		ar(scope.symbolID, scope.parentScope, scope.blockStart, scope.blockCount);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, SymbolData& symbol)
+	{
+		ar(symbol.identID, symbol.scopeID, symbol.type);
+	}
+
+	template <class Archive>
+	inline void serialize(Archive& ar, AttributeData& attrib)
+	{
+		ar(attrib.semanticIndex);
+	}
+
+	template <class Archive, typename SnapshotT>
+	inline void SerializeSnapshotFields(Archive& ar, SnapshotT& snapshot)
+	{
+		ar(
+			snapshot.version, snapshot.files, snapshot.blocks,
+			snapshot.scopes, snapshot.scopeSymbolCounts, snapshot.scopeSymbols,
+			snapshot.identNames, snapshot.scopeSymbolEntries, snapshot.scopeOverloadEntries,
+			snapshot.overloadCounts, snapshot.overloads,
+			snapshot.tokens, snapshot.symbols, snapshot.types, snapshot.userTypes,
+			snapshot.functions, snapshot.attributes,
+			snapshot.topScope, snapshot.pendingScopeSymbol, snapshot.textPool
+		);
+	}
+
+	template <class Archive>
+	inline void save(Archive& ar, const ParseSnapshot& snapshot)
+	{
+		ar(snapshot.formatVersion);
+		SerializeSnapshotFields(ar, snapshot);
+	}
+
+	template <class Archive>
+	inline void load(Archive& ar, ParseSnapshot& snapshot)
+	{
+		ar(snapshot.formatVersion);
+
+		// Fields of other formats can't be read reliably
+		if (snapshot.formatVersion == g_ParseSnapshotVersion)
+			SerializeSnapshotFields(ar, snapshot);
+	}
+}
+
+static fs::path GetSnapshotPath(string_view dir, const Hash128& srcHash)
+{
+	return fs::path(dir) / std::format(s_SnapshotFileFormat, srcHash.high, srcHash.low);
+}
+
+ParseCache::ParseCache() = default;
+
+ParseCache::~ParseCache() = default;
+
+void ParseCache::SetDirectory(string_view path)
+{
+	dir = path;
+
+	if (!dir.empty())
+		Trim();
+}
+
+string_view ParseCache::GetDirectory() const { return dir; }
+
+bool ParseCache::GetIsEnabled() const { return !dir.empty(); }
+
+bool ParseCache::TryGetSnapshot(const Hash128& srcHash, ParseSnapshot& dst) const
+{
+	if (dir.empty())
+		return false;
+
+	const fs::path path = GetSnapshotPath(dir, srcHash);
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+	{
+		WV_METRIC_ADD("fx.parse.snapshotMisses", 1);
+		return false;
+	}
+
+	try
+	{
+		static thread_local std::stringstream streamBuf;
+		static thread_local ZLibArchive archive;
+		static thread_local Vector<byte> zipBuffer;
+
+		streamBuf.str({});
+		streamBuf.clear();
+		streamBuf << file.rdbuf();
+
+		dst.Clear();
+		DeserializeCompressedStream(streamBuf.view(), archive, zipBuffer, dst);
+	}
+	catch (const std::exception& err)
+	{
+		// A stale or corrupt snapshot only costs reparsing
+		WV_LOG_WARN() << "Failed to read parse snapshot " << path.string() << ": " << err.what();
+		WV_METRIC_ADD("fx.parse.snapshotMisses", 1);
+		return false;
+	}
+
+	if (dst.formatVersion != g_ParseSnapshotVersion || dst.version != VERSION_STRING)
+	{
+		WV_METRIC_ADD("fx.parse.snapshotMisses", 1);
+		return false;
+	}
+
+	// Read times are tracked as write times, for eviction
+	std::error_code ec;
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+	WV_METRIC_ADD("fx.parse.snapshotHits", 1);
+	return true;
+}
+
+void ParseCache::AddSnapshot(const Hash128& srcHash, const ParseSnapshot& snapshot) const
+{
+	if (dir.empty())
+		return;
+
+	static thread_local std::stringstream streamBuf;
+	static thread_local ZLibArchive zipBuffer;
+	static thread_local std::mt19937_64 tmpRng(std::random_device{}());
+	const fs::path path = GetSnapshotPath(dir, srcHash);
+
+	// Written to a temporary file first, so concurrent readers never see a partial snapshot. The
+	// name is random, as other processes may share the directory.
+	fs::path tmpPath = path;
+	tmpPath += std::format(".{:016x}{}", tmpRng(), s_TempExt);
+
+	try
+	{
+		streamBuf.str({});
+		streamBuf.clear();
+
+		{
+			Serializer writer(streamBuf);
+			writer(snapshot);
+		}
+
+		zipBuffer.compressionLevel = s_CompressionLevel;
+		CompressBytes(streamBuf.view(), zipBuffer);
+		streamBuf.str({});
+		streamBuf.clear();
+
+		{
+			Serializer zipWriter(streamBuf);
+			zipWriter(zipBuffer);
+		}
+
+		fs::create_directories(path.parent_path());
+
+		{
+			const string_view data = streamBuf.view();
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			file.write(data.data(), data.size());
+			FX_CHECK_MSG(file.good(), "Failed to write {}", tmpPath.string());
+		}
+
+		fs::rename(tmpPath, path);
+		WV_METRIC_ADD("fx.parse.snapshotsWritten", 1);
+	}
+	catch (const std::exception& err)
+	{
+		WV_LOG_WARN() << "Failed to write parse snapshot " << path.string() << ": " << err.what();
+		std::error_code ec;
+		fs::remove(tmpPath, ec);
+	}
+}
+
+void ParseCache::Trim() const
+{
+	struct SnapshotFileInfo
+	{
+		fs::path path;
+		fs::file_time_type lastUsed;
+		ulong size;
+	};
+
+	std::error_code ec;
+	Vector<SnapshotFileInfo> snapshots;
+	const fs::file_time_type now = fs::file_time_type::clock::now();
+	ulong totalBytes = 0;
+
+	for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec))
+	{
+		if (!entry.is_regular_file(ec))
+			continue;
+
+		const fs::path ext = entry.path().extension();
+		const fs::file_time_type lastUsed = entry.last_write_time(ec);
+
+		if (ec)
+			continue;
+
+		if (ext == s_TempExt)
+		{
+			if (now - lastUsed > s_MaxTempAge)
+				fs::remove(entry.path(), ec);
+		}
+		else if (ext == s_SnapshotExt)
+		{
+			const ulong size = (ulong)entry.file_size(ec);
+
+			if (!ec)
+			{
+				snapshots.EmplaceBack(entry.path(), lastUsed, size);
+				totalBytes += size;
+			}
+		}
+	}
+
+	if (totalBytes <= s_MaxCacheBytes)
+		return;
+
+	std::sort(snapshots.begin(), snapshots.end(), [](const SnapshotFileInfo& a, const SnapshotFileInfo& b)
+	{
+		return a.lastUsed < b.lastUsed;
+	});
+
+	uint evicted = 0;
+
+	for (const SnapshotFileInfo& snapshot : snapshots)
+	{
+		if (totalBytes <= s_MaxCacheBytes)
+			break;
+
+		// Snapshots are replaced atomically, and readers fall back to reparsing if one is removed
+		if (fs::remove(snapshot.path, ec))
+		{
+			totalBytes -= snapshot.size;
+			evicted++;
+		}
+	}
+
+	WV_LOG_DEBUG() << "Evicted " << evicted << " parse snapshots from " << dir;
+	WV_METRIC_ADD("fx.parse.snapshotsEvicted", evicted);
+}
@@ -0,0 +1,143 @@
+#include "pch.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompileCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryMap.hpp"
+#include "WeaveEffects/ShaderDataHandles.hpp"
+
+using namespace Weave;
+using namespace Weave::Effects;
+
+ShaderCompileCache::ShaderCompileCache() :
+	pRegistry(new ShaderRegistryBuilder()),
+	pExportRegistry(new ShaderRegistryBuilder()),
+	isMapStale(true),
+	isChanged(false)
+{
+	UpdateMap();
+}
+
+ShaderCompileCache::~ShaderCompileCache() = default;
+
+Hash128 ShaderCompileCache::GetKey(
+	string_view srcFile,
+	string_view srcText,
+	string_view featureLevel,
+	ShadeStages stage,
+	string_view mainName,
+	bool isDebugging
+)
+{
+	// Options are hashed separately and used to seed the source hash
+	thread_local string optBuf;
+	optBuf.clear();
+	optBuf.append(featureLevel);
+	optBuf.push_back('\0');
+	optBuf.append(mainName);
+	optBuf.push_back('\0');
+	optBuf.push_back((char)stage);
+	optBuf.push_back(isDebugging ? 1 : 0);
+
+	if (isDebugging)
+		optBuf.append(srcFile);
+
+	const Hash128 optHash = GetHash128(optBuf);
+	return GetHash128(srcText, optHash.low ^ optHash.high);
+}
+
+uint ShaderCompileCache::TryGetShader(const Hash128& key) const
+{
+	FX_ASSERT_MSG(!isMapStale, "Compile cache map must be updated before use");
+	const auto it = keyShaderMap.find(key);
+	return (it != keyShaderMap.end()) ? it->second : -1;
+}
+
+const ShaderRegistryMap& ShaderCompileCache::GetMap() const { return *pMap; }
+
+uint ShaderCompileCache::GetShaderCount() const { return (uint)keyShaderMap.size(); }
+
+bool ShaderCompileCache::GetIsChanged() const { return isChanged; }
+
+void ShaderCompileCache::AddShader(const Hash128& key, const ShaderDefHandle& shader)
+{
+	if (!keyShaderMap.contains(key))
+	{
+		keyShaderMap.emplace(key, pRegistry->GetOrAddShader(shader));
+		isMapStale = true;
+		isChanged = true;
+	}
+}
+
+void ShaderCompileCache::UpdateMap()
+{
+	if (isMapStale)
+	{
+		pRegistry->ClearCopyCache();
+		pMap.reset(new ShaderRegistryMap(pRegistry->GetDefinition(), pRegistry->GetStringIDBuilder().GetDefinition()));
+		isMapStale = false;
+	}
+}
+
+void ShaderCompileCache::SetDefinition(const ShaderCompileCacheDef::Handle& cacheDef)
+{
+	Clear();
+
+	const ShaderRegistryMap srcMap(cacheDef.regHandle, cacheDef.strMapHandle);
+	const IDynamicArray<Hash128>& keys = *cacheDef.pKeys;
+	const IDynamicArray<uint>& shaderIDs = *cacheDef.pShaderIDs;
+	FX_CHECK_MSG(keys.GetLength() == shaderIDs.GetLength(), "Malformed shader compile cache");
+
+	for (uint i = 0; i < (uint)keys.GetLength(); i++)
+		keyShaderMap.emplace(keys[i], pRegistry->GetOrAddShader(ShaderDefHandle(srcMap, shaderIDs[i])));
+
+	isMapStale = true;
+	UpdateMap();
+}
+
+ShaderCompileCacheDef::Handle ShaderCompileCache::GetDefinition(const PlatformDef& platform) const
+{
+	lastPlatform = platform;
+	keyBuf.Clear();
+	shaderIDBuf.Clear();
+	keyBuf.Reserve(keyShaderMap.size());
+	shaderIDBuf.Reserve(keyShaderMap.size());
+
+	for (const auto& [key, shaderID] : keyShaderMap)
+		keyBuf.Add(key);
+
+	// Map iteration and compile order vary between runs, so entries are exported in key order
+	// into a separate registry, making equal caches serialize to identical bytes
+	std::sort(keyBuf.begin(), keyBuf.end(), [](const Hash128& a, const Hash128& b)
+	{
+		return (a.high != b.high) ? (a.high < b.high) : (a.low < b.low);
+	});
+
+	const ShaderRegistryMap srcMap(pRegistry->GetDefinition(), pRegistry->GetStringIDBuilder().GetDefinition());
+	pExportRegistry->Clear();
+	pExportRegistry->ClearCopyCache();
+
+	for (const Hash128& key : keyBuf)
+		shaderIDBuf.Add(pExportRegistry->GetOrAddShader(ShaderDefHandle(srcMap, keyShaderMap.at(key))));
+
+	pExportRegistry->ClearCopyCache();
+
+	return
+	{
+		.pPlatform = &lastPlatform,
+		.pKeys = &keyBuf,
+		.pShaderIDs = &shaderIDBuf,
+		.regHandle = pExportRegistry->GetDefinition(),
+		.strMapHandle = pExportRegistry->GetStringIDBuilder().GetDefinition()
+	};
+}
+
+void ShaderCompileCache::Clear()
+{
+	pRegistry->Clear();
+	pExportRegistry->Clear();
+	keyShaderMap.clear();
+	keyBuf.Clear();
+	shaderIDBuf.Clear();
+	isChanged = false;
+	isMapStale = true;
+	UpdateMap();
+}
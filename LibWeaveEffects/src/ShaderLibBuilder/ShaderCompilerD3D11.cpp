@@ -432,4 +432,12 @@ uint Weave::Effects::GetShaderDefD3D11(
 	return builder.GetOrAddShader(def);
 }
 
-string_view Weave::Effects::GetCompilerVersionD3D11() { return D3DCOMPILER_DLL_A; }
\ No newline at end of file
+string_view Weave::Effects::GetCompilerVersionD3D11() { return D3DCOMPILER_DLL_A; }
+
+string_view ShaderCompilerD3D11::GetVersion() const { return GetCompilerVersionD3D11(); }
+
+uint ShaderCompilerD3D11::GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const
+{
+	return GetShaderDefD3D11(args.srcFile, args.srcText, args.featureLevel, args.stage, args.mainName, 
+		builder, args.isDebugging);
+}
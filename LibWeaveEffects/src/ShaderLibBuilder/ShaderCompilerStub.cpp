@@ -0,0 +1,397 @@
+#include "pch.hpp"
+#include <charconv>
+#include "WeaveUtils/ContentHash.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/SymbolTable.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
+
+using namespace Weave;
+using namespace Weave::Effects;
+
+// Header prefixed to placeholder bytecode
+static constexpr string_view s_StubMagic = "WVSB";
+
+// Component type enums used in IO signatures. Matches D3D_REGISTER_COMPONENT_TYPE.
+static constexpr uint s_ComponentUInt = 1;
+static constexpr uint s_ComponentSInt = 2;
+static constexpr uint s_ComponentFloat = 3;
+
+// Constant buffer register size in bytes
+static constexpr uint s_CBufRegisterSize = 16;
+
+static uint GetComponentCount(const ShaderTypeInfo& type)
+{
+	if (type.GetHasFlags(ShaderTypes::Dim4))
+		return 4;
+	else if (type.GetHasFlags(ShaderTypes::Dim3))
+		return 3;
+	else if (type.GetHasFlags(ShaderTypes::Dim2))
+		return 2;
+	else
+		return 1;
+}
+
+static uint GetComponentType(const ShaderTypeInfo& type)
+{
+	if (type.GetHasFlags(ShaderTypes::Float) || type.GetHasFlags(ShaderTypes::Half) || type.GetHasFlags(ShaderTypes::Double))
+		return s_ComponentFloat;
+	else if (type.GetHasFlags(ShaderTypes::Integer))
+		return s_ComponentSInt;
+	else
+		return s_ComponentUInt;
+}
+
+/// <summary>
+/// Returns the variable's type, or nullptr if it has none
+/// </summary>
+static const ShaderTypeInfo* TryGetVarType(const SymbolHandle& symbol, ShaderTypeInfo& type)
+{
+	const optional<VarHandle> var = symbol.GetAsVar();
+
+	if (var == std::nullopt)
+		return nullptr;
+
+	TokenTypes modifiers;
+	var->GetType(type, modifiers);
+	return &type;
+}
+
+/// <summary>
+/// Searches the given scope and its parents for a symbol with the given name
+/// </summary>
+static optional<SymbolHandle> TryFindSymbol(optional<ScopeHandle> scope, string_view name)
+{
+	while (scope != std::nullopt)
+	{
+		if (optional<SymbolHandle> symbol = scope->TryGetChild(name); symbol != std::nullopt)
+			return symbol;
+
+		scope = scope->GetParentScope();
+	}
+
+	return std::nullopt;
+}
+
+/// <summary>
+/// Returns the first semantic attached to the given identifier, if any
+/// </summary>
+static bool TryGetSemantic(const TokenNodeHandle& ident, string_view& name, uint& index)
+{
+	for (int i = 0; i < ident.GetChildCount(); i++)
+	{
+		const TokenNodeHandle child = ident[i];
+
+		if (child.GetHasFlags(TokenTypes::SemanticIdent))
+		{
+			name = child.GetValue();
+			index = (uint)child.GetAsAttribute()->GetSemanticIndex();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// <summary>
+/// Adds IO elements for a parameter or return value. Struct members with semantics are expanded
+/// one level deep.
+/// </summary>
+static void AddIOElements(const ShaderTypeInfo& type, const TokenNodeHandle& ident, const ScopeHandle& scope,
+	Vector<uint>& idBuf, ShaderRegistryBuilder& builder)
+{
+	string_view semantic;
+	uint semanticIndex = 0;
+
+	if (TryGetSemantic(ident, semantic, semanticIndex))
+	{
+		IOElementDef element;
+		element.semanticID = builder.GetOrAddStringID(semantic);
+		element.semanticIndex = semanticIndex;
+		element.dataType = GetComponentType(type);
+		element.componentCount = GetComponentCount(type);
+		element.size = element.componentCount * 4; // Assume 4-byte/32-bit components
+
+		idBuf.EmplaceBack(builder.GetOrAddIOElement(element));
+	}
+	else if (type.GetHasFlags(ShaderTypes::UserType))
+	{
+		const optional<SymbolHandle> structSymbol = TryFindSymbol(scope, type.name);
+
+		if (structSymbol == std::nullopt || !structSymbol->GetIsScope())
+			return;
+
+		const ScopeHandle members = *structSymbol->GetScope();
+		ShaderTypeInfo memberType;
+
+		for (int i = 0; i < members.GetChildCount(); i++)
+		{
+			const SymbolHandle member = members[i];
+
+			if (TryGetVarType(member, memberType) != nullptr && TryGetSemantic(member.GetIdent(), semantic, semanticIndex))
+				AddIOElements(memberType, member.GetIdent(), scope, idBuf, builder);
+		}
+	}
+}
+
+/// <summary>
+/// Approximates input and output signatures from the entrypoint's parameters and return value
+/// </summary>
+static void GetIOLayout(const FuncHandle& main, ShaderDef& def, ShaderRegistryBuilder& builder)
+{
+	const ScopeHandle body = *main.GetScope();
+	Vector<uint> idBuf = builder.GetTmpIDBuffer();
+	ShaderTypeInfo type;
+
+	// Input params
+	for (int i = 0; i < body.GetChildCount(); i++)
+	{
+		const SymbolHandle param = body[i];
+
+		if (param.GetHasFlags(SymbolTypes::Parameter) && TryGetVarType(param, type) != nullptr)
+			AddIOElements(type, param.GetIdent(), body, idBuf, builder);
+	}
+
+	def.inLayoutID = !idBuf.IsEmpty() ? builder.GetOrAddIDGroup(idBuf) : -1;
+	idBuf.Clear();
+
+	// Return value
+	TokenTypes modifiers;
+	main.GetReturnType(type, modifiers);
+	AddIOElements(type, main.GetIdent(), body, idBuf, builder);
+
+	def.outLayoutID = !idBuf.IsEmpty() ? builder.GetOrAddIDGroup(idBuf) : -1;
+	builder.ReturnTmpIDBuffer(std::move(idBuf));
+}
+
+/// <summary>
+/// Appends a constant to a buffer layout using HLSL packing rules
+/// </summary>
+static void AddConstant(string_view name, uint size, uint& offset, Vector<uint>& idBuf, ShaderRegistryBuilder& builder)
+{
+	const uint regOffset = offset % s_CBufRegisterSize;
+
+	// Constants cannot straddle registers, and large types start on a new register
+	if (regOffset != 0 && (size >= s_CBufRegisterSize || (regOffset + size) > s_CBufRegisterSize))
+		offset += s_CBufRegisterSize - regOffset;
+
+	idBuf.EmplaceBack(builder.GetOrAddConstant(ConstDef(builder.GetOrAddStringID(name), offset, size)));
+	offset += size;
+}
+
+/// <summary>
+/// Adds a constant buffer definition for the given layout
+/// </summary>
+static uint GetConstantBuffer(string_view name, uint size, const IDynamicArray<uint>& layout, ShaderRegistryBuilder& builder)
+{
+	ConstBufDef cbuf;
+	cbuf.stringID = builder.GetOrAddStringID(name);
+	cbuf.size = (size + s_CBufRegisterSize - 1) / s_CBufRegisterSize * s_CBufRegisterSize;
+	cbuf.layoutID = builder.GetOrAddIDGroup(layout);
+
+	return builder.GetOrAddConstantBuffer(cbuf);
+}
+
+/// <summary>
+/// Approximates constant buffer and resource bindings from symbols visible to the entrypoint, in
+/// declaration order. Unlike a real compiler, unused resources are not stripped.
+/// </summary>
+static void GetResources(const SymbolTable& table, const FuncHandle& main, ShaderDef& def, ShaderRegistryBuilder& builder)
+{
+	Vector<int> symbolIDs;
+	optional<ScopeHandle> scope = main.GetScope()->GetParentScope();
+
+	while (scope != std::nullopt)
+	{
+		for (int i = 0; i < scope->GetChildCount(); i++)
+			symbolIDs.EmplaceBack(scope->GetChild(i).GetID());
+
+		scope = scope->GetParentScope();
+	}
+
+	std::sort(symbolIDs.begin(), symbolIDs.end());
+
+	Vector<uint> cbufIDs = builder.GetTmpIDBuffer();
+	Vector<uint> resIDs = builder.GetTmpIDBuffer();
+	Vector<uint> globalIDs = builder.GetTmpIDBuffer();
+	Vector<uint> constIDs = builder.GetTmpIDBuffer();
+	uint globalSize = 0;
+	uint texSlot = 0, rwSlot = 0, samplerSlot = 0;
+	ShaderTypeInfo type;
+
+	for (const int symbolID : symbolIDs)
+	{
+		const SymbolHandle symbol = table.GetSymbol(symbolID);
+
+		if (symbol.GetHasFlags(SymbolTypes::ConstBufDef))
+		{
+			const ScopeHandle members = *symbol.GetScope();
+			uint size = 0;
+			constIDs.Clear();
+
+			for (int i = 0; i < members.GetChildCount(); i++)
+			{
+				const SymbolHandle member = members[i];
+
+				if (member.GetHasFlags(SymbolTypes::Variable) && TryGetVarType(member, type) != nullptr)
+					AddConstant(member.GetName(), std::max((uint)type.size, 4u), size, constIDs, builder);
+			}
+
+			cbufIDs.EmplaceBack(GetConstantBuffer(symbol.GetName(), size, constIDs, builder));
+		}
+		else if (symbol.GetHasFlags(SymbolTypes::Variable) && !symbol.GetHasFlags(SymbolTypes::Definition) &&
+			!symbol.GetHasFlags(SymbolTypes::Ambiguous))
+		{
+			TokenTypes modifiers;
+			symbol.GetAsVar()->GetType(type, modifiers);
+
+			if (type.GetHasFlags(ShaderTypes::Resource))
+			{
+				ResourceDef res;
+				res.stringID = builder.GetOrAddStringID(symbol.GetName());
+				res.type = type.flags;
+
+				if (type.GetHasFlags(ShaderTypes::Sampler))
+					res.slot = samplerSlot++;
+				else if (type.GetHasFlags(ShaderTypes::RandomRW))
+					res.slot = rwSlot++;
+				else
+				{
+					res.type |= ShaderTypes::ReadOnly;
+					res.slot = texSlot++;
+				}
+
+				resIDs.EmplaceBack(builder.GetOrAddResource(res));
+			}
+			else if ((int)(modifiers & TokenTypes::TypeModifier) == 0) // Loose globals, see ShaderGenerator
+				AddConstant(symbol.GetName(), std::max((uint)type.size, 4u), globalSize, globalIDs, builder);
+		}
+	}
+
+	if (!globalIDs.IsEmpty())
+		cbufIDs.EmplaceBack(GetConstantBuffer("_EffectGlobals", globalSize, globalIDs, builder));
+
+	def.cbufGroupID = !cbufIDs.IsEmpty() ? builder.GetOrAddIDGroup(cbufIDs) : -1;
+	def.resLayoutID = !resIDs.IsEmpty() ? builder.GetOrAddIDGroup(resIDs) : -1;
+
+	builder.ReturnTmpIDBuffer(std::move(cbufIDs));
+	builder.ReturnTmpIDBuffer(std::move(resIDs));
+	builder.ReturnTmpIDBuffer(std::move(globalIDs));
+	builder.ReturnTmpIDBuffer(std::move(constIDs));
+}
+
+/// <summary>
+/// Reads thread group dimensions from the entrypoint's numthreads attribute
+/// </summary>
+static void GetThreadGroupSize(const FuncHandle& main, ShaderDef& def)
+{
+	const TokenNodeHandle ident = main.GetIdent();
+	uint* pDims[] = { &def.threadGroupSize.x, &def.threadGroupSize.y, &def.threadGroupSize.z };
+
+	for (uint* pDim : pDims)
+		*pDim = 1;
+
+	for (int i = 0; i < ident.GetChildCount(); i++)
+	{
+		const TokenNodeHandle attrib = ident[i];
+
+		if (attrib.GetHasFlags(TokenTypes::Attribute) && attrib.GetValue() == "numthreads")
+		{
+			for (int j = 0, dim = 0; j < attrib.GetChildCount() && dim < 3; j++)
+			{
+				const string_view arg = attrib[j].GetValue();
+
+				if (attrib[j].GetHasFlags(TokenTypes::Literal))
+					std::from_chars(arg.data(), arg.data() + arg.size(), *pDims[dim++]);
+			}
+
+			break;
+		}
+	}
+}
+
+/// <summary>
+/// Appends raw bytes to the end of the buffer
+/// </summary>
+static void AppendBytes(const void* pSrc, size_t size, Vector<byte>& dst)
+{
+	const size_t start = dst.GetLength();
+	dst.Resize(start + size);
+	memcpy(&dst[start], pSrc, size);
+}
+
+/// <summary>
+/// Writes placeholder bytecode unique to the given source and options
+/// </summary>
+static uint GetStubByteCode(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder)
+{
+	const Hash128 optHash = GetHash128(args.featureLevel, GetHash128(args.mainName, (ulong)args.stage).low);
+	const Hash128 srcHash = GetHash128(args.srcText, optHash.low ^ (args.isDebugging ? 1u : 0u));
+	Vector<byte> byteBuf = builder.GetTmpByteBuffer();
+
+	AppendBytes(s_StubMagic.data(), s_StubMagic.size(), byteBuf);
+	AppendBytes(&srcHash, sizeof(Hash128), byteBuf);
+	// Approximate the size of real bytecode
+	AppendBytes(args.srcText.data(), args.srcText.size(), byteBuf);
+
+	const uint byteCodeID = builder.GetOrAddShaderBin(byteBuf);
+	builder.ReturnTmpByteBuffer(std::move(byteBuf));
+
+	return byteCodeID;
+}
+
+/// <summary>
+/// Parses generated source when the caller has no symbol table, such as in a worker process, and
+/// returns the ID of the entrypoint definition
+/// </summary>
+static const SymbolTable& GetParsedSource(const ShaderCompileArgs& args, int& mainSymbolID)
+{
+	thread_local BlockAnalyzer analyzer;
+	thread_local SymbolTable table;
+	string_view src = args.srcText;
+
+	table.Clear();
+	analyzer.Clear();
+	analyzer.AnalyzeSource(args.srcFile, src);
+	table.ParseBlocks(analyzer);
+	mainSymbolID = -1;
+
+	for (int i = 0; i < table.GetSymbolCount(); i++)
+	{
+		const SymbolHandle symbol = table.GetSymbol(i);
+
+		if (symbol.GetHasFlags(SymbolTypes::FuncDefinition) && symbol.GetName() == args.mainName)
+		{
+			mainSymbolID = i;
+			break;
+		}
+	}
+
+	FX_CHECK_MSG(mainSymbolID != -1, "Shader entrypoint '{}' not found", args.mainName);
+	return table;
+}
+
+string_view ShaderCompilerStub::GetVersion() const { return "Weave Stub Compiler 1"; }
+
+bool ShaderCompilerStub::GetIsUsingSymbols() const { return true; }
+
+uint ShaderCompilerStub::GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const
+{
+	int mainSymbolID = args.mainSymbolID;
+	const SymbolTable& table = (args.pTable != nullptr) ? *args.pTable : GetParsedSource(args, mainSymbolID);
+	const optional<FuncHandle> main = table.GetSymbol(mainSymbolID).GetAsFunc();
+	FX_CHECK_MSG(main != std::nullopt && main->GetIsScope(), "Shader entrypoint '{}' is not a function definition", args.mainName);
+
+	ShaderDef def;
+	def.fileStringID = builder.GetOrAddStringID(args.srcFile);
+	def.nameID = builder.GetOrAddStringID(args.mainName);
+	def.stage = args.stage;
+	def.byteCodeID = GetStubByteCode(args, builder);
+
+	GetIOLayout(*main, def, builder);
+	GetResources(table, *main, def, builder);
+
+	if (def.stage == ShadeStages::Compute)
+		GetThreadGroupSize(*main, def);
+
+	return builder.GetOrAddShader(def);
+}
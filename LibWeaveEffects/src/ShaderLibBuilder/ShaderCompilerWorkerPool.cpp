@@ -0,0 +1,304 @@
+#include "pch.hpp"
+#include "WeaveUtils/ChildProcess.hpp"
+#include "WeaveUtils/SpanStream.hpp"
+#include "WeaveUtils/Metrics.hpp"
+#include "WeaveEffects/ShaderDataSerialization.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompilerWorkerPool.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryMap.hpp"
+#include "WeaveEffects/ShaderDataHandles.hpp"
+
+using namespace Weave;
+using namespace Weave::Effects;
+
+// Upper bound on message size, used to detect corrupted streams
+static constexpr uint s_MaxFrameSize = 1u << 30u;
+
+// Number of workers a shader is sent to before a worker failure is reported as an error
+static constexpr uint s_MaxAttempts = 2;
+
+// Time a worker is given to start, or to compile a single shader, before it is assumed to be hung
+static constexpr std::chrono::seconds s_WorkerTimeout(120);
+
+// Appended to the version reported by workers with backends that use symbol tables. Workers
+// reflect shaders without them, so their output is cached separately from the in-process backend.
+static constexpr string_view s_VersionSuffix = " (Worker Process)";
+
+/// <summary>
+/// Compile arguments sent to worker processes
+/// </summary>
+struct WorkerRequest
+{
+	string srcFile;
+	string srcText;
+	string featureLevel;
+	ShadeStages stage;
+	string mainName;
+	bool isDebugging;
+
+	template<class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(srcFile, srcText, featureLevel, stage, mainName, isDebugging);
+	}
+};
+
+/*
+	Messages are framed as a 32-bit length followed by a serialized payload. Workers send their
+	backend version on startup, then one response per request.
+*/
+
+template<typename WriteFunc>
+static bool TryWriteFrame(string_view data, const WriteFunc& Write)
+{
+	const uint size = (uint)data.size();
+	return Write(&size, sizeof(uint)) && Write(data.data(), data.size());
+}
+
+template<typename ReadFunc>
+static bool TryReadFrame(string& data, const ReadFunc& Read)
+{
+	uint size = 0;
+
+	if (!Read(&size, sizeof(uint)) || size > s_MaxFrameSize)
+		return false;
+
+	data.resize(size);
+	return Read(data.data(), size);
+}
+
+ShaderCompilerWorkerPool::ShaderCompilerWorkerPool(string_view exePath, const IDynamicArray<string_view>& workerArgs, uint maxWorkers) :
+	exePath(exePath),
+	maxWorkers(std::max(maxWorkers, 1u)),
+	workerCount(0)
+{
+	for (const string_view arg : workerArgs)
+		this->workerArgs.EmplaceBack(arg);
+
+	idleWorkers.EmplaceBack(StartWorker(backendVersion));
+	workerCount = 1;
+}
+
+ShaderCompilerWorkerPool::~ShaderCompilerWorkerPool() = default;
+
+string_view ShaderCompilerWorkerPool::GetVersion() const { return backendVersion; }
+
+unique_ptr<ChildProcess> ShaderCompilerWorkerPool::StartWorker(string& workerVersion) const
+{
+	Vector<string_view> args;
+
+	for (const string& arg : workerArgs)
+		args.EmplaceBack(arg);
+
+	unique_ptr<ChildProcess> pWorker(new ChildProcess());
+	pWorker->Start(exePath, args);
+
+	const ChildProcess::Clock::time_point deadline = ChildProcess::Clock::now() + s_WorkerTimeout;
+	const bool isReady = TryReadFrame(workerVersion, [&](void* pDst, size_t size) { return pWorker->TryRead(pDst, size, deadline); });
+
+	if (!isReady)
+	{
+		pWorker->Kill();
+		FX_THROW("Failed to start shader compiler worker: {}", exePath);
+	}
+
+	WV_METRIC_ADD("fx.shaders.workersStarted", 1);
+	return pWorker;
+}
+
+unique_ptr<ChildProcess> ShaderCompilerWorkerPool::AcquireWorker() const
+{
+	std::unique_lock lock(poolMutex);
+	workerFreed.wait(lock, [this] { return !idleWorkers.IsEmpty() || workerCount < maxWorkers; });
+
+	if (!idleWorkers.IsEmpty())
+	{
+		unique_ptr<ChildProcess> pWorker = std::move(idleWorkers.GetBack());
+		idleWorkers.RemoveBack();
+		return pWorker;
+	}
+
+	// Reserve a slot and start the worker outside the lock
+	workerCount++;
+	lock.unlock();
+
+	try
+	{
+		string workerVersion;
+		unique_ptr<ChildProcess> pWorker = StartWorker(workerVersion);
+		FX_CHECK_MSG(workerVersion == backendVersion, "Shader compiler worker version mismatch. Expected: '{}' Found: '{}'",
+			backendVersion, workerVersion);
+
+		return pWorker;
+	}
+	catch (...)
+	{
+		ReleaseWorker(nullptr);
+		throw;
+	}
+}
+
+void ShaderCompilerWorkerPool::ReleaseWorker(unique_ptr<ChildProcess>&& pWorker) const
+{
+	{
+		std::lock_guard lock(poolMutex);
+
+		if (pWorker.get() != nullptr)
+			idleWorkers.EmplaceBack(std::move(pWorker));
+		else
+			workerCount--;
+	}
+
+	workerFreed.notify_one();
+}
+
+/// <summary>
+/// Copies the shader returned by a worker into the given registry
+/// </summary>
+static uint GetResponseShader(string_view response, ShaderRegistryBuilder& builder)
+{
+	bool isSuccess = false;
+	string error;
+	uint shaderID = -1;
+	ShaderRegistryDef regDef;
+	StringIDMapDef strDef;
+
+	{
+		ISpanStream stream(response);
+		Deserializer reader(stream);
+		reader(isSuccess, error, shaderID, regDef, strDef);
+	}
+
+	FX_CHECK_MSG(isSuccess, "{}", error);
+
+	const ShaderRegistryMap resultMap(std::move(regDef), std::move(strDef));
+	shaderID = builder.GetOrAddShader(ShaderDefHandle(resultMap, shaderID));
+	// The map is temporary, and its address may be reused by the next response
+	builder.ClearCopyCache();
+
+	return shaderID;
+}
+
+uint ShaderCompilerWorkerPool::GetShaderDef(const ShaderCompileArgs& args, ShaderRegistryBuilder& builder) const
+{
+	thread_local WorkerRequest request;
+	thread_local std::stringstream streamBuf;
+	thread_local string responseBuf;
+
+	request.srcFile = args.srcFile;
+	request.srcText = args.srcText;
+	request.featureLevel = args.featureLevel;
+	request.stage = args.stage;
+	request.mainName = args.mainName;
+	request.isDebugging = args.isDebugging;
+
+	streamBuf.str({});
+	streamBuf.clear();
+
+	{
+		Serializer writer(streamBuf);
+		writer(request);
+	}
+
+	for (uint attempt = 0; attempt < s_MaxAttempts; attempt++)
+	{
+		unique_ptr<ChildProcess> pWorker = AcquireWorker();
+		const ChildProcess::Clock::time_point deadline = ChildProcess::Clock::now() + s_WorkerTimeout;
+		const auto Write = [&](const void* pSrc, size_t size) { return pWorker->TryWrite(pSrc, size); };
+		const auto Read = [&](void* pDst, size_t size) { return pWorker->TryRead(pDst, size, deadline); };
+
+		if (TryWriteFrame(streamBuf.view(), Write) && TryReadFrame(responseBuf, Read))
+		{
+			ReleaseWorker(std::move(pWorker));
+			return GetResponseShader(responseBuf, builder);
+		}
+
+		// Replace the failed or hung worker
+		const bool isTimedOut = ChildProcess::Clock::now() >= deadline;
+		pWorker->Kill();
+		ReleaseWorker(nullptr);
+
+		if (isTimedOut)
+		{
+			WV_LOG_WARN() << "Shader compiler worker timed out after " << s_WorkerTimeout.count() << "s compiling " 
+				<< args.mainName << " in " << args.srcFile;
+			WV_METRIC_ADD("fx.shaders.workerTimeouts", 1);
+		}
+		else
+			WV_LOG_WARN() << "Shader compiler worker exited while compiling " << args.mainName << " in " << args.srcFile;
+
+		WV_METRIC_ADD("fx.shaders.workerFailures", 1);
+	}
+
+	FX_THROW("Shader compiler worker failed {} times compiling '{}' in {}", s_MaxAttempts, args.mainName, args.srcFile);
+}
+
+void ShaderCompilerWorkerPool::RunWorker(const IShaderCompiler& compiler)
+{
+	ChildProcess::InitParentPipes();
+
+	WorkerRequest request;
+	ShaderRegistryBuilder registry;
+	std::stringstream streamBuf;
+	string requestBuf;
+
+	string version(compiler.GetVersion());
+
+	if (compiler.GetIsUsingSymbols())
+		version.append(s_VersionSuffix);
+
+	if (!TryWriteFrame(version, ChildProcess::TryWriteParent))
+		return;
+
+	while (TryReadFrame(requestBuf, ChildProcess::TryReadParent))
+	{
+		{
+			ISpanStream stream{ string_view(requestBuf) };
+			Deserializer reader(stream);
+			reader(request);
+		}
+
+		const ShaderCompileArgs args
+		{
+			.srcFile = request.srcFile,
+			.srcText = request.srcText,
+			.featureLevel = request.featureLevel,
+			.stage = request.stage,
+			.mainName = request.mainName,
+			.isDebugging = request.isDebugging,
+			.pTable = nullptr,
+			.mainSymbolID = -1
+		};
+
+		bool isSuccess = false;
+		string error;
+		uint shaderID = -1;
+		registry.Clear();
+
+		// Compile errors are returned to the parent
+		try
+		{
+			shaderID = compiler.GetShaderDef(args, registry);
+			isSuccess = true;
+		}
+		catch (const WeaveException& err)
+		{
+			error = err.GetDescription();
+		}
+		catch (const std::exception& err)
+		{
+			error = err.what();
+		}
+
+		streamBuf.str({});
+		streamBuf.clear();
+
+		{
+			Serializer writer(streamBuf);
+			writer(isSuccess, error, shaderID, registry.GetDefinition(), registry.GetStringIDBuilder().GetDefinition());
+		}
+
+		if (!TryWriteFrame(streamBuf.view(), ChildProcess::TryWriteParent))
+			return;
+	}
+}
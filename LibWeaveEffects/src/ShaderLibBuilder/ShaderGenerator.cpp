@@ -26,7 +26,7 @@ int SourceMask::GetLastBlock() const { return startBlock + blockCount - 1; }
 ShaderGenerator::ShaderGenerator()
 { }
 
-void ShaderGenerator::GetShaderSource(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks, const ShaderEntrypoint& main,
+void ShaderGenerator::GetShaderSource(const SymbolTable& table, const LexBlockList& srcBlocks, const ShaderEntrypoint& main,
 	const IDynamicArray<ShaderEntrypoint>& shaders, std::string & srcOut)
 {
 	Clear();
@@ -73,7 +73,7 @@ static void GetCorrectedMask(SourceMask& a, SourceMask& b)
 	or truncates earlier masks in partial overlaps, ensuring a final, non-overlapping set
 	for generation before applying them to the source blocks.
 */
-void ShaderGenerator::GetMaskedSource(const IDynamicArray<LexBlock>& srcBlocks, std::string& srcOut)
+void ShaderGenerator::GetMaskedSource(const LexBlockList& srcBlocks, std::string& srcOut)
 {
 	// Sort masks in ascending order
 	std::sort(sourceMasks.begin(), sourceMasks.end(), [](const SourceMask& a, const SourceMask& b)
@@ -99,11 +99,11 @@ void ShaderGenerator::GetMaskedSource(const IDynamicArray<LexBlock>& srcBlocks,
 		// Append alternate text
 		if (mask.altText.GetLength() > 0)
 		{
-			const int lastLine = srcBlocks[mask.GetLastBlock()].GetLastLine();
-			const int startLine = srcBlocks[mask.startBlock].startLine;
+			const int lastLine = srcBlocks.GetLastLine(mask.GetLastBlock());
+			const int startLine = srcBlocks.GetStartLine(mask.startBlock);
 
 			if (line != startLine)
-				AppendLineDirective(srcBlocks[mask.startBlock].startLine, srcOut);
+				AppendLineDirective(startLine, srcOut);
 				
 			srcOut.append(mask.altText);
 			line = startLine + mask.altText.FindCount('\n');
@@ -146,7 +146,7 @@ void ShaderGenerator::GetGlobalVariables(const SymbolTable& table, const int mai
 	std::sort(globalVarBuf.begin(), globalVarBuf.end());
 }
 
-void ShaderGenerator::GetSourceMask(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks,
+void ShaderGenerator::GetSourceMask(const SymbolTable& table, const LexBlockList& srcBlocks,
 	const ShaderEntrypoint& main, const IDynamicArray<ShaderEntrypoint>& shaders)
 {
 	sourceMasks.Clear();
@@ -185,7 +185,7 @@ void ShaderGenerator::GetSourceMask(const SymbolTable& table, const IDynamicArra
 		GenerateGlobalCBuffer(table, srcBlocks);
 }
 
-void ShaderGenerator::GenerateGlobalCBuffer(const SymbolTable& table, const IDynamicArray<LexBlock>& srcBlocks)
+void ShaderGenerator::GenerateGlobalCBuffer(const SymbolTable& table, const LexBlockList& srcBlocks)
 {
 	globalVarDefBuf.clear();
 	globalVarDefBuf.append("cbuffer _EffectGlobals\n{\n");
@@ -211,12 +211,14 @@ void ShaderGenerator::GenerateGlobalCBuffer(const SymbolTable& table, const IDyn
 		{
 			// Containers' contents are included in child blocks, only their bounding 
 			// characters are needed
-			if (srcBlocks[blockID].GetHasFlags(LexBlockTypes::StartContainer))
-				globalVarDefBuf.push_back(srcBlocks[blockID].src.GetFront());
-			else if (srcBlocks[blockID].GetHasFlags(LexBlockTypes::EndContainer))
-				globalVarDefBuf.push_back(srcBlocks[blockID].src.GetBack());
+			const TextBlock src = srcBlocks.GetSrc(blockID);
+
+			if (srcBlocks.GetHasFlags(blockID, LexBlockTypes::StartContainer))
+				globalVarDefBuf.push_back(src.GetFront());
+			else if (srcBlocks.GetHasFlags(blockID, LexBlockTypes::EndContainer))
+				globalVarDefBuf.push_back(src.GetBack());
 			else
-				globalVarDefBuf.append(srcBlocks[blockID].src);
+				globalVarDefBuf.append(src);
 		}
 
 		globalVarDefBuf.append("\n");
@@ -243,59 +245,59 @@ void ShaderGenerator::AddScopeMask(SymbolHandle symbol, bool isContentMasked)
 	}
 }
 
-void ShaderGenerator::AddBlockRange(const IDynamicArray<LexBlock>& srcBlocks, int start, const int end, std::string& srcOut, int& line)
+void ShaderGenerator::AddBlockRange(const LexBlockList& srcBlocks, int start, const int end, std::string& srcOut, int& line)
 {
 	while (start <= end)
 	{
-		const LexBlock& block = srcBlocks[start];
+		const TextBlock src = srcBlocks.GetSrc(start);
+		const int startLine = srcBlocks.GetStartLine(start);
 
-		if ((start + 1) <= end && block.GetHasFlags(LexBlockTypes::LineDirectiveName))
+		if ((start + 1) <= end && srcBlocks.GetHasFlags(start, LexBlockTypes::LineDirectiveName))
 		{
-			FXSYNTAX_ASSERT_MSG(srcBlocks[start + 1].GetHasFlags(LexBlockTypes::LineDirectiveBody),
+			FXSYNTAX_ASSERT_MSG(srcBlocks.GetHasFlags(start + 1, LexBlockTypes::LineDirectiveBody),
 				"Expected line directive body after #line");
 
-			const LexBlock& body = srcBlocks[start + 1];
-			line = body.startLine + 1;
+			line = srcBlocks.GetStartLine(start + 1) + 1;
 
 			if (!srcOut.empty() && srcOut.back() != '\n')
 				srcOut.push_back('\n');
 
-			srcOut.append(block.src);
-			srcOut.append(body.src);
+			srcOut.append(src);
+			srcOut.append(srcBlocks.GetSrc(start + 1));
 			start += 2;
 		}
 		else
 		{ 
-			if (!block.GetHasFlags(LexBlockTypes::EndContainer))
+			if (!srcBlocks.GetHasFlags(start, LexBlockTypes::EndContainer))
 			{
-				if ((block.startLine - line) > 3)
+				if ((startLine - line) > 3)
 				{
-					AppendLineDirective(block.startLine, srcOut);
-					line = block.startLine;
+					AppendLineDirective(startLine, srcOut);
+					line = startLine;
 				}
-				else while (line < block.startLine)
+				else while (line < startLine)
 				{
 					srcOut.push_back('\n');
 					line++;
 				}
 			}
 
-			if (block.GetHasFlags(LexBlockTypes::StartContainer))
-				srcOut.push_back(block.src.GetFront());
-			else if (block.GetHasFlags(LexBlockTypes::EndContainer))
-				srcOut.push_back(block.src.GetBack());
-			else if (block.GetHasFlags(LexBlockTypes::DirectiveName))
+			if (srcBlocks.GetHasFlags(start, LexBlockTypes::StartContainer))
+				srcOut.push_back(src.GetFront());
+			else if (srcBlocks.GetHasFlags(start, LexBlockTypes::EndContainer))
+				srcOut.push_back(src.GetBack());
+			else if (srcBlocks.GetHasFlags(start, LexBlockTypes::DirectiveName))
 			{
 				if (!srcOut.empty() && srcOut.back() != '\n')
 					srcOut.push_back('\n');
 
-				srcOut.append(block.src);
-				line += block.lineCount;
+				srcOut.append(src);
+				line += srcBlocks.GetLineCount(start);
 			}
 			else
 			{
-				srcOut.append(block.src);
-				line += block.lineCount;
+				srcOut.append(src);
+				line += srcBlocks.GetLineCount(start);
 			}
 
 			start++;
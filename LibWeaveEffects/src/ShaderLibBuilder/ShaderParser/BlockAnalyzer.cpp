@@ -1,10 +1,20 @@
 #include "pch.hpp"
 #include <charconv>
+#include <algorithm>
+#include <thread>
+#include "WeaveUtils/Metrics.hpp"
 #include "WeaveEffects/EffectParseException.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ParseSnapshot.hpp"
 
 namespace Weave::Effects
 {
+    static constexpr CharFilter s_WordFilter("", '!', '~');
+    static constexpr CharFilter s_DigitFilter("", '0', '9');
+
+    // Smallest range of source worth lexing on its own thread
+    static constexpr size_t s_MinChunkLength = 64 * 1024;
+
     static LexBlockTypes GetDelimiterType(const char ch)
     {
         switch (ch)
@@ -30,20 +40,22 @@ namespace Weave::Effects
         }
     }
 
-    const string_view s_BreakFilters[]
-    {
-        "=,:;{}()[]#", // 0 - No templates
-        "=,:;{}()[]<#", // 1 - Can start templates
-        "=,:;{}()[]<>#", // 2 - Can start or close templates
-    };
-
     /// <summary>
-    /// Returns appropriate filter based on current template instantiation or backtracking state.
+    /// Returns block delimiters based on current template instantiation or backtracking state.
+    /// 0 - No templates, 1 - Can start templates, 2 - Can start or close templates
     /// </summary>
-    string_view BlockAnalyzer::GetBreakFilter() const 
+    ScanMasks BlockAnalyzer::GetBreakMasks() const
     {
-        const int index = (int)GetCanCloseTemplate() + (int)GetCanOpenTemplate();
-        return s_BreakFilters[index];
+        const int filterID = (int)GetCanCloseTemplate() + (int)GetCanOpenTemplate();
+        ScanMasks masks = ScanMasks::Breaks;
+
+        if (filterID >= 1)
+            masks |= ScanMasks::OpenAngles;
+
+        if (filterID >= 2)
+            masks |= ScanMasks::CloseAngles;
+
+        return masks;
     }
 
     /// <summary>
@@ -56,16 +68,185 @@ namespace Weave::Effects
     /// <summary>
     /// Returns true if a template instantiation is pending completion and '>' should be considered.
     /// </summary>
-    bool BlockAnalyzer::GetCanCloseTemplate() const { return !containers.IsEmpty() && blocks[containers.GetBack()].GetHasFlags(LexBlockTypes::OpenAngleBrackets); }
+    bool BlockAnalyzer::GetCanCloseTemplate() const { return !containers.IsEmpty() && blocks.GetHasFlags(containers.GetBack(), LexBlockTypes::OpenAngleBrackets); }
+
+    size_t BlockAnalyzer::GetOffset(const char* pCh) const { return (size_t)(pCh - src.GetData()); }
 
     static bool GetHasFlags(const LexBlockTypes value, const LexBlockTypes flags) { return (value & flags) == flags; }
 
+    /// <summary>
+    /// Finds the last line break in the body of a preprocessor directive, following line continuations,
+    /// and counts the lines it spans. Unterminated directives end with the source.
+    /// </summary>
+    static const char* FindDirectiveEnd(const TextBlock& src, const char* pBody, int& lineCount)
+    {
+        const char* pLast = pBody;
+        bool hasMoreLines;
+        lineCount = 0;
+
+        do
+        {
+            const char* lnStart = pLast + 1;
+            pLast = src.Find('\n', lnStart);
+
+            if (pLast == nullptr)
+            {
+                lineCount++;
+                return &src.GetBack();
+            }
+
+            TextBlock ln(lnStart, pLast);
+            hasMoreLines = ln.Contains("\\\n");
+            lineCount++;
+
+        } while (hasMoreLines);
+
+        return pLast;
+    }
+
+    /// <summary>
+    /// Parses the line number and optional file path in the body of a #line directive. Returns false
+    /// if the line number is missing or invalid.
+    /// </summary>
+    static bool TryGetLineDirective(const TextBlock& body, int& newLine, string_view& newPath)
+    {
+        const char* pFirstDigit = body.FindStart(body.GetData(), s_DigitFilter);
+        const char* pLastDigit = body.FindEnd(pFirstDigit, s_DigitFilter);
+        TextBlock numString(pFirstDigit, pLastDigit);
+
+        newLine = -1;
+        newPath = {};
+
+        if (*pFirstDigit < '0' || *pFirstDigit > '9')
+            return false;
+
+        std::from_chars(&numString.GetFront(), &numString.GetBack() + 1, newLine);
+
+        if (newLine < 0)
+            return false;
+
+        // New file path
+        if (pLastDigit < &body.GetBack())
+        {
+            const char* pFileStart = body.Find('"', pLastDigit + 1);
+
+            if (pFileStart != nullptr)
+            {
+                const char* pFileEnd = body.FindEnd(pFileStart + 1, """");
+                newPath = TextBlock(pFileStart, pFileEnd);
+            }
+        }
+
+        return true;
+    }
+
+    /// <summary>
+    /// Translates text in one copy of a source to the same range in another
+    /// </summary>
+    static TextBlock GetRebased(string_view text, const char* pOldBase, const char* pNewBase)
+    {
+        return TextBlock(pNewBase + (text.data() - pOldBase), text.length());
+    }
+
+    LexBlockList::LexBlockList() :
+        pBase(nullptr)
+    { }
+
+    LexBlock LexBlockList::operator[](ptrdiff_t index) const
+    {
+        return LexBlock(depths[index], types[index], GetSrc(index), startLines[index], lineCounts[index], files[index]);
+    }
+
+    void LexBlockList::SetBase(const char* pBase) { this->pBase = pBase; }
+
+    void LexBlockList::Add(const LexBlock& block)
+    {
+        types.Add(block.type);
+        offsets.Add((uint)(block.src.GetData() - pBase));
+        lengths.Add((uint)block.src.GetLength());
+        files.Add(block.file);
+        depths.Add(block.depth);
+        startLines.Add(block.startLine);
+        lineCounts.Add(block.lineCount);
+    }
+
+    void LexBlockList::AddRange(const LexBlockList& other, ptrdiff_t start, ptrdiff_t count)
+    {
+        types.AddRange(other.types, start, count);
+        offsets.AddRange(other.offsets, start, count);
+        lengths.AddRange(other.lengths, start, count);
+        files.AddRange(other.files, start, count);
+        depths.AddRange(other.depths, start, count);
+        startLines.AddRange(other.startLines, start, count);
+        lineCounts.AddRange(other.lineCounts, start, count);
+    }
+
+    void LexBlockList::Set(ptrdiff_t index, const LexBlock& block)
+    {
+        types[index] = block.type;
+        SetSrc(index, block.src);
+        files[index] = block.file;
+        depths[index] = block.depth;
+        startLines[index] = block.startLine;
+        lineCounts[index] = block.lineCount;
+    }
+
+    void LexBlockList::AddChunk(const LexBlockList& chunk, int fileOffset)
+    {
+        const uint offsetDelta = (uint)(chunk.pBase - pBase);
+        const size_t start = offsets.GetLength();
+        const size_t count = chunk.GetLength();
+
+        types.AddRange(chunk.types);
+        offsets.AddRange(chunk.offsets);
+        lengths.AddRange(chunk.lengths);
+        files.AddRange(chunk.files);
+        depths.AddRange(chunk.depths);
+        startLines.AddRange(chunk.startLines);
+        lineCounts.AddRange(chunk.lineCounts);
+
+        for (size_t i = start; i < start + count; i++)
+        {
+            offsets[i] += offsetDelta;
+            files[i] += fileOffset;
+        }
+    }
+
+    void LexBlockList::SetSrc(ptrdiff_t index, const TextBlock& src)
+    {
+        offsets[index] = (uint)(src.GetData() - pBase);
+        lengths[index] = (uint)src.GetLength();
+    }
+
+    void LexBlockList::RemoveRange(ptrdiff_t start, ptrdiff_t count)
+    {
+        types.RemoveRange(start, count);
+        offsets.RemoveRange(start, count);
+        lengths.RemoveRange(start, count);
+        files.RemoveRange(start, count);
+        depths.RemoveRange(start, count);
+        startLines.RemoveRange(start, count);
+        lineCounts.RemoveRange(start, count);
+    }
+
+    void LexBlockList::Clear()
+    {
+        types.Clear();
+        offsets.Clear();
+        lengths.Clear();
+        files.Clear();
+        depths.Clear();
+        startLines.Clear();
+        lineCounts.Clear();
+    }
+
     BlockAnalyzer::BlockAnalyzer() :
         containers(20),
         pPos(nullptr),
         depth(0),
         line(1),
-        pPosOld(nullptr)
+        pPosOld(nullptr),
+        maxThreads(1)
     { }
 
     void BlockAnalyzer::Clear()
@@ -73,6 +254,7 @@ namespace Weave::Effects
         files.Clear();
         containers.Clear();
         blocks.Clear();
+        checkpoints.Clear();
         depth = 0;
         line = 1;
         pPos = nullptr;
@@ -81,11 +263,44 @@ namespace Weave::Effects
 
     void BlockAnalyzer::AnalyzeSource(string_view path, TextBlock src)
     {
-        Clear();
         this->src = src;
+        blocks.SetBase(src.GetData());
+        index.Build(string_view(src.GetData(), src.GetLength()));
+        StartAnalysis(path);
+
+        const size_t remaining = src.GetLength() - GetOffset(pPos);
+        const uint chunkCount = (uint)std::min<size_t>(maxThreads, remaining / s_MinChunkLength);
+
+        if (chunkCount > 1)
+            FindChunks(chunkCount);
+        else
+            chunkStarts.Clear();
+
+        if (chunkStarts.GetLength() > 1)
+            AnalyzeChunks(path);
+        else
+            Lex();
+    }
+
+    void BlockAnalyzer::SetMaxThreads(uint maxThreads) { this->maxThreads = std::max(maxThreads, 1u); }
+
+    /// <summary>
+    /// Resets lexing to the start of the current source, restoring cached blocks where possible
+    /// </summary>
+    void BlockAnalyzer::StartAnalysis(string_view path)
+    {
+        Clear();
         pPos = src.GetData();
-        files.EmplaceBack(path, line);
 
+        if (!TryRestoreCache(path))
+            files.EmplaceBack(path, line);
+    }
+
+    /// <summary>
+    /// Lexes from the current position to the end of the source
+    /// </summary>
+    void BlockAnalyzer::Lex()
+    {
         while (true)
         {            
             // Parse
@@ -93,8 +308,12 @@ namespace Weave::Effects
             { 
                 if (*pPos <= ' ') // Skip whitespace
                 {
-                    if (*pPos == '\n') // Count lines
-                        line++;
+                    const size_t start = GetOffset(pPos);
+                    const size_t next = index.FindNext(start, ScanMasks::NonSpaces);
+
+                    // Count lines and resume at the next non-whitespace character
+                    line += (int)index.GetCount(start, next, ScanMasks::Newlines);
+                    pPos = src.GetData() + next - 1;
                 }
                 else // Get blocks
                 {
@@ -102,6 +321,7 @@ namespace Weave::Effects
                     {
                     case '#':
                         AddDirective();
+                        TryAddCheckpoint();
                         break;
                     case '{':
                     case '[':
@@ -121,6 +341,7 @@ namespace Weave::Effects
                         if (*pPos != '<' || GetCanCloseTemplate())
                         {
                             EndContainer();
+                            TryAddCheckpoint();
                             break;
                         }
                         [[fallthrough]];
@@ -133,6 +354,7 @@ namespace Weave::Effects
                         [[fallthrough]];
                     default:
                         AddBlock({ pPos, &src.GetBack() });
+                        TryAddCheckpoint();
                         break;
                     }
                 }
@@ -142,26 +364,419 @@ namespace Weave::Effects
             // Try exit
             else if (TryFinalizeParse())
                 break;
+            // Resume after the last block retained by backtracking
+            else
+                pPos++;
+        }
+    }
+
+    /// <summary>
+    /// Splits the remaining source into roughly equal chunks ending in top-level scopes, and 
+    /// estimates the lexer state at the start of each. Directives are skipped, and line directives 
+    /// followed, as they are when lexing. Estimates are verified when chunks are stitched together.
+    /// </summary>
+    void BlockAnalyzer::FindChunks(uint chunkCount)
+    {
+        chunkStarts.Clear();
+        chunkStarts.EmplaceBack(pPos, line, files.GetBack().filePath);
+
+        const size_t start = GetOffset(pPos);
+        const size_t chunkLength = (src.GetLength() - start) / chunkCount;
+        size_t nextChunk = start + chunkLength;
+        size_t offset = start;
+        int scanLine = line;
+        string_view filePath = files.GetBack().filePath;
+        int scopeDepth = 0;
+
+        while (chunkStarts.GetLength() < chunkCount)
+        {
+            offset = index.FindNext(offset, ScanMasks::Breaks | ScanMasks::Newlines);
+
+            if (offset >= src.GetLength())
+                break;
+
+            const char* pCh = src.GetData() + offset;
+
+            switch (*pCh)
+            {
+            case '\n':
+                scanLine++;
+                break;
+            case '{':
+                scopeDepth++;
+                break;
+            case '}':
+                // Unbalanced scopes are left for the lexer to report
+                if (--scopeDepth < 0)
+                    return;
+
+                if (scopeDepth == 0 && offset >= nextChunk && pCh < &src.GetBack())
+                {
+                    chunkStarts.EmplaceBack(pCh + 1, scanLine, filePath);
+                    nextChunk = offset + chunkLength;
+                }
+                break;
+            case '#':
+            {
+                const TextBlock name(pCh, src.FindEnd(pCh, s_WordFilter) + 1);
+                const char* pBody = src.FindStart(&name.GetBack() + 1, s_WordFilter);
+                int lineCount;
+                const char* pLast = FindDirectiveEnd(src, pBody, lineCount);
+                int newLine;
+                string_view newPath;
+
+                scanLine += lineCount;
+
+                if (name.StartsWith("#line") && TryGetLineDirective(TextBlock(pBody, pLast), newLine, newPath))
+                {
+                    scanLine = newLine;
+
+                    if (!newPath.empty())
+                        filePath = newPath;
+                }
+
+                offset = GetOffset(pLast);
+                break;
+            }
+            default:
+                break;
+            }
+
+            offset++;
+        }
+    }
+
+    /// <summary>
+    /// Lexes the first chunk on the calling thread, and the rest in parallel, before stitching them
+    /// together. If a chunk cannot be used, the source is lexed serially from its start.
+    /// </summary>
+    void BlockAnalyzer::AnalyzeChunks(string_view path)
+    {
+        const uint chunkCount = (uint)chunkStarts.GetLength();
+        const TextBlock fullSrc = src;
+        bool isFirstValid = false;
+
+        while (chunkAnalyzers.GetLength() < chunkCount - 1)
+            chunkAnalyzers.EmplaceBack(new BlockAnalyzer());
+
+        const auto GetChunkSrc = [&](const uint chunkID)
+        {
+            const char* pLast = (chunkID + 1 < chunkCount) ? chunkStarts[chunkID + 1].pStart - 1 : &fullSrc.GetBack();
+            return TextBlock(chunkStarts[chunkID].pStart, pLast);
+        };
+
+        {
+            Vector<std::jthread> workers;
+            workers.Reserve(chunkCount - 1);
+
+            for (uint i = 1; i < chunkCount; i++)
+            {
+                workers.EmplaceBack([&, i]
+                {
+                    BlockAnalyzer& chunk = *chunkAnalyzers[i - 1];
+
+                    // Errors are reported by the serial fallback
+                    try
+                    {
+                        chunk.AnalyzeChunk(chunkStarts[i], GetChunkSrc(i));
+                    }
+                    catch (...)
+                    {
+                        chunk.Clear();
+                    }
+                });
+            }
+
+            // Retains the same base, so offsets in the index remain valid
+            src = TextBlock(fullSrc.GetData(), chunkStarts[1].pStart - 1);
+
+            try
+            {
+                Lex();
+                isFirstValid = GetIsChunkClosed();
+            }
+            catch (const EffectParseException&)
+            { }
+
+            src = fullSrc;
+        }
+
+        WV_METRIC_ADD("fx.parse.lexChunks", chunkCount);
+
+        if (!isFirstValid)
+        {
+            WV_METRIC_ADD("fx.parse.lexChunkFallbacks", 1);
+            StartAnalysis(path);
+            Lex();
+            return;
+        }
+
+        for (uint i = 1; i < chunkCount; i++)
+        {
+            const BlockAnalyzer& chunk = *chunkAnalyzers[i - 1];
+            const ChunkStart& start = chunkStarts[i];
+            const bool isLast = (i + 1 == chunkCount);
+
+            // Chunks must start in the state the last one ended in, and end where the next starts
+            if (!chunk.blocks.IsEmpty() && start.line == line && start.filePath == files.GetBack().filePath
+                && (isLast || chunk.GetIsChunkClosed()))
+            {
+                AddChunk(chunk);
+                continue;
+            }
+
+            // The last chunk ended in a closed top-level scope, and lexing can resume from there
+            WV_METRIC_ADD("fx.parse.lexChunkFallbacks", 1);
+            pPos = start.pStart;
+            depth = 0;
+            pPosOld = nullptr;
+            containers.Clear();
+            Lex();
+            return;
+        }
+
+        pPos = &src.GetBack() + 1;
+    }
+
+    /// <summary>
+    /// Lexes a chunk of top-level declarations on its own, starting in the given state
+    /// </summary>
+    void BlockAnalyzer::AnalyzeChunk(const ChunkStart& start, TextBlock chunk)
+    {
+        Clear();
+        src = chunk;
+        pPos = chunk.GetData();
+        line = start.line;
+        blocks.SetBase(chunk.GetData());
+        index.Build(string_view(chunk.GetData(), chunk.GetLength()));
+        files.EmplaceBack(start.filePath, start.line);
+        Lex();
+    }
+
+    /// <summary>
+    /// Returns true if the analysis ended in a top-level scope closed by the last character of the 
+    /// source, without backtracking past it. Lexing can continue after it without prior state.
+    /// </summary>
+    bool BlockAnalyzer::GetIsChunkClosed() const
+    {
+        if (blocks.IsEmpty() || (pPosOld != nullptr && pPosOld > &src.GetBack()))
+            return false;
+
+        const ptrdiff_t last = (ptrdiff_t)blocks.GetLength() - 1;
+
+        return blocks.GetDepth(last) == 0 && blocks.GetHasFlags(last, LexBlockTypes::EndScope)
+            && &blocks.GetSrc(last).GetBack() == &src.GetBack();
+    }
+
+    /// <summary>
+    /// Appends the results of a chunk that starts where the current analysis ends
+    /// </summary>
+    void BlockAnalyzer::AddChunk(const BlockAnalyzer& chunk)
+    {
+        // The first file of the chunk is the current file
+        const int fileOffset = GetFileIndex();
+        const int blockOffset = (int)blocks.GetLength();
+
+        blocks.AddChunk(chunk.blocks, fileOffset);
+        files.AddRange(chunk.files, 1);
+
+        for (const Checkpoint& cp : chunk.checkpoints)
+            checkpoints.EmplaceBack(cp.block + blockOffset, cp.line, cp.fileCount + fileOffset);
+
+        line = chunk.line;
+    }
+
+    /// <summary>
+    /// Restores blocks from the retained analysis up to the last checkpoint preceding the first 
+    /// character that differs from the new source. Returns false if nothing could be reused.
+    /// </summary>
+    bool BlockAnalyzer::TryRestoreCache(string_view path)
+    {
+        if (cachedCheckpoints.IsEmpty() || path != cachedPath)
+            return false;
+
+        const char* pCacheStart = cachedSrc.data();
+        const char* pSrcStart = src.GetData();
+        const size_t maxLength = std::min(src.GetLength(), cachedSrc.length());
+        const ptrdiff_t matchLength = std::mismatch(pSrcStart, pSrcStart + maxLength, pCacheStart).first - pSrcStart;
+
+        // Checkpoints are ordered by position. The last character of the block must precede the 
+        // first difference.
+        ptrdiff_t cpIndex = (ptrdiff_t)cachedCheckpoints.GetLength() - 1;
+
+        while (cpIndex >= 0 && (&cachedBlocks.GetSrc(cachedCheckpoints[cpIndex].block).GetBack() - pCacheStart) >= matchLength)
+            cpIndex--;
+
+        if (cpIndex < 0)
+            return false;
+
+        const Checkpoint& cp = cachedCheckpoints[cpIndex];
+        checkpoints.AddRange(cachedCheckpoints, 0, cpIndex + 1);
+
+        // Block offsets are relative to the source, and carry over as-is
+        blocks.AddRange(cachedBlocks, 0, cp.block + 1);
+
+        // Paths set by line directives reference the source
+        files.EmplaceBack(path, 1);
+
+        for (int i = 1; i < cp.fileCount; i++)
+        {
+            LexFile& file = files.EmplaceBack(cachedFiles[i]);
+            file.filePath = GetRebased(file.filePath, pCacheStart, pSrcStart);
+        }
+
+        depth = 0;
+        line = cp.line;
+        pPos = &blocks.GetSrc((ptrdiff_t)blocks.GetLength() - 1).GetBack() + 1;
+
+        WV_METRIC_ADD("fx.parse.blocksReused", blocks.GetLength());
+        return true;
+    }
+
+    void BlockAnalyzer::RetainAnalysis(string_view path)
+    {
+        ClearRetainedAnalysis();
+
+        if (checkpoints.IsEmpty())
+            return;
+
+        // Nothing past the last checkpoint can be restored
+        const Checkpoint& lastCp = checkpoints.GetBack();
+        const char* pSrcStart = src.GetData();
+        const size_t retainedLength = &blocks.GetSrc(lastCp.block).GetBack() - pSrcStart + 1;
+
+        cachedPath = path;
+        cachedSrc.assign(pSrcStart, retainedLength);
+
+        const char* pCacheStart = cachedSrc.data();
+        cachedBlocks.SetBase(pCacheStart);
+        cachedBlocks.AddRange(blocks, 0, lastCp.block + 1);
+
+        for (int i = 0; i < lastCp.fileCount; i++)
+        {
+            LexFile& file = cachedFiles.EmplaceBack(files[i]);
+
+            if (i > 0)
+                file.filePath = GetRebased(file.filePath, pSrcStart, pCacheStart);
+        }
+
+        cachedCheckpoints.AddRange(checkpoints);
+    }
+
+    void BlockAnalyzer::SetRetainedAnalysis(const BlockAnalyzer& other)
+    {
+        ClearRetainedAnalysis();
+
+        if (other.cachedCheckpoints.IsEmpty())
+            return;
+
+        cachedPath = other.cachedPath;
+        cachedSrc = other.cachedSrc;
+
+        const char* pCacheStart = cachedSrc.data();
+        const char* pOtherStart = other.cachedSrc.data();
+        cachedBlocks.SetBase(pCacheStart);
+        cachedBlocks.AddRange(other.cachedBlocks, 0, (ptrdiff_t)other.cachedBlocks.GetLength());
+
+        for (int i = 0; i < (int)other.cachedFiles.GetLength(); i++)
+        {
+            LexFile& file = cachedFiles.EmplaceBack(other.cachedFiles[i]);
+
+            if (i > 0)
+                file.filePath = GetRebased(file.filePath, pOtherStart, pCacheStart);
+        }
+
+        cachedCheckpoints.AddRange(other.cachedCheckpoints);
+    }
+
+    void BlockAnalyzer::ClearRetainedAnalysis()
+    {
+        cachedPath.clear();
+        cachedSrc.clear();
+        cachedFiles.Clear();
+        cachedBlocks.Clear();
+        cachedCheckpoints.Clear();
+    }
+
+    /// <summary>
+    /// Marks the last block as a checkpoint if it ends a top-level declaration or directive, 
+    /// and lexing can be resumed after it without backtracking state.
+    /// </summary>
+    void BlockAnalyzer::TryAddCheckpoint()
+    {
+        if (depth != 0 || !containers.IsEmpty() || blocks.IsEmpty() || pPosOld > pPos)
+            return;
+
+        const int blockIndex = (int)blocks.GetLength() - 1;
+
+        if (blocks.GetDepth(blockIndex) == 0 && &blocks.GetSrc(blockIndex).GetBack() == pPos
+            && (blocks.GetHasFlags(blockIndex, LexBlockTypes::SemicolonSeparator)
+            || blocks.GetHasFlags(blockIndex, LexBlockTypes::EndScope) 
+            || blocks.GetHasFlags(blockIndex, LexBlockTypes::DirectiveBody)))
+        {
+            checkpoints.EmplaceBack(blockIndex, line, (int)files.GetLength());
         }
     }
 
     const IDynamicArray<LexFile>& BlockAnalyzer::GetSourceFiles() const { return files; }
 
-    const IDynamicArray<LexBlock>& BlockAnalyzer::GetBlocks() const { return blocks; }
+    const LexBlockList& BlockAnalyzer::GetBlocks() const { return blocks; }
 
-    void BlockAnalyzer::AddBlock(const TextBlock& start)
+    void BlockAnalyzer::GetSnapshot(ParseSnapshot& dst) const
     {
-        const string_view filter = GetBreakFilter();
-        const char* pNext = start.GetData() - 1;
+        const string_view srcText(src.GetData(), src.GetLength());
+        dst.files.Clear();
+        dst.blocks.Clear();
+        dst.blocks.Reserve(blocks.GetLength());
 
-        do
+        for (int i = 1; i < (int)files.GetLength(); i++)
+            dst.files.EmplaceBack(dst.GetTextRef(srcText, files[i].filePath), files[i].startLine);
+
+        for (int i = 0; i < (int)blocks.GetLength(); i++)
         {
-            pNext = start.FindEnd(pNext + 1, filter);
-        } 
-        while (pNext < &start.GetBack() && TextBlock::GetIsRangeChar(*pNext, filter));
+            const TextBlock blockSrc = blocks.GetSrc(i);
+            dst.blocks.EmplaceBack(
+                blocks.GetType(i),
+                (uint)(blockSrc.GetData() - blocks.GetBase()), 
+                (uint)blockSrc.GetLength(),
+                blocks.GetFile(i),
+                blocks.GetDepth(i),
+                blocks.GetStartLine(i),
+                blocks.GetLineCount(i)
+            );
+        }
+    }
+
+    void BlockAnalyzer::SetSnapshot(string_view path, TextBlock src, const ParseSnapshot& snapshot)
+    {
+        Clear();
+        this->src = src;
+        blocks.SetBase(src.GetData());
+
+        const string_view srcText(src.GetData(), src.GetLength());
+        files.EmplaceBack(path, line);
+
+        for (const SnapshotFile& file : snapshot.files)
+            files.EmplaceBack(ParseSnapshot::GetText(srcText, {}, file.path), file.startLine);
+
+        for (const SnapshotBlock& block : snapshot.blocks)
+        {
+            FX_CHECK_MSG((size_t)block.offset + block.length <= src.GetLength() && block.file >= 0 
+                && block.file < (int)files.GetLength(), "Malformed parse snapshot");
+
+            blocks.Add(LexBlock(block.depth, block.type, TextBlock(src.GetData() + block.offset, block.length), 
+                block.startLine, block.lineCount, block.file));
+        }
+    }
+
+    void BlockAnalyzer::AddBlock(const TextBlock& start)
+    {
+        // First break in the filter or non-ASCII character, or the end of the source
+        const size_t nextOffset = index.FindNext(GetOffset(start.GetData()), GetBreakMasks());
+        const char* pNext = std::min<const char*>(src.GetData() + nextOffset, &start.GetBack());
 
         // Create new non-container block
-        LexBlock& block = blocks.EmplaceBack();
+        LexBlock block;
         
         switch (*pNext)
         {
@@ -201,14 +816,19 @@ namespace Weave::Effects
         block.depth = depth;
         block.src = TextBlock(start.GetData(), pNext);
         block.startLine = line;
-        block.lineCount = block.src.FindCount('\n');
+        block.lineCount = (int)index.GetCount(GetOffset(block.src.GetData()),
+            GetOffset(block.src.GetData()) + block.src.GetLength(), ScanMasks::Newlines);
         block.file = GetFileIndex();
 
+        blocks.Add(block);
         line += block.lineCount;
         pPos = &block.src.GetBack();
     }
 
-    LexBlock* BlockAnalyzer::GetTopContainer() { return !containers.IsEmpty() ? &blocks[containers.GetBack()] : nullptr; }
+    /// <summary>
+    /// Returns the index of the innermost open container, or -1 if none are open
+    /// </summary>
+    int BlockAnalyzer::GetTopContainer() const { return !containers.IsEmpty() ? containers.GetBack() : -1; }
 
     void BlockAnalyzer::SetState(int blockIndex)
     {
@@ -217,7 +837,12 @@ namespace Weave::Effects
         // Restart from the beginning but without template parsing
         if (blockIndex < 0)
         {
-            Clear();          
+            const LexFile firstFile = files[0];
+            Clear();
+            files.Add(firstFile);
+            line = firstFile.startLine;
+            // Incremented before the next character is read
+            pPos = src.GetData() - 1;
         }
         // Revert state to the point just after the given block was added and temporarily 
         // disable template parsing until this point is reached again
@@ -225,7 +850,7 @@ namespace Weave::Effects
         { 
             FXSYNTAX_ASSERT_MSG(blockIndex >= 0 && blockIndex < (int)blocks.GetLength(), "Block index out of range");
 
-            LexBlock& block = blocks[blockIndex];
+            const LexBlock block = blocks[blockIndex];
             pPos = &block.src.GetBack();
             // Depth is normally incremented after a container is added
             depth = block.depth + (int)block.GetHasFlags(LexBlockTypes::StartContainer);
@@ -237,6 +862,9 @@ namespace Weave::Effects
             while (block.file > GetFileIndex())
                 files.RemoveBack();
 
+            while (!checkpoints.IsEmpty() && checkpoints.GetBack().block > blockIndex)
+                checkpoints.RemoveBack();
+
             blocks.RemoveRange(blockIndex + 1, (int)blocks.GetLength() - blockIndex - 1);
         }
 
@@ -246,10 +874,9 @@ namespace Weave::Effects
     void BlockAnalyzer::RevertContainer(int blockIndex)
     {
         FXSYNTAX_ASSERT_MSG(blockIndex >= 0 && blockIndex < (int)blocks.GetLength(), "Block index out of range");
-        const LexBlock& block = blocks[blockIndex];
 
         // Revert to block before container preamble
-        if (blockIndex > 0 && blocks[blockIndex - 1].GetHasFlags(LexBlockTypes::Preamble))
+        if (blockIndex > 0 && blocks.GetHasFlags(blockIndex - 1, LexBlockTypes::Preamble))
             SetState(blockIndex - 2);
         // Revert to block before container
         else
@@ -258,16 +885,16 @@ namespace Weave::Effects
 
     void BlockAnalyzer::RevertTemplate()
     {
-        if (const LexBlock* top = GetTopContainer(); top->GetHasFlags(LexBlockTypes::OpenAngleBrackets))
+        if (blocks.GetHasFlags(GetTopContainer(), LexBlockTypes::OpenAngleBrackets))
         {
             uint idx = containers.GetBack();
 
             // It may be necessary to revert multiple containers
-            for (uint i = (uint)containers.GetLength() - 1; i >= 0; i--)
+            for (int i = (int)containers.GetLength() - 1; i >= 0; i--)
             {
                 const uint id = containers[i];
 
-                if (blocks[id].GetHasFlags(LexBlockTypes::OpenAngleBrackets))
+                if (blocks.GetHasFlags(id, LexBlockTypes::OpenAngleBrackets))
                     idx = id;
                 else
                     break;
@@ -288,7 +915,7 @@ namespace Weave::Effects
         // type is started. More restrictive than a normal parser, but should be an acceptable simplification.
         if (!GetHasFlags(delimType, LexBlockTypes::OpenAngleBrackets) && !containers.IsEmpty())
         { 
-            if (const LexBlock* top = GetTopContainer(); top->GetHasFlags(LexBlockTypes::OpenAngleBrackets))
+            if (blocks.GetHasFlags(GetTopContainer(), LexBlockTypes::OpenAngleBrackets))
             {
                 RevertTemplate();
                 return;
@@ -297,18 +924,19 @@ namespace Weave::Effects
 
         // Start new container to be later finalized in LIFO order as closing braces are encountered
         containers.Add((int)blocks.GetLength());
-        blocks.EmplaceBack(depth, delimType, pPos, line, GetFileIndex());
+        blocks.Add(LexBlock(depth, delimType, pPos, line, 0, GetFileIndex()));
         depth++;
     }
 
     void BlockAnalyzer::EndContainer()
     {
-        LexBlock* pCont = GetTopContainer();
-        FXSYNTAX_CHECK_MSG(pCont != nullptr, "Unexpected closing '{}' on line: {}", *pPos, line);
+        const int contIndex = GetTopContainer();
+        FXSYNTAX_CHECK_MSG(contIndex != -1, "Unexpected closing '{}' on line: {}", *pPos, line);
+        LexBlock cont = blocks[contIndex];
 
         // An opening '<' was previously classified as a potential template, but another container closed 
         // before it was ready. It will need to be reverted and reclassified.
-        if (pCont->GetHasFlags(LexBlockTypes::OpenAngleBrackets) && (*pPos != '>'))
+        if (cont.GetHasFlags(LexBlockTypes::OpenAngleBrackets) && (*pPos != '>'))
         {
             RevertTemplate();
         }
@@ -317,17 +945,17 @@ namespace Weave::Effects
         { 
             LexBlockTypes delimType = GetDelimiterType(*pPos);
 
-            if (pCont->GetHasFlags(LexBlockTypes::Scope))
+            if (cont.GetHasFlags(LexBlockTypes::Scope))
             {
                 FXSYNTAX_CHECK_MSG(GetHasFlags(delimType, LexBlockTypes::EndScope),
                     "Expected scope end '}}' on line: {}", line);
             }
-            else if (pCont->GetHasFlags(LexBlockTypes::Parentheses))
+            else if (cont.GetHasFlags(LexBlockTypes::Parentheses))
             {
                 FXSYNTAX_CHECK_MSG(GetHasFlags(delimType, LexBlockTypes::CloseParentheses),
                     "Expected closing parentheses ')' on line: {}", line);
             }
-            else if (pCont->GetHasFlags(LexBlockTypes::SquareBrackets))
+            else if (cont.GetHasFlags(LexBlockTypes::SquareBrackets))
             {
                 FXSYNTAX_CHECK_MSG(GetHasFlags(delimType, LexBlockTypes::CloseSquareBrackets),
                     "Expected closing square bracket ']' on line: {}", line);
@@ -338,12 +966,13 @@ namespace Weave::Effects
 
             // Finalize source range and line count in container opening
             containers.RemoveBack();
-            pCont->src = TextBlock(pCont->src.GetData(), pPos);
-            pCont->lineCount = line - pCont->startLine;
+            cont.src = TextBlock(cont.src.GetData(), pPos);
+            cont.lineCount = line - cont.startLine;
+            blocks.Set(contIndex, cont);
 
             // Add duplicate ending marker with appropriate delim flags
-            LexBlock& endContainer = blocks.EmplaceBack(*pCont);
-            endContainer.type = delimType;
+            cont.type = delimType;
+            blocks.Add(cont);
         }
     }
 
@@ -352,30 +981,18 @@ namespace Weave::Effects
     /// </summary>
     void BlockAnalyzer::AddDirective()
     {
-        LexBlock& name = blocks.EmplaceBack();
-        bool hasMoreLines;
+        LexBlock name;
 
         name.depth = depth;
         name.type = LexBlockTypes::DirectiveName;
-        name.src = TextBlock(pPos, src.FindWordEnd(pPos) + 1);
+        name.src = TextBlock(pPos, src.FindEnd(pPos, s_WordFilter) + 1);
         name.startLine = line;
         name.file = GetFileIndex();
 
-        pPos = src.FindWord(&name.src.GetBack() + 1);
-
-        const char* pLast = pPos;
-        int lineCount = 0;
-
-        do
-        {
-            const char* lnStart = pLast + 1;
-            pLast = src.Find('\n', lnStart);
-            TextBlock ln(lnStart, pLast);
-
-            hasMoreLines = ln.Contains("\\\n");
-            lineCount++;
+        pPos = src.FindStart(&name.src.GetBack() + 1, s_WordFilter);
 
-        } while (hasMoreLines);
+        int lineCount;
+        const char* pLast = FindDirectiveEnd(src, pPos, lineCount);
 
         bool isLineDirective = false;
 
@@ -385,7 +1002,7 @@ namespace Weave::Effects
             name.type |= LexBlockTypes::LineDirective;
         }
 
-        LexBlock& body = blocks.EmplaceBack();
+        LexBlock body;
         body.depth = depth;
         body.type = LexBlockTypes::DirectiveBody;
         body.src = TextBlock(pPos, pLast);
@@ -398,35 +1015,21 @@ namespace Weave::Effects
 
         if (isLineDirective)
             ProcessLineDirective(body);
+
+        blocks.Add(name);
+        blocks.Add(body);
     }
 
     void BlockAnalyzer::ProcessLineDirective(LexBlock& body) 
     {
-        // New line number
-        const char* pFirstDigit = body.src.FindStart(body.src.GetData(), "", '0', '9');
-        const char* pLastDigit = body.src.FindEnd(pFirstDigit, "", '0', '9');
-        TextBlock numString(pFirstDigit, pLastDigit);
-
-        FXSYNTAX_CHECK_MSG(*pFirstDigit >= '0' && *pFirstDigit <= '9',
-            "Expected a line number after #line directive on line {}", line);
-
-        int newLine = -1;
+        int newLine;
         string_view newPath;
-        std::from_chars(&numString.GetFront(), &numString.GetBack() + 1, newLine);
 
-        FXSYNTAX_CHECK_MSG(newLine >= 0,
+        FXSYNTAX_CHECK_MSG(TryGetLineDirective(body.src, newLine, newPath),
             "Expected a line number after #line directive on line {}", line);
 
-        // New file path
-        if (pLastDigit < &body.src.GetBack())
-        {
-            const char* pFileStart = body.src.Find('"', pLastDigit + 1);
-            const char* pFileEnd = body.src.FindEnd(pFileStart + 1, """");
-            newPath = TextBlock(pFileStart, pFileEnd);
-
-            if (files.IsEmpty() || files.GetBack().filePath != newPath)
-                files.EmplaceBack(newPath, newLine);
-        }
+        if (!newPath.empty() && (files.IsEmpty() || files.GetBack().filePath != newPath))
+            files.EmplaceBack(newPath, newLine);
 
         line = newLine;
         body.type |= LexBlockTypes::LineDirective;
@@ -441,7 +1044,7 @@ namespace Weave::Effects
     {
         if (!containers.IsEmpty())
         {
-            LexBlock& top = *GetTopContainer();
+            const LexBlock top = blocks[GetTopContainer()];
 
             if (top.GetHasFlags(LexBlockTypes::StartScope))
             {
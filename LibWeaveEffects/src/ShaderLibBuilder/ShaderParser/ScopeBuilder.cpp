@@ -2,10 +2,13 @@
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/SymbolData.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/SymbolPatterns.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/ScopeBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ParseSnapshot.hpp"
 
 using namespace Weave;
 using namespace Weave::Effects;
 
+static ulong GetScopeKey(const int scopeID, const int identID) { return ((ulong)scopeID << 32) | (uint)identID; }
+
 ScopeBuilder::ScopeBuilder() :
     scopes(50),
     topScope(0)
@@ -35,39 +38,74 @@ void ScopeBuilder::AddScope(const int symbolID, const int blockStart, const int
     scope.blockStart = blockStart;
     scope.blockCount = blockCount;
 
-    scopeSymbolMaps.EmplaceBack();
-    funcOverloadMaps.EmplaceBack();
     scopeSymbolLists.EmplaceBack();
 }
 
 void ScopeBuilder::AddFuncToOverloadTable(const string_view name, const int symbolID)
 {
-    FuncOverloadMap& map = funcOverloadMaps[topScope];
+    const ulong key = GetScopeKey(topScope, GetOrAddIdentID(name));
+    const auto [it, isNew] = scopeOverloadMap.try_emplace(key, (int)funcOverloads.GetLength());
+
+    if (isNew)
+        funcOverloads.EmplaceBack();
+
+    funcOverloads[it->second].Add(symbolID);
+}
 
-    if (!map.contains(name))
-        map.emplace(name, IDList());
+int ScopeBuilder::TryGetIdentID(string_view name) const
+{
+    const auto it = identIDMap.find(name);
+    return it != identIDMap.end() ? it->second : -1;
+}
 
-    IDList& funcList = map.find(name)->second;
-    funcList.push_front(symbolID);
+int ScopeBuilder::GetOrAddIdentID(string_view name)
+{
+    return identIDMap.try_emplace(name, (int)identIDMap.size()).first->second;
+}
+
+int ScopeBuilder::TryGetScopeValue(const std::unordered_map<ulong, int>& map, const IDynamicArray<ScopeData>& scopes, 
+    int identID, int top)
+{
+    if (identID == -1)
+        return -1;
+
+    const ScopeData* pScope;
+
+    do
+    {
+        pScope = &scopes[top];
+        const auto it = map.find(GetScopeKey(top, identID));
+
+        if (it != map.end())
+            return it->second;
+
+        top = pScope->parentScope;
+
+    } while (pScope->parentScope != -1);
+
+    return -1;
 }
 
 void ScopeBuilder::Clear()
 {
     scopes.Clear();
-    scopeSymbolMaps.Clear();
-    funcOverloadMaps.Clear();
     scopeSymbolLists.Clear();
 
+    identIDMap.clear();
+    scopeSymbolMap.clear();
+    scopeOverloadMap.clear();
+    funcOverloads.Clear();
+
     tokens.Clear();
     symbols.Clear();
 
     types.Clear();
-    userTypes.Clear();
+    userTypes.clear();
     functions.Clear();
     attributes.Clear();
 
     deferredSymbolBuf.Clear();
-    generatedText.clear();
+    generatedText.Clear();
 
     Init();
 }
@@ -121,17 +159,24 @@ int ScopeBuilder::GetScopeChild(const int scopeID, const int index) const
 
 int ScopeBuilder::GetScopeChild(const int scopeID, string_view ident) const
 {
-    if (scopeSymbolMaps[scopeID].contains(ident))
-        return scopeSymbolMaps[scopeID].find(ident)->second;
-    else
-        return -1;
+    const int identID = TryGetIdentID(ident);
+
+    if (identID != -1)
+    {
+        const auto it = scopeSymbolMap.find(GetScopeKey(scopeID, identID));
+
+        if (it != scopeSymbolMap.end())
+            return it->second;
+    }
+
+    return -1;
 }
 
 size_t ScopeBuilder::GetScopeChildCount(const int scopeID) const { return scopeSymbolLists[scopeID].GetLength(); }
 
-string_view ScopeBuilder::AddGeneratedText(string&& str) { return generatedText.emplace_front(std::move(str)); }
+string_view ScopeBuilder::AddGeneratedText(string_view str) { return generatedText.Add(str); }
 
-string_view ScopeBuilder::AddGeneratedText(string_view str) { return generatedText.emplace_front(str); }
+TextArena& ScopeBuilder::GetGeneratedText() { return generatedText; }
 
 bool ScopeBuilder::TryGetTokenFlags(TokenDef& token, int top) const
 {
@@ -198,22 +243,13 @@ bool ScopeBuilder::TryGetSymbol(string_view name, int& symbolID, int top) const
     if (top == -1)
         top = topScope;
 
-    const ScopeData* pScope;
+    const int result = TryGetScopeValue(scopeSymbolMap, scopes, TryGetIdentID(name), top);
 
-    do
+    if (result != -1)
     {
-        pScope = &scopes[top];
-        auto nameSymbolPair = scopeSymbolMaps[top].find(name);
-
-        if (nameSymbolPair != scopeSymbolMaps[top].end())
-        {
-            symbolID = nameSymbolPair->second;
-            return true;
-        }
-
-        top = pScope->parentScope;
-
-    } while (pScope->parentScope != -1);
+        symbolID = result;
+        return true;
+    }
 
     return false;
 }
@@ -223,23 +259,8 @@ const IDList* ScopeBuilder::TryGetFuncOverloads(string_view ident, int top) cons
     if (top == -1)
         top = topScope;
 
-    const ScopeData* pScope;
-
-    do
-    {
-        pScope = &scopes[top];     
-        auto nameSymbolPair = funcOverloadMaps[top].find(ident);
-
-        if (nameSymbolPair != funcOverloadMaps[top].end())
-        {
-            return &nameSymbolPair->second;
-        }
-
-        top = pScope->parentScope;
-
-    } while (pScope->parentScope != -1);
-
-    return nullptr;
+    const int listID = TryGetScopeValue(scopeOverloadMap, scopes, TryGetIdentID(ident), top);
+    return listID != -1 ? &funcOverloads[listID] : nullptr;
 }
 
 bool ScopeBuilder::GetHasSymbol(string_view name, int top) const
@@ -247,20 +268,7 @@ bool ScopeBuilder::GetHasSymbol(string_view name, int top) const
     if (top == -1)
         top = topScope;
 
-    const ScopeData* pScope;
-
-    do
-    {
-        pScope = &scopes[top];
-
-        if (scopeSymbolMaps[top].contains(name))
-            return true;
-
-        top = pScope->parentScope;
-
-    } while (pScope->parentScope != -1);
-
-    return false;
+    return TryGetScopeValue(scopeSymbolMap, scopes, TryGetIdentID(name), top) != -1;
 }
 
 int ScopeBuilder::GetNewToken(string_view value, TokenTypes flags, const int depth, const int blockID)
@@ -346,8 +354,8 @@ int ScopeBuilder::GetNewUserType(const int tokenID, SymbolTypes flags)
     const int symbolID = GetNewSymbol(tokenID, flags);
     TokenNode& token = tokens[tokenID];
     token.type |= TokenTypes::UserType;
-    token.subtypeID = (int)userTypes.GetLength();
-    ShaderTypeInfo& type = userTypes.EmplaceBack();
+    token.subtypeID = (int)userTypes.size();
+    ShaderTypeInfo& type = userTypes.emplace_back();
     type.name = token.value;
     type.flags = ShaderTypes::UserType;
     type.size = 0;
@@ -407,7 +415,7 @@ void ScopeBuilder::PushSymbol(const int symbolID, const bool isDeferred)
 
         FXSYNTAX_CHECK_MSG(!GetHasSymbol(name), "Unexpected redefinition of symbol '{}'", name);
 
-        scopeSymbolMaps[topScope].emplace(name, symbolID);
+        scopeSymbolMap.emplace(GetScopeKey(topScope, GetOrAddIdentID(name)), symbolID);
         scopeSymbolLists[topScope].EmplaceBack(symbolID);
     }
 
@@ -417,3 +425,166 @@ void ScopeBuilder::PushSymbol(const int symbolID, const bool isDeferred)
         pendingScopeSymbol = symbolID;
     }
 }
+
+/* 
+    Snapshots
+*/
+
+template<typename T>
+static void AddFlattened(const IDynamicArray<UniqueVector<T>>& lists, UniqueVector<uint>& counts, UniqueVector<T>& dst)
+{
+    for (const UniqueVector<T>& list : lists)
+    {
+        counts.Add((uint)list.GetLength());
+        dst.AddRange(list);
+    }
+}
+
+template<typename T>
+static void GetUnflattened(const IDynamicArray<uint>& counts, const IDynamicArray<T>& src, UniqueVector<UniqueVector<T>>& dst)
+{
+    size_t start = 0;
+
+    for (const uint count : counts)
+    {
+        FX_CHECK_MSG(start + count <= src.GetLength(), "Malformed parse snapshot");
+        dst.EmplaceBack().AddRange(src, start, count);
+        start += count;
+    }
+}
+
+void ScopeBuilder::GetSnapshot(string_view src, ParseSnapshot& dst) const
+{
+    dst.scopes.Clear();
+    dst.scopeSymbolCounts.Clear();
+    dst.scopeSymbols.Clear();
+    dst.identNames.Clear();
+    dst.scopeSymbolEntries.Clear();
+    dst.scopeOverloadEntries.Clear();
+    dst.overloadCounts.Clear();
+    dst.overloads.Clear();
+    dst.tokens.Clear();
+    dst.symbols.Clear();
+    dst.types.Clear();
+    dst.userTypes.Clear();
+    dst.functions.Clear();
+    dst.attributes.Clear();
+
+    dst.scopes.AddRange(scopes);
+    AddFlattened(scopeSymbolLists, dst.scopeSymbolCounts, dst.scopeSymbols);
+    AddFlattened(funcOverloads, dst.overloadCounts, dst.overloads);
+
+    dst.identNames.Resize(identIDMap.size());
+
+    for (const auto& [name, identID] : identIDMap)
+        dst.identNames[identID] = dst.GetTextRef(src, name);
+
+    for (const auto& [key, symbolID] : scopeSymbolMap)
+        dst.scopeSymbolEntries.EmplaceBack(key, symbolID);
+
+    for (const auto& [key, listID] : scopeOverloadMap)
+        dst.scopeOverloadEntries.EmplaceBack(key, listID);
+
+    // Sorted, so identical parses write identical snapshots regardless of map iteration order
+    const auto GetIsKeyLess = [](const SnapshotMapEntry& a, const SnapshotMapEntry& b) { return a.key < b.key; };
+    std::sort(dst.scopeSymbolEntries.begin(), dst.scopeSymbolEntries.end(), GetIsKeyLess);
+    std::sort(dst.scopeOverloadEntries.begin(), dst.scopeOverloadEntries.end(), GetIsKeyLess);
+
+    dst.tokens.Reserve(tokens.GetLength());
+
+    for (const TokenNode& token : tokens)
+    {
+        dst.tokens.EmplaceBack(dst.GetTextRef(src, token.value), token.type, token.depth, token.blockStart, 
+            token.blockCount, token.childStart, token.childCount, token.subtypeID, token.symbolID);
+    }
+
+    dst.symbols.AddRange(symbols);
+
+    // Specifiers and aliases of user types point into userTypes
+    std::unordered_map<const ShaderTypeInfo*, int> userTypeIDs;
+
+    for (int i = 0; i < (int)userTypes.size(); i++)
+        userTypeIDs.emplace(&userTypes[i], i);
+
+    for (const ShaderTypeInfo* pType : types)
+    {
+        if (pType == nullptr)
+            dst.types.EmplaceBack(ShaderTypes::Void, SnapshotTypeRef::Null);
+        else if (const auto it = userTypeIDs.find(pType); it != userTypeIDs.end())
+            dst.types.EmplaceBack(pType->flags, it->second);
+        else
+            dst.types.EmplaceBack(pType->flags, SnapshotTypeRef::Intrinsic);
+    }
+
+    for (const ShaderTypeInfo& type : userTypes)
+        dst.userTypes.EmplaceBack(dst.GetTextRef(src, type.name), type.flags, (ulong)type.size);
+
+    for (const FunctionData& func : functions)
+        dst.functions.Add(dst.GetTextRef(src, func.signature));
+
+    dst.attributes.AddRange(attributes);
+    dst.topScope = topScope;
+    dst.pendingScopeSymbol = pendingScopeSymbol;
+}
+
+void ScopeBuilder::SetSnapshot(string_view src, const ParseSnapshot& snapshot)
+{
+    Clear();
+    scopes.Clear();
+    scopeSymbolLists.Clear();
+    symbols.Clear();
+
+    const string_view pool = AddGeneratedText(string_view(snapshot.textPool));
+
+    scopes.AddRange(snapshot.scopes);
+    GetUnflattened(snapshot.scopeSymbolCounts, snapshot.scopeSymbols, scopeSymbolLists);
+    GetUnflattened(snapshot.overloadCounts, snapshot.overloads, funcOverloads);
+
+    identIDMap.reserve(snapshot.identNames.GetLength());
+
+    for (int i = 0; i < (int)snapshot.identNames.GetLength(); i++)
+        identIDMap.emplace(ParseSnapshot::GetText(src, pool, snapshot.identNames[i]), i);
+
+    scopeSymbolMap.reserve(snapshot.scopeSymbolEntries.GetLength());
+    scopeOverloadMap.reserve(snapshot.scopeOverloadEntries.GetLength());
+
+    for (const SnapshotMapEntry& entry : snapshot.scopeSymbolEntries)
+        scopeSymbolMap.emplace(entry.key, entry.value);
+
+    for (const SnapshotMapEntry& entry : snapshot.scopeOverloadEntries)
+        scopeOverloadMap.emplace(entry.key, entry.value);
+
+    tokens.Reserve(snapshot.tokens.GetLength());
+
+    for (const SnapshotToken& token : snapshot.tokens)
+    {
+        tokens.EmplaceBack(ParseSnapshot::GetText(src, pool, token.value), token.type, token.depth, token.blockStart, 
+            token.blockCount, token.childStart, token.childCount, token.subtypeID, token.symbolID);
+    }
+
+    symbols.AddRange(snapshot.symbols);
+
+    // User types are restored first, as types reference them
+    for (const SnapshotUserType& type : snapshot.userTypes)
+        userTypes.emplace_back(ParseSnapshot::GetText(src, pool, type.name), type.flags, (size_t)type.size);
+
+    for (const SnapshotTypeRef& type : snapshot.types)
+    {
+        if (type.userTypeID == SnapshotTypeRef::Null)
+            types.Add(nullptr);
+        else if (type.userTypeID == SnapshotTypeRef::Intrinsic)
+            types.Add(TryGetShaderTypeInfo(type.flags));
+        else
+        {
+            FX_CHECK_MSG(type.userTypeID >= 0 && type.userTypeID < (int)userTypes.size(), "Malformed parse snapshot");
+            types.Add(&userTypes[type.userTypeID]);
+        }
+    }
+
+    for (const SnapshotText& signature : snapshot.functions)
+        functions.EmplaceBack(ParseSnapshot::GetText(src, pool, signature));
+
+    attributes.AddRange(snapshot.attributes);
+    topScope = snapshot.topScope;
+    pendingScopeSymbol = snapshot.pendingScopeSymbol;
+}
@@ -1,4 +1,5 @@
 #include "pch.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ConstNameMap.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/ShaderTypeInfo.hpp"
 
 namespace Weave::Effects
@@ -190,7 +191,7 @@ GetTypeEntry<glm::mat<4,4,double,glm::defaultp>>("double4x4",(ShaderTypes::Matri
 {(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx3),{"min16uint4x3",(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx3),0u}},
 {(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx4),{"min16uint4x4",(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx4),0u}},
 };
-static const std::unordered_map<string_view, ShaderTypes> s_ShaderTypeNameMap
+static constexpr auto s_ShaderTypeNameMap = GetConstNameMap<ShaderTypes>(
 {
 {"void",ShaderTypes::Void},
 {"matrix",ShaderTypes::Matrix},
@@ -368,7 +369,7 @@ static const std::unordered_map<string_view, ShaderTypes> s_ShaderTypeNameMap
 {"min16uint4x2",(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx2)},
 {"min16uint4x3",(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx3)},
 {"min16uint4x4",(ShaderTypes::Matrix|ShaderTypes::Min16UInt|ShaderTypes::Dim4|ShaderTypes::DimAx4)},
-};
+});
 
 const ShaderTypeInfo* TryGetShaderTypeInfo(ShaderTypes flags)
 {
@@ -384,11 +385,11 @@ const ShaderTypeInfo* TryGetShaderTypeInfo(ShaderTypes flags)
 
 bool TryGetShaderType(string_view name, ShaderTypes& type)
 {
-	const auto& pair = s_ShaderTypeNameMap.find(name);
+	const ShaderTypes* pType = s_ShaderTypeNameMap.TryGetValue(name);
 
-	if (pair != s_ShaderTypeNameMap.end())
+	if (pType != nullptr)
 	{
-		type |= pair->second;
+		type |= *pType;
 		return true;
 	}
 	else
@@ -0,0 +1,172 @@
+#include "pch.hpp"
+#include <bit>
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/StructuralIndex.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WV_SCAN_SSE2 1
+#include <emmintrin.h>
+#else
+#define WV_SCAN_SSE2 0
+#endif
+
+namespace Weave::Effects
+{
+    static constexpr size_t s_ChunkSize = 64;
+
+#if WV_SCAN_SSE2
+    static uint GetCharMask(const __m128i chars, const char ch)
+    {
+        return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8(ch)));
+    }
+
+    /// <summary>
+    /// Classifies 16 characters, setting the corresponding bits in each mask
+    /// </summary>
+    static void ClassifyLane(const char* pLane, const uint shift, ulong& breaks, ulong& openAngles, ulong& closeAngles,
+        ulong& newlines, ulong& nonSpaces)
+    {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pLane));
+
+        // The sign bit is set for non-ASCII bytes
+        const uint laneBreaks = (uint)_mm_movemask_epi8(chars) |
+            GetCharMask(chars, '=') | GetCharMask(chars, ',') | GetCharMask(chars, ':') | GetCharMask(chars, ';') |
+            GetCharMask(chars, '{') | GetCharMask(chars, '}') | GetCharMask(chars, '(') | GetCharMask(chars, ')') |
+            GetCharMask(chars, '[') | GetCharMask(chars, ']') | GetCharMask(chars, '#');
+
+        breaks |= (ulong)laneBreaks << shift;
+        openAngles |= (ulong)GetCharMask(chars, '<') << shift;
+        closeAngles |= (ulong)GetCharMask(chars, '>') << shift;
+        newlines |= (ulong)GetCharMask(chars, '\n') << shift;
+        // Signed comparison, matching char on MSVC
+        nonSpaces |= (ulong)_mm_movemask_epi8(_mm_cmpgt_epi8(chars, _mm_set1_epi8(' '))) << shift;
+    }
+#endif
+
+    StructuralIndex::StructuralIndex() :
+        length(0)
+    { }
+
+    void StructuralIndex::Build(string_view text)
+    {
+        const size_t fullChunks = text.length() / s_ChunkSize;
+        const size_t tailLength = text.length() % s_ChunkSize;
+
+        length = text.length();
+        chunks.Clear();
+        chunks.Resize(fullChunks + (tailLength > 0 ? 1 : 0));
+
+        for (size_t i = 0; i < fullChunks; i++)
+            ClassifyChunk(&text[i * s_ChunkSize], chunks[i]);
+
+        // Null padding is not in any class
+        if (tailLength > 0)
+        {
+            alignas(16) char tail[s_ChunkSize] = {};
+            memcpy(tail, &text[fullChunks * s_ChunkSize], tailLength);
+            ClassifyChunk(tail, chunks.GetBack());
+        }
+    }
+
+    size_t StructuralIndex::FindNext(size_t offset, ScanMasks classes) const
+    {
+        if (offset >= length)
+            return length;
+
+        size_t chunkID = offset / s_ChunkSize;
+        ulong bits = GetMask(chunks[chunkID], classes) & (~0ull << (offset % s_ChunkSize));
+
+        while (bits == 0)
+        {
+            if (++chunkID >= chunks.GetLength())
+                return length;
+
+            bits = GetMask(chunks[chunkID], classes);
+        }
+
+        return std::min(chunkID * s_ChunkSize + std::countr_zero(bits), length);
+    }
+
+    uint StructuralIndex::GetCount(size_t start, size_t end, ScanMasks classes) const
+    {
+        end = std::min(end, length);
+
+        if (start >= end)
+            return 0;
+
+        const size_t firstChunk = start / s_ChunkSize;
+        const size_t lastChunk = (end - 1) / s_ChunkSize;
+        const ulong startMask = ~0ull << (start % s_ChunkSize);
+        const ulong endMask = ~0ull >> (s_ChunkSize - 1 - ((end - 1) % s_ChunkSize));
+
+        if (firstChunk == lastChunk)
+            return (uint)std::popcount(GetMask(chunks[firstChunk], classes) & startMask & endMask);
+
+        uint count = (uint)std::popcount(GetMask(chunks[firstChunk], classes) & startMask);
+
+        for (size_t i = firstChunk + 1; i < lastChunk; i++)
+            count += (uint)std::popcount(GetMask(chunks[i], classes));
+
+        count += (uint)std::popcount(GetMask(chunks[lastChunk], classes) & endMask);
+        return count;
+    }
+
+    size_t StructuralIndex::GetLength() const { return length; }
+
+    void StructuralIndex::Clear()
+    {
+        chunks.Clear();
+        length = 0;
+    }
+
+    ulong StructuralIndex::GetMask(const Chunk& chunk, ScanMasks classes)
+    {
+        ulong mask = 0;
+
+        if ((uint)(classes & ScanMasks::Breaks))
+            mask |= chunk.breaks;
+
+        if ((uint)(classes & ScanMasks::OpenAngles))
+            mask |= chunk.openAngles;
+
+        if ((uint)(classes & ScanMasks::CloseAngles))
+            mask |= chunk.closeAngles;
+
+        if ((uint)(classes & ScanMasks::Newlines))
+            mask |= chunk.newlines;
+
+        if ((uint)(classes & ScanMasks::NonSpaces))
+            mask |= chunk.nonSpaces;
+
+        return mask;
+    }
+
+    void StructuralIndex::ClassifyChunk(const char* pChunk, Chunk& dst)
+    {
+        dst = {};
+
+    #if WV_SCAN_SSE2
+        for (uint lane = 0; lane < s_ChunkSize; lane += 16)
+            ClassifyLane(pChunk + lane, lane, dst.breaks, dst.openAngles, dst.closeAngles, dst.newlines, dst.nonSpaces);
+    #else
+        static constexpr string_view s_Breaks = "=,:;{}()[]#";
+
+        for (uint i = 0; i < s_ChunkSize; i++)
+        {
+            const char ch = pChunk[i];
+            const ulong bit = 1ull << i;
+
+            if ((byte)ch > 127 || s_Breaks.find(ch) != string_view::npos)
+                dst.breaks |= bit;
+            else if (ch == '<')
+                dst.openAngles |= bit;
+            else if (ch == '>')
+                dst.closeAngles |= bit;
+            else if (ch == '\n')
+                dst.newlines |= bit;
+
+            if (ch > ' ')
+                dst.nonSpaces |= bit;
+        }
+    #endif
+    }
+}
@@ -1,16 +1,16 @@
 #include "pch.hpp"
 #include <array>
-#include <unordered_map>
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ConstNameMap.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderParser/SymbolEnums.hpp"
 
 namespace Weave::Effects
 {
-    static const std::unordered_map<std::string_view, TokenTypes> s_KeywordToTypeMap
+    static constexpr auto s_KeywordToTypeMap = GetConstNameMap<TokenTypes>(
     {
         { "technique", TokenTypes::TechniqueDecl },
         { "effect", TokenTypes::TechniqueDecl },
         { "pass", TokenTypes::PassDecl },
-        { "cbuffer", TokenTypes::ConstBufDecl, },
+        { "cbuffer", TokenTypes::ConstBufDecl },
 
         { "vertex", TokenTypes::VertexShaderDecl },
         { "hull", TokenTypes::HullShaderDecl },
@@ -31,7 +31,7 @@ namespace Weave::Effects
         { "out", TokenTypes::TypeModifier },
         { "uniform", TokenTypes::TypeModifier },
         { "groupshared", TokenTypes::GroupShared }
-    };
+    });
 
     bool TryGetShaderKeyword(std::string_view name, TokenTypes& type)
     {
@@ -44,18 +44,18 @@ namespace Weave::Effects
             cpyBuf[i] = std::tolower(name[i]);
 
         string_view nameCpy((char*)&cpyBuf, name.length());
-        auto keywordTypePair = s_KeywordToTypeMap.find(nameCpy);
+        const TokenTypes* pKeywordType = s_KeywordToTypeMap.TryGetValue(nameCpy);
 
-        if (keywordTypePair != s_KeywordToTypeMap.end())
+        if (pKeywordType != nullptr)
         {
-            type |= keywordTypePair->second;
+            type |= *pKeywordType;
             return true;
         }
         else
             return false;
     }
 
-    const std::unordered_map<string_view, ShadeStages> s_StageNameMap
+    static constexpr auto s_StageNameMap = GetConstNameMap<ShadeStages>(
     {
         { "vertex", ShadeStages::Vertex },
         { "hull", ShadeStages::Hull },
@@ -66,7 +66,7 @@ namespace Weave::Effects
         { "frag", ShadeStages::Pixel },
         { "compute", ShadeStages::Compute },
         { "kernel", ShadeStages::Compute }
-    };
+    });
 
     bool TryGetShadeStage(string_view name, ShadeStages& stage)
     {
@@ -79,11 +79,11 @@ namespace Weave::Effects
             cpyBuf[i] = std::tolower(name[i]);
 
         string_view nameCpy((char*)&cpyBuf, name.length());
-        auto keywordTypePair = s_StageNameMap.find(nameCpy);
+        const ShadeStages* pStage = s_StageNameMap.TryGetValue(nameCpy);
 
-        if (keywordTypePair != s_StageNameMap.end())
+        if (pStage != nullptr)
         {
-            stage = keywordTypePair->second;
+            stage = *pStage;
             return true;
         }
         else
@@ -6,7 +6,9 @@
 
 namespace Weave::Effects
 {
-    const string g_WordBreakFilter = "=,:;[]";
+    // Words bounded by whitespace and separators
+    constexpr CharFilter g_WordFilter("=,:;[]", '!', '~');
+    constexpr CharFilter g_DigitFilter("", '0', '9');
 
     struct MatchState
     {
@@ -57,8 +59,6 @@ namespace Weave::Effects
         ClearMatchBuffers();
 
         tokenBuf.Clear();
-        textBuf.clear();
-        textBuf.str({});
         
         pAnalyzer = nullptr;
         pSB = nullptr;
@@ -66,24 +66,25 @@ namespace Weave::Effects
 
     void SymbolParser::ParseSource()
     {
+        const LexBlockList& blocks = pAnalyzer->GetBlocks();
+
         for (int i = 0; i < GetBlockCount(); i++)
         {
-            const LexBlock& block = GetBlock(i);
-
-            if (block.GetHasFlags(LexBlockTypes::Directive))
+            if (blocks.GetHasFlags(i, LexBlockTypes::Directive))
                 continue;
 
-            if (block.GetHasFlags(LexBlockTypes::StartScope))
+            if (blocks.GetHasFlags(i, LexBlockTypes::StartScope))
             {
-                pSB->PushScope(i, block.depth);
+                pSB->PushScope(i, blocks.GetDepth(i));
             }
-            else if (block.GetHasFlags(LexBlockTypes::EndScope))
+            else if (blocks.GetHasFlags(i, LexBlockTypes::EndScope))
             {
                 pSB->PopScope(i);
             }
-            else if (!block.GetHasFlags(LexBlockTypes::Container))
+            else if (!blocks.GetHasFlags(i, LexBlockTypes::Container))
             {
-                TokenDef startToken(block.src.GetWord(block.src.GetData(), g_WordBreakFilter));
+                const TextBlock src = blocks.GetSrc(i);
+                TokenDef startToken(src.GetWord(src.GetData(), g_WordFilter));
 
                 if (pSB->TryGetTokenFlags(startToken))
                 {
@@ -94,7 +95,7 @@ namespace Weave::Effects
                         CaptureSymbols();
                         i += length - 1;
 
-                        if (GetBlock(i).GetHasFlags(LexBlockTypes::StartScope))
+                        if (blocks.GetHasFlags(i, LexBlockTypes::StartScope))
                             i--;
                     }
                 }
@@ -104,12 +105,19 @@ namespace Weave::Effects
 
     int SymbolParser::TryMatchPatternType(const int start, const TokenTypes startFlags)
     {
+        const LexBlockTypes startType = pAnalyzer->GetBlocks().GetType(start);
+
         for (const MatchNodeGroup& group : MatchNodeGroup::MatchNodeGroups)
         {
             if (group.GetHasFlags(startFlags))
             {
-                for (const MatchNode& rootPattern : group.rootNodes)
+                for (int rootID = 0; rootID < (int)group.rootNodes.GetLength(); rootID++)
                 {
+                    // Skip roots that cannot begin with this block without backtracking through them
+                    if (!group.rootStartSets[rootID].GetCanStartWith(startType))
+                        continue;
+
+                    const MatchNode& rootPattern = group.rootNodes[rootID];
                     ClearMatchBuffers();
                     int nextMatch = TryMatchPatternNode(rootPattern, start);
 
@@ -268,6 +276,7 @@ namespace Weave::Effects
     {
         FX_ASSERT_MSG(matchPattern.GetLength() > 0, "Empty matching patterns are not allowed");
 
+        const LexBlockList& blocks = pAnalyzer->GetBlocks();
         const bool isAlternation = matchPattern.GetHasFlags(MatchQualifiers::Alternation);
         const int last = (int)matchPattern.GetLength() - 1;
 
@@ -286,7 +295,7 @@ namespace Weave::Effects
 
                 for (int j = matchStart; (j >= 0 && j < GetBlockCount()); j += dir)
                 {
-                    if (GetBlock(j).GetHasFlags(gMatchNext.type))
+                    if (blocks.GetHasFlags(j, gMatchNext.type))
                     {
                         newEnd = j;
                         break;
@@ -304,10 +313,9 @@ namespace Weave::Effects
 
             while ((nextStart != matchEnd))
             {
-                const LexBlock& block = GetBlock(nextStart);
-                const bool canSkip = isWild || (nextStart != matchStart && block.GetHasFlags(LexBlockTypes::Directive));
+                const bool canSkip = isWild || (nextStart != matchStart && blocks.GetHasFlags(nextStart, LexBlockTypes::Directive));
 
-                if (pattern.GetHasFlags(block.type) || canSkip)
+                if (pattern.GetHasFlags(blocks.GetType(nextStart)) || canSkip)
                     nextStart += dir;
                 else
                     break;
@@ -380,7 +388,7 @@ namespace Weave::Effects
 
     int SymbolParser::GetDirectiveEnd(int start, const int dir)
     {
-        while (start > 0 && start < GetBlockCount() && GetBlock(start).GetHasFlags(LexBlockTypes::Directive))
+        while (start > 0 && start < GetBlockCount() && pAnalyzer->GetBlocks().GetHasFlags(start, LexBlockTypes::Directive))
             start += dir;
 
         return start;
@@ -468,7 +476,7 @@ namespace Weave::Effects
     {
         const int tokenStart = (int)tokenBuf.GetLength();
         const IDynamicArray<CapturePattern>& patterns = *cap.pPatterns;
-        const LexBlock& block = GetBlock(cap.blockID);
+        const LexBlock block = GetBlock(cap.blockID);
         const char* pStart = block.src.GetData();
         const char* pLast = nullptr;
 
@@ -485,7 +493,7 @@ namespace Weave::Effects
 
                 do // Predicates
                 {
-                    pLast = block.src.FindWordEnd(pStart, g_WordBreakFilter);
+                    pLast = block.src.FindEnd(pStart, g_WordFilter);
                     TokenDef token(TextBlock(pStart, pLast));
 
                     if (pSB->TryGetTokenFlags(token) && token.GetHasFlags(match.type))
@@ -501,18 +509,18 @@ namespace Weave::Effects
                         FXBLOCK_THROW(*pAnalyzer, cap.blockID, "Unexpected expression: {}", string_view(token.name));
                     }
 
-                    pStart = block.src.FindWord(pLast + 1, g_WordBreakFilter);
+                    pStart = block.src.FindStart(pLast + 1, g_WordFilter);
 
                 } while (isUnbounded && pStart > pLast);
             }
 
             // Identifier
-            ident.name = TextBlock(pStart, block.src.FindWordEnd(pStart, g_WordBreakFilter));
+            ident.name = TextBlock(pStart, block.src.FindEnd(pStart, g_WordFilter));
             pSB->TryGetTokenFlags(ident);
 
             ident.tokenFlags |= pattern.tokenType;
             tokenBuf.EmplaceBack(ident, pattern.symbolType, cap.blockID);
-            pStart = block.src.FindWord(&ident.name.GetBack() + 1, g_WordBreakFilter);
+            pStart = block.src.FindStart(&ident.name.GetBack() + 1, g_WordFilter);
         }
 
         FXBLOCK_CHECK_MSG((tokenBuf.GetLength() - tokenStart) == patterns.GetLength(), *pAnalyzer, cap.blockID, "Expected an identifier");
@@ -523,7 +531,7 @@ namespace Weave::Effects
         if (ident.value.back() >= '0' && ident.value.back() <= '9')
         {
             TextBlock idText = ident.value;
-            idText = idText.GetLastWord(&ident.value.back(), "", '0', '9');
+            idText = idText.GetLastWord(&ident.value.back(), g_DigitFilter);
             ident.value = TextBlock(ident.value.data(), idText.GetData() - 1);
 
             const int len = std::min((int)idText.GetLength(), 9);
@@ -539,9 +547,8 @@ namespace Weave::Effects
 
     int SymbolParser::GetNewToken(const TokenNodeDef& nodeDef)
     {
-        const LexBlock& block = GetBlock(nodeDef.blockStart);
         const int tokenID = pSB->GetNewToken(nodeDef.identifier.name, nodeDef.identifier.tokenFlags,
-            block.depth, nodeDef.blockStart);
+            pAnalyzer->GetBlocks().GetDepth(nodeDef.blockStart), nodeDef.blockStart);
         TokenNode& ident = pSB->GetTokenNode(tokenID);
         ident.blockCount = nodeDef.blockCount;
         ident.childStart = nodeDef.childStart;
@@ -595,9 +602,10 @@ namespace Weave::Effects
     {
         int paramCount = 0;
 
-        textBuf.clear();
-        textBuf.str({});
-        textBuf << ident.value << "(";
+        // Written in place, without intermediate copies
+        TextArena& text = pSB->GetGeneratedText();
+        TextArena::Appender out = text.GetAppender();
+        out = std::format_to(out, "{}(", ident.value);
 
         // Find param symbols and get type data
         for (int paramID = ident.childStart; paramID < (ident.childStart + ident.childCount); paramID++)
@@ -612,10 +620,7 @@ namespace Weave::Effects
                     {
                         const ShaderTypeInfo& subtype = pSB->GetTypeData(paramChild.subtypeID);
 
-                        if (paramCount > 0)
-                            textBuf << ",";
-
-                        textBuf << subtype.name;
+                        out = std::format_to(out, "{}{}", (paramCount > 0) ? "," : "", subtype.name);
                         paramCount++;
                         break;
                     }
@@ -624,15 +629,15 @@ namespace Weave::Effects
         }
 
         if (paramCount == 0)
-            textBuf << "void";
+            out = std::format_to(out, "void");
 
-        textBuf << ")";
+        text.Append(')');
 
         FunctionData& func = pSB->GetFuncData(ident.subtypeID);
-        func.signature = pSB->AddGeneratedText(textBuf.str());
+        func.signature = text.EndText();
     }
 
-    const LexBlock& SymbolParser::GetBlock(ptrdiff_t index) { return pAnalyzer->GetBlocks()[index]; }
+    LexBlock SymbolParser::GetBlock(ptrdiff_t index) { return pAnalyzer->GetBlocks()[index]; }
 
     size_t SymbolParser::GetBlockCount() { return pAnalyzer->GetBlocks().GetLength(); }
 
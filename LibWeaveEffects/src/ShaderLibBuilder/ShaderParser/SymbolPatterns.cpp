@@ -395,13 +395,128 @@ void MatchNode::ReversePattern()
 	}
 }
 
+/// <summary>
+/// Adds the block types that can begin the given block pattern, mirroring 
+/// SymbolParser::TryMatchBlockPattern. Returns true if the pattern can match zero blocks.
+/// </summary>
+static bool TryAddStartTypes(const MatchPattern& pattern, UniqueVector<LexBlockTypes>& types, bool& isAny)
+{
+	const bool isAlternation = pattern.GetHasFlags(MatchQualifiers::Alternation);
+	const int last = (int)pattern.GetLength() - 1;
+
+	for (int i = 0; i <= last; i++)
+	{
+		const BlockQualifier& block = pattern[i];
+		const bool isOptional = block.GetHasFlags(MatchQualifiers::Optional) || (isAlternation && i < last);
+
+		if (block.type == BlockQualifier::Wild)
+		{
+			isAny = true;
+			return true;
+		}
+
+		types.Add(block.type);
+
+		// Alternatives are tried at the same position until one matches
+		if (!isOptional && !isAlternation)
+			return false;
+
+		if (isAlternation && i == last)
+			return isOptional;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Adds the block types that can begin the forward part of the given node, mirroring 
+/// SymbolParser::TryMatchPatternNode. Returns true if the node can match zero forward blocks.
+/// Backward matching subnodes start before the entrypoint, and are treated as empty.
+/// </summary>
+static bool TryAddStartTypes(const MatchNode& node, UniqueVector<LexBlockTypes>& types, bool& isAny)
+{
+	const bool isOptional = node.GetHasFlags(MatchQualifiers::Optional),
+		isAlternation = node.GetHasFlags(MatchQualifiers::Alternation);
+
+	if (!node.GetIsForward())
+		return true;
+
+	if (node.GetHasMatchPatterns())
+	{
+		const IDynamicArray<MatchPattern>& patterns = node.GetMatchPatterns();
+		const int last = (int)patterns.GetLength() - 1;
+
+		for (int i = 0; i <= last; i++)
+		{
+			const bool isPatternOptional = patterns[i].GetHasFlags(MatchQualifiers::Optional) || (isAlternation && i < last);
+
+			if (!TryAddStartTypes(patterns[i], types, isAny) && !isPatternOptional)
+				return isOptional;
+		}
+	}
+
+	if (node.GetHasMatchNodes())
+	{
+		bool isAnyNullable = false;
+
+		for (const MatchNode& subnode : node.GetMatchNodes())
+		{
+			const bool isNullable = TryAddStartTypes(subnode, types, isAny);
+
+			// Alternation succeeds on the first matching subnode, sequences require each in order
+			if (isAlternation)
+				isAnyNullable |= isNullable;
+			else if (!isNullable)
+				return isOptional;
+		}
+
+		if (isAlternation && !isAnyNullable)
+			return isOptional;
+	}
+
+	return true;
+}
+
+MatchStartSet::MatchStartSet() :
+	isAny(true),
+	isNullable(true)
+{ }
+
+MatchStartSet::MatchStartSet(const MatchNode& node) :
+	isAny(false),
+	isNullable(false)
+{
+	UniqueVector<LexBlockTypes> typeBuf;
+	isNullable = TryAddStartTypes(node, typeBuf, isAny);
+	types = DynamicArray<LexBlockTypes>(typeBuf);
+}
+
+bool MatchStartSet::GetCanStartWith(LexBlockTypes blockType) const
+{
+	if (isAny || isNullable)
+		return true;
+
+	// Qualifiers accept blocks with a subset of their flags
+	for (const LexBlockTypes type : types)
+	{
+		if ((type & blockType) == blockType)
+			return true;
+	}
+
+	return false;
+}
+
 MatchNodeGroup::MatchNodeGroup(
 	const std::initializer_list<TokenTypes>& startingTypes, 
 	const std::initializer_list<MatchNode>& patterns
 ) noexcept :
 	symbolTypes(startingTypes),
-	rootNodes(patterns)
-{ }
+	rootNodes(patterns),
+	rootStartSets(rootNodes.GetLength())
+{
+	for (int i = 0; i < (int)rootNodes.GetLength(); i++)
+		rootStartSets[i] = MatchStartSet(rootNodes[i]);
+}
 
 bool MatchNodeGroup::GetHasFlags(TokenTypes flags) const
 {
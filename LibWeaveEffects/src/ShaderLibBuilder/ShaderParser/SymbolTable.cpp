@@ -18,6 +18,14 @@ namespace Weave::Effects
         pParse->GetSymbols(src, *pSB);
     }
 
+    void SymbolTable::GetSnapshot(string_view src, ParseSnapshot& dst) const { pSB->GetSnapshot(src, dst); }
+
+    void SymbolTable::SetSnapshot(string_view src, const ParseSnapshot& snapshot)
+    {
+        pParse->Reset();
+        pSB->SetSnapshot(src, snapshot);
+    }
+
     void SymbolTable::Clear()
     {
         pSB->Clear();
@@ -0,0 +1,74 @@
+#include "pch.hpp"
+#include <bit>
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/TextArena.hpp"
+
+namespace Weave::Effects
+{
+    // Default chunk size, fitting on the order of a hundred function signatures
+    static constexpr size_t s_ChunkSize = 4 * 1024;
+
+    TextArena::TextArena() :
+        chunkID(0),
+        length(0),
+        textStart(0)
+    {
+        chunks.EmplaceBack(unique_ptr<char[]>(new char[s_ChunkSize]), s_ChunkSize);
+    }
+
+    void TextArena::Append(string_view text)
+    {
+        if (text.empty())
+            return;
+
+        if (length + text.length() > chunks[chunkID].capacity)
+            ReserveChunk(text.length());
+
+        memcpy(&chunks[chunkID].pData[length], text.data(), text.length());
+        length += text.length();
+    }
+
+    string_view TextArena::EndText()
+    {
+        const string_view text(&chunks[chunkID].pData[textStart], length - textStart);
+        textStart = length;
+        return text;
+    }
+
+    string_view TextArena::Add(string_view text)
+    {
+        Append(text);
+        return EndText();
+    }
+
+    void TextArena::Clear()
+    {
+        chunkID = 0;
+        length = 0;
+        textStart = 0;
+    }
+
+    void TextArena::ReserveChunk(size_t count)
+    {
+        const size_t pendingLength = length - textStart;
+        const size_t minCapacity = pendingLength + count;
+        size_t nextID = chunkID + 1;
+
+        // Retained chunks too small for the text are skipped until the next Clear()
+        while (nextID < chunks.GetLength() && chunks[nextID].capacity < minCapacity)
+            nextID++;
+
+        if (nextID == chunks.GetLength())
+        {
+            const size_t capacity = std::max(s_ChunkSize, std::bit_ceil(minCapacity));
+            chunks.EmplaceBack(unique_ptr<char[]>(new char[capacity]), capacity);
+        }
+
+        // Pending text must remain contiguous
+        if (pendingLength > 0)
+            memcpy(chunks[nextID].pData.get(), &chunks[chunkID].pData[textStart], pendingLength);
+
+        chunkID = nextID;
+        textStart = 0;
+        length = pendingLength;
+    }
+}
@@ -35,6 +35,11 @@ void ShaderRegistryBuilder::Clear()
 	resCount = 0;
 	uniqueResCount = 0;
 
+	ClearCopyCache();
+}
+
+void ShaderRegistryBuilder::ClearCopyCache()
+{
 	shaderCopyCache.clear();
 	effectCopyCache.clear();
 	pCopySrc = nullptr;
@@ -0,0 +1,261 @@
+#include "pch.hpp"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include "WeaveUtils/Compression.hpp"
+#include "WeaveUtils/Metrics.hpp"
+#include "WeaveEffects/ShaderDataSerialization.hpp"
+#include "WeaveEffects/ShaderDataHandles.hpp"
+#include "WeaveEffects/ShaderLibMap.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompileCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ParseCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryMap.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantCompileService.hpp"
+
+using namespace Weave;
+using namespace Weave::Effects;
+
+VariantCompileService::VariantCompileService(const ShaderLibMap& libMap, unique_ptr<IShaderCompiler>&& compiler, string_view cachePath) :
+	cachePath(cachePath),
+	pCompiler(std::move(compiler)),
+	pCompileCache(new ShaderCompileCache()),
+	pParseCache(new ParseCache()),
+	isCacheChanged(false),
+	isStopping(false)
+{
+	FX_CHECK_MSG(pCompiler.get() != nullptr, "Shader compiler cannot be null");
+	const ShaderLibDef::Handle libDef = libMap.GetDefinition();
+	const IDynamicArray<VariantRepoDef>& repos = *libDef.pRepos;
+
+	platform = *libDef.pPlatform;
+	repoSources = UniqueArray<RepoSource>(repos.GetLength());
+
+	// Only deferred repos need to be regenerated
+	for (uint i = 0; i < (uint)repos.GetLength(); i++)
+	{
+		if (!repos[i].deferredSrc.empty())
+			repoSources[i] = { .path = repos[i].path, .src = repos[i].deferredSrc, .includes = repos[i].deferredIncludes };
+	}
+
+	if (platform.compilerVersion != pCompiler->GetVersion())
+	{
+		WV_LOG_WARN() << "Deferred variants in " << libMap.GetName() << " compiled with " << pCompiler->GetVersion()
+			<< " instead of " << platform.compilerVersion;
+		platform.compilerVersion = pCompiler->GetVersion();
+	}
+
+	ReadCache();
+	worker = std::thread(&VariantCompileService::Run, this);
+}
+
+VariantCompileService::~VariantCompileService()
+{
+	{
+		std::lock_guard lock(queueMutex);
+		isStopping = true;
+	}
+
+	requestAdded.notify_all();
+
+	if (worker.joinable())
+		worker.join();
+
+	WriteCache();
+}
+
+void VariantCompileService::Request(uint vID)
+{
+	{
+		std::lock_guard lock(queueMutex);
+
+		if (pendingIDs.contains(vID) || results.contains(vID))
+			return;
+
+		pendingIDs.emplace(vID);
+		requests.push(vID);
+
+		// The worker no longer accepts requests
+		if (isStopping)
+		{
+			CancelRequests();
+			return;
+		}
+	}
+
+	requestAdded.notify_one();
+}
+
+bool VariantCompileService::GetIsReady(uint vID) const
+{
+	std::lock_guard lock(queueMutex);
+	return results.contains(vID);
+}
+
+VariantCompileService::CompiledVariant VariantCompileService::GetVariant(uint vID)
+{
+	Request(vID);
+
+	std::unique_lock lock(queueMutex);
+	variantCompiled.wait(lock, [&] { return results.contains(vID); });
+
+	VariantResult result = std::move(results.at(vID));
+	results.erase(vID);
+	lock.unlock();
+
+	if (result.error != nullptr)
+		std::rethrow_exception(result.error);
+
+	return std::move(result.def);
+}
+
+void VariantCompileService::Run()
+{
+	std::unique_lock lock(queueMutex);
+
+	while (true)
+	{
+		requestAdded.wait(lock, [this] { return isStopping || !requests.empty(); });
+
+		if (isStopping)
+		{
+			CancelRequests();
+			break;
+		}
+
+		const uint vID = requests.front();
+		requests.pop();
+		lock.unlock();
+
+		VariantResult result;
+
+		try
+		{
+			CompileVariant(vID, result.def);
+		}
+		catch (...)
+		{
+			result.error = std::current_exception();
+		}
+
+		lock.lock();
+		pendingIDs.erase(vID);
+		results.emplace(vID, std::move(result));
+		variantCompiled.notify_all();
+
+		// Persist new shaders while idle
+		if (requests.empty() && isCacheChanged)
+		{
+			lock.unlock();
+			WriteCache();
+			lock.lock();
+		}
+	}
+}
+
+void VariantCompileService::CancelRequests()
+{
+	if (pendingIDs.empty())
+		return;
+
+	const std::exception_ptr error = std::make_exception_ptr(
+		EffectParseException("Variant compile service stopped before the request completed"));
+
+	while (!requests.empty())
+		requests.pop();
+
+	for (const uint vID : pendingIDs)
+		results.emplace(vID, VariantResult{ .error = error });
+
+	pendingIDs.clear();
+	variantCompiled.notify_all();
+}
+
+void VariantCompileService::CompileVariant(uint vID, CompiledVariant& result)
+{
+	const uint repoIndex = vID >> g_VariantGroupOffset;
+	const uint configID = vID & g_VariantMask;
+	FX_CHECK_MSG(repoIndex < repoSources.GetLength() && !repoSources[repoIndex].src.empty(),
+		"Variant {} was not deferred", vID);
+
+	const RepoSource& repo = repoSources[repoIndex];
+	pipeline.Clear();
+	pipeline.SetSrc(repo.path, repo.src, platform.featureLevel, platform.isDebugging, *pCompileCache, *pParseCache, *pCompiler);
+
+	// The original includes may have changed or be absent
+	for (const IncludeTextDef& include : repo.includes)
+		pipeline.AddIncludeText(include.path, include.text);
+
+	// Variant 0 declares flags and modes, and must be preprocessed first
+	pipeline.PreprocessVariant(0);
+
+	if (configID != 0)
+		pipeline.PreprocessVariant(configID);
+
+	pipeline.CompileVariant(configID, repoIndex << g_VariantGroupOffset, result.variant);
+
+	const ShaderRegistryBuilder& registry = pipeline.GetRegistry();
+	result.regDef = registry.GetDefinition().GetCopy();
+	result.strDef = registry.GetStringIDBuilder().GetDefinition().GetCopy();
+
+	if (!pipeline.GetCompiledShaders().IsEmpty())
+	{
+		const ShaderRegistryMap regMap(registry.GetDefinition(), registry.GetStringIDBuilder().GetDefinition());
+
+		for (const VariantPipeline::CompiledShader& shader : pipeline.GetCompiledShaders())
+			pCompileCache->AddShader(shader.key, ShaderDefHandle(regMap, shader.shaderID));
+
+		pCompileCache->UpdateMap();
+		isCacheChanged = true;
+	}
+
+	WV_METRIC_ADD("fx.variants.deferredCompiled", 1);
+	pipeline.Clear();
+}
+
+void VariantCompileService::ReadCache()
+{
+	if (cachePath.empty() || !std::filesystem::is_regular_file(cachePath))
+		return;
+
+	try
+	{
+		std::ifstream file(cachePath, std::ios::binary);
+		std::stringstream streamBuf;
+		streamBuf << file.rdbuf();
+
+		const ShaderCompileCacheDef cacheDef = GetDeserializedCompileCacheDef(streamBuf.view());
+		// Feature level and debugging are part of each shader's compile key
+		PlatformDef cachePlatform = cacheDef.platform;
+		cachePlatform.featureLevel = platform.featureLevel;
+		cachePlatform.isDebugging = platform.isDebugging;
+
+		if (platform == cachePlatform)
+			pCompileCache->SetDefinition(cacheDef.GetHandle());
+		else
+			WV_LOG_INFO() << "Variant compile cache version mismatch: " << cachePath;
+	}
+	catch (const std::exception& err)
+	{
+		// A stale or corrupt cache only costs recompilation
+		WV_LOG_WARN() << "Failed to read variant compile cache " << cachePath << ": " << err.what();
+		pCompileCache->Clear();
+	}
+}
+
+void VariantCompileService::WriteCache()
+{
+	if (cachePath.empty() || !isCacheChanged)
+		return;
+
+	std::stringstream streamBuf;
+	ZLibArchive zipBuffer;
+	const string_view data = GetCompressedSerializedStream(pCompileCache->GetDefinition(platform), zipBuffer, streamBuf);
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+
+	if (file.write(data.data(), data.size()))
+		isCacheChanged = false;
+	else
+		WV_LOG_WARN() << "Failed to write variant compile cache " << cachePath;
+}
@@ -0,0 +1,448 @@
+#include "pch.hpp"
+#include "WeaveUtils/Metrics.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/BlockAnalyzer.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderParser/ParseSnapshot.hpp"
+#include "WeaveEffects/ShaderLibBuilder/SymbolTable.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderGenerator.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompileCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ParseCache.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantPreprocessor.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantPipeline.hpp"
+#include "WeaveEffects/ShaderDataHandles.hpp"
+
+using namespace Weave::Effects;
+
+VariantPipeline::VariantPipeline() :
+	isDebugging(false),
+	pCompileCache(nullptr),
+	pParseCache(nullptr),
+	pCompiler(nullptr),
+	pShaderRegistry(new ShaderRegistryBuilder()),
+	pVariantGen(new VariantPreprocessor()),
+	pAnalyzer(new BlockAnalyzer()),
+	pTable(new SymbolTable()),
+	pShaderGen(new ShaderGenerator()),
+	pSnapshot(new ParseSnapshot()),
+	srcHash({})
+{ }
+
+VariantPipeline::~VariantPipeline() = default;
+
+void VariantPipeline::SetSrc(string_view repoPath, string_view libSrc, string_view featureLevel, bool isDebugging,
+	const ShaderCompileCache& compileCache, const ParseCache& parseCache, const IShaderCompiler& compiler)
+{
+	ClearVariant();
+	libText.clear();
+
+	this->repoPath = repoPath;
+	this->featureLevel = featureLevel;
+	this->isDebugging = isDebugging;
+	pCompileCache = &compileCache;
+	pParseCache = &parseCache;
+	pCompiler = &compiler;
+	pVariantGen->SetSrc(repoPath, libSrc);
+	pAnalyzer->ClearRetainedAnalysis();
+}
+
+void VariantPipeline::SetSrc(const VariantPipeline& other)
+{
+	FX_ASSERT_MSG(other.pVariantGen->GetIsInitialized(), "Source pipeline must process variant 0 first");
+	ClearVariant();
+	libText.clear();
+
+	repoPath = other.repoPath;
+	featureLevel = other.featureLevel;
+	isDebugging = other.isDebugging;
+	pCompileCache = other.pCompileCache;
+	pParseCache = other.pParseCache;
+	pCompiler = other.pCompiler;
+	pVariantGen->SetSrc(*other.pVariantGen);
+	pAnalyzer->SetRetainedAnalysis(*other.pAnalyzer);
+}
+
+void VariantPipeline::AddIncludeText(string_view filePath, string_view text) { pVariantGen->AddIncludeText(filePath, text); }
+
+void VariantPipeline::SetMaxLexThreads(uint maxThreads) { pAnalyzer->SetMaxThreads(maxThreads); }
+
+Hash128 VariantPipeline::PreprocessVariant(const uint configID)
+{
+	ClearVariant();
+	libText.clear();
+	pVariantGen->GetVariant(configID, libText, entrypoints);
+	srcHash = GetHash128(libText);
+
+	return srcHash;
+}
+
+void VariantPipeline::CompileVariant(const uint configID, const uint repoID, VariantDef& variant)
+{
+	const uint vID = repoID | configID;
+	const uint resCount = pShaderRegistry->GetUniqueResCount();
+
+	ParseVariant();
+
+	// Variants are lexed against the base configuration, regardless of which pipeline processed it
+	if (configID == 0)
+		pAnalyzer->RetainAnalysis(repoPath);
+
+	// Shaders
+	GetEntryPoints();
+	variant.shaders = DynamicArray<ShaderVariantDef>(entrypoints.GetLength());
+	GetShaderDefs(variant.shaders, vID);
+
+	// Effects
+	GetEffects();
+	variant.effects = DynamicArray<EffectVariantDef>(effectBlocks.GetLength());
+	GetEffectDefs(variant.effects, vID);
+
+	if (resCount == pShaderRegistry->GetUniqueResCount())
+		WV_LOG_WARN() << "Unused flag/mode combination detected. ID: " << vID << ". Not skipped.";
+
+	WV_METRIC_ADD("fx.variants.processed", 1);
+}
+
+const VariantPreprocessor& VariantPipeline::GetPreprocessor() const { return *pVariantGen; }
+
+const ShaderRegistryBuilder& VariantPipeline::GetRegistry() const { return *pShaderRegistry; }
+
+const IDynamicArray<VariantPipeline::CompiledShader>& VariantPipeline::GetCompiledShaders() const { return compiledShaders; }
+
+void VariantPipeline::Clear()
+{
+	ClearVariant();
+	libText.clear();
+
+	repoPath = string_view();
+	pVariantGen->Clear();
+	pAnalyzer->ClearRetainedAnalysis();
+	pShaderRegistry->Clear();
+	keyShaderMap.clear();
+	compiledShaders.Clear();
+}
+
+void VariantPipeline::ClearVariant()
+{
+	pTable->Clear();
+	pAnalyzer->Clear();
+	pShaderGen->Clear();
+
+	entrypoints.Clear();
+	epNameShaderIDMap.clear();
+
+	effectBlocks.Clear();
+	effectPasses.Clear();
+	effectShaders.Clear();
+
+	hlslBuf.clear();
+}
+
+void VariantPipeline::ParseVariant()
+{
+	if (pParseCache->TryGetSnapshot(srcHash, *pSnapshot))
+	{
+		try
+		{
+			pAnalyzer->SetSnapshot(repoPath, libText, *pSnapshot);
+			pTable->SetSnapshot(libText, *pSnapshot);
+			return;
+		}
+		catch (const EffectParseException& err)
+		{
+			WV_LOG_WARN() << "Discarded malformed parse snapshot: " << err.what();
+			pTable->Clear();
+			pAnalyzer->Clear();
+		}
+	}
+
+	pAnalyzer->AnalyzeSource(repoPath, libText);
+	pTable->ParseBlocks(*pAnalyzer);
+
+	if (pParseCache->GetIsEnabled())
+	{
+		pSnapshot->Clear();
+		pAnalyzer->GetSnapshot(*pSnapshot);
+		pTable->GetSnapshot(libText, *pSnapshot);
+		pParseCache->AddSnapshot(srcHash, *pSnapshot);
+	}
+}
+
+/* 
+	Metadata Analysis 
+*/
+
+void VariantPipeline::GetEntryPoints()
+{
+	// Attribute tags
+	for (int i = 0; i < pTable->GetSymbolCount(); i++)
+	{
+		SymbolHandle symbol = pTable->GetSymbol(i);
+
+		if (symbol.GetHasFlags(SymbolTypes::FuncDefinition))
+		{
+			TokenNodeHandle funcIdent = symbol.GetIdent();
+
+			for (int j = 0; j < funcIdent.GetChildCount(); j++)
+			{
+				if (funcIdent[j].GetHasFlags(TokenTypes::AttribShaderDecl))
+				{
+					string_view name = funcIdent.GetValue();
+					const uint nameID = pShaderRegistry->GetOrAddStringID(name);
+
+					if (!epNameShaderIDMap.contains(nameID))
+					{
+						ShaderEntrypoint& ep = entrypoints.EmplaceBack();
+						epNameShaderIDMap.emplace(nameID, -1);
+						ep.name = name;
+						ep.stage = GetStageFromFlags(funcIdent[j].GetFlags());
+						ep.symbolID = i;
+					}
+
+					break;
+				}
+			}
+		}
+	}
+
+	// Pragma shaders
+	for (int i = 0; i < entrypoints.GetLength(); i++)
+	{
+		ShaderEntrypoint& ep = entrypoints[i];
+		ScopeHandle global = pTable->GetScope(0);
+		const IDList* pFuncs = global.TryGetFuncOverloads(ep.name);
+		
+		if (pFuncs != nullptr && !pFuncs->IsEmpty())
+		{
+			const uint nameID = pShaderRegistry->GetOrAddStringID(ep.name);
+
+			if (!epNameShaderIDMap.contains(nameID))
+			{
+				epNameShaderIDMap.emplace(nameID, -1);
+				ep.symbolID = pFuncs->GetBack();
+			}
+		}
+		else
+			FXBLOCK_THROW(*pAnalyzer, global.GetBlockStart(), 
+				"Definition for shader '{}' declared in pragma not found", ep.name);
+	}
+	
+	// Shader blocks
+	for (int i = 0; i < pTable->GetSymbolCount(); i++)
+	{
+		SymbolHandle symbol = pTable->GetSymbol(i);
+
+		if (symbol.GetHasFlags(SymbolTypes::ShaderDef))
+		{
+			ScopeHandle scope = *symbol.GetScope();
+			string_view name = symbol.GetName();
+			const IDList* pFuncs = scope.TryGetFuncOverloads(name);
+
+			if (pFuncs != nullptr && !pFuncs->IsEmpty())
+			{
+				const uint nameID = pShaderRegistry->GetOrAddStringID(name);
+
+				if (!epNameShaderIDMap.contains(nameID))
+				{
+					ShaderEntrypoint& ep = entrypoints.EmplaceBack();
+					epNameShaderIDMap.emplace(nameID, -1);
+					ep.name = name;
+					ep.stage = GetStageFromFlags(symbol.GetFlags());
+					ep.symbolID = pFuncs->GetBack();
+				}
+			}
+			else
+				FXBLOCK_THROW(*pAnalyzer, symbol.GetIdent().GetBlockStart(),
+					"Could not find entrypoint for shader block '{}'", name);
+		}
+	}
+}
+
+void VariantPipeline::GetEffects()
+{
+	for (int i = 0; i < pTable->GetSymbolCount(); i++)
+	{
+		SymbolHandle symbol = pTable->GetSymbol(i);
+
+		if (symbol.GetIsScope() && symbol.GetHasFlags(SymbolTypes::TechniqueDef))
+		{
+			ScopeHandle effectScope = *symbol.GetScope();
+			EffectBlock& effect = effectBlocks.EmplaceBack();
+			effect.nameID = pShaderRegistry->GetOrAddStringID(symbol.GetName());
+			effect.passStart = 0;
+			effect.passStart = (uint)effectPasses.GetLength();
+			effect.passCount = 0; 
+			bool isPassDefaulted = false;
+
+			for (int j = 0; j < effectScope.GetChildCount(); j++)
+			{
+				SymbolHandle effectChild = effectScope[j];
+
+				if (!isPassDefaulted && effectChild.GetHasFlags(SymbolTypes::TechniqueShaderDecl))
+					isPassDefaulted = true;
+
+				if (effectChild.GetHasFlags(SymbolTypes::TechniquePassDecl))
+				{
+					FXBLOCK_CHECK_MSG(!isPassDefaulted, *pAnalyzer, symbol.GetIdent().GetBlockStart(),
+						"Illegal use of defaulted and explicit passes in the same effect '{}'", symbol.GetName());
+						
+					effect.passCount++;
+				}
+			}
+
+			if (isPassDefaulted)
+			{
+				AddPass(effectScope, "DefaultedPass");
+				effect.passCount = 1;
+			}
+			else
+			{
+				for (int j = 0; j < effectScope.GetChildCount(); j++)
+				{
+					SymbolHandle effectChild = effectScope[j];
+
+					if (effectChild.GetHasFlags(SymbolTypes::TechniquePassDecl))
+					{
+						ScopeHandle passScope = *effectChild.GetScope();
+						AddPass(passScope, effectChild.GetName());
+					}
+				}
+			}
+		}
+	}
+}
+
+void VariantPipeline::AddPass(const ScopeHandle& passScope, string_view name)
+{
+	PassBlock& pass = effectPasses.EmplaceBack();
+	pass.nameID = pShaderRegistry->GetOrAddStringID(name);
+	pass.shaderStart = (uint)effectShaders.GetLength();
+
+	for (int j = 0; j < passScope.GetChildCount(); j++)
+	{
+		SymbolHandle effectChild = passScope[j];
+
+		if (effectChild.GetHasFlags(SymbolTypes::TechniqueShaderDecl))
+		{
+			string_view shaderName = effectChild.GetName();
+			const uint stringID = pShaderRegistry->GetOrAddStringID(shaderName);
+			const auto& it = epNameShaderIDMap.find(stringID);
+
+			FXBLOCK_CHECK_MSG(it != epNameShaderIDMap.end(), *pAnalyzer, effectChild.GetIdent().GetBlockStart(),
+				"Unrecognised shader name '{}' declared in effect pass", shaderName);
+
+			const uint shaderID = it->second;
+			effectShaders.EmplaceBack(shaderID);
+		}
+	}
+
+	pass.shaderCount = (uint)effectShaders.GetLength() - pass.shaderStart;
+}
+
+void VariantPipeline::GetShaderDefs(DynamicArray<ShaderVariantDef>& variants, uint vID)
+{
+	for (int i = 0; i < entrypoints.GetLength(); i++)
+	{
+		hlslBuf.clear();
+
+		const ShaderEntrypoint& ep = entrypoints[i];
+		pShaderGen->GetShaderSource(*pTable, pAnalyzer->GetBlocks(), ep, entrypoints, hlslBuf);
+
+		const uint shaderID = GetOrCompileShader(ep);
+		const uint nameID = pShaderRegistry->GetShader(shaderID).nameID;
+
+		variants[i].shaderID = shaderID;
+		variants[i].variantID = vID;
+		// Update name -> shader ID key
+		epNameShaderIDMap[nameID] = shaderID;
+	}
+}
+
+uint VariantPipeline::GetOrCompileShader(const ShaderEntrypoint& ep)
+{
+	const Hash128 key = ShaderCompileCache::GetKey(repoPath, hlslBuf, featureLevel, ep.stage, ep.name, isDebugging);
+
+	if (const auto it = keyShaderMap.find(key); it != keyShaderMap.end())
+	{
+		WV_METRIC_ADD("fx.shaders.compileCacheHits", 1);
+		return it->second;
+	}
+
+	uint shaderID = pCompileCache->TryGetShader(key);
+
+	if (shaderID != -1)
+	{
+		shaderID = pShaderRegistry->GetOrAddShader(ShaderDefHandle(pCompileCache->GetMap(), shaderID));
+
+		// Cached shaders may have been compiled from another file with identical output
+		const uint fileID = pShaderRegistry->GetOrAddStringID(repoPath);
+
+		if (pShaderRegistry->GetShader(shaderID).fileStringID != fileID)
+		{
+			ShaderDef def = pShaderRegistry->GetShader(shaderID);
+			def.fileStringID = fileID;
+			shaderID = pShaderRegistry->GetOrAddShader(def);
+		}
+
+		WV_METRIC_ADD("fx.shaders.compileCacheHits", 1);
+	}
+	else
+	{
+		const ShaderCompileArgs args
+		{
+			.srcFile = repoPath,
+			.srcText = hlslBuf,
+			.featureLevel = featureLevel,
+			.stage = ep.stage,
+			.mainName = ep.name,
+			.isDebugging = isDebugging,
+			.pTable = pTable.get(),
+			.mainSymbolID = ep.symbolID
+		};
+
+		shaderID = pCompiler->GetShaderDef(args, *pShaderRegistry);
+		compiledShaders.Add({ .key = key, .shaderID = shaderID });
+		WV_METRIC_ADD("fx.shaders.compileCacheMisses", 1);
+	}
+
+	keyShaderMap.emplace(key, shaderID);
+	return shaderID;
+}
+
+void VariantPipeline::GetEffectDefs(DynamicArray<EffectVariantDef>& effects, uint vID)
+{
+	// Effects
+	for (uint i = 0; i < (uint)effectBlocks.GetLength(); i++)
+	{
+		const EffectBlock& block = effectBlocks[i];
+		EffectDef effect;
+		effect.nameID = block.nameID;
+		Vector<uint> passBuf = pShaderRegistry->GetTmpIDBuffer();
+
+		// Passes
+		for (uint j = 0; j < block.passCount; j++)
+		{
+			PassBlock& pass = effectPasses[block.passStart + j];
+			Vector<uint> idBuf = pShaderRegistry->GetTmpIDBuffer();
+
+			// Shaders
+			for (uint k = 0; k < pass.shaderCount; k++)
+			{
+				const uint shaderIndex = pass.shaderStart + k;
+				idBuf.EmplaceBack(effectShaders[shaderIndex]);
+			}
+
+			passBuf.EmplaceBack(pShaderRegistry->GetOrAddIDGroup(idBuf));
+			pShaderRegistry->ReturnTmpIDBuffer(std::move(idBuf));
+		}
+
+		effect.passGroupID = pShaderRegistry->GetOrAddIDGroup(passBuf);
+		pShaderRegistry->ReturnTmpIDBuffer(std::move(passBuf));
+
+		effects[i] = EffectVariantDef 
+		{
+			.effectID = pShaderRegistry->GetOrAddEffect(effect),
+			.variantID = vID
+		};
+	}
+}
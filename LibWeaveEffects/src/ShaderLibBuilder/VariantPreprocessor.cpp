@@ -1,4 +1,6 @@
 #include "pch.hpp"
+#include <fstream>
+#include <sstream>
 #include "WeaveEffects/ShaderLibBuilder/VariantPreprocessor.hpp"
 
 namespace Weave::Effects
@@ -18,11 +20,28 @@ namespace Weave::Effects
 		return spanBuf.EmplaceBack(textBuf, bufStart, subLen);
 	}
 
+	/// <summary>
+	/// Returns the key an embedded include is stored under. Paths are compared lexically, as they
+	/// may not exist on this machine.
+	/// </summary>
+	static string GetEmbeddedPath(boost::filesystem::path path)
+	{
+		path.make_preferred();
+		return path.lexically_normal().string();
+	}
+
 	VariantPreprocessor::VariantPreprocessor() : 
 		isInitialized(false), 
-		pEntrypoints(nullptr)
+		pEntrypoints(nullptr),
+		hasEmbeddedIncludes(false),
+		lastVariantLength(0),
+		referencedFlags(0),
+		isModeReferenced(false),
+		pTokenCache(new WaveTokenCache())
 	{ }
 
+	VariantPreprocessor::~VariantPreprocessor() = default;
+
 	void VariantPreprocessor::SetSrc(string_view filePath, string_view src)
 	{
 		Clear();
@@ -30,6 +49,38 @@ namespace Weave::Effects
 		this->filePath = filePath;
 	}
 
+	void VariantPreprocessor::SetSrc(const VariantPreprocessor& other)
+	{
+		SetSrc(other.filePath, other.src);
+
+		for (const StringSpan& macro : other.macroStarts)
+			AddMacro(string_view(macro));
+
+		for (const StringSpan& sysInclude : other.sysIncludeStarts)
+			AddSystemIncludePath(string_view(sysInclude));
+
+		for (const StringSpan& include : other.includeStarts)
+			AddIncludePath(string_view(include));
+
+		for (const StringSpan& flag : other.variantFlags)
+			AddVariantFlag(string_view(flag));
+
+		// Default mode is added by Clear()
+		for (uint i = 1; i < (uint)other.variantModes.GetLength(); i++)
+			AddVariantMode(string_view(other.variantModes[i]));
+
+		if (other.hasEmbeddedIncludes)
+		{
+			fileTextMap = other.fileTextMap;
+			hasEmbeddedIncludes = true;
+		}
+
+		isInitialized = other.isInitialized;
+
+		if (isInitialized)
+			InitDefineIndexMap();
+	}
+
 	bool VariantPreprocessor::GetIsInitialized() const { return isInitialized; }
 
 	void VariantPreprocessor::AddMacro(std::string_view macro) { AddStringSpan(macro, macroStarts, textBuf); }
@@ -38,6 +89,24 @@ namespace Weave::Effects
 
 	void VariantPreprocessor::AddIncludePath(std::string_view path) { AddStringSpan(path, includeStarts, textBuf); }
 
+	void VariantPreprocessor::AddIncludeText(string_view includePath, string_view text)
+	{
+		FX_ASSERT_MSG(!filePath.empty(), "Source must be set before embedding includes");
+		namespace fs = boost::filesystem;
+		fs::path path{ string(includePath) };
+
+		// Resolved as Wave resolves the source's directory, so keys match the paths it requests
+		if (!path.has_root_directory())
+			path = boost::wave::util::complete_path(fs::path(string(filePath))).parent_path() / path;
+
+		// Tokens are cached by text address, which may change on reassignment
+		fileTextMap.insert_or_assign(GetEmbeddedPath(path), string(text));
+		hasEmbeddedIncludes = true;
+		pTokenCache->Clear();
+	}
+
+	bool VariantPreprocessor::GetHasEmbeddedIncludes() const { return hasEmbeddedIncludes; }
+
 	void VariantPreprocessor::Clear()
 	{
 		src = std::string_view();
@@ -54,6 +123,14 @@ namespace Weave::Effects
 		includeStarts.Clear();
 	
 		pEntrypoints = nullptr;
+		dependencies.Clear();
+		fileTextMap.clear();
+		hasEmbeddedIncludes = false;
+		pTokenCache->Clear();
+		lastVariantLength = 0;
+		defineIndexMap.clear();
+		referencedFlags = 0;
+		isModeReferenced = false;
 
 		AddVariantMode("__DEFAULT_SHADER_MODE__");
 	}
@@ -63,7 +140,12 @@ namespace Weave::Effects
 	void VariantPreprocessor::GetVariant(const uint configID, string& dst, Vector<ShaderEntrypoint>& entrypoints)
 	{
 		FX_ASSERT_MSG(configID != -1 && configID < std::max<uint>(1u, GetVariantCount()), "Invalid variant ID");
+		// Files are lexed once per source, and replayed for each variant after the first
+		const WaveTokenCache::Scope tokenScope(*pTokenCache);
 		pEntrypoints = &entrypoints;
+		dependencies.Clear();
+		referencedFlags = 0;
+		isModeReferenced = false;
 
 		// Initialize context to source
 		WaveStringView str(src.data(), src.length());
@@ -98,6 +180,10 @@ namespace Weave::Effects
 		if (enumID > 0)
 			ctx.add_macro_definition(variantModes[enumID]);
 
+		// Variants of the same source are usually close in length
+		dst.reserve(dst.length() + lastVariantLength);
+		const size_t dstStart = dst.length();
+
 		// Process directives
 		WaveTokenIterator it = ctx.begin();
 		WaveTokenIterator last = ctx.end();
@@ -111,7 +197,11 @@ namespace Weave::Effects
 
 				WaveLexToken& token = *it;
 				const WaveString& value = token.get_value();
-				std::copy(value.begin(), value.end(), std::back_inserter(dst));
+				dst.append(value.c_str(), value.size());
+
+				// Undefined flags remain in the output
+				if (token == boost::wave::T_IDENTIFIER)
+					AddReference(string_view(value.c_str(), value.size()));
 			}
 			catch (const WaveException& err)
 			{
@@ -124,8 +214,17 @@ namespace Weave::Effects
 			++it;
 		}
 
-		isInitialized = true;
+		// Defines are finalized by variant 0, and the references preceding them are unknown
+		if (!isInitialized)
+		{
+			isInitialized = true;
+			referencedFlags = GetFlagVariantCount() - 1;
+			isModeReferenced = true;
+			InitDefineIndexMap();
+		}
+
 		pEntrypoints = nullptr;
+		lastVariantLength = dst.length() - dstStart;
 	}
 
 	uint VariantPreprocessor::GetFlagVariantCount() const { return 1u << (variantFlags.GetLength()); }
@@ -171,6 +270,72 @@ namespace Weave::Effects
 		pEntrypoints->EmplaceBack(string(shaderName), stage);
 	}
 
+	void VariantPreprocessor::AddDependency(string_view filePath) { dependencies.EmplaceBack(filePath); }
+
+	const IDynamicArray<string>& VariantPreprocessor::GetDependencies() const { return dependencies; }
+
+	void VariantPreprocessor::AddReference(string_view identifier)
+	{
+		const auto it = defineIndexMap.find(identifier);
+
+		if (it == defineIndexMap.end())
+			return;
+
+		if (it->second < g_VariantFlagLimit)
+			referencedFlags |= 1u << it->second;
+		else
+			isModeReferenced = true;
+	}
+
+	uint VariantPreprocessor::GetReferencedFlags() const { return referencedFlags; }
+
+	bool VariantPreprocessor::GetIsModeReferenced() const { return isModeReferenced; }
+
+	void VariantPreprocessor::InitDefineIndexMap()
+	{
+		defineIndexMap.clear();
+
+		for (uint i = 0; i < (uint)variantFlags.GetLength(); i++)
+			defineIndexMap.emplace(variantFlags[i].c_str(), i);
+
+		for (const StringSpan& mode : variantModes)
+			defineIndexMap.emplace(mode.c_str(), g_VariantFlagLimit);
+	}
+
+	bool VariantPreprocessor::TryGetFileText(string_view filePath, string_view& text)
+	{
+		auto it = fileTextMap.find(string(filePath));
+
+		if (it == fileTextMap.end())
+		{
+			if (hasEmbeddedIncludes)
+				return false;
+
+			std::ifstream stream(string(filePath), std::ios::binary);
+
+			if (!stream)
+				return false;
+
+			std::stringstream streamBuf;
+			streamBuf << stream.rdbuf();
+			it = fileTextMap.emplace(filePath, std::move(streamBuf).str()).first;
+		}
+
+		text = it->second;
+		return true;
+	}
+
+	bool VariantPreprocessor::TryGetCachedFileText(string_view filePath, string_view& text) const
+	{
+		const auto it = fileTextMap.find(string(filePath));
+
+		if (it == fileTextMap.end())
+			return false;
+
+		text = it->second;
+		return true;
+	}
+
 	const IDynamicArray<StringSpan>& VariantPreprocessor::GetVariantFlags() const { return variantFlags; }
 
 	const IDynamicArray<StringSpan>& VariantPreprocessor::GetVariantModes() const { return variantModes; }
@@ -238,4 +403,259 @@ namespace Weave::Effects
 		else
 			return false;
 	}
-}
\ No newline at end of file
+
+	void WaveContextPolicy::AddReference(WaveLexToken const& token)
+	{
+		if (pMain != nullptr && token == boost::wave::T_IDENTIFIER)
+		{
+			const WaveString& value = token.get_value();
+			pMain->AddReference(string_view(value.c_str(), value.size()));
+		}
+	}
+
+	bool WaveContextPolicy::TryGetFileText(std::string_view filePath, std::string_view& text)
+	{
+		return pMain != nullptr && pMain->TryGetFileText(filePath, text);
+	}
+
+	bool WaveContextPolicy::GetHasEmbeddedIncludes() const { return pMain != nullptr && pMain->GetHasEmbeddedIncludes(); }
+
+	bool WaveContextPolicy::TryLocateEmbeddedFile(const boost::filesystem::path& currentDir, std::string& filePath) const
+	{
+		boost::filesystem::path path(filePath);
+
+		if (!path.has_root_directory())
+			path = currentDir / path;
+
+		string_view text;
+		string normPath = GetEmbeddedPath(path);
+
+		if (!pMain->TryGetCachedFileText(normPath, text))
+			return false;
+
+		filePath = std::move(normPath);
+		return true;
+	}
+
+	template<>
+	void WaveContextPolicy::opened_include_file(
+		WaveContext const& ctx,
+		std::string const& relname,
+		std::string const& absname,
+		bool is_system_include)
+	{
+		if (pMain != nullptr)
+			pMain->AddDependency(absname);
+	}
+
+	/// <summary>
+	/// Cache used by lexers created on this thread
+	/// </summary>
+	static thread_local WaveTokenCache* s_pActiveTokenCache = nullptr;
+
+	/// <summary>
+	/// Tokens lexed from a single file, with the options they were lexed with
+	/// </summary>
+	struct WaveTokenCache::FileTokens
+	{
+		std::vector<WaveLexToken> tokens;
+		size_t length = 0;
+		WaveLexToken::string_type fileName;
+		WaveLangSupport language = WaveLangSupport();
+		std::string guardName;
+		bool hasIncludeGuards = false;
+		// Set once the file was lexed to its end
+		bool isComplete = false;
+		// Set while a lexer is recording the file
+		bool isRecording = false;
+		// Set if the file repositions the lexer with #line, which shifts the tokens recorded after it
+		bool isUncacheable = false;
+	};
+
+	/// <summary>
+	/// Replays the tokens of a completely lexed file
+	/// </summary>
+	class WaveTokenCache::TokenReplay : public WaveLexInterface
+	{
+	public:
+		TokenReplay(const FileTokens& file) :
+			file(file),
+			next(0),
+			isRepositioned(false),
+			lineOffset(0)
+		{ }
+
+		WaveLexToken& get(WaveLexToken& token) override
+		{
+			if (next >= file.tokens.size())
+				return token = WaveLexToken();
+
+			token = file.tokens[next++];
+
+			// Copied on write, leaving the cached token unchanged
+			if (isRepositioned)
+			{
+				position_type pos = token.get_position();
+				pos.set_file(fileName);
+				pos.set_line((size_t)((ptrdiff_t)pos.get_line() + lineOffset));
+				token.set_position(pos);
+			}
+
+			return token;
+		}
+
+		void set_position(position_type const& pos) override
+		{
+			// The lexer resumes counting lines from the given position at its next token
+			const size_t nextLine = (next < file.tokens.size()) ? file.tokens[next].get_position().get_line() : pos.get_line();
+			isRepositioned = true;
+			fileName = pos.get_file();
+			lineOffset = (ptrdiff_t)pos.get_line() - (ptrdiff_t)nextLine;
+		}
+
+		bool has_include_guards(std::string& guardName) const override
+		{
+			guardName = file.guardName;
+			return file.hasIncludeGuards;
+		}
+
+	private:
+		const FileTokens& file;
+		size_t next;
+		bool isRepositioned;
+		WaveLexToken::string_type fileName;
+		ptrdiff_t lineOffset;
+	};
+
+	/// <summary>
+	/// Forwards tokens from the Wave lexer, and records them for replay once the file is lexed to 
+	/// its end. Incomplete recordings are discarded.
+	/// </summary>
+	class WaveTokenCache::TokenRecorder : public WaveLexInterface
+	{
+	public:
+		MAKE_IMMOVABLE(TokenRecorder)
+
+		TokenRecorder(FileTokens& file, WaveLexInterface* pLexer) :
+			pFile(&file),
+			pLexer(pLexer)
+		{ 
+			file.tokens.clear();
+			file.isRecording = true;
+		}
+
+		~TokenRecorder() override
+		{
+			StopRecording();
+			delete pLexer;
+		}
+
+		WaveLexToken& get(WaveLexToken& token) override
+		{
+			try
+			{
+				pLexer->get(token);
+			}
+			catch (...)
+			{
+				StopRecording();
+				throw;
+			}
+
+			if (pFile != nullptr)
+			{
+				if (token.is_eoi())
+				{
+					pFile->hasIncludeGuards = pLexer->has_include_guards(pFile->guardName);
+					pFile->isComplete = true;
+					pFile->isRecording = false;
+					pFile = nullptr;
+				}
+				else
+					pFile->tokens.push_back(token);
+			}
+
+			return token;
+		}
+
+		void set_position(position_type const& pos) override
+		{
+			if (pFile != nullptr)
+			{
+				pFile->isUncacheable = true;
+				StopRecording();
+			}
+
+			pLexer->set_position(pos);
+		}
+
+		bool has_include_guards(std::string& guardName) const override
+		{
+			return pLexer->has_include_guards(guardName);
+		}
+
+	private:
+		FileTokens* pFile;
+		WaveLexInterface* pLexer;
+
+		void StopRecording()
+		{
+			if (pFile != nullptr)
+			{
+				pFile->tokens.clear();
+				pFile->isRecording = false;
+				pFile = nullptr;
+			}
+		}
+	};
+
+	WaveTokenCache::Scope::Scope(WaveTokenCache& cache) :
+		pLast(s_pActiveTokenCache)
+	{
+		s_pActiveTokenCache = &cache;
+	}
+
+	WaveTokenCache::Scope::~Scope() { s_pActiveTokenCache = pLast; }
+
+	WaveTokenCache::WaveTokenCache() = default;
+
+	WaveTokenCache::~WaveTokenCache() = default;
+
+	WaveLexInterface* WaveTokenCache::GetLexer(const char* pFirst, const char* pLast, 
+		WaveLexToken::position_type const& pos, WaveLangSupport language)
+	{
+		using WaveLexGenerator = boost::wave::cpplexer::lex_input_interface_generator<WaveLexToken>;
+		std::unique_ptr<FileTokens>& pFile = fileMap[pFirst];
+
+		if (pFile == nullptr)
+			pFile.reset(new FileTokens());
+
+		FileTokens& file = *pFile;
+
+		// Files included again while recording, such as by themselves, are lexed normally
+		if (file.isRecording)
+			return WaveLexGenerator::new_lexer(pFirst, pLast, pos, language);
+
+		// Recorded again if the address was reused, or lexed with other options
+		if (file.length != (size_t)(pLast - pFirst) || file.language != language || file.fileName != pos.get_file())
+		{
+			file.tokens.clear();
+			file.length = (size_t)(pLast - pFirst);
+			file.language = language;
+			file.fileName = pos.get_file();
+			file.isComplete = false;
+			file.isUncacheable = false;
+		}
+
+		if (file.isComplete)
+			return new TokenReplay(file);
+		else if (file.isUncacheable)
+			return WaveLexGenerator::new_lexer(pFirst, pLast, pos, language);
+		else
+			return new TokenRecorder(file, WaveLexGenerator::new_lexer(pFirst, pLast, pos, language));
+	}
+
+	void WaveTokenCache::Clear() { fileMap.clear(); }
+
+	WaveTokenCache* WaveTokenCache::GetActive() { return s_pActiveTokenCache; }
+}
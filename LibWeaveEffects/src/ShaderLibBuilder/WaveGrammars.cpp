@@ -0,0 +1,13 @@
+#include "pch.hpp"
+#include <boost/wave/grammars/cpp_grammar.hpp>
+#include <boost/wave/grammars/cpp_predef_macros_grammar.hpp>
+#include <boost/wave/grammars/cpp_defined_grammar.hpp>
+
+/*
+	Boost.Wave only instantiates its grammars for its own lexer iterator. They're instantiated 
+	here for WaveLexIterator, as done by the Wave library. The expression grammar depends only on
+	the token type, and is taken from the library.
+*/
+template struct boost::wave::grammars::cpp_grammar_gen<Weave::Effects::WaveLexIterator, Weave::Effects::WaveLexTokenSeq>;
+template struct boost::wave::grammars::predefined_macros_grammar_gen<Weave::Effects::WaveLexIterator>;
+template struct boost::wave::grammars::defined_grammar_gen<Weave::Effects::WaveLexIterator>;
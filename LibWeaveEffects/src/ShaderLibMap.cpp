@@ -1,6 +1,8 @@
 #include "pch.hpp"
 #include "WeaveEffects/ShaderLibMap.hpp"
+#include "WeaveUtils/StringIDBuilder.hpp"
 #include "WeaveEffects/ShaderLibBuilder/ShaderRegistryMap.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderRegistryBuilder.hpp"
 
 /* Variant ID generation
 
@@ -27,6 +29,12 @@
 	Vid(Ri, Cid) = (Ri << 16) | (Cid & 0xFFFF)
 	Ri(Vid) = Vid >> 16
 	Cid(Vid) = Vid & 0xFFFF
+
+ Deferred Variants:
+
+	Variants compiled at runtime are added with their own registry, and their shader and effect IDs
+	are offset to follow those of previously added variants. Bit 23 is set in the index of deferred
+	IDs to distinguish them from IDs in the library's registry.
 */
 
 using namespace Weave;
@@ -38,7 +46,27 @@ static uint GetRepoIndex(uint vID) { return vID >> g_VariantGroupOffset; }
 
 static uint GetConfigIndex(uint vID) { return (vID & g_VariantMask); }
 
-ShaderLibMap::ShaderLibMap() = default;
+// Set in the index of shader and effect IDs belonging to deferred variants
+static constexpr uint s_DeferredIDFlag = 1u << 23u;
+
+static bool GetIsDeferredID(uint id) { return (ShaderRegistryBuilder::GetIndex(id) & s_DeferredIDFlag) != 0; }
+
+static bool GetHasDeferredVariants(const IDynamicArray<VariantRepoDef>& repos)
+{
+	for (const VariantRepoDef& repo : repos)
+	{
+		if (!repo.deferredSrc.empty())
+			return true;
+	}
+
+	return false;
+}
+
+ShaderLibMap::ShaderLibMap() :
+	pStringIDs(nullptr),
+	deferredShaderCount(0),
+	deferredEffectCount(0)
+{ }
 
 ShaderLibMap::~ShaderLibMap() = default;
 
@@ -46,13 +74,20 @@ string_view ShaderLibMap::GetName() const { return name; }
 
 const IStringIDMap& ShaderLibMap::GetStringMap() const { return pRegMap->GetStringMap(); }
 
+// Deferred variants require a mutable string map to merge new strings into
 ShaderLibMap::ShaderLibMap(const ShaderLibDef::Handle& def) :
 	name(*def.pName),
 	platform(*def.pPlatform),
 	variantShaderMaps(def.pRepos->GetLength()),
 	repoConfigTables(def.pRepos->GetLength()),
 	variantRepos(*def.pRepos),
-	pRegMap(new ShaderRegistryMap(def.regHandle, def.strMapHandle))
+	pOwnedStringIDs(GetHasDeferredVariants(*def.pRepos) ? new StringIDBuilder() : nullptr),
+	pStringIDs(pOwnedStringIDs.get()),
+	pRegMap((pStringIDs != nullptr) ? 
+		new ShaderRegistryMap(def.regHandle, def.strMapHandle, *pStringIDs) :
+		new ShaderRegistryMap(def.regHandle, def.strMapHandle)),
+	deferredShaderCount(0),
+	deferredEffectCount(0)
 {
 	InitMaps();
 }
@@ -62,8 +97,14 @@ ShaderLibMap::ShaderLibMap(ShaderLibDef&& def) :
 	platform(std::move(def.platform)),
 	variantShaderMaps(def.repos.GetLength()),
 	repoConfigTables(def.repos.GetLength()),
-	variantRepos(std::move(def.repos)),
-	pRegMap(new ShaderRegistryMap(std::move(def.regData), std::move(def.stringIDs)))
+	pOwnedStringIDs(GetHasDeferredVariants(def.repos) ? new StringIDBuilder() : nullptr),
+	pStringIDs(pOwnedStringIDs.get()),
+	pRegMap((pStringIDs != nullptr) ?
+		new ShaderRegistryMap(std::move(def.regData), def.stringIDs.GetHandle(), *pStringIDs) :
+		new ShaderRegistryMap(std::move(def.regData), std::move(def.stringIDs))),
+	deferredShaderCount(0),
+	deferredEffectCount(0),
+	variantRepos(std::move(def.repos))
 {
 	InitMaps();
 }
@@ -74,7 +115,10 @@ ShaderLibMap::ShaderLibMap(const ShaderLibDef::Handle& def, StringIDBuilder& sha
 	variantShaderMaps(def.pRepos->GetLength()),
 	repoConfigTables(def.pRepos->GetLength()),
 	variantRepos(*def.pRepos),
-	pRegMap(new ShaderRegistryMap(def.regHandle, def.strMapHandle, sharedStringIDs))
+	pStringIDs(GetHasDeferredVariants(*def.pRepos) ? &sharedStringIDs : nullptr),
+	pRegMap(new ShaderRegistryMap(def.regHandle, def.strMapHandle, sharedStringIDs)),
+	deferredShaderCount(0),
+	deferredEffectCount(0)
 {
 	InitMaps();
 }
@@ -84,8 +128,11 @@ ShaderLibMap::ShaderLibMap(ShaderLibDef&& def, StringIDBuilder& sharedStringIDs)
 	platform(std::move(def.platform)),
 	variantShaderMaps(def.repos.GetLength()),
 	repoConfigTables(def.repos.GetLength()),
-	variantRepos(std::move(def.repos)),
-	pRegMap(new ShaderRegistryMap(std::move(def.regData), def.stringIDs.GetHandle(), sharedStringIDs))
+	pStringIDs(GetHasDeferredVariants(def.repos) ? &sharedStringIDs : nullptr),
+	pRegMap(new ShaderRegistryMap(std::move(def.regData), def.stringIDs.GetHandle(), sharedStringIDs)),
+	deferredShaderCount(0),
+	deferredEffectCount(0),
+	variantRepos(std::move(def.repos))
 {
 	InitMaps();
 }
@@ -127,6 +174,7 @@ void ShaderLibMap::InitMaps()
 		{
 			const VariantDef& variant = repoDef.variants[configID];
 			variantMap[configID] = VariantNameMap();
+			variantMap[configID].isDeferred = GetIsVariantDeferred(repoDef, configID);
 
 			// Shaders
 			for (const ShaderVariantDef& pair : variant.shaders)
@@ -150,15 +198,117 @@ void ShaderLibMap::InitMaps()
 ShaderDefHandle ShaderLibMap::GetShader(uint shaderID) const
 {
 	FX_CHECK_MSG(shaderID != g_InvalidID32, "Shader ID invalid");
+
+	if (GetIsDeferredID(shaderID))
+	{
+		uint localID;
+		const DeferredRegistry& reg = GetDeferredRegistry(shaderID, localID);
+		return ShaderDefHandle(*reg.pRegMap, localID);
+	}
+
 	return ShaderDefHandle(*pRegMap, shaderID);
 }
 
 EffectDefHandle ShaderLibMap::GetEffect(uint effectID) const
 {
 	FX_CHECK_MSG(effectID != g_InvalidID32, "Effect ID invalid");
+
+	if (GetIsDeferredID(effectID))
+	{
+		uint localID;
+		const DeferredRegistry& reg = GetDeferredRegistry(effectID, localID);
+		return EffectDefHandle(*reg.pRegMap, localID);
+	}
+
 	return EffectDefHandle(*pRegMap, effectID);
 }
 
+uint ShaderLibMap::GetEffectShaderID(uint effectID, uint shaderID) const
+{
+	FX_CHECK_MSG(effectID != g_InvalidID32 && shaderID != g_InvalidID32, "Effect shader ID invalid");
+
+	if (GetIsDeferredID(effectID))
+	{
+		uint localID;
+		const DeferredRegistry& reg = GetDeferredRegistry(effectID, localID);
+		const uint index = ShaderRegistryBuilder::GetIndex(shaderID) + reg.shaderStart;
+		return ShaderRegistryBuilder::SetResourceType(index | s_DeferredIDFlag, ResourceType::Shader);
+	}
+
+	return shaderID;
+}
+
+const ShaderLibMap::DeferredRegistry& ShaderLibMap::GetDeferredRegistry(uint id, uint& localID) const
+{
+	const ResourceType type = ShaderRegistryBuilder::GetResourceType(id);
+	const uint index = ShaderRegistryBuilder::GetIndex(id) & ~s_DeferredIDFlag;
+	const auto GetStart = [type](const DeferredRegistry& reg) 
+	{ 
+		return (type == ResourceType::Shader) ? reg.shaderStart : reg.effectStart; 
+	};
+
+	// Find the last registry starting at or before the index
+	const DeferredRegistry* pFirst = deferredRegs.GetData();
+	const DeferredRegistry* pLast = pFirst + deferredRegs.GetLength();
+	const DeferredRegistry* pReg = std::upper_bound(pFirst, pLast, index, 
+		[&](uint i, const DeferredRegistry& reg) { return i < GetStart(reg); });
+
+	FX_CHECK_MSG(pReg != pFirst, "Deferred resource ID invalid");
+	pReg--;
+
+	localID = ShaderRegistryBuilder::SetResourceType(index - GetStart(*pReg), type);
+	return *pReg;
+}
+
+bool ShaderLibMap::GetHasDeferredVariants() const { return pStringIDs != nullptr; }
+
+bool ShaderLibMap::GetIsDeferred(uint vID) const
+{
+	FX_CHECK_MSG(vID != g_InvalidID32, "Variant ID invalid");
+	const uint repoIndex = GetRepoIndex(vID);
+	const uint cfgIndex = GetConfigIndex(vID);
+	FX_CHECK_MSG(repoIndex < variantShaderMaps.GetLength() && cfgIndex < variantShaderMaps[repoIndex].GetLength(),
+		"Variant ID invalid");
+
+	return variantShaderMaps[repoIndex][cfgIndex].isDeferred;
+}
+
+void ShaderLibMap::AddDeferredVariant(uint vID, ShaderRegistryDef&& regDef, const StringIDMapDef::Handle& strDef,
+	const VariantDef& variant)
+{
+	FX_CHECK_MSG(GetIsDeferred(vID), "Variant {} is not awaiting compilation", vID);
+	const uint shaderCount = (uint)regDef.shaders.GetLength();
+	const uint effectCount = (uint)regDef.effects.GetLength();
+	FX_CHECK_MSG(deferredShaderCount + shaderCount < s_DeferredIDFlag && deferredEffectCount + effectCount < s_DeferredIDFlag,
+		"Deferred variant limit exceeded");
+
+	DeferredRegistry& reg = deferredRegs.EmplaceBack();
+	reg.pRegMap.reset(new ShaderRegistryMap(std::move(regDef), strDef, *pStringIDs));
+	reg.shaderStart = deferredShaderCount;
+	reg.effectStart = deferredEffectCount;
+	deferredShaderCount += shaderCount;
+	deferredEffectCount += effectCount;
+
+	// Name IDs were aliased to the library's strings by the registry map
+	VariantNameMap& nameMap = variantShaderMaps[GetRepoIndex(vID)][GetConfigIndex(vID)];
+
+	for (const ShaderVariantDef& pair : variant.shaders)
+	{
+		const ShaderDef& shader = reg.pRegMap->GetShader(pair.shaderID);
+		const uint index = ShaderRegistryBuilder::GetIndex(pair.shaderID) + reg.shaderStart;
+		nameMap.shaders[shader.nameID] = ShaderRegistryBuilder::SetResourceType(index | s_DeferredIDFlag, ResourceType::Shader);
+	}
+
+	for (const EffectVariantDef& pair : variant.effects)
+	{
+		const EffectDef& effect = reg.pRegMap->GetEffect(pair.effectID);
+		const uint index = ShaderRegistryBuilder::GetIndex(pair.effectID) + reg.effectStart;
+		nameMap.effects[effect.nameID] = ShaderRegistryBuilder::SetResourceType(index | s_DeferredIDFlag, ResourceType::Effect);
+	}
+
+	nameMap.isDeferred = false;
+}
+
 uint ShaderLibMap::TryGetDefaultShaderVariant(uint nameID) const
 {
 	FX_CHECK_MSG(nameID != g_InvalidID32, "Name ID invalid");
@@ -287,18 +437,19 @@ uint ShaderLibMap::ResetMode(uint vID) const
 	return PackVariantID(repoID, configID);
 }
 
+// Counted from lookup tables to include deferred variants added at runtime
 uint ShaderLibMap::GetShaderCount(uint vID) const 
 {
 	const uint repoIndex = GetRepoIndex(vID);
 	const uint configIndex = GetConfigIndex(vID);
-	return (uint)variantRepos[repoIndex].variants[configIndex].shaders.GetLength();
+	return (uint)variantShaderMaps[repoIndex][configIndex].shaders.size();
 }
 
 uint ShaderLibMap::GetEffectCount(uint vID) const 
 {
 	const uint repoIndex = GetRepoIndex(vID);
 	const uint configIndex = GetConfigIndex(vID);
-	return (uint)variantRepos[repoIndex].variants[configIndex].effects.GetLength();
+	return (uint)variantShaderMaps[repoIndex][configIndex].effects.size();
 }
 
 ShaderLibDef::Handle ShaderLibMap::GetDefinition() const
@@ -191,6 +191,18 @@ namespace Weave::D3D11
 		/// </summary>
 		void SetIsDepthStencilEnabled(bool value);
 
+		/// <summary>
+		/// Returns the directory used to cache deferred shader variants. Empty if disabled.
+		/// </summary>
+		string_view GetVariantCacheDir() const;
+
+		/// <summary>
+		/// Sets the directory used to cache deferred shader variants compiled at runtime. Libraries
+		/// registered afterward compile their deferred variants on first use, if built with
+		/// WV_DEFERRED_VARIANTS_ENABLED. Empty by default, disabling deferred variants.
+		/// </summary>
+		void SetVariantCacheDir(string_view dir);
+
 		/// <summary>
 		/// Creates a shader library by copying the given definition and registers it with the renderer
 		/// </summary>
@@ -276,6 +288,7 @@ namespace Weave::D3D11
 
 		std::unordered_map<string_view, uint> shaderLibNameMap;
 		Vector<ShaderLibrary> shaderLibs;
+		string variantCacheDir;
 
 		std::atomic<double> targetFPS;
 		std::atomic<bool> useDefaultDS;
@@ -1,8 +1,25 @@
 #pragma once
+#include <memory>
 #include "WeaveEffects/ShaderLibMap.hpp"
 #include "Shaders/ShaderVariants.hpp"
 #include "Shaders/EffectVariant.hpp"
 
+// --- Compile-Time Configuration ---
+
+#ifndef WV_DEFERRED_VARIANTS_ENABLED
+//
+/// Set to 1 to compile deferred shader variants on first use. Disabled by default, as it links
+/// the effect preprocessor and compiler along with their dependencies (Boost.Wave, cereal and
+/// d3dcompiler). When disabled, deferred variants are unavailable.
+//
+#define WV_DEFERRED_VARIANTS_ENABLED 0
+#endif // !WV_DEFERRED_VARIANTS_ENABLED
+
+namespace Weave::Effects
+{
+	class VariantCompileService;
+}
+
 namespace Weave::D3D11
 {
 	using Effects::ShaderLibDef;
@@ -10,6 +27,12 @@ namespace Weave::D3D11
 	using Effects::ShadeStages;
 	using Effects::EffectDef;
 
+	/// <summary>
+	/// Instantiates shaders and effects from a library on demand. Deferred variants are compiled by
+	/// a background service, but retrieving one that hasn't finished blocks the calling thread,
+	/// usually the render thread, for a full preprocess, parse and compile of the variant. Prefetch
+	/// variants well ahead of use to avoid stalls.
+	/// </summary>
 	class ShaderVariantManager
 	{
 	public:
@@ -17,15 +40,40 @@ namespace Weave::D3D11
 
 		ShaderVariantManager();
 
-		ShaderVariantManager(Device& device, const ShaderLibDef::Handle& def);
+		/// <summary>
+		/// Creates a manager for the given library. If deferred variants are enabled and the library
+		/// has any, they are compiled on first use, and cached in the file at the given path. An empty
+		/// path disables deferred variants.
+		/// </summary>
+		ShaderVariantManager(Device& device, const ShaderLibDef::Handle& def, string_view variantCachePath = "");
 
-		ShaderVariantManager(Device& device, ShaderLibDef&& def);
+		ShaderVariantManager(Device& device, ShaderLibDef&& def, string_view variantCachePath = "");
+
+		~ShaderVariantManager();
 
 		/// <summary>
 		/// Retrieves interface for querying string IDs used in library resources
 		/// </summary>
 		const IStringIDMap& GetStringMap() const;
 
+		/// <summary>
+		/// Returns the shaderID with the given name and variant, -1 on fail. Deferred variants are
+		/// compiled on first use, blocking until finished unless prefetched.
+		/// </summary>
+		uint TryGetShaderID(uint nameID, uint vID);
+
+		/// <summary>
+		/// Returns the effectID with the given name and variant, -1 on fail. Deferred variants are
+		/// compiled on first use, blocking until finished unless prefetched.
+		/// </summary>
+		uint TryGetEffectID(uint nameID, uint vID);
+
+		/// <summary>
+		/// Starts compiling the given variant in the background if it was deferred and has not been
+		/// compiled, without waiting for it to finish
+		/// </summary>
+		void PrefetchVariant(uint vID);
+
 		/// <summary>
 		/// Tries to retrieve the given shader as a vertex shader
 		/// </summary>
@@ -73,5 +121,20 @@ namespace Weave::D3D11
 
 		ShaderLibMap libMap;
 		Device* pDev;
+#if WV_DEFERRED_VARIANTS_ENABLED
+		// Compiles deferred variants, if the library has any
+		std::unique_ptr<Effects::VariantCompileService> pCompileService;
+#endif
+
+		/// <summary>
+		/// Initializes the compile service for libraries with deferred variants
+		/// </summary>
+		void InitCompileService(string_view cachePath);
+
+		/// <summary>
+		/// Compiles and adds the given variant to the library if it was deferred. Waits for the
+		/// compile service if the variant is still pending, and logs the time spent waiting.
+		/// </summary>
+		void ResolveVariant(uint vID);
 	};
 }
\ No newline at end of file
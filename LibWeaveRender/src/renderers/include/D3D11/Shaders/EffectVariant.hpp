@@ -19,7 +19,7 @@ namespace Weave::D3D11
 
 		EffectVariant(
 			ShaderVariantManager& lib,
-			EffectDefHandle effectDef
+			uint effectID
 		);
 
 		/// <summary>
@@ -6,6 +6,7 @@
 #include "D3D11/Resources/Sampler.hpp"
 #include "D3D11/Resources/ConstantBuffer.hpp"
 #include "D3D11/Shaders/ShaderVariantBase.hpp"
+#include "WeaveUtils/Metrics.hpp"
 
 using namespace Weave::D3D11;
 
@@ -179,7 +180,10 @@ bool ContextState::TryUpdateTopology(PrimTopology topology)
 		return true;
 	}
 	else
+	{
+		WV_METRIC_ADD("d3d11.state.updatesSkipped", 1);
 		return false;
+	}
 }
 
 uint ContextState::TryUpdateVertexBuffers(IDynamicArray<VertexBuffer>& vertBuffers, sint startSlot)
@@ -244,7 +248,10 @@ bool ContextState::TryUpdateIndexBuffer(ID3D11Buffer* pIndexBuffer)
 		return true;
 	}
 	else
+	{
+		WV_METRIC_ADD("d3d11.state.updatesSkipped", 1);
 		return false;
+	}
 }
 
 bool ContextState::TryUpdateInputLayout(ID3D11InputLayout* pLayout)
@@ -255,7 +262,10 @@ bool ContextState::TryUpdateInputLayout(ID3D11InputLayout* pLayout)
 		return true;
 	}
 	else
+	{
+		WV_METRIC_ADD("d3d11.state.updatesSkipped", 1);
 		return false;
+	}
 }
 
 const Span<ID3D11SamplerState*> ContextState::StageState::GetSamplers(sint offset, uint extent) const
@@ -295,7 +305,10 @@ bool ContextState::TrySetShader(ShadeStages stage, const ShaderVariantBase* pSha
 		return true;
 	}
 	else
+	{
+		WV_METRIC_ADD("d3d11.state.updatesSkipped", 1);
 		return false;
+	}
 }
 
 template<typename ViewT, typename ResT>
@@ -432,7 +445,10 @@ bool ContextState::TryUpdateDepthStencil(IDepthStencil* pDepthStencil)
 	{
 		if (this->pDSV == *pDepthStencil && this->pDSS == pDepthStencil->GetState()
 			&& depthStencilRange == pDepthStencil->GetRange())
-		{ return false; }
+		{
+			WV_METRIC_ADD("d3d11.state.updatesSkipped", 1);
+			return false;
+		}
 
 		// Update and track usage
 		UpdateUsageMap<RWResourceUsages::DepthStencilView>(ShadeStages::Pixel, Span(&this->pDSResource), Span(&pDepthStencil));
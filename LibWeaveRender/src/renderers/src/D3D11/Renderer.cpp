@@ -216,6 +216,10 @@ bool Renderer::GetIsDepthStencilEnabled() const { return useDefaultDS; }
 
 void Renderer::SetIsDepthStencilEnabled(bool value) { useDefaultDS = value; }
 
+string_view Renderer::GetVariantCacheDir() const { return variantCacheDir; }
+
+void Renderer::SetVariantCacheDir(string_view dir) { variantCacheDir = dir; }
+
 /*
 	Default resources used for internal functions and generalized samplers
 */
@@ -9,16 +9,29 @@
 
 using namespace Weave::D3D11;
 
+/// <summary>
+/// Returns the path of the deferred variant cache for the given library, or an empty string if
+/// deferred variants are disabled
+/// </summary>
+static string GetVariantCachePath(const Renderer& renderer, string_view libName)
+{
+	if (renderer.GetVariantCacheDir().empty())
+		return string();
+
+	const std::filesystem::path path = std::filesystem::path(renderer.GetVariantCacheDir()) / std::format("{}.variants.ccache", libName);
+	return path.string();
+}
+
 DEF_DEST_MOVE(ShaderLibrary);
 
 ShaderLibrary::ShaderLibrary() = default;
 
 ShaderLibrary::ShaderLibrary(Renderer& renderer, const ShaderLibDef::Handle& def) :
-	pManager(new ShaderVariantManager(renderer.GetDevice(), def))
+	pManager(new ShaderVariantManager(renderer.GetDevice(), def, GetVariantCachePath(renderer, *def.pName)))
 { }
 
 ShaderLibrary::ShaderLibrary(Renderer& renderer, ShaderLibDef&& def) :
-	pManager(new ShaderVariantManager(renderer.GetDevice(), std::move(def)))
+	pManager(new ShaderVariantManager(renderer.GetDevice(), std::move(def), GetVariantCachePath(renderer, def.name)))
 { }
 
 string_view ShaderLibrary::GetName() const { return pManager->GetLibMap().GetName(); }
@@ -1,23 +1,97 @@
 #include "pch.hpp"
 #include "D3D11/InternalD3D11.hpp"
 #include "D3D11/ShaderVariantManager.hpp"
+#include "WeaveUtils/Metrics.hpp"
+
+#if WV_DEFERRED_VARIANTS_ENABLED
+#include "WeaveUtils/Stopwatch.hpp"
+#include "WeaveEffects/ShaderLibBuilder/ShaderCompiler.hpp"
+#include "WeaveEffects/ShaderLibBuilder/VariantCompileService.hpp"
+#endif
 
 using namespace Weave;
 using namespace Weave::D3D11;
+using Effects::VariantCompileService;
 
 ShaderVariantManager::ShaderVariantManager() :
 	pDev(nullptr)
 { }
 
-ShaderVariantManager::ShaderVariantManager(Device& device, const ShaderLibDef::Handle& def) :
+ShaderVariantManager::ShaderVariantManager(Device& device, const ShaderLibDef::Handle& def, string_view variantCachePath) :
 	pDev(&device),
 	libMap(def)
-{ }
+{ 
+	InitCompileService(variantCachePath);
+}
 
-ShaderVariantManager::ShaderVariantManager(Device& device, ShaderLibDef&& def) :
+ShaderVariantManager::ShaderVariantManager(Device& device, ShaderLibDef&& def, string_view variantCachePath) :
 	pDev(&device),
 	libMap(std::move(def))
-{ }
+{ 
+	InitCompileService(variantCachePath);
+}
+
+ShaderVariantManager::~ShaderVariantManager() = default;
+
+#if WV_DEFERRED_VARIANTS_ENABLED
+void ShaderVariantManager::InitCompileService(string_view cachePath)
+{
+	if (!cachePath.empty() && libMap.GetHasDeferredVariants())
+	{
+		pCompileService.reset(new VariantCompileService(
+			libMap, 
+			std::make_unique<Effects::ShaderCompilerD3D11>(), 
+			cachePath
+		));
+	}
+}
+
+void ShaderVariantManager::PrefetchVariant(uint vID)
+{
+	if (pCompileService.get() != nullptr && libMap.GetIsDeferred(vID))
+		pCompileService->Request(vID);
+}
+
+void ShaderVariantManager::ResolveVariant(uint vID)
+{
+	if (pCompileService.get() != nullptr && libMap.GetIsDeferred(vID))
+	{
+		const bool isStalled = !pCompileService->GetIsReady(vID);
+		Stopwatch timer;
+		timer.Start();
+
+		VariantCompileService::CompiledVariant variant = pCompileService->GetVariant(vID);
+
+		if (isStalled)
+		{
+			timer.Stop();
+			WV_LOG_INFO() << "Waited " << timer.GetElapsedMS() << " ms for deferred variant " << vID << " to compile";
+			WV_METRIC_ADD("d3d11.deferredVariants.stalls", 1);
+		}
+
+		libMap.AddDeferredVariant(vID, std::move(variant.regDef), variant.strDef.GetHandle(), variant.variant);
+		WV_METRIC_ADD("d3d11.deferredVariants.added", 1);
+	}
+}
+#else
+void ShaderVariantManager::InitCompileService(string_view cachePath) { }
+
+void ShaderVariantManager::PrefetchVariant(uint vID) { }
+
+void ShaderVariantManager::ResolveVariant(uint vID) { }
+#endif
+
+uint ShaderVariantManager::TryGetShaderID(uint nameID, uint vID)
+{
+	ResolveVariant(vID);
+	return libMap.TryGetShaderID(nameID, vID);
+}
+
+uint ShaderVariantManager::TryGetEffectID(uint nameID, uint vID)
+{
+	ResolveVariant(vID);
+	return libMap.TryGetEffectID(nameID, vID);
+}
 
 const IStringIDMap& ShaderVariantManager::GetStringMap() const { return libMap.GetStringMap(); }
 
@@ -36,6 +110,7 @@ bool ShaderVariantManager::TryGetShader(uint shaderID, const VertexShaderVariant
 
 		if (def.GetStage() == ShadeStages::Vertex)
 		{
+			WV_METRIC_ADD("d3d11.shaderVariants.created", 1);
 			vertexShaders.emplace(shaderID, VertexShaderVariant(*pDev, def));
 			pVS = &vertexShaders[shaderID];
 			return true;
@@ -60,6 +135,7 @@ bool ShaderVariantManager::TryGetShader(uint shaderID, const PixelShaderVariant*
 
 		if (def.GetStage() == ShadeStages::Pixel)
 		{
+			WV_METRIC_ADD("d3d11.shaderVariants.created", 1);
 			pixelShaders.emplace(shaderID, PixelShaderVariant(*pDev, def));
 			pPS = &pixelShaders[shaderID];
 			return true;
@@ -84,6 +160,7 @@ bool ShaderVariantManager::TryGetShader(uint shaderID, const ComputeShaderVarian
 
 		if (def.GetStage() == ShadeStages::Compute)
 		{
+			WV_METRIC_ADD("d3d11.shaderVariants.created", 1);
 			computeShaders.emplace(shaderID, ComputeShaderVariant(*pDev, def));
 			pCS = &computeShaders[shaderID];
 			return true;
@@ -102,8 +179,8 @@ const EffectVariant& ShaderVariantManager::GetEffect(uint effectID)
 		return it->second;
 	else
 	{
-		const EffectDefHandle& def = libMap.GetEffect(effectID);
-		effects.emplace(effectID, EffectVariant(*this, def));
+		WV_METRIC_ADD("d3d11.effectVariants.created", 1);
+		effects.emplace(effectID, EffectVariant(*this, effectID));
 		return effects[effectID];
 	}
 }
@@ -30,7 +30,7 @@ void ComputeInstance::SetKernel(uint nameID)
 	this->nameID = nameID;
 	vID = pLib->GetLibMap().TryGetDefaultShaderVariant(nameID);
 
-	const uint shaderID = pLib->GetLibMap().TryGetShaderID(nameID, vID);
+	const uint shaderID = pLib->TryGetShaderID(nameID, vID);
 	pCS = &pLib->GetShader<ComputeShaderVariant>(shaderID);
 }
 
@@ -79,7 +79,7 @@ const ComputeShaderVariant& ComputeInstance::GetShader() const
 
 	if (pCS == nullptr)
 	{
-		const uint shaderID = pLib->GetLibMap().TryGetShaderID(nameID, vID);
+		const uint shaderID = pLib->TryGetShaderID(nameID, vID);
 		pCS = &pLib->GetShader<ComputeShaderVariant>(shaderID);
 	}
 
@@ -89,10 +89,11 @@ const ComputeShaderVariant& ComputeInstance::GetShader() const
 void ComputeInstance::SetVariantID(uint vID)
 {
 	D3D_ASSERT_MSG(vID != uint(-1), "Cannot set invalid variant");
+	pLib->PrefetchVariant(vID);
 
 	if (pCS != nullptr && vID != this->vID)
 	{ 
-		const uint shaderID = pLib->GetLibMap().TryGetShaderID(nameID, vID);
+		const uint shaderID = pLib->TryGetShaderID(nameID, vID);
 		pCS = &pLib->GetShader<ComputeShaderVariant>(shaderID);
 		this->vID = vID;
 	}
@@ -9,9 +9,9 @@ using namespace Weave::D3D11;
 
 EffectVariant::EffectVariant() = default;
 
-EffectVariant::EffectVariant(ShaderVariantManager& lib, EffectDefHandle effectDef) :
-	def(effectDef),
-	passes(effectDef.GetPassCount())
+EffectVariant::EffectVariant(ShaderVariantManager& lib, uint effectID) :
+	def(lib.GetLibMap().GetEffect(effectID)),
+	passes(def.GetPassCount())
 { 
 	for (uint passDef = 0; passDef < def.GetPassCount(); passDef++)
 	{
@@ -21,8 +21,9 @@ EffectVariant::EffectVariant(ShaderVariantManager& lib, EffectDefHandle effectDe
 
 		for (uint shader = 0; shader < pass.GetLength(); shader++)
 		{
-			const ShaderDefHandle shaderDef = effectDef.GetShader(passDef, shader);
-			const uint shaderID = pass[shader];
+			const ShaderDefHandle shaderDef = def.GetShader(passDef, shader);
+			// Pass IDs of deferred effects are local to their variant's registry
+			const uint shaderID = lib.GetLibMap().GetEffectShaderID(effectID, pass[shader]);
 			const ShadeStages stage = shaderDef.GetStage();
 
 			switch (shaderDef.GetStage())
@@ -31,7 +31,7 @@ const EffectVariant& Material::GetEffect() const
 
 	if (pEffect == nullptr)
 	{
-		const uint effectID = pLib->GetLibMap().TryGetEffectID(nameID, vID);
+		const uint effectID = pLib->TryGetEffectID(nameID, vID);
 		pEffect = &pLib->GetEffect(effectID);
 	}
 
@@ -41,10 +41,11 @@ const EffectVariant& Material::GetEffect() const
 void Material::SetVariantID(uint vID)
 {
 	D3D_ASSERT_MSG(vID != uint(-1), "Cannot set invalid variant");
+	pLib->PrefetchVariant(vID);
 
 	if (pEffect != nullptr && vID != this->vID)
 	{ 
-		const uint effectID = pLib->GetLibMap().TryGetEffectID(nameID, vID);
+		const uint effectID = pLib->TryGetEffectID(nameID, vID);
 		pEffect = &pLib->GetEffect(effectID);
 		this->vID = vID;
 	}
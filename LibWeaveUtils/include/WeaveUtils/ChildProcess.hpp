@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include "WeaveUtils/GlobalUtils.hpp"
+#include "WeaveUtils/DynamicCollections.hpp"
+
+namespace Weave
+{
+	/// <summary>
+	/// Child process with its standard input and output redirected to pipes owned by the parent.
+	/// Standard error is inherited. Reads and writes block, and fail rather than throw if the
+	/// process exits, allowing callers to recover from crashes in the child. Reads can be given a
+	/// deadline, allowing callers to recover from hangs.
+	/// </summary>
+	class ChildProcess
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		MAKE_IMMOVABLE(ChildProcess)
+
+		ChildProcess();
+
+		/// <summary>
+		/// Closes the process's input and waits for it to exit
+		/// </summary>
+		~ChildProcess();
+
+		/// <summary>
+		/// Starts the given executable with the given arguments, excluding the executable path
+		/// </summary>
+		void Start(string_view exePath, const IDynamicArray<string_view>& args);
+
+		/// <summary>
+		/// Returns true if the process was started and its pipes have not failed
+		/// </summary>
+		bool GetIsRunning() const;
+
+		/// <summary>
+		/// Writes the given bytes to the process's standard input. Returns false on failure.
+		/// </summary>
+		bool TryWrite(const void* pSrc, size_t size);
+
+		/// <summary>
+		/// Reads exactly the given number of bytes from the process's standard output. Returns false
+		/// if the process exits or the pipe fails first.
+		/// </summary>
+		bool TryRead(void* pDst, size_t size);
+
+		/// <summary>
+		/// Reads exactly the given number of bytes from the process's standard output. Returns false
+		/// if the process exits, the pipe fails, or the deadline passes first. The output stream is
+		/// left in an undefined state after a timeout, and the process should be killed.
+		/// </summary>
+		bool TryRead(void* pDst, size_t size, Clock::time_point deadline);
+
+		/// <summary>
+		/// Closes the process's input, allowing it to exit, and waits for it to finish
+		/// </summary>
+		void Stop();
+
+		/// <summary>
+		/// Forcibly terminates the process and waits for it to exit
+		/// </summary>
+		void Kill();
+
+		/// <summary>
+		/// Returns the path to the executable of the calling process
+		/// </summary>
+		static string GetExecutablePath();
+
+		/// <summary>
+		/// Prepares the calling process's standard input and output for binary transfer to and from
+		/// a parent process
+		/// </summary>
+		static void InitParentPipes();
+
+		/// <summary>
+		/// Reads exactly the given number of bytes from the parent process via standard input.
+		/// Returns false if the parent closes the pipe first.
+		/// </summary>
+		static bool TryReadParent(void* pDst, size_t size);
+
+		/// <summary>
+		/// Writes and flushes the given bytes to the parent process via standard output
+		/// </summary>
+		static bool TryWriteParent(const void* pSrc, size_t size);
+
+	private:
+	#ifdef _WIN32
+		void* hProcess;
+		void* hInput;
+		void* hOutput;
+		void* hReadEvent;
+	#else
+		int pid;
+		int inputFD;
+		int outputFD;
+	#endif
+
+		/// <summary>
+		/// Closes pipes and resets handles after the process exits
+		/// </summary>
+		void Reset();
+	};
+}
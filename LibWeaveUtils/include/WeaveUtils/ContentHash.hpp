@@ -0,0 +1,43 @@
+#pragma once
+#include "WeaveUtils/Int.hpp"
+#include "WeaveUtils/GlobalUtils.hpp"
+
+namespace Weave
+{
+	/// <summary>
+	/// 128-bit non-cryptographic content hash. Wide enough to treat equal hashes as equal content
+	/// for deduplication and caching.
+	/// </summary>
+	struct Hash128
+	{
+		ulong low;
+		ulong high;
+
+		bool operator==(const Hash128& other) const = default;
+	};
+
+	template <class Archive>
+	inline void serialize(Archive& ar, Hash128& hash)
+	{
+		ar(hash.low, hash.high);
+	}
+
+	/// <summary>
+	/// Computes a 128-bit MurmurHash3 of the given bytes, continuing from the given seed
+	/// </summary>
+	Hash128 GetHash128(const void* pData, size_t size, ulong seed = 0);
+
+	/// <summary>
+	/// Computes a 128-bit MurmurHash3 of a narrow string
+	/// </summary>
+	inline Hash128 GetHash128(string_view data, ulong seed = 0) { return GetHash128(data.data(), data.size(), seed); }
+}
+
+namespace std
+{
+	template<>
+	struct hash<Weave::Hash128>
+	{
+		size_t operator()(const Weave::Hash128& hash) const noexcept { return (size_t)(hash.low ^ (hash.high * 31u)); }
+	};
+}
@@ -0,0 +1,299 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "WeaveUtils/GlobalUtils.hpp"
+#include "WeaveUtils/DynamicCollections.hpp"
+
+// --- Compile-Time Configuration ---
+
+#ifndef WV_METRICS_ENABLED
+//
+/// Set to 0 to compile the metric recording macros out entirely. Enabled by default, including
+/// in Release builds. Each update costs one relaxed atomic add on a per-thread shard.
+//
+#define WV_METRICS_ENABLED 1
+#endif // !WV_METRICS_ENABLED
+
+#ifndef WV_METRICS_MAX_SLOTS
+//
+/// Number of 64-bit value slots reserved per shard. Counters and gauges use one slot each.
+/// Histograms use g_MetricHistBucketCount + 1.
+//
+#define WV_METRICS_MAX_SLOTS 2048
+#endif // !WV_METRICS_MAX_SLOTS
+
+#ifndef WV_METRICS_SHARD_COUNT
+//
+/// Number of independent copies of each counter and histogram. Threads are assigned shards
+/// round-robin to reduce cache line contention.
+//
+#define WV_METRICS_SHARD_COUNT 16
+#endif // !WV_METRICS_SHARD_COUNT
+
+// --- Recording Macros ---
+// Each macro registers its metric once, on first use, and caches the handle in a function-local
+// static. NAME must be the same string for every invocation at a given call site.
+
+#if WV_METRICS_ENABLED
+// Adds to a named counter. Usage: WV_METRIC_ADD("fx.repo.cacheHits", 1);
+#define WV_METRIC_ADD(NAME, VALUE) do { static const Weave::MetricCounter _wvMetric = Weave::Metrics::GetCounter(NAME); _wvMetric.Add(VALUE); } while (0)
+// Sets a named gauge. Usage: WV_METRIC_SET("log.queueDepth", depth);
+#define WV_METRIC_SET(NAME, VALUE) do { static const Weave::MetricGauge _wvMetric = Weave::Metrics::GetGauge(NAME); _wvMetric.Set(VALUE); } while (0)
+// Records a value in a named log2 histogram. Usage: WV_METRIC_RECORD("fx.compile.timeNS", timeNS);
+#define WV_METRIC_RECORD(NAME, VALUE) do { static const Weave::MetricHistogram _wvMetric = Weave::Metrics::GetHistogram(NAME); _wvMetric.Record(VALUE); } while (0)
+#else
+// Disabled counter macro (due to WV_METRICS_ENABLED).
+#define WV_METRIC_ADD(NAME, VALUE) WV_EMPTY(VALUE)
+// Disabled gauge macro (due to WV_METRICS_ENABLED).
+#define WV_METRIC_SET(NAME, VALUE) WV_EMPTY(VALUE)
+// Disabled histogram macro (due to WV_METRICS_ENABLED).
+#define WV_METRIC_RECORD(NAME, VALUE) WV_EMPTY(VALUE)
+#endif
+
+namespace Weave
+{
+	class Metrics;
+
+	/// <summary>
+	/// Kinds of values tracked by the metrics registry
+	/// </summary>
+	enum class MetricTypes : byte
+	{
+		Counter = 0,
+		Gauge = 1,
+		Histogram = 2
+	};
+
+	/// <summary>
+	/// Number of log2 histogram buckets. Bucket N holds values with a bit width of N, or [2^(N-1), 2^N).
+	/// </summary>
+	inline constexpr uint g_MetricHistBucketCount = 65;
+
+	/// <summary>
+	/// Handle to a monotonically increasing, sharded counter. Thread safe.
+	/// </summary>
+	class MetricCounter
+	{
+	public:
+		MetricCounter();
+
+		/// <summary>
+		/// Increments the counter by the given value. Thread safe and lock-free.
+		/// </summary>
+		void Add(slong value = 1) const;
+
+		/// <summary>
+		/// Returns true if the handle refers to a registered metric
+		/// </summary>
+		bool GetIsValid() const;
+
+	private:
+		friend Metrics;
+		uint slot;
+
+		explicit MetricCounter(uint slot);
+	};
+
+	/// <summary>
+	/// Handle to a last-value-wins gauge. Not sharded. Thread safe.
+	/// </summary>
+	class MetricGauge
+	{
+	public:
+		MetricGauge();
+
+		/// <summary>
+		/// Overwrites the gauge value. Thread safe and lock-free.
+		/// </summary>
+		void Set(slong value) const;
+
+		/// <summary>
+		/// Adds to the gauge value. Thread safe and lock-free.
+		/// </summary>
+		void Add(slong value) const;
+
+		/// <summary>
+		/// Returns true if the handle refers to a registered metric
+		/// </summary>
+		bool GetIsValid() const;
+
+	private:
+		friend Metrics;
+		uint slot;
+
+		explicit MetricGauge(uint slot);
+	};
+
+	/// <summary>
+	/// Handle to a sharded histogram with power of two buckets. Thread safe.
+	/// </summary>
+	class MetricHistogram
+	{
+	public:
+		MetricHistogram();
+
+		/// <summary>
+		/// Records a value. Negative values are clamped to zero. Thread safe and lock-free.
+		/// </summary>
+		void Record(slong value) const;
+
+		/// <summary>
+		/// Returns true if the handle refers to a registered metric
+		/// </summary>
+		bool GetIsValid() const;
+
+	private:
+		friend Metrics;
+		uint slot;
+
+		explicit MetricHistogram(uint slot);
+	};
+
+	/// <summary>
+	/// Point in time copy of a single metric
+	/// </summary>
+	struct MetricSample
+	{
+		string name;
+		MetricTypes type;
+		/// <summary>
+		/// Counter total, gauge value, or histogram sample count
+		/// </summary>
+		slong value;
+		/// <summary>
+		/// Sum of all recorded values. Histograms only.
+		/// </summary>
+		slong sum;
+		/// <summary>
+		/// Sample count per log2 bucket. Histograms only.
+		/// </summary>
+		Vector<slong> buckets;
+
+		/// <summary>
+		/// Returns the upper bound of the bucket containing the given percentile on [0, 1].
+		/// Histograms only.
+		/// </summary>
+		slong GetPercentile(double pct) const;
+
+		/// <summary>
+		/// Returns the mean recorded value. Histograms only.
+		/// </summary>
+		double GetAverage() const;
+	};
+
+	/// <summary>
+	/// Point in time copy of every registered metric, in registration order
+	/// </summary>
+	struct MetricsSnapshot
+	{
+		Vector<MetricSample> samples;
+
+		/// <summary>
+		/// Returns the sample with the given name, or nullptr if none exists
+		/// </summary>
+		const MetricSample* TryGetSample(string_view name) const;
+
+		/// <summary>
+		/// Appends a human readable, one metric per line description of the snapshot
+		/// </summary>
+		void WriteText(string& out) const;
+
+		/// <summary>
+		/// Appends the snapshot as a single JSON object keyed by metric name
+		/// </summary>
+		void WriteJSON(string& out) const;
+	};
+
+	/// <summary>
+	/// Process-wide registry of named counters, gauges and histograms. Registration is mutex
+	/// guarded and intended to happen once per call site. Recording is lock-free.
+	/// </summary>
+	class Metrics
+	{
+	public:
+		/// <summary>
+		/// Returns a handle to the counter with the given name, registering it if needed.
+		/// Thread safe.
+		/// </summary>
+		static MetricCounter GetCounter(string_view name);
+
+		/// <summary>
+		/// Returns a handle to the gauge with the given name, registering it if needed.
+		/// Thread safe.
+		/// </summary>
+		static MetricGauge GetGauge(string_view name);
+
+		/// <summary>
+		/// Returns a handle to the histogram with the given name, registering it if needed.
+		/// Thread safe.
+		/// </summary>
+		static MetricHistogram GetHistogram(string_view name);
+
+		/// <summary>
+		/// Writes the current value of every registered metric into the snapshot. Values recorded
+		/// concurrently may or may not be included. Thread safe.
+		/// </summary>
+		static void GetSnapshot(MetricsSnapshot& snapshot);
+
+		/// <summary>
+		/// Zeroes all metric values without unregistering them. Thread safe, but updates
+		/// made concurrently may be lost.
+		/// </summary>
+		static void Reset();
+
+	private:
+		friend MetricCounter;
+		friend MetricGauge;
+		friend MetricHistogram;
+
+		MAKE_IMMOVABLE(Metrics)
+
+		struct MetricDef
+		{
+			string name;
+			MetricTypes type;
+			uint slot;
+		};
+
+		struct alignas(64) Shard
+		{
+			std::atomic<slong> slots[WV_METRICS_MAX_SLOTS];
+		};
+
+		std::mutex regMutex;
+		UniqueVector<MetricDef> defs;
+		std::unordered_map<string, uint> nameIndexMap;
+		uint slotCount;
+
+		std::unique_ptr<Shard[]> pShards;
+		std::atomic<uint> nextShard;
+
+		Metrics();
+
+		~Metrics();
+
+		/// <summary>
+		/// Returns the registry. Constructed on first use, so that metrics can be registered
+		/// during static initialization in other translation units.
+		/// </summary>
+		static Metrics& GetInstance();
+
+		/// <summary>
+		/// Returns the shard assigned to the calling thread
+		/// </summary>
+		static std::atomic<slong>* GetThreadSlots();
+
+		/// <summary>
+		/// Returns the global, unsharded slots used for gauges
+		/// </summary>
+		static std::atomic<slong>* GetGlobalSlots();
+
+		/// <summary>
+		/// Returns the first slot of the metric with the given name and type, registering it
+		/// if needed
+		/// </summary>
+		uint GetOrAddMetric(string_view name, MetricTypes type);
+	};
+}
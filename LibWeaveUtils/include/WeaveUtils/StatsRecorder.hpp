@@ -1,11 +1,16 @@
 #pragma once
 #include <algorithm>
+#include <cmath>
 #include "DynamicCollections.hpp"
 
 namespace Weave
 {
 	/// <summary>
-	/// Class template for recording statistics using scalar numeric values in a sliding window
+	/// Class template for recording statistics using scalar numeric values in a sliding window.
+	/// Window values are indexed by an order statistic tree, a treap with subtree sizes, making
+	/// updates and percentile queries O(log n) expected, without allocation.
+	/// NaN values have no ordering. They are discarded by AddValue, and are not counted in the
+	/// window or the average.
 	/// </summary>
 	template <typename T> requires (std::integral<T> || std::floating_point<T>) && std::is_trivial_v<T>
 	class StatsRecorder
@@ -15,11 +20,12 @@ namespace Weave
 
 		StatsRecorder(size_t windowSize) :
 			values(windowSize, 0),
-			sortedValues(windowSize),
+			nodes(windowSize),
+			root(s_Null),
 			index(0),
 			wndSize(0),
 			sum(0),
-			isSorted(false)
+			seed(0)
 		{ }
 
 		/// <summary>
@@ -28,27 +34,70 @@ namespace Weave
 		void Clear()
 		{
 			SetArrNull(values);
+			root = s_Null;
 			wndSize = 0;
 			index = 0;
 			sum = 0;
-			isSorted = false;
 		}
 
 		/// <summary>
-		/// Updates and adds a new value to the recorder
+		/// Updates and adds a new value to the recorder. If the window is full, the oldest value
+		/// is evicted. NaN values are discarded.
 		/// </summary>
 		void AddValue(T value)
 		{
 			WV_ASSERT(values.GetLength() > 0);
 
+			if constexpr (std::floating_point<T>)
+			{
+				if (std::isnan(value))
+					return;
+			}
+
+			const uint slot = (uint)index;
+
+			if (wndSize == values.GetLength())
+				root = Erase(root, slot);
+
 			sum -= values[index];
 			values[index] = value;
 			sum += value;
 
+			Node& node = nodes[slot];
+			node.left = s_Null;
+			node.right = s_Null;
+			node.count = 1;
+			node.priority = GetNextPriority();
+			root = Insert(root, slot);
+
 			index++;
 			wndSize = std::max(wndSize, index);
 			index %= values.GetLength();
-			isSorted = false;
+		}
+
+		/// <summary>
+		/// Adds the window of another recorder to this one, after this recorder's own values.
+		/// The capacity grows to fit both windows if needed, so no values are evicted and the
+		/// result describes the union of both windows. Used to combine recorders populated on
+		/// separate threads.
+		/// </summary>
+		void Merge(const StatsRecorder& other)
+		{
+			// Copied first, as other may be this recorder
+			UniqueArray<T> window(wndSize + other.wndSize);
+			GetWindow(window, 0);
+			other.GetWindow(window, wndSize);
+
+			if (window.GetLength() > values.GetLength())
+			{
+				values = UniqueArray<T>(window.GetLength(), 0);
+				nodes = UniqueArray<Node>(window.GetLength());
+			}
+
+			Clear();
+
+			for (size_t i = 0; i < window.GetLength(); i++)
+				AddValue(window[i]);
 		}
 
 		/// <summary>
@@ -57,7 +106,7 @@ namespace Weave
 		size_t GetMaxWindowSize() const { return values.GetLength(); }
 
 		/// <summary>
-		/// Returns the window size. May be less than max if the recorder hasn't had 
+		/// Returns the window size. May be less than max if the recorder hasn't had
 		/// time to fully populate
 		/// </summary>
 		size_t GetWindowSize() const { return wndSize; }
@@ -68,28 +117,173 @@ namespace Weave
 		T GetPercentile(double pct) const
 		{
 			WV_ASSERT(wndSize > 0);
-
-			if (!isSorted)
-			{
-				ArrMemCopy(sortedValues, values);
-				std::sort(sortedValues.GetData(), sortedValues.GetData() + GetWindowSize());
-				isSorted = true;
-			}
-
 			pct = std::clamp(pct, 0.0, 1.0);
-			return sortedValues[(ptrdiff_t)std::round(pct * (double)(wndSize - 1))];
+			return GetNthValue((uint)std::round(pct * (double)(wndSize - 1)));
 		}
 
+		/// <summary>
+		/// Returns the smallest value in the window
+		/// </summary>
+		T GetMin() const { WV_ASSERT(wndSize > 0); return GetNthValue(0); }
+
+		/// <summary>
+		/// Returns the largest value in the window
+		/// </summary>
+		T GetMax() const { WV_ASSERT(wndSize > 0); return GetNthValue((uint)wndSize - 1); }
+
 		/// <summary>
 		/// Returns the mean value
 		/// </summary>
 		T GetAverage() const { WV_ASSERT(wndSize > 0); return sum / static_cast<T>(wndSize); }
 
 	private:
-		mutable bool isSorted;
-		mutable UniqueArray<T> sortedValues;
+		static constexpr uint s_Null = UINT32_MAX;
+
+		/// <summary>
+		/// Treap node for the value in the ring buffer slot with the same index
+		/// </summary>
+		struct Node
+		{
+			uint left;
+			uint right;
+			uint count;
+			uint priority;
+		};
+
 		UniqueArray<T> values;
+		UniqueArray<Node> nodes;
+		uint root;
 		size_t index, wndSize;
 		T sum;
+		ulong seed;
+
+		uint GetCount(uint node) const { return (node != s_Null) ? nodes[node].count : 0; }
+
+		void UpdateCount(uint node) { nodes[node].count = 1 + GetCount(nodes[node].left) + GetCount(nodes[node].right); }
+
+		/// <summary>
+		/// Orders slots by value, then by slot, making keys unique
+		/// </summary>
+		bool GetIsLess(uint a, uint b) const
+		{
+			return values[a] < values[b] || (values[a] == values[b] && a < b);
+		}
+
+		/// <summary>
+		/// Returns a pseudorandom priority, using the SplitMix64 finalizer
+		/// </summary>
+		uint GetNextPriority()
+		{
+			ulong z = (seed += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return (uint)(z ^ (z >> 31));
+		}
+
+		/// <summary>
+		/// Splits the given subtree into keys less than the given slot, and all others
+		/// </summary>
+		void Split(uint node, uint slot, uint& lessOut, uint& restOut)
+		{
+			if (node == s_Null)
+			{
+				lessOut = s_Null;
+				restOut = s_Null;
+			}
+			else if (GetIsLess(node, slot))
+			{
+				Split(nodes[node].right, slot, nodes[node].right, restOut);
+				lessOut = node;
+				UpdateCount(node);
+			}
+			else
+			{
+				Split(nodes[node].left, slot, lessOut, nodes[node].left);
+				restOut = node;
+				UpdateCount(node);
+			}
+		}
+
+		/// <summary>
+		/// Joins two subtrees, where all keys in the first precede those in the second
+		/// </summary>
+		uint Join(uint lhs, uint rhs)
+		{
+			if (lhs == s_Null)
+				return rhs;
+			if (rhs == s_Null)
+				return lhs;
+
+			if (nodes[lhs].priority > nodes[rhs].priority)
+			{
+				nodes[lhs].right = Join(nodes[lhs].right, rhs);
+				UpdateCount(lhs);
+				return lhs;
+			}
+			else
+			{
+				nodes[rhs].left = Join(lhs, nodes[rhs].left);
+				UpdateCount(rhs);
+				return rhs;
+			}
+		}
+
+		uint Insert(uint node, uint slot)
+		{
+			uint less, rest;
+			Split(node, slot, less, rest);
+			return Join(Join(less, slot), rest);
+		}
+
+		uint Erase(uint node, uint slot)
+		{
+			WV_ASSERT_MSG(node != s_Null, "Evicted value missing from ordered window");
+
+			if (node == slot)
+				return Join(nodes[node].left, nodes[node].right);
+
+			if (GetIsLess(slot, node))
+				nodes[node].left = Erase(nodes[node].left, slot);
+			else
+				nodes[node].right = Erase(nodes[node].right, slot);
+
+			UpdateCount(node);
+			return node;
+		}
+
+		/// <summary>
+		/// Returns the value with the given rank in ascending order
+		/// </summary>
+		T GetNthValue(uint rank) const
+		{
+			uint node = root;
+
+			while (true)
+			{
+				const uint leftCount = GetCount(nodes[node].left);
+
+				if (rank < leftCount)
+					node = nodes[node].left;
+				else if (rank > leftCount)
+				{
+					rank -= leftCount + 1;
+					node = nodes[node].right;
+				}
+				else
+					return values[node];
+			}
+		}
+
+		/// <summary>
+		/// Copies the window to the given array, oldest first, starting at the given offset
+		/// </summary>
+		void GetWindow(IDynamicArray<T>& dst, size_t offset) const
+		{
+			const size_t maxSize = values.GetLength();
+			const size_t start = (wndSize == maxSize) ? index : 0;
+
+			for (size_t i = 0; i < wndSize; i++)
+				dst[offset + i] = values[(start + i) % maxSize];
+		}
 	};
-}
\ No newline at end of file
+}
@@ -2,6 +2,19 @@
 #include <chrono>
 #include "WeaveUtils/Int.hpp"
 
+#ifndef WV_STOPWATCH_USE_TSC
+// 
+/// Set to 1 to source Stopwatch time from the calibrated CPU timestamp counter (TscClock)
+/// instead of std::chrono::steady_clock. Reduces the cost of each elapsed time query in
+/// spin-waits and trace scopes. Falls back to steady_clock at runtime without an invariant TSC.
+// 
+#define WV_STOPWATCH_USE_TSC 0
+#endif // !WV_STOPWATCH_USE_TSC
+
+#if WV_STOPWATCH_USE_TSC
+#include "WeaveUtils/TscClock.hpp"
+#endif
+
 namespace Weave
 {
 	/// <summary>
@@ -40,7 +53,11 @@ namespace Weave
 	class Stopwatch
 	{
 	public:
-		using Clock = std::chrono::high_resolution_clock;
+	#if WV_STOPWATCH_USE_TSC
+		using Clock = TscClock;
+	#else
+		using Clock = std::chrono::steady_clock;
+	#endif
 		using Duration = std::chrono::duration<slong, std::nano>;
 		using TimePoint = Clock::time_point;
 
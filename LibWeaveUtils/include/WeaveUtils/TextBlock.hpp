@@ -6,6 +6,69 @@
 
 namespace Weave
 { 
+    /// <summary>
+    /// Character set used by TextBlock range searches, precomputed from a break filter and an 
+    /// inclusive [min, max] range. Equivalent to passing the filter and range directly, but tests 
+    /// each character with a single table lookup instead of searching the filter.
+    /// </summary>
+    class CharFilter
+    {
+    public:
+        explicit constexpr CharFilter(std::string_view breakFilter = "", char min = '\0', char max = (char)127) :
+            rangeMask{},
+            startMask{}
+        {
+            // Signed ranges map to at most two contiguous runs of bytes
+            if (min < 0)
+                SetBits(rangeMask, (byte)min, (byte)std::min(max, (char)-1));
+
+            if (max >= 0)
+                SetBits(rangeMask, (byte)std::max(min, '\0'), (byte)max);
+
+            for (int i = 0; i < 4; i++)
+                startMask[i] = rangeMask[i];
+
+            for (const char ch : breakFilter)
+            {
+                const byte b = (byte)ch;
+                rangeMask[b >> 6] &= ~(1ull << (b & 63));
+                startMask[b >> 6] |= 1ull << (b & 63);
+            }
+        }
+
+        /// <summary>
+        /// Returns true if the character falls inside the range and isn't in the break filter
+        /// </summary>
+        constexpr bool GetIsRangeChar(char ch) const { return GetHasBit(rangeMask, ch); }
+
+        /// <summary>
+        /// Returns true if the character falls inside the range or is in the break filter
+        /// </summary>
+        constexpr bool GetIsStartChar(char ch) const { return GetHasBit(startMask, ch); }
+
+    private:
+        ulong rangeMask[4];
+        ulong startMask[4];
+
+        static constexpr void SetBits(ulong(&mask)[4], uint first, uint last)
+        {
+            if (first > last)
+                return;
+
+            for (uint i = first >> 6; i <= (last >> 6); i++)
+            {
+                const uint lo = std::max(first, i * 64) & 63, hi = std::min(last, i * 64 + 63) & 63;
+                mask[i] |= (~0ull >> (63 - (hi - lo))) << lo;
+            }
+        }
+
+        static constexpr bool GetHasBit(const ulong(&mask)[4], char ch)
+        {
+            const byte b = (byte)ch;
+            return (mask[b >> 6] >> (b & 63)) & 1;
+        }
+    };
+
     /// <summary>
     /// Span type used to represent a range of characters within a string. Does not
     /// store text.
@@ -108,6 +171,10 @@ namespace Weave
 
         TextBlock GetLastWord(const char* pStart, const string_view& breakFilter = "", char min = '!', char max = '~') const;
 
+        TextBlock GetWord(const char* pStart, const CharFilter& filter) const;
+
+        TextBlock GetLastWord(const char* pStart, const CharFilter& filter) const;
+
         /// <summary>
         /// Finds position of the first character of the first matching occurence of 
         /// the given substring, starting from the given pointer. Doesn't stop on '\0'.
@@ -138,6 +205,24 @@ namespace Weave
         /// </summary>
         const char* FindLastStart(const char* pStart, const string_view& breakFilter = "", char min = '\0', char max = (char)127) const;
 
+        /// <summary>
+        /// Returns pointer to first character in a range found in the text after the 
+        /// given start, using a precomputed filter.
+        /// </summary>
+        const char* FindStart(const char* pStart, const CharFilter& filter) const;
+
+        /// <summary>
+        /// Returns the position of the last character in the range starting at the given 
+        /// pointer, using a precomputed filter.
+        /// </summary>
+        const char* FindEnd(const char* pStart, const CharFilter& filter) const;
+
+        /// <summary>
+        /// Returns pointer to first character in a range found in the text before the 
+        /// given start, using a precomputed filter.
+        /// </summary>
+        const char* FindLastStart(const char* pStart, const CharFilter& filter) const;
+
         /// <summary>
         /// Finds position of the first character of the first matching occurence of 
         /// the given substring, starting from the given pointer. Doesn't stop on '\0'.
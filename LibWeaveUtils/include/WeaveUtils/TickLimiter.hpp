@@ -5,8 +5,23 @@
 
 namespace Weave
 {
+	/// <summary>
+	/// Distribution of absolute tick time error measured against a target tick time
+	/// </summary>
+	struct TickJitterStats
+	{
+		slong targetNS;
+		slong avgTickNS;
+		slong avgErrorNS;
+		slong p50ErrorNS;
+		slong p95ErrorNS;
+		slong p99ErrorNS;
+		slong maxErrorNS;
+	};
+
 	/// <summary>
 	/// Update loop timing class for high-precision thread sleeping for tick rate limiting.
+	/// Uses the multimedia timer on Windows and absolute CLOCK_MONOTONIC sleeps elsewhere.
 	/// </summary>
 	class TickLimiter
 	{
@@ -16,8 +31,8 @@ namespace Weave
 		~TickLimiter();
 
 		/// <summary>
-		/// Returns true if thread sleep interrupts can be configured to a 1ms tick for WaitTick()
-		/// Thread safe.
+		/// Returns true if thread sleep interrupts can be configured to a 1ms tick or better for 
+		/// WaitTick(). Thread safe.
 		/// </summary>
 		bool GetCanUseHighResSleep() const;
 
@@ -58,17 +73,25 @@ namespace Weave
 		/// </summary>
 		void EndTick();
 
+		/// <summary>
+		/// Runs an empty update loop at the given tick time and returns the distribution of tick 
+		/// timing error. Blocks the calling thread for roughly targetTickTimeNS * tickCount.
+		/// </summary>
+		static TickJitterStats GetJitterStats(slong targetTickTimeNS, uint tickCount, slong spinLimit = 0ll);
+
 	private:
 		std::atomic<slong> targetTickTimeNS;
 
 		bool canHighResSleep;
 		uint sysInterruptTickMS;
+		slong sleepQuantumNS;
 
 		slong targetTickNS;
 		slong lastTickNS;
 
 		slong avgTickErrorNS;
 		slong avgSpinErrorNS;
+		slong avgSleepErrorNS;
 		std::atomic<slong> avgTickDeltaNS;
 
 		Stopwatch tickTimer;
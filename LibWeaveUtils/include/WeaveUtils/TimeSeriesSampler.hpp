@@ -0,0 +1,201 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "WeaveUtils/GlobalUtils.hpp"
+#include "WeaveUtils/DynamicCollections.hpp"
+#include "WeaveUtils/Stopwatch.hpp"
+
+namespace Weave
+{
+	/// <summary>
+	/// Resolutions retained by TimeSeriesSampler. Raw holds every sample. Each subsequent tier
+	/// holds min/max/average buckets aggregated from the tier before it.
+	/// </summary>
+	enum class SampleTiers : byte
+	{
+		Raw = 0,
+		OneSecond = 1,
+		TenSeconds = 2,
+		OneMinute = 3
+	};
+
+	inline constexpr uint g_SampleTierCount = 4;
+
+	/// <summary>
+	/// Chronologically ordered copy of a single series at a single resolution. For the raw tier,
+	/// min, max and average are identical.
+	/// </summary>
+	struct SeriesSnapshot
+	{
+		/// <summary>
+		/// Sample time, or bucket start time, relative to the sampler's first sample
+		/// </summary>
+		Vector<slong> timesNS;
+		Vector<double> avgValues;
+		Vector<double> minValues;
+		Vector<double> maxValues;
+
+		/// <summary>
+		/// Returns the number of samples or buckets in the snapshot
+		/// </summary>
+		uint GetLength() const { return (uint)timesNS.GetLength(); }
+
+		/// <summary>
+		/// Removes all samples
+		/// </summary>
+		void Clear();
+	};
+
+	/// <summary>
+	/// Records a fixed set of named scalar series at a fixed rate on a background thread. Series
+	/// are stored in per-tier, structure of arrays ring buffers and downsampled into 1s, 10s and
+	/// 60s buckets. Snapshots are seqlock guarded, so readers never block the sampling thread.
+	/// </summary>
+	class TimeSeriesSampler
+	{
+	public:
+		/// <summary>
+		/// Returns the current value of a series. Called on the sampling thread.
+		/// </summary>
+		using SourceFunc = std::function<double()>;
+
+		MAKE_IMMOVABLE(TimeSeriesSampler)
+
+		/// <summary>
+		/// Creates a sampler with the given sampling period, raw ring capacity and downsampled
+		/// bucket capacity per tier. The sampling period cannot exceed one second.
+		/// </summary>
+		TimeSeriesSampler(slong samplePeriodNS = slong(1E7), uint rawCapacity = 1024u, uint tierCapacity = 120u);
+
+		~TimeSeriesSampler();
+
+		/// <summary>
+		/// Registers a new series and returns its ID. If no source is given, the series samples
+		/// the last value passed to SetValue(). Series must be added before the first sample.
+		/// </summary>
+		uint AddSeries(string_view name, SourceFunc&& source = nullptr);
+
+		/// <summary>
+		/// Returns the number of registered series
+		/// </summary>
+		uint GetSeriesCount() const;
+
+		/// <summary>
+		/// Returns the name of the series with the given ID
+		/// </summary>
+		string_view GetSeriesName(uint seriesID) const;
+
+		/// <summary>
+		/// Returns the ID of the series with the given name, or g_InvalidID32 if not found
+		/// </summary>
+		uint TryGetSeriesID(string_view name) const;
+
+		/// <summary>
+		/// Updates the value sampled for a series without a source. Thread safe and lock-free
+		/// once series registration is complete.
+		/// </summary>
+		void SetValue(uint seriesID, double value);
+
+		/// <summary>
+		/// Returns the sampling period in nanoseconds
+		/// </summary>
+		slong GetSamplePeriodNS() const;
+
+		/// <summary>
+		/// Starts sampling on a background thread
+		/// </summary>
+		void Start();
+
+		/// <summary>
+		/// Stops the background thread and waits for it to exit
+		/// </summary>
+		void Stop();
+
+		/// <summary>
+		/// Returns true if the background thread is running
+		/// </summary>
+		bool GetIsRunning() const;
+
+		/// <summary>
+		/// Records one sample of every series on the calling thread. Only valid while the
+		/// background thread is stopped.
+		/// </summary>
+		void Sample();
+
+		/// <summary>
+		/// Copies the given series and tier into the snapshot, oldest first. Downsampled tiers only
+		/// include completed buckets. Thread safe. Retries if the sampler writes during the copy.
+		/// </summary>
+		void GetSnapshot(uint seriesID, SampleTiers tier, SeriesSnapshot& snapshot) const;
+
+	private:
+		/// <summary>
+		/// Ring buffer for one resolution. Values are stored series-major, with each series' ring
+		/// contiguous. Written only by the sampling thread.
+		/// </summary>
+		struct Tier
+		{
+			slong periodNS;
+			uint capacity;
+
+			// Odd while a write is in progress
+			std::atomic<ulong> seq;
+			std::atomic<ulong> count;
+			UniqueArray<slong> timesNS;
+			UniqueArray<double> avgValues;
+			UniqueArray<double> minValues;
+			UniqueArray<double> maxValues;
+
+			// Pending bucket, downsampled tiers only
+			slong bucketStartNS;
+			ulong accCount;
+			UniqueArray<double> accSums;
+			UniqueArray<double> accMins;
+			UniqueArray<double> accMaxs;
+		};
+
+		struct SeriesDef
+		{
+			string name;
+			SourceFunc source;
+			double pushedValue;
+		};
+
+		const slong samplePeriodNS;
+		UniqueVector<SeriesDef> seriesDefs;
+		UniqueArray<double> sampleValues;
+		UniqueArray<double> bucketAvgs;
+		Tier tiers[g_SampleTierCount];
+
+		Stopwatch sampleTimer;
+		std::jthread samplerThread;
+		bool isInitialized;
+
+		/// <summary>
+		/// Allocates ring buffers for the registered series. Called on first sample.
+		/// </summary>
+		void InitBuffers();
+
+		/// <summary>
+		/// Samples every series and propagates the results through the tiers
+		/// </summary>
+		void WriteSample();
+
+		/// <summary>
+		/// Adds a sample or completed bucket to the pending bucket of a downsampled tier, flushing
+		/// the pending bucket first if the new one belongs to a later period
+		/// </summary>
+		void Accumulate(uint tierIndex, slong timeNS, ulong count, const double* pSums, const double* pMins, const double* pMaxs);
+
+		/// <summary>
+		/// Writes the pending bucket of a downsampled tier to its ring and forwards it to the next tier
+		/// </summary>
+		void FlushBucket(uint tierIndex);
+
+		/// <summary>
+		/// Appends one entry per series to a tier's ring under its seqlock
+		/// </summary>
+		static void WriteTier(Tier& tier, slong timeNS, const double* pAvgs, const double* pMins, const double* pMaxs);
+	};
+}
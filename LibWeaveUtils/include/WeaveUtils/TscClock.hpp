@@ -0,0 +1,99 @@
+#pragma once
+#include <chrono>
+#include "WeaveUtils/Int.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WV_TSC_SUPPORTED 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define WV_TSC_SUPPORTED 0
+#endif
+
+namespace Weave
+{
+	/// <summary>
+	/// std::chrono compatible steady clock sourced from the CPU timestamp counter. Calibrated once
+	/// against std::chrono::steady_clock on first use. Falls back to steady_clock on CPUs without
+	/// an invariant TSC. Thread safe.
+	/// </summary>
+	class TscClock
+	{
+	public:
+		using rep = slong;
+		using period = std::nano;
+		using duration = std::chrono::duration<rep, period>;
+		using time_point = std::chrono::time_point<TscClock>;
+
+		static constexpr bool is_steady = true;
+
+		/// <summary>
+		/// Returns the current time. Time points share their epoch with steady_clock,
+		/// approximately.
+		/// </summary>
+		static time_point now() noexcept
+		{
+			const Calibration& calib = GetCalibration();
+
+		#if WV_TSC_SUPPORTED
+			if (calib.isInvariant)
+			{
+				uint aux;
+				const ulong ticks = __rdtscp(&aux) - calib.baseTicks;
+				return time_point(duration(calib.baseNS + (slong)GetScaledTicks(ticks, calib.nsPerTick)));
+			}
+		#endif
+
+			return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+		}
+
+		/// <summary>
+		/// Returns true if the clock is reading an invariant TSC, rather than falling back to
+		/// steady_clock
+		/// </summary>
+		static bool GetIsInvariant() { return GetCalibration().isInvariant; }
+
+		/// <summary>
+		/// Returns the calibrated TSC frequency in Hz, or 0 if unavailable
+		/// </summary>
+		static double GetFrequencyHz() { return GetCalibration().frequencyHz; }
+
+	private:
+		struct Calibration
+		{
+			ulong baseTicks;
+			slong baseNS;
+			// Nanoseconds per tick in 32.32 fixed point
+			ulong nsPerTick;
+			double frequencyHz;
+			bool isInvariant;
+		};
+
+		static Calibration GetNewCalibration();
+
+		static const Calibration& GetCalibration()
+		{
+			static const Calibration s_Calibration = GetNewCalibration();
+			return s_Calibration;
+		}
+
+		/// <summary>
+		/// Returns (ticks * nsPerTick) >> 32 without overflowing
+		/// </summary>
+		static ulong GetScaledTicks(ulong ticks, ulong nsPerTick)
+		{
+		#if defined(_MSC_VER) && defined(_M_X64)
+			ulong hi;
+			const ulong lo = _umul128(ticks, nsPerTick, &hi);
+			return (hi << 32u) | (lo >> 32u);
+		#elif defined(__SIZEOF_INT128__)
+			return (ulong)(((unsigned __int128)ticks * nsPerTick) >> 32u);
+		#else
+			return (ticks >> 32u) * nsPerTick + (((ticks & 0xFFFFFFFFull) * nsPerTick) >> 32u);
+		#endif
+		}
+	};
+}
@@ -0,0 +1,462 @@
+#include "pch.hpp"
+#include "WeaveUtils/ChildProcess.hpp"
+
+#ifdef _WIN32
+#include "WeaveUtils/Win32.hpp"
+#include "WeaveUtils/WeaveWinException.hpp"
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+using namespace Weave;
+
+// Serializes process creation so pipe handles are only inherited by the child they belong to
+static std::mutex s_StartMutex;
+
+/// <summary>
+/// Returns the time remaining until the given deadline in milliseconds, rounded up, or -1 if the
+/// deadline is unbounded
+/// </summary>
+static slong GetTimeoutMS(ChildProcess::Clock::time_point deadline)
+{
+	if (deadline == ChildProcess::Clock::time_point::max())
+		return -1;
+
+	const auto remaining = deadline - ChildProcess::Clock::now();
+	return std::max(std::chrono::ceil<std::chrono::milliseconds>(remaining).count(), (slong)0);
+}
+
+bool ChildProcess::TryRead(void* pDst, size_t size) { return TryRead(pDst, size, Clock::time_point::max()); }
+
+#ifdef _WIN32
+
+// Number of output pipes created by this process, used to name them
+static uint s_PipeCount = 0;
+
+ChildProcess::ChildProcess() :
+	hProcess(nullptr),
+	hInput(nullptr),
+	hOutput(nullptr),
+	hReadEvent(nullptr)
+{ }
+
+/// <summary>
+/// Appends an argument to a command line, quoting it if it contains whitespace or quotes. Quoted
+/// arguments follow the rules used by CommandLineToArgvW: backslashes are only escaped where they
+/// precede a quote, including the closing quote.
+/// </summary>
+static void AppendArg(string_view arg, string& cmdLine)
+{
+	if (!cmdLine.empty())
+		cmdLine.push_back(' ');
+
+	if (!arg.empty() && arg.find_first_of(" \t\"") == string_view::npos)
+	{
+		cmdLine.append(arg);
+		return;
+	}
+
+	cmdLine.push_back('"');
+	size_t slashCount = 0;
+
+	for (const char c : arg)
+	{
+		if (c == '\\')
+		{
+			slashCount++;
+		}
+		else
+		{
+			if (c == '"')
+				cmdLine.append(slashCount + 1, '\\');
+
+			slashCount = 0;
+		}
+
+		cmdLine.push_back(c);
+	}
+
+	cmdLine.append(slashCount, '\\');
+	cmdLine.push_back('"');
+}
+
+void ChildProcess::Start(string_view exePath, const IDynamicArray<string_view>& args)
+{
+	WV_CHECK_MSG(hProcess == nullptr, "Child process already started");
+
+	string cmdLine;
+	AppendArg(exePath, cmdLine);
+
+	for (const string_view arg : args)
+		AppendArg(arg, cmdLine);
+
+	std::lock_guard lock(s_StartMutex);
+	SECURITY_ATTRIBUTES secAttrib = { .nLength = sizeof(SECURITY_ATTRIBUTES), .bInheritHandle = TRUE };
+	HANDLE hChildIn = nullptr, hParentIn = nullptr, hParentOut = nullptr, hChildOut = nullptr;
+
+	WIN_CHECK_NZ_LAST_MSG(CreatePipe(&hChildIn, &hParentIn, &secAttrib, 0), "Failed to create child process input pipe");
+	// Parent ends are not inherited
+	SetHandleInformation(hParentIn, HANDLE_FLAG_INHERIT, 0);
+
+	// Output is read with overlapped IO to allow timeouts, which anonymous pipes do not support
+	const string pipeName = std::format("\\\\.\\pipe\\Weave.ChildProcess.{}.{}", GetCurrentProcessId(), s_PipeCount++);
+	hParentOut = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 0, 0, 0, nullptr);
+
+	if (hParentOut != INVALID_HANDLE_VALUE)
+		hChildOut = CreateFileA(pipeName.c_str(), GENERIC_WRITE, 0, &secAttrib, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (hParentOut == INVALID_HANDLE_VALUE || hChildOut == INVALID_HANDLE_VALUE)
+	{
+		const DWORD error = GetLastError();
+		CloseHandle(hChildIn);
+		CloseHandle(hParentIn);
+
+		if (hParentOut != INVALID_HANDLE_VALUE)
+			CloseHandle(hParentOut);
+
+		WIN_THROW_HR_MSG(HRESULT_FROM_WIN32(error), "Failed to create child process output pipe");
+	}
+
+	const HANDLE hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+	if (hEvent == nullptr)
+	{
+		const DWORD error = GetLastError();
+
+		for (const HANDLE handle : { hChildIn, hParentIn, hParentOut, hChildOut })
+			CloseHandle(handle);
+
+		WIN_THROW_HR_MSG(HRESULT_FROM_WIN32(error), "Failed to create child process read event");
+	}
+
+	STARTUPINFOA startInfo = { .cb = sizeof(STARTUPINFOA) };
+	startInfo.dwFlags = STARTF_USESTDHANDLES;
+	startInfo.hStdInput = hChildIn;
+	startInfo.hStdOutput = hChildOut;
+	startInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION procInfo = {};
+	const BOOL isStarted = CreateProcessA(
+		nullptr, cmdLine.data(),
+		nullptr, nullptr,
+		TRUE, 0,
+		nullptr, nullptr,
+		&startInfo, &procInfo
+	);
+
+	CloseHandle(hChildIn);
+	CloseHandle(hChildOut);
+
+	if (!isStarted)
+	{
+		const DWORD error = GetLastError();
+		CloseHandle(hParentIn);
+		CloseHandle(hParentOut);
+		CloseHandle(hEvent);
+		WIN_THROW_HR_MSG(HRESULT_FROM_WIN32(error), "Failed to start child process: {}", cmdLine);
+	}
+
+	CloseHandle(procInfo.hThread);
+	hProcess = procInfo.hProcess;
+	hInput = hParentIn;
+	hOutput = hParentOut;
+	hReadEvent = hEvent;
+}
+
+bool ChildProcess::GetIsRunning() const { return hInput != nullptr && hOutput != nullptr; }
+
+bool ChildProcess::TryWrite(const void* pSrc, size_t size)
+{
+	const char* pBytes = static_cast<const char*>(pSrc);
+
+	while (hInput != nullptr && size > 0)
+	{
+		DWORD written = 0;
+
+		if (!WriteFile(hInput, pBytes, (DWORD)std::min(size, (size_t)MAXDWORD), &written, nullptr))
+			return false;
+
+		pBytes += written;
+		size -= written;
+	}
+
+	return size == 0;
+}
+
+bool ChildProcess::TryRead(void* pDst, size_t size, Clock::time_point deadline)
+{
+	char* pBytes = static_cast<char*>(pDst);
+
+	while (hOutput != nullptr && size > 0)
+	{
+		OVERLAPPED overlapped = { .hEvent = hReadEvent };
+		DWORD read = 0;
+
+		if (!ReadFile(hOutput, pBytes, (DWORD)std::min(size, (size_t)MAXDWORD), nullptr, &overlapped))
+		{
+			if (GetLastError() != ERROR_IO_PENDING)
+				return false;
+
+			const slong timeoutMS = GetTimeoutMS(deadline);
+			const DWORD waitMS = (timeoutMS >= 0) ? (DWORD)std::min(timeoutMS, (slong)INFINITE - 1) : INFINITE;
+
+			if (WaitForSingleObject(hReadEvent, waitMS) != WAIT_OBJECT_0)
+			{
+				// The buffer must outlive the read, so cancellation is waited on
+				CancelIo(hOutput);
+				GetOverlappedResult(hOutput, &overlapped, &read, TRUE);
+				return false;
+			}
+		}
+
+		if (!GetOverlappedResult(hOutput, &overlapped, &read, FALSE) || read == 0)
+			return false;
+
+		pBytes += read;
+		size -= read;
+	}
+
+	return size == 0;
+}
+
+void ChildProcess::Stop()
+{
+	if (hInput != nullptr)
+	{
+		CloseHandle(hInput);
+		hInput = nullptr;
+	}
+
+	if (hProcess != nullptr)
+		WaitForSingleObject(hProcess, INFINITE);
+
+	Reset();
+}
+
+void ChildProcess::Kill()
+{
+	if (hProcess != nullptr)
+	{
+		TerminateProcess(hProcess, 1);
+		WaitForSingleObject(hProcess, INFINITE);
+	}
+
+	Reset();
+}
+
+void ChildProcess::Reset()
+{
+	for (void** ppHandle : { &hProcess, &hInput, &hOutput, &hReadEvent })
+	{
+		if (*ppHandle != nullptr)
+		{
+			CloseHandle(*ppHandle);
+			*ppHandle = nullptr;
+		}
+	}
+}
+
+string ChildProcess::GetExecutablePath()
+{
+	string path(MAX_PATH, '\0');
+	DWORD length = 0;
+
+	while ((length = GetModuleFileNameA(nullptr, path.data(), (DWORD)path.size())) == path.size())
+		path.resize(2 * path.size());
+
+	WIN_CHECK_NZ_LAST_MSG(length, "Failed to get executable path");
+	path.resize(length);
+	return path;
+}
+
+void ChildProcess::InitParentPipes()
+{
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+}
+
+#else
+
+ChildProcess::ChildProcess() :
+	pid(-1),
+	inputFD(-1),
+	outputFD(-1)
+{ }
+
+void ChildProcess::Start(string_view exePath, const IDynamicArray<string_view>& args)
+{
+	WV_CHECK_MSG(pid == -1, "Child process already started");
+
+	// Null terminated copies must be made before forking
+	Vector<string> argStrings;
+	Vector<char*> argv;
+	argStrings.EmplaceBack(exePath);
+
+	for (const string_view arg : args)
+		argStrings.EmplaceBack(arg);
+
+	for (string& arg : argStrings)
+		argv.Add(arg.data());
+
+	argv.Add(nullptr);
+
+	std::lock_guard lock(s_StartMutex);
+	int inPipe[2], outPipe[2];
+	// Writes to exited children fail with EPIPE instead of terminating the parent
+	signal(SIGPIPE, SIG_IGN);
+
+	WV_CHECK_MSG(pipe2(inPipe, O_CLOEXEC) == 0, "Failed to create child process input pipe. Error: {}", errno);
+
+	if (pipe2(outPipe, O_CLOEXEC) != 0)
+	{
+		close(inPipe[0]);
+		close(inPipe[1]);
+		WV_THROW("Failed to create child process output pipe. Error: {}", errno);
+	}
+
+	const int newPID = fork();
+
+	if (newPID == 0)
+	{
+		// Duplicated descriptors do not inherit O_CLOEXEC
+		dup2(inPipe[0], STDIN_FILENO);
+		dup2(outPipe[1], STDOUT_FILENO);
+		execv(argv[0], argv.GetData());
+		_exit(127);
+	}
+
+	close(inPipe[0]);
+	close(outPipe[1]);
+
+	if (newPID < 0)
+	{
+		close(inPipe[1]);
+		close(outPipe[0]);
+		WV_THROW("Failed to start child process: {}. Error: {}", exePath, errno);
+	}
+
+	pid = newPID;
+	inputFD = inPipe[1];
+	outputFD = outPipe[0];
+}
+
+bool ChildProcess::GetIsRunning() const { return inputFD != -1 && outputFD != -1; }
+
+bool ChildProcess::TryWrite(const void* pSrc, size_t size)
+{
+	const char* pBytes = static_cast<const char*>(pSrc);
+
+	while (inputFD != -1 && size > 0)
+	{
+		const ssize_t written = write(inputFD, pBytes, std::min(size, (size_t)SSIZE_MAX));
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		else if (written <= 0)
+			return false;
+
+		pBytes += written;
+		size -= (size_t)written;
+	}
+
+	return size == 0;
+}
+
+bool ChildProcess::TryRead(void* pDst, size_t size, Clock::time_point deadline)
+{
+	char* pBytes = static_cast<char*>(pDst);
+
+	while (outputFD != -1 && size > 0)
+	{
+		if (deadline != Clock::time_point::max())
+		{
+			pollfd pollInfo = { .fd = outputFD, .events = POLLIN, .revents = 0 };
+			const int readyCount = poll(&pollInfo, 1, (int)std::min(GetTimeoutMS(deadline), (slong)INT_MAX));
+
+			if (readyCount < 0 && errno == EINTR)
+				continue;
+			else if (readyCount <= 0)
+				return false;
+		}
+
+		const ssize_t bytesRead = read(outputFD, pBytes, std::min(size, (size_t)SSIZE_MAX));
+
+		if (bytesRead < 0 && errno == EINTR)
+			continue;
+		else if (bytesRead <= 0)
+			return false;
+
+		pBytes += bytesRead;
+		size -= (size_t)bytesRead;
+	}
+
+	return size == 0;
+}
+
+void ChildProcess::Stop()
+{
+	if (inputFD != -1)
+	{
+		close(inputFD);
+		inputFD = -1;
+	}
+
+	if (pid != -1)
+		waitpid(pid, nullptr, 0);
+
+	Reset();
+}
+
+void ChildProcess::Kill()
+{
+	if (pid != -1)
+	{
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+	}
+
+	Reset();
+}
+
+void ChildProcess::Reset()
+{
+	if (inputFD != -1)
+		close(inputFD);
+
+	if (outputFD != -1)
+		close(outputFD);
+
+	pid = -1;
+	inputFD = -1;
+	outputFD = -1;
+}
+
+string ChildProcess::GetExecutablePath()
+{
+	return std::filesystem::read_symlink("/proc/self/exe").string();
+}
+
+void ChildProcess::InitParentPipes() { }
+
+#endif
+
+ChildProcess::~ChildProcess() { Stop(); }
+
+bool ChildProcess::TryReadParent(void* pDst, size_t size)
+{
+	return fread(pDst, 1, size, stdin) == size;
+}
+
+bool ChildProcess::TryWriteParent(const void* pSrc, size_t size)
+{
+	return fwrite(pSrc, 1, size, stdout) == size && fflush(stdout) == 0;
+}
@@ -2,6 +2,7 @@
 #include <zlib/zlib.h>
 #include "WeaveUtils/Compression.hpp"
 #include "WeaveUtils/Span.hpp"
+#include "WeaveUtils/Metrics.hpp"
 
 using namespace Weave;
 
@@ -76,6 +77,8 @@ void Weave::CompressBytes(const IDynamicArray<byte>& input, ZLibArchive& output)
 
     // Trim output to exact size
     output.data.Resize(outputPos);
+    WV_METRIC_ADD("utils.compress.bytesIn", (slong)input.GetLength());
+    WV_METRIC_ADD("utils.compress.bytesOut", (slong)outputPos);
 
     // Clean up
     deflateEnd(&zlibStream);
@@ -0,0 +1,84 @@
+#include "pch.hpp"
+#include <bit>
+#include <cstring>
+#include "WeaveUtils/ContentHash.hpp"
+
+using namespace Weave;
+
+// MurmurHash3 x64_128, Austin Appleby (public domain)
+static constexpr ulong s_C1 = 0x87c37b91114253d5ull;
+static constexpr ulong s_C2 = 0x4cf5ad432745937full;
+
+static ulong FMix64(ulong k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+static ulong LoadBlock(const byte* pSrc)
+{
+	ulong value;
+	memcpy(&value, pSrc, sizeof(ulong));
+	return value;
+}
+
+Hash128 Weave::GetHash128(const void* pData, size_t size, ulong seed)
+{
+	const byte* pBytes = static_cast<const byte*>(pData);
+	const size_t blockCount = size / 16;
+	ulong h1 = seed;
+	ulong h2 = seed;
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		ulong k1 = LoadBlock(pBytes + i * 16);
+		ulong k2 = LoadBlock(pBytes + i * 16 + 8);
+
+		k1 *= s_C1; k1 = std::rotl(k1, 31); k1 *= s_C2; h1 ^= k1;
+		h1 = std::rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= s_C2; k2 = std::rotl(k2, 33); k2 *= s_C1; h2 ^= k2;
+		h2 = std::rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	// Remaining 0-15 bytes
+	const byte* pTail = pBytes + blockCount * 16;
+	const size_t tailSize = size & 15;
+	ulong k1 = 0;
+	ulong k2 = 0;
+
+	for (size_t i = tailSize; i > 8; i--)
+		k2 ^= (ulong)pTail[i - 1] << ((i - 9) * 8);
+
+	if (tailSize > 8)
+	{
+		k2 *= s_C2; k2 = std::rotl(k2, 33); k2 *= s_C1; h2 ^= k2;
+	}
+
+	for (size_t i = std::min(tailSize, (size_t)8); i > 0; i--)
+		k1 ^= (ulong)pTail[i - 1] << ((i - 1) * 8);
+
+	if (tailSize > 0)
+	{
+		k1 *= s_C1; k1 = std::rotl(k1, 31); k1 *= s_C2; h1 ^= k1;
+	}
+
+	// Finalization
+	h1 ^= (ulong)size;
+	h2 ^= (ulong)size;
+
+	h1 += h2;
+	h2 += h1;
+
+	h1 = FMix64(h1);
+	h2 = FMix64(h2);
+
+	h1 += h2;
+	h2 += h1;
+
+	return { .low = h1, .high = h2 };
+}
@@ -0,0 +1,306 @@
+#include "pch.hpp"
+#include <bit>
+#include "WeaveUtils/Metrics.hpp"
+
+using namespace Weave;
+
+static constexpr uint s_InvalidSlot = g_InvalidID32;
+static constexpr uint s_HistSlotCount = g_MetricHistBucketCount + 1;
+static constexpr std::memory_order s_Relaxed = std::memory_order_relaxed;
+
+static constexpr string_view s_MetricTypeNames[]
+{
+	"counter",
+	"gauge",
+	"histogram"
+};
+
+/*
+	Handles
+*/
+
+MetricCounter::MetricCounter() : slot(s_InvalidSlot) { }
+
+MetricCounter::MetricCounter(uint slot) : slot(slot) { }
+
+void MetricCounter::Add(slong value) const
+{
+	WV_ASSERT_MSG(slot != s_InvalidSlot, "Attempted to update an unregistered counter");
+	Metrics::GetThreadSlots()[slot].fetch_add(value, s_Relaxed);
+}
+
+bool MetricCounter::GetIsValid() const { return slot != s_InvalidSlot; }
+
+MetricGauge::MetricGauge() : slot(s_InvalidSlot) { }
+
+MetricGauge::MetricGauge(uint slot) : slot(slot) { }
+
+void MetricGauge::Set(slong value) const
+{
+	WV_ASSERT_MSG(slot != s_InvalidSlot, "Attempted to update an unregistered gauge");
+	Metrics::GetGlobalSlots()[slot].store(value, s_Relaxed);
+}
+
+void MetricGauge::Add(slong value) const
+{
+	WV_ASSERT_MSG(slot != s_InvalidSlot, "Attempted to update an unregistered gauge");
+	Metrics::GetGlobalSlots()[slot].fetch_add(value, s_Relaxed);
+}
+
+bool MetricGauge::GetIsValid() const { return slot != s_InvalidSlot; }
+
+MetricHistogram::MetricHistogram() : slot(s_InvalidSlot) { }
+
+MetricHistogram::MetricHistogram(uint slot) : slot(slot) { }
+
+void MetricHistogram::Record(slong value) const
+{
+	WV_ASSERT_MSG(slot != s_InvalidSlot, "Attempted to update an unregistered histogram");
+	value = std::max(value, slong(0));
+
+	// Sample count is derived from the buckets, only the sum needs its own slot
+	std::atomic<slong>* pSlots = Metrics::GetThreadSlots() + slot;
+	const uint bucket = (uint)std::bit_width((ulong)value);
+	pSlots[bucket].fetch_add(1, s_Relaxed);
+	pSlots[g_MetricHistBucketCount].fetch_add(value, s_Relaxed);
+}
+
+bool MetricHistogram::GetIsValid() const { return slot != s_InvalidSlot; }
+
+/*
+	Snapshots
+*/
+
+slong MetricSample::GetPercentile(double pct) const
+{
+	WV_ASSERT_MSG(type == MetricTypes::Histogram, "Percentiles are only defined for histograms");
+
+	if (value <= 0)
+		return 0;
+
+	const slong target = std::max((slong)std::ceil(std::clamp(pct, 0.0, 1.0) * (double)value), slong(1));
+	slong count = 0;
+
+	for (uint i = 0; i < (uint)buckets.GetLength(); i++)
+	{
+		count += buckets[i];
+
+		if (count >= target)
+			return (i == 0) ? 0 : (slong)((i < 64) ? ((1ull << i) - 1) : ~0ull >> 1);
+	}
+
+	return std::numeric_limits<slong>::max();
+}
+
+double MetricSample::GetAverage() const
+{
+	WV_ASSERT_MSG(type == MetricTypes::Histogram, "Averages are only defined for histograms");
+	return (value > 0) ? (double)sum / (double)value : 0.0;
+}
+
+const MetricSample* MetricsSnapshot::TryGetSample(string_view name) const
+{
+	for (const MetricSample& sample : samples)
+	{
+		if (sample.name == name)
+			return &sample;
+	}
+
+	return nullptr;
+}
+
+void MetricsSnapshot::WriteText(string& out) const
+{
+	for (const MetricSample& sample : samples)
+	{
+		if (sample.type == MetricTypes::Histogram)
+		{
+			std::format_to(std::back_inserter(out), "{} count={} sum={} avg={:.1f} p50<={} p95<={} p99<={}\n",
+				sample.name, sample.value, sample.sum, sample.GetAverage(),
+				sample.GetPercentile(0.5), sample.GetPercentile(0.95), sample.GetPercentile(0.99));
+		}
+		else
+			std::format_to(std::back_inserter(out), "{} {}\n", sample.name, sample.value);
+	}
+}
+
+/// <summary>
+/// Appends a JSON string literal, escaping quotes, backslashes and control characters
+/// </summary>
+static void AppendJSONString(string_view str, string& out)
+{
+	out.push_back('"');
+
+	for (char ch : str)
+	{
+		if (ch == '"' || ch == '\\')
+		{
+			out.push_back('\\');
+			out.push_back(ch);
+		}
+		else if ((byte)ch < 0x20)
+			std::format_to(std::back_inserter(out), "\\u{:04x}", (uint)ch);
+		else
+			out.push_back(ch);
+	}
+
+	out.push_back('"');
+}
+
+void MetricsSnapshot::WriteJSON(string& out) const
+{
+	out.push_back('{');
+
+	for (uint i = 0; i < (uint)samples.GetLength(); i++)
+	{
+		const MetricSample& sample = samples[i];
+
+		if (i > 0)
+			out.push_back(',');
+
+		AppendJSONString(sample.name, out);
+		std::format_to(std::back_inserter(out), ":{{\"type\":\"{}\",\"value\":{}",
+			s_MetricTypeNames[(uint)sample.type], sample.value);
+
+		if (sample.type == MetricTypes::Histogram)
+		{
+			std::format_to(std::back_inserter(out), ",\"sum\":{},\"p50\":{},\"p95\":{},\"p99\":{},\"buckets\":[",
+				sample.sum, sample.GetPercentile(0.5), sample.GetPercentile(0.95), sample.GetPercentile(0.99));
+
+			for (uint j = 0; j < (uint)sample.buckets.GetLength(); j++)
+			{
+				if (j > 0)
+					out.push_back(',');
+
+				std::format_to(std::back_inserter(out), "{}", sample.buckets[j]);
+			}
+
+			out.push_back(']');
+		}
+
+		out.push_back('}');
+	}
+
+	out.push_back('}');
+}
+
+/*
+	Registry
+*/
+
+Metrics::Metrics() :
+	slotCount(0),
+	pShards(new Shard[WV_METRICS_SHARD_COUNT]()),
+	nextShard(0)
+{ }
+
+Metrics::~Metrics() = default;
+
+Metrics& Metrics::GetInstance()
+{
+	static Metrics s_Instance;
+	return s_Instance;
+}
+
+std::atomic<slong>* Metrics::GetThreadSlots()
+{
+	thread_local std::atomic<slong>* t_pSlots = nullptr;
+
+	if (t_pSlots == nullptr)
+	{
+		Metrics& metrics = GetInstance();
+		const uint shard = metrics.nextShard.fetch_add(1, s_Relaxed) % WV_METRICS_SHARD_COUNT;
+		t_pSlots = metrics.pShards[shard].slots;
+	}
+
+	return t_pSlots;
+}
+
+std::atomic<slong>* Metrics::GetGlobalSlots() { return GetInstance().pShards[0].slots; }
+
+uint Metrics::GetOrAddMetric(string_view name, MetricTypes type)
+{
+	WV_CHECK_MSG(!name.empty(), "Metric names cannot be empty");
+	std::lock_guard lock(regMutex);
+	const auto& it = nameIndexMap.find(string(name));
+
+	if (it != nameIndexMap.end())
+	{
+		const MetricDef& def = defs[it->second];
+		WV_CHECK_MSG(def.type == type, "Metric '{}' already registered as a {}", name, s_MetricTypeNames[(uint)def.type]);
+		return def.slot;
+	}
+
+	const uint size = (type == MetricTypes::Histogram) ? s_HistSlotCount : 1u;
+	WV_CHECK_MSG((slotCount + size) <= WV_METRICS_MAX_SLOTS,
+		"Metric slot limit exceeded registering '{}'. Increase WV_METRICS_MAX_SLOTS.", name);
+
+	MetricDef& def = defs.EmplaceBack();
+	def.name = name;
+	def.type = type;
+	def.slot = slotCount;
+	slotCount += size;
+
+	nameIndexMap.emplace(def.name, (uint)defs.GetLength() - 1);
+	return def.slot;
+}
+
+MetricCounter Metrics::GetCounter(string_view name) { return MetricCounter(GetInstance().GetOrAddMetric(name, MetricTypes::Counter)); }
+
+MetricGauge Metrics::GetGauge(string_view name) { return MetricGauge(GetInstance().GetOrAddMetric(name, MetricTypes::Gauge)); }
+
+MetricHistogram Metrics::GetHistogram(string_view name) { return MetricHistogram(GetInstance().GetOrAddMetric(name, MetricTypes::Histogram)); }
+
+void Metrics::GetSnapshot(MetricsSnapshot& snapshot)
+{
+	Metrics& metrics = GetInstance();
+	std::lock_guard lock(metrics.regMutex);
+	snapshot.samples.Clear();
+
+	for (const MetricDef& def : metrics.defs)
+	{
+		MetricSample& sample = snapshot.samples.EmplaceBack();
+		sample.name = def.name;
+		sample.type = def.type;
+		sample.value = 0;
+		sample.sum = 0;
+		sample.buckets.Clear();
+
+		if (def.type == MetricTypes::Gauge)
+			sample.value = metrics.pShards[0].slots[def.slot].load(s_Relaxed);
+		else if (def.type == MetricTypes::Counter)
+		{
+			for (uint i = 0; i < WV_METRICS_SHARD_COUNT; i++)
+				sample.value += metrics.pShards[i].slots[def.slot].load(s_Relaxed);
+		}
+		else
+		{
+			sample.buckets.Resize(g_MetricHistBucketCount);
+
+			for (uint i = 0; i < WV_METRICS_SHARD_COUNT; i++)
+			{
+				const std::atomic<slong>* pSlots = metrics.pShards[i].slots + def.slot;
+
+				for (uint j = 0; j < g_MetricHistBucketCount; j++)
+					sample.buckets[j] += pSlots[j].load(s_Relaxed);
+
+				sample.sum += pSlots[g_MetricHistBucketCount].load(s_Relaxed);
+			}
+
+			for (slong count : sample.buckets)
+				sample.value += count;
+		}
+	}
+}
+
+void Metrics::Reset()
+{
+	Metrics& metrics = GetInstance();
+	std::lock_guard lock(metrics.regMutex);
+
+	for (uint i = 0; i < WV_METRICS_SHARD_COUNT; i++)
+	{
+		for (uint j = 0; j < metrics.slotCount; j++)
+			metrics.pShards[i].slots[j].store(0, s_Relaxed);
+	}
+}
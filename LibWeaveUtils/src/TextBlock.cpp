@@ -87,16 +87,9 @@ int TextBlock::FindCount(const char ch, const char* pStart) const
 
     size_t remLen = UnsignedDelta(&GetBack(), pStart);
 
+    // std::count is vectorized for characters
     if (pStart >= GetData() && remLen >= 1)
-    {
-        for (size_t i = 0; i <= remLen; i++)
-        {
-            if (pStart[i] == ch)
-            {
-                count++;
-            }
-        }
-    }
+        count = (int)std::count(pStart, pStart + remLen + 1, ch);
 
     return count;
 }
@@ -151,25 +144,18 @@ const char* TextBlock::Find(const char* substr, size_t subLen, const char* pStar
     if (substr[subLen - 1] == '\0')
         subLen--;
 
-    if (pStart >= GetData() && remLen >= subLen)
+    if (subLen > 0 && pStart >= GetData() && remLen >= subLen)
     {
-        for (size_t i = 0; i < remLen; i++)
-        {
-            if (pStart[i] == substr[0])
-            {
-                size_t matchLen = 1;
-
-                for (size_t j = 1; j < subLen; j++)
-                {
-                    if (pStart[i + j] != substr[j])
-                        break;
+        const char* pEnd = pStart + remLen;
+        const char* pCh = pStart;
 
-                    matchLen++;
-                }
+        // Candidates are found with memchr, which is vectorized, and then compared in full
+        while ((pCh = (const char*)memchr(pCh, substr[0], UnsignedDelta(pEnd, pCh))) != nullptr)
+        {
+            if (memcmp(pCh + 1, substr + 1, subLen - 1) == 0)
+                return pCh;
 
-                if (matchLen == subLen)
-                    return &pStart[i];
-            }
+            pCh++;
         }
     }
 
@@ -182,7 +168,7 @@ const char* TextBlock::Find(const char* substr, size_t subLen, const char* pStar
 /// </summary>
 const char* TextBlock::FindWord(const char* pStart, const string_view& breakFilter) const
 {
-    return FindStart(pStart, breakFilter, '!', '~');
+    return FindStart(pStart, CharFilter(breakFilter, '!', '~'));
 }
 
 /// <summary>
@@ -191,7 +177,7 @@ const char* TextBlock::FindWord(const char* pStart, const string_view& breakFilt
 /// </summary>
 const char* TextBlock::FindWordEnd(const char* pStart, const string_view& breakFilter) const
 {
-    return FindEnd(pStart, breakFilter, '!', '~');
+    return FindEnd(pStart, CharFilter(breakFilter, '!', '~'));
 }
 
 /// <summary>
@@ -200,97 +186,89 @@ const char* TextBlock::FindWordEnd(const char* pStart, const string_view& breakF
 /// </summary>
 const char* TextBlock::FindLastWord(const char* pStart, const string_view& breakFilter) const
 {
-    return FindLastStart(pStart, breakFilter, '!', '~');
+    return FindLastStart(pStart, CharFilter(breakFilter, '!', '~'));
 }
 
 TextBlock TextBlock::GetWord(const char* pStart, const string_view& breakFilter, char min, char max) const
 {
-    pStart = FindStart(pStart, breakFilter, min, max);
-    const char* pEnd = FindEnd(pStart, breakFilter, min, max);
-    return TextBlock(pStart, pEnd);
+    return GetWord(pStart, CharFilter(breakFilter, min, max));
 }
 
 TextBlock TextBlock::GetLastWord(const char* pStart, const string_view& breakFilter, char min, char max) const
 {
-    pStart = FindLastStart(pStart, breakFilter, min, max);
-    const char* pEnd = FindEnd(pStart, breakFilter, min, max);
-    return TextBlock(pStart, pEnd);
+    return GetLastWord(pStart, CharFilter(breakFilter, min, max));
 }
 
-const char* TextBlock::Find(const char* substr, size_t subLen, const char* pStart)
+TextBlock TextBlock::GetWord(const char* pStart, const CharFilter& filter) const
 {
-    if (pStart == nullptr)
-        pStart = this->data();
-
-    size_t remLen = UnsignedDelta(&GetBack(), pStart);
-
-    if (substr[subLen - 1] == '\0')
-        subLen--;
-
-    if (pStart >= GetData() && remLen >= subLen)
-    {
-        for (size_t i = 0; i < remLen; i++)
-        {
-            if (pStart[i] == substr[0])
-            {
-                size_t matchLen = 1;
-
-                for (size_t j = 1; j < subLen; j++)
-                {
-                    if (pStart[i + j] != substr[j])
-                        break;
-
-                    matchLen++;
-                }
+    pStart = FindStart(pStart, filter);
+    const char* pEnd = FindEnd(pStart, filter);
+    return TextBlock(pStart, pEnd);
+}
 
-                if (matchLen == subLen)
-                    return &pStart[i];
-            }
-        }
-    }
+TextBlock TextBlock::GetLastWord(const char* pStart, const CharFilter& filter) const
+{
+    pStart = FindLastStart(pStart, filter);
+    const char* pEnd = FindEnd(pStart, filter);
+    return TextBlock(pStart, pEnd);
+}
 
-    return nullptr;
+const char* TextBlock::Find(const char* substr, size_t subLen, const char* pStart)
+{
+    return std::as_const(*this).Find(substr, subLen, pStart);
 }
 
 /// <summary>
 /// Returns pointer to first character in a word found in the text after the given start
 /// </summary>
 const char* TextBlock::FindStart(const char* pStart, const string_view& breakFilter, char min, char max) const
+{
+    return FindStart(pStart, CharFilter(breakFilter, min, max));
+}
+
+/// <summary>
+/// Returns the position of the last character in the word starting at the given pointer
+/// </summary>
+const char* TextBlock::FindEnd(const char* pStart, const string_view& breakFilter, char min, char max) const
+{
+    return FindEnd(pStart, CharFilter(breakFilter, min, max));
+}
+
+/// <summary>
+/// Returns pointer to first character in a word found in the text before the given start
+/// </summary>
+const char* TextBlock::FindLastStart(const char* pStart, const string_view& breakFilter, char min, char max) const
+{
+    return FindLastStart(pStart, CharFilter(breakFilter, min, max));
+}
+
+const char* TextBlock::FindStart(const char* pStart, const CharFilter& filter) const
 {
     pStart = ClampPtr(pStart, GetData(), &GetBack());
 
-    while (pStart < &GetBack() && !(*pStart >= min && *pStart <= max) && breakFilter.find(*pStart) == string::npos)
+    while (pStart < &GetBack() && !filter.GetIsStartChar(*pStart))
         pStart++;
 
     return pStart;
 }
 
-/// <summary>
-/// Returns the position of the last character in the word starting at the given pointer
-/// </summary>
-const char* TextBlock::FindEnd(const char* pStart, const string_view& breakFilter, char min, char max) const
+const char* TextBlock::FindEnd(const char* pStart, const CharFilter& filter) const
 {
     pStart = ClampPtr(pStart, GetData(), &GetBack());
     const char* pCh = pStart;
 
-    while (pCh <= &GetBack() && GetIsRangeChar(*pCh, breakFilter, min, max))
-    {
-        pStart = pCh;
+    while (pCh <= &GetBack() && filter.GetIsRangeChar(*pCh))
         pCh++;
-    }
 
-    return pStart;
+    return pCh > pStart ? pCh - 1 : pStart;
 }
 
-/// <summary>
-/// Returns pointer to first character in a word found in the text before the given start
-/// </summary>
-const char* TextBlock::FindLastStart(const char* pStart, const string_view& breakFilter, char min, char max) const
+const char* TextBlock::FindLastStart(const char* pStart, const CharFilter& filter) const
 {
     pStart = ClampPtr(pStart, GetData(), &GetBack());
     const char* pCh = pStart;
 
-    while (pCh > GetData() && !(*pCh >= min && *pCh <= max) && breakFilter.find(*pCh) == string::npos)
+    while (pCh > GetData() && !filter.GetIsStartChar(*pCh))
         pCh--;
 
     do
@@ -298,7 +276,7 @@ const char* TextBlock::FindLastStart(const char* pStart, const string_view& brea
         pStart = pCh;
         pCh--;
     } 
-    while (pCh >= GetData() && GetIsRangeChar(*pCh, breakFilter, min, max));
+    while (pCh >= GetData() && filter.GetIsRangeChar(*pCh));
 
     return pStart;
 }
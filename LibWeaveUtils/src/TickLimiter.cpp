@@ -1,10 +1,20 @@
 #include "pch.hpp"
-#include "WeaveUtils/Win32.hpp"
 #include "WeaveUtils/TickLimiter.hpp"
+#include "WeaveUtils/StatsRecorder.hpp"
 #include <thread>
+
+#ifdef _WIN32
+#include "WeaveUtils/Win32.hpp"
 #include <timeapi.h>
 #include <intrin.h>
 #pragma comment(lib, "winmm.lib")
+#else
+#include <time.h>
+#include <cerrno>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#endif
 
 using namespace Weave;
 
@@ -23,7 +33,7 @@ static slong GetClampedEMA(slong value, slong avgValue)
 
 static slong GetSignedClampedEMA(slong value, slong avgValue)
 {
-	const slong absErrRange = std::min(3ll * std::abs(avgValue), slong(1E6));
+	const slong absErrRange = std::min(slong(3) * std::abs(avgValue), slong(1E6));
 
 	if (absErrRange > 0)
 		value = std::clamp(value, -3 * absErrRange, 3 * absErrRange);
@@ -31,16 +41,51 @@ static slong GetSignedClampedEMA(slong value, slong avgValue)
 	return static_cast<slong>(0.9 * avgValue + 0.1 * value);
 }
 
+/// <summary>
+/// Hints to the CPU that the calling thread is in a busy wait
+/// </summary>
+static void SpinPause()
+{
+#if defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+#ifndef _WIN32
+// Default Linux timer slack. Sleeps are not expected to wake more precisely than this.
+static constexpr slong s_MinSleepQuantumNS = slong(5E4);
+
+/// <summary>
+/// Blocks until the given time on the limiter's timeline, using an absolute deadline on the
+/// monotonic clock to avoid accumulating wake-up drift across signal interruptions.
+/// </summary>
+static void SleepUntilNS(slong targetNS, slong nowNS)
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	const slong deadlineNS = slong(ts.tv_sec) * slong(1E9) + ts.tv_nsec + std::max(targetNS - nowNS, slong(0));
+	ts.tv_sec = (time_t)(deadlineNS / slong(1E9));
+	ts.tv_nsec = (long)(deadlineNS % slong(1E9));
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+}
+#endif
+
 TickLimiter::TickLimiter() :
 	targetTickNS(0),
 	targetTickTimeNS(0),
 	canHighResSleep(false),
 	avgTickErrorNS(slong(1E6)),
 	avgSpinErrorNS(slong(1E6)),
+	avgSleepErrorNS(0),
 	avgTickDeltaNS(slong(1E6)),
 	lastTickNS(0),
 	tickCount(0)
 {
+#ifdef _WIN32
 	UINT desiredResolutionMS = 1;
 	TIMECAPS tc;
 
@@ -55,13 +100,31 @@ TickLimiter::TickLimiter() :
 	else
 		sysInterruptTickMS = 10;
 
+	sleepQuantumNS = slong(1E6) * sysInterruptTickMS;
+#else
+	timespec res;
+	sysInterruptTickMS = 1;
+
+	// High resolution timers report 1ns. Actual wake-up latency is dominated by timer slack,
+	// and is tracked separately by avgSleepErrorNS.
+	if (clock_getres(CLOCK_MONOTONIC, &res) == 0 && res.tv_sec == 0 && res.tv_nsec <= slong(1E6))
+	{
+		sleepQuantumNS = std::max(slong(res.tv_nsec), s_MinSleepQuantumNS);
+		canHighResSleep = true;
+	}
+	else
+		sleepQuantumNS = slong(1E7);
+#endif
+
 	tickTimer.Start();
 }
 
 TickLimiter::~TickLimiter()
 {
+#ifdef _WIN32
 	if (canHighResSleep)
 		timeEndPeriod(sysInterruptTickMS);
+#endif
 }
 
 bool TickLimiter::GetCanUseHighResSleep() const { return canHighResSleep; }
@@ -81,8 +144,8 @@ void TickLimiter::BeginTick()
 
 void TickLimiter::WaitTick(slong spinLimit)
 {
-	// Convert to MS and double
-	const slong sysTickMaxNS = slong(2E6) * sysInterruptTickMS;
+	// Double the sleep quantum
+	const slong sysTickMaxNS = 2 * sleepQuantumNS;
 
 	// Target time invalid or too fast to wait efficiently
 	if (canHighResSleep && (targetTickTimeNS <= sysTickMaxNS || targetTickTimeNS <= 0))
@@ -92,23 +155,34 @@ void TickLimiter::WaitTick(slong spinLimit)
 	const slong sleepMinNS = (spinLimit > 0) ? sleepStartNS + sysTickMaxNS : 0;
 	// Bias toward sleep based on avg spin time
 	const slong sleepEndNS = std::max(targetTickNS, sleepMinNS) + avgSpinErrorNS;
-	slong waitNS = std::max(sleepEndNS - sleepStartNS, 0ll);
+	slong waitNS = std::max(sleepEndNS - sleepStartNS, slong(0));
 
+#ifdef _WIN32
 	// Precision sleep, not perfect, but usually fine
 	while (waitNS > sysTickMaxNS)
 	{
 		std::this_thread::sleep_for(std::chrono::milliseconds(sysInterruptTickMS));
-		waitNS = std::max(sleepEndNS - tickTimer.GetElapsedNS(), 0ll);
+		waitNS = std::max(sleepEndNS - tickTimer.GetElapsedNS(), slong(0));
 	}
+#else
+	// Absolute monotonic sleep, woken early by the average oversleep to leave room for the spin
+	const slong wakeNS = sleepEndNS - std::max(avgSleepErrorNS, sleepQuantumNS);
+
+	if (waitNS > sysTickMaxNS && wakeNS > sleepStartNS)
+	{
+		SleepUntilNS(wakeNS, tickTimer.GetElapsedNS());
+		avgSleepErrorNS = GetSignedClampedEMA(tickTimer.GetElapsedNS() - wakeNS, avgSleepErrorNS);
+	}
+#endif
 
 	// Spin for precise timing, if allowed
 	const slong spinStartNS = tickTimer.GetElapsedNS();
-	waitNS = std::clamp(targetTickNS - tickTimer.GetElapsedNS(), 0ll, spinLimit);
+	waitNS = std::clamp(targetTickNS - tickTimer.GetElapsedNS(), slong(0), spinLimit);
 
 	while (waitNS > slong(1E5))
 	{
-		_mm_pause();
-		waitNS = std::max(targetTickNS - tickTimer.GetElapsedNS(), 0ll);
+		SpinPause();
+		waitNS = std::max(targetTickNS - tickTimer.GetElapsedNS(), slong(0));
 	}
 
 	avgSpinErrorNS = GetSignedClampedEMA(tickTimer.GetElapsedNS() - spinStartNS, avgSpinErrorNS);
@@ -125,3 +199,45 @@ void TickLimiter::EndTick()
 
 	tickCount++;
 }
+
+TickJitterStats TickLimiter::GetJitterStats(slong targetTickTimeNS, uint tickCount, slong spinLimit)
+{
+	WV_CHECK_MSG(targetTickTimeNS > 0 && tickCount > 0, "Jitter benchmark requires a positive tick time and count");
+
+	TickLimiter limiter;
+	StatsRecorder<slong> errors(tickCount);
+	Stopwatch timer;
+	slong lastTickNS = 0;
+
+	limiter.SetTargetTickTimeNS(targetTickTimeNS);
+	timer.Start();
+
+	// Discard the first tick, the EMA model needs a reference point
+	for (uint i = 0; i <= tickCount; i++)
+	{
+		limiter.BeginTick();
+		limiter.WaitTick(spinLimit);
+		limiter.EndTick();
+
+		const slong tickNS = timer.GetElapsedNS();
+
+		if (i > 0)
+		{
+			const slong errorNS = (tickNS - lastTickNS) - targetTickTimeNS;
+			errors.AddValue(std::abs(errorNS));
+		}
+
+		lastTickNS = tickNS;
+	}
+
+	return TickJitterStats
+	{
+		.targetNS = targetTickTimeNS,
+		.avgTickNS = limiter.GetAverageTickTimeNS(),
+		.avgErrorNS = errors.GetAverage(),
+		.p50ErrorNS = errors.GetPercentile(0.5),
+		.p95ErrorNS = errors.GetPercentile(0.95),
+		.p99ErrorNS = errors.GetPercentile(0.99),
+		.maxErrorNS = errors.GetMax()
+	};
+}
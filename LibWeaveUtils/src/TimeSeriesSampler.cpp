@@ -0,0 +1,311 @@
+#include "pch.hpp"
+#include <condition_variable>
+#include "WeaveUtils/TimeSeriesSampler.hpp"
+
+using namespace Weave;
+
+static constexpr std::memory_order s_Relaxed = std::memory_order_relaxed;
+
+// Bucket length for each tier. Raw samples are not bucketed.
+static constexpr slong s_TierPeriodsNS[g_SampleTierCount]
+{
+	0,
+	slong(1E9),
+	slong(1E10),
+	slong(6E10)
+};
+
+// Ring data is read concurrently by snapshots, and accessed through relaxed atomics to keep the
+// seqlock free of data races. These compile to plain loads and stores.
+template<typename T>
+static void StoreRelaxed(T& dst, T value) { std::atomic_ref<T>(dst).store(value, s_Relaxed); }
+
+template<typename T>
+static T LoadRelaxed(const T& src) { return std::atomic_ref<T>(const_cast<T&>(src)).load(s_Relaxed); }
+
+void SeriesSnapshot::Clear()
+{
+	timesNS.Clear();
+	avgValues.Clear();
+	minValues.Clear();
+	maxValues.Clear();
+}
+
+TimeSeriesSampler::TimeSeriesSampler(slong samplePeriodNS, uint rawCapacity, uint tierCapacity) :
+	samplePeriodNS(samplePeriodNS),
+	isInitialized(false)
+{
+	WV_CHECK_MSG(samplePeriodNS > 0 && samplePeriodNS <= s_TierPeriodsNS[1],
+		"Sample period must be on (0, 1s]. Got {}ns.", samplePeriodNS);
+	WV_CHECK_MSG(rawCapacity > 0 && tierCapacity > 0, "Time series capacities must be non-zero");
+
+	for (uint i = 0; i < g_SampleTierCount; i++)
+	{
+		Tier& tier = tiers[i];
+		tier.periodNS = s_TierPeriodsNS[i];
+		tier.capacity = (i == 0) ? rawCapacity : tierCapacity;
+		tier.seq.store(0, s_Relaxed);
+		tier.count.store(0, s_Relaxed);
+		tier.bucketStartNS = 0;
+		tier.accCount = 0;
+	}
+}
+
+TimeSeriesSampler::~TimeSeriesSampler() { Stop(); }
+
+uint TimeSeriesSampler::AddSeries(string_view name, SourceFunc&& source)
+{
+	WV_CHECK_MSG(!isInitialized, "Series must be added before sampling begins");
+	WV_CHECK_MSG(TryGetSeriesID(name) == g_InvalidID32, "Duplicate time series name '{}'", name);
+
+	SeriesDef& def = seriesDefs.EmplaceBack();
+	def.name = name;
+	def.source = std::move(source);
+	def.pushedValue = 0.0;
+
+	return (uint)seriesDefs.GetLength() - 1;
+}
+
+uint TimeSeriesSampler::GetSeriesCount() const { return (uint)seriesDefs.GetLength(); }
+
+string_view TimeSeriesSampler::GetSeriesName(uint seriesID) const { return seriesDefs[seriesID].name; }
+
+uint TimeSeriesSampler::TryGetSeriesID(string_view name) const
+{
+	for (uint i = 0; i < (uint)seriesDefs.GetLength(); i++)
+	{
+		if (seriesDefs[i].name == name)
+			return i;
+	}
+
+	return g_InvalidID32;
+}
+
+void TimeSeriesSampler::SetValue(uint seriesID, double value)
+{
+	WV_ASSERT_MSG(seriesID < GetSeriesCount(), "Time series ID out of range");
+	StoreRelaxed(seriesDefs[seriesID].pushedValue, value);
+}
+
+slong TimeSeriesSampler::GetSamplePeriodNS() const { return samplePeriodNS; }
+
+void TimeSeriesSampler::Start()
+{
+	WV_CHECK_MSG(!GetIsRunning(), "Time series sampler already running");
+	InitBuffers();
+
+	samplerThread = std::jthread([this](std::stop_token stop)
+	{
+		using SteadyClock = std::chrono::steady_clock;
+		const SteadyClock::duration period = std::chrono::nanoseconds(samplePeriodNS);
+		std::mutex waitMutex;
+		std::condition_variable_any waitCond;
+		SteadyClock::time_point nextSample = SteadyClock::now();
+
+		while (!stop.stop_requested())
+		{
+			WriteSample();
+			nextSample += period;
+
+			// Drop missed samples rather than bursting to catch up
+			const SteadyClock::time_point now = SteadyClock::now();
+
+			if (nextSample < now)
+				nextSample = now;
+
+			// Wakes early on stop request
+			std::unique_lock lock(waitMutex);
+			waitCond.wait_until(lock, stop, nextSample, [] { return false; });
+		}
+	});
+}
+
+void TimeSeriesSampler::Stop()
+{
+	if (samplerThread.joinable())
+	{
+		samplerThread.request_stop();
+		samplerThread.join();
+	}
+}
+
+bool TimeSeriesSampler::GetIsRunning() const { return samplerThread.joinable(); }
+
+void TimeSeriesSampler::Sample()
+{
+	WV_CHECK_MSG(!GetIsRunning(), "Manual sampling is not allowed while the sampler thread is running");
+	InitBuffers();
+	WriteSample();
+}
+
+void TimeSeriesSampler::GetSnapshot(uint seriesID, SampleTiers tierID, SeriesSnapshot& snapshot) const
+{
+	WV_CHECK_MSG(seriesID < GetSeriesCount(), "Time series ID out of range");
+	snapshot.Clear();
+
+	if (!isInitialized)
+		return;
+
+	const Tier& tier = tiers[(uint)tierID];
+	const uint offset = seriesID * tier.capacity;
+	const bool isRaw = (tierID == SampleTiers::Raw);
+
+	while (true)
+	{
+		const ulong seq = tier.seq.load(std::memory_order_acquire);
+
+		if ((seq & 1) != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const ulong count = tier.count.load(s_Relaxed);
+		const uint length = (uint)std::min(count, (ulong)tier.capacity);
+		const uint start = (count > tier.capacity) ? (uint)(count % tier.capacity) : 0u;
+
+		snapshot.timesNS.Resize(length);
+		snapshot.avgValues.Resize(length);
+		snapshot.minValues.Resize(length);
+		snapshot.maxValues.Resize(length);
+
+		for (uint i = 0; i < length; i++)
+		{
+			const uint pos = (start + i) % tier.capacity;
+			const double avg = LoadRelaxed(tier.avgValues[offset + pos]);
+
+			snapshot.timesNS[i] = LoadRelaxed(tier.timesNS[pos]);
+			snapshot.avgValues[i] = avg;
+			snapshot.minValues[i] = isRaw ? avg : LoadRelaxed(tier.minValues[offset + pos]);
+			snapshot.maxValues[i] = isRaw ? avg : LoadRelaxed(tier.maxValues[offset + pos]);
+		}
+
+		// Order the copy before the sequence recheck
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (tier.seq.load(s_Relaxed) == seq)
+			break;
+	}
+}
+
+void TimeSeriesSampler::InitBuffers()
+{
+	if (isInitialized)
+		return;
+
+	const uint seriesCount = GetSeriesCount();
+	sampleValues = UniqueArray<double>(seriesCount, 0.0);
+	bucketAvgs = UniqueArray<double>(seriesCount, 0.0);
+
+	for (uint i = 0; i < g_SampleTierCount; i++)
+	{
+		Tier& tier = tiers[i];
+		const uint ringSize = seriesCount * tier.capacity;
+
+		tier.timesNS = UniqueArray<slong>(tier.capacity, slong(0));
+		tier.avgValues = UniqueArray<double>(ringSize, 0.0);
+
+		// Raw samples have no range
+		if (i > 0)
+		{
+			tier.minValues = UniqueArray<double>(ringSize, 0.0);
+			tier.maxValues = UniqueArray<double>(ringSize, 0.0);
+			tier.accSums = UniqueArray<double>(seriesCount, 0.0);
+			tier.accMins = UniqueArray<double>(seriesCount, 0.0);
+			tier.accMaxs = UniqueArray<double>(seriesCount, 0.0);
+		}
+	}
+
+	sampleTimer.Start();
+	isInitialized = true;
+}
+
+void TimeSeriesSampler::WriteSample()
+{
+	const slong timeNS = sampleTimer.GetElapsedNS();
+	double* pValues = sampleValues.GetData();
+
+	for (uint i = 0; i < GetSeriesCount(); i++)
+	{
+		const SeriesDef& def = seriesDefs[i];
+		pValues[i] = def.source ? def.source() : LoadRelaxed(def.pushedValue);
+	}
+
+	WriteTier(tiers[0], timeNS, pValues, nullptr, nullptr);
+	Accumulate(1, timeNS, 1, pValues, pValues, pValues);
+}
+
+void TimeSeriesSampler::Accumulate(uint tierIndex, slong timeNS, ulong count, const double* pSums, const double* pMins, const double* pMaxs)
+{
+	Tier& tier = tiers[tierIndex];
+	const slong bucketStartNS = timeNS - (timeNS % tier.periodNS);
+
+	if (tier.accCount > 0 && bucketStartNS != tier.bucketStartNS)
+		FlushBucket(tierIndex);
+
+	if (tier.accCount == 0)
+	{
+		tier.bucketStartNS = bucketStartNS;
+		SetArrNull(tier.accSums);
+		std::copy(pMins, pMins + GetSeriesCount(), tier.accMins.GetData());
+		std::copy(pMaxs, pMaxs + GetSeriesCount(), tier.accMaxs.GetData());
+	}
+
+	for (uint i = 0; i < GetSeriesCount(); i++)
+	{
+		tier.accSums[i] += pSums[i];
+		tier.accMins[i] = std::min(tier.accMins[i], pMins[i]);
+		tier.accMaxs[i] = std::max(tier.accMaxs[i], pMaxs[i]);
+	}
+
+	tier.accCount += count;
+}
+
+void TimeSeriesSampler::FlushBucket(uint tierIndex)
+{
+	Tier& tier = tiers[tierIndex];
+	// Sums are forwarded unchanged so that coarser averages stay sample weighted
+	double* pAvgs = bucketAvgs.GetData();
+
+	for (uint i = 0; i < GetSeriesCount(); i++)
+		pAvgs[i] = tier.accSums[i] / (double)tier.accCount;
+
+	WriteTier(tier, tier.bucketStartNS, pAvgs, tier.accMins.GetData(), tier.accMaxs.GetData());
+
+	if ((tierIndex + 1) < g_SampleTierCount)
+	{
+		Accumulate(tierIndex + 1, tier.bucketStartNS, tier.accCount,
+			tier.accSums.GetData(), tier.accMins.GetData(), tier.accMaxs.GetData());
+	}
+
+	tier.accCount = 0;
+}
+
+void TimeSeriesSampler::WriteTier(Tier& tier, slong timeNS, const double* pAvgs, const double* pMins, const double* pMaxs)
+{
+	const ulong count = tier.count.load(s_Relaxed);
+	const ulong seq = tier.seq.load(s_Relaxed);
+	const uint pos = (uint)(count % tier.capacity);
+	const uint seriesCount = (uint)(tier.avgValues.GetLength() / tier.capacity);
+
+	// Mark write in progress, and keep the data stores below from moving above it
+	tier.seq.store(seq + 1, s_Relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	StoreRelaxed(tier.timesNS[pos], timeNS);
+
+	for (uint i = 0; i < seriesCount; i++)
+	{
+		const uint index = i * tier.capacity + pos;
+		StoreRelaxed(tier.avgValues[index], pAvgs[i]);
+
+		if (pMins != nullptr)
+		{
+			StoreRelaxed(tier.minValues[index], pMins[i]);
+			StoreRelaxed(tier.maxValues[index], pMaxs[i]);
+		}
+	}
+
+	tier.count.store(count + 1, s_Relaxed);
+	tier.seq.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,78 @@
+#include "pch.hpp"
+#include "WeaveUtils/TscClock.hpp"
+
+#if WV_TSC_SUPPORTED && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+using namespace Weave;
+using SteadyClock = std::chrono::steady_clock;
+
+// Length of the one-time frequency measurement. Longer intervals reduce quantization error from
+// the reference clock.
+static constexpr slong s_CalibrationTimeNS = slong(2E7);
+
+/// <summary>
+/// Returns true if the CPU reports a constant rate TSC that continues ticking in deep C-states
+/// </summary>
+static bool GetHasInvariantTSC()
+{
+#if WV_TSC_SUPPORTED
+	uint regs[4] = {};
+
+#ifdef _MSC_VER
+	__cpuid(reinterpret_cast<int*>(regs), 0x80000000);
+
+	if (regs[0] < 0x80000007)
+		return false;
+
+	__cpuid(reinterpret_cast<int*>(regs), 0x80000007);
+#else
+	if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+		return false;
+
+	__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+
+	// EDX bit 8: Invariant TSC
+	return (regs[3] & (1u << 8u)) != 0;
+#else
+	return false;
+#endif
+}
+
+static slong GetSteadyNS()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now().time_since_epoch()).count();
+}
+
+TscClock::Calibration TscClock::GetNewCalibration()
+{
+	Calibration calib = {};
+	calib.isInvariant = GetHasInvariantTSC();
+
+#if WV_TSC_SUPPORTED
+	if (calib.isInvariant)
+	{
+		uint aux;
+		const slong startNS = GetSteadyNS();
+		const ulong startTicks = __rdtscp(&aux);
+		slong endNS = startNS;
+
+		// Busy wait to avoid scheduler wake-up latency skewing the measurement
+		while ((endNS - startNS) < s_CalibrationTimeNS)
+			endNS = GetSteadyNS();
+
+		const ulong endTicks = __rdtscp(&aux);
+		const double ticks = (double)(endTicks - startTicks);
+		const double elapsedNS = (double)(endNS - startNS);
+
+		calib.frequencyHz = 1E9 * ticks / elapsedNS;
+		calib.nsPerTick = (ulong)(4294967296.0 * elapsedNS / ticks);
+		calib.baseTicks = endTicks;
+		calib.baseNS = endNS;
+	}
+#endif
+
+	return calib;
+}